@@ -0,0 +1,124 @@
+// ขับ heap_frag ด้วย stand-in backend บน host: ผลรวม/histogram/capacity, แบ่ง step ตาม budget, แนวโน้ม
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "heap_frag.h"
+
+static int s_fail = 0;
+
+#define CHECK(cond)                                                      \
+    do                                                                   \
+    {                                                                    \
+        if (!(cond))                                                     \
+        {                                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);       \
+            s_fail++;                                                    \
+        }                                                                \
+    } while (0)
+
+// region A นับเป็นทั้ง INTERNAL และ DMA, region B เป็น INTERNAL อย่างเดียว, ไม่มี SPIRAM
+static heap_frag_block_t s_a[] = {
+    {0x1000, 100, false},
+    {0x1080, 200, true},
+    {0x1200, 5000, false},
+};
+static heap_frag_block_t s_b[] = {
+    {0x8000, 16, false},
+    {0x8020, 1024, false},
+    {0x8500, 64, true},
+};
+static const heap_frag_standin_t s_heaps[] = {
+    {HEAP_FRAG_CLASS_BIT(HEAP_FRAG_INTERNAL) | HEAP_FRAG_CLASS_BIT(HEAP_FRAG_DMA), s_a, 3},
+    {HEAP_FRAG_CLASS_BIT(HEAP_FRAG_INTERNAL), s_b, 3},
+    {0, NULL, 0},
+};
+
+static int64_t s_now = 0;
+static int64_t fake_now(void)
+{
+    return s_now += 1000;
+}
+
+static void init(void)
+{
+    heap_frag_backend_t be;
+    heap_frag_standin_backend(&be, s_heaps);
+    be.now_us = fake_now;
+    CHECK(heap_frag_init(&be));
+}
+
+static void test_sums(void)
+{
+    init();
+    heap_frag_report_t r;
+    CHECK(!heap_frag_get(HEAP_FRAG_INTERNAL, &r)); // ยังไม่มี sweep ที่จบ
+    heap_frag_sweep();
+
+    CHECK(heap_frag_get(HEAP_FRAG_INTERNAL, &r));
+    CHECK(r.sweep == 0);
+    CHECK(r.s.regions == 2);
+    CHECK(r.s.free_blocks == 4 && r.s.free_bytes == 6140);
+    CHECK(r.s.used_blocks == 2 && r.s.used_bytes == 264);
+    CHECK(r.s.largest == 5000);
+    CHECK(r.s.hist[1] == 1 && r.s.hist[3] == 1 && r.s.hist[7] == 1 && r.s.hist[9] == 1);
+    // (size + 8) / (req + 8) ต่อ free block
+    const uint32_t cap[HEAP_FRAG_NREQ] = {84, 21, 5, 1, 0};
+    CHECK(memcmp(r.s.capacity, cap, sizeof(cap)) == 0);
+    CHECK(fabsf(r.frag - (1.0f - 5000.0f / 6140.0f)) < 1e-6f);
+    CHECK(r.cap_loss[4] == 0.0f); // 6140 B ไม่พอแม้หนึ่งก้อน 16 KB → ไม่นับว่าเสีย
+    CHECK(r.sweep_us > 0);
+
+    CHECK(heap_frag_get(HEAP_FRAG_DMA, &r));
+    CHECK(r.s.regions == 1 && r.s.free_bytes == 5100 && r.s.free_blocks == 2);
+
+    CHECK(heap_frag_get(HEAP_FRAG_SPIRAM, &r));
+    CHECK(r.s.regions == 0 && r.s.free_bytes == 0);
+}
+
+// budget 1: หนึ่ง step เดินหนึ่ง block ผลต้องเท่ากับเดินทีเดียว
+static void test_budget(void)
+{
+    init();
+    heap_frag_report_t r;
+    uint32_t steps = 0;
+    while (!heap_frag_get(HEAP_FRAG_INTERNAL, &r))
+    {
+        CHECK(heap_frag_step(1) <= 1);
+        steps++;
+    }
+    CHECK(steps == 7); // 6 block + step ที่พบว่าไม่มี region ถัดไป
+    CHECK(r.steps == steps);
+    CHECK(r.s.regions == 2 && r.s.free_bytes == 6140 && r.s.used_blocks == 2);
+    CHECK(heap_frag_step(0) == 0);
+}
+
+static void test_trend(void)
+{
+    init();
+    heap_frag_report_t r;
+    heap_frag_sweep();
+    s_b[1].used = true; // ก้อน 1024 ถูกจองไประหว่าง sweep
+    heap_frag_sweep();
+    s_b[1].used = false;
+
+    CHECK(heap_frag_get(HEAP_FRAG_INTERNAL, &r));
+    CHECK(r.sweep == 1);
+    CHECK(r.trend_len == 2);
+    CHECK(r.free_delta == -1024);
+    CHECK(r.largest_delta == 0);
+    CHECK(r.frag_delta < 0.0f); // free ลดแต่ largest เท่าเดิม → 1 - largest/free ลดลง
+
+    CHECK(heap_frag_get(HEAP_FRAG_DMA, &r));
+    CHECK(r.free_delta == 0); // region B ไม่ใช่ DMA
+}
+
+int main(void)
+{
+    CHECK(!heap_frag_init(NULL));
+    test_sums();
+    test_budget();
+    test_trend();
+    printf("%s: %d failure(s)\n", s_fail ? "FAIL" : "OK", s_fail);
+    return s_fail ? 1 : 0;
+}
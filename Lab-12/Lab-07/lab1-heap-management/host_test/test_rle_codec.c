@@ -0,0 +1,272 @@
+// rle_codec บน host: COMPAT ต้องได้ stream เดียวกับ encoder เดิมทุกไบต์ (ทั้ง one-shot และแบบท่อน)
+// ถอดข้ามกันได้ทั้งสองทาง, LONG mode กับ run ยาว, และการถอดที่ output จำกัดแล้วต่อได้
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rle_codec.h"
+
+static int s_fail = 0;
+
+#define CHECK(cond)                                                      \
+    do                                                                   \
+    {                                                                    \
+        if (!(cond))                                                     \
+        {                                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);       \
+            s_fail++;                                                    \
+        }                                                                \
+    } while (0)
+
+/* ---------- encoder/decoder เดิม (rle_compress/rle_decompress ก่อนมี rle_codec) ---------- */
+static size_t old_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity)
+{
+    size_t in_pos = 0, out_pos = 0;
+    while (in_pos < in_len)
+    {
+        size_t run_len = 1;
+        while (in_pos + run_len < in_len && run_len < 127 && in[in_pos + run_len] == in[in_pos])
+            run_len++;
+        if (run_len >= 3)
+        {
+            uint8_t header = (uint8_t)(257 - run_len); // 129..255
+            if (out_pos + 2 > out_capacity)
+                break;
+            out[out_pos++] = header;
+            out[out_pos++] = in[in_pos];
+            in_pos += run_len;
+        }
+        else
+        {
+            size_t lit_start = in_pos, lit_len = 0;
+            while (in_pos < in_len && lit_len < 128)
+            {
+                if (in_pos + 2 < in_len && in[in_pos] == in[in_pos + 1] && in[in_pos] == in[in_pos + 2])
+                    break;
+                in_pos++;
+                lit_len++;
+            }
+            if (lit_len > 0)
+            {
+                if (out_pos + 1 + lit_len > out_capacity)
+                    break;
+                out[out_pos++] = (uint8_t)(lit_len - 1);
+                memcpy(out + out_pos, in + lit_start, lit_len);
+                out_pos += lit_len;
+            }
+        }
+    }
+    return out_pos;
+}
+
+static size_t old_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity)
+{
+    size_t in_pos = 0, out_pos = 0;
+    while (in_pos < in_len && out_pos < out_capacity)
+    {
+        uint8_t header = in[in_pos++];
+        if (header <= 127)
+        {
+            size_t lit_len = (size_t)header + 1;
+            if (in_pos + lit_len > in_len || out_pos + lit_len > out_capacity)
+                break;
+            memcpy(out + out_pos, in + in_pos, lit_len);
+            in_pos += lit_len;
+            out_pos += lit_len;
+        }
+        else if (header >= 129)
+        {
+            size_t rep_len = 257 - (size_t)header;
+            if (in_pos >= in_len || out_pos + rep_len > out_capacity)
+                break;
+            uint8_t value = in[in_pos++];
+            memset(out + out_pos, value, rep_len);
+            out_pos += rep_len;
+        }
+    }
+    return out_pos;
+}
+
+/* ---------- ข้อมูลทดสอบ ---------- */
+#define MAX_LEN (64 * 1024)
+
+static uint32_t s_rng = 1;
+static uint32_t rnd(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return s_rng >> 8;
+}
+
+// ผสม run ความยาวต่าง ๆ (รวม 1, 2, 3, 127, 128, 129, ยาวมาก) กับ literal ยาวรอบ ๆ 128
+static size_t gen(uint8_t *buf, size_t cap, int kind)
+{
+    size_t n = 0;
+    while (n < cap)
+    {
+        uint32_t r = rnd();
+        size_t len;
+        switch (kind)
+        {
+        case 0: // สุ่มล้วน: แทบไม่มี run
+            buf[n++] = (uint8_t)r;
+            continue;
+        case 1: // run สั้น ๆ ปนกัน
+            len = 1 + r % 6;
+            break;
+        case 2: // run รอบขอบ 127/128 และ literal รอบ 128
+            len = (r & 1) ? 125 + (r >> 1) % 6 : 1;
+            break;
+        default: // sensor-like: ค่าค้างนาน + noise
+            len = (r % 4) ? 16 + (r >> 4) % 600 : 1 + (r >> 4) % 4;
+            break;
+        }
+        uint8_t v = (uint8_t)(r >> 16);
+        for (size_t k = 0; k < len && n < cap; k++)
+            buf[n++] = (kind == 2 && len == 1) ? (uint8_t)rnd() : v;
+    }
+    return n;
+}
+
+// encode แบบแบ่งท่อนสุ่ม (ขอบท่อนตกกลาง run/literal ได้)
+static size_t enc_chunked(rle_mode_t mode, const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+    rle_enc_t e;
+    rle_enc_init(&e, mode);
+    size_t o = 0;
+    for (size_t off = 0; off < len;)
+    {
+        size_t take = 1 + rnd() % 300;
+        if (take > len - off)
+            take = len - off;
+        size_t w = rle_enc_update(&e, in + off, take, out + o, cap - o);
+        if (w == RLE_ERR)
+            return RLE_ERR;
+        o += w;
+        off += take;
+    }
+    size_t w = rle_enc_finish(&e, out + o, cap - o);
+    return w == RLE_ERR ? RLE_ERR : o + w;
+}
+
+// ถอดโดยให้ input/output ทีละท่อนเล็ก ๆ ต่อ state ข้ามการเรียก
+static size_t dec_chunked(rle_mode_t mode, const uint8_t *in, size_t len, uint8_t *out, size_t cap, size_t out_step)
+{
+    rle_dec_t d;
+    rle_dec_init(&d, mode);
+    size_t i = 0, o = 0;
+    while (i < len || (!rle_dec_finish(&d) && o < cap))
+    {
+        size_t in_take = 1 + rnd() % 64;
+        if (in_take > len - i)
+            in_take = len - i;
+        size_t out_take = out_step < cap - o ? out_step : cap - o;
+        size_t used = 0;
+        size_t w = rle_dec_update(&d, in + i, in_take, &used, out + o, out_take);
+        if (!w && !used)
+            break;
+        i += used;
+        o += w;
+    }
+    return (i == len && rle_dec_finish(&d)) ? o : RLE_ERR;
+}
+
+static uint8_t s_src[MAX_LEN], s_old[MAX_LEN * 2], s_new[MAX_LEN * 2], s_out[MAX_LEN + 64];
+
+static void test_compat_identical(void)
+{
+    static const size_t lens[] = {0, 1, 2, 3, 4, 127, 128, 129, 130, 255, 256, 257, 1000, MAX_LEN};
+    for (int kind = 0; kind < 4; kind++)
+    {
+        for (size_t li = 0; li < sizeof(lens) / sizeof(lens[0]); li++)
+        {
+            size_t n = gen(s_src, lens[li], kind);
+            size_t olen = old_compress(s_src, n, s_old, sizeof(s_old));
+            size_t nlen = rle_encode(RLE_MODE_COMPAT, s_src, n, s_new, sizeof(s_new));
+            CHECK(nlen == olen && memcmp(s_old, s_new, olen) == 0);
+
+            nlen = enc_chunked(RLE_MODE_COMPAT, s_src, n, s_new, sizeof(s_new));
+            CHECK(nlen == olen && memcmp(s_old, s_new, olen) == 0);
+
+            // ถอดข้ามกัน: decoder เดิมอ่าน stream ใหม่ และ decoder ใหม่อ่าน stream เดิม
+            CHECK(old_decompress(s_new, nlen, s_out, sizeof(s_out)) == n && memcmp(s_out, s_src, n) == 0);
+            CHECK(rle_decode(RLE_MODE_COMPAT, s_old, olen, s_out, sizeof(s_out)) == n &&
+                  memcmp(s_out, s_src, n) == 0);
+            CHECK(rle_decode(RLE_MODE_LONG, s_old, olen, s_out, sizeof(s_out)) == n &&
+                  memcmp(s_out, s_src, n) == 0);
+        }
+    }
+}
+
+static void test_long_mode(void)
+{
+    // run เดียวยาวทั้ง buffer: COMPAT ต้องตัดทุก 127 ไบต์ LONG เป็น token เดียว
+    memset(s_src, 0xAB, MAX_LEN);
+    size_t clen = rle_encode(RLE_MODE_COMPAT, s_src, MAX_LEN, s_new, sizeof(s_new));
+    size_t llen = rle_encode(RLE_MODE_LONG, s_src, MAX_LEN, s_old, sizeof(s_old));
+    CHECK(clen == 2 * ((MAX_LEN + 126) / 127));
+    CHECK(llen <= 1 + 5 + 1);
+    CHECK(s_old[0] == 128);
+    CHECK(rle_decode(RLE_MODE_LONG, s_old, llen, s_out, sizeof(s_out)) == MAX_LEN &&
+          memcmp(s_out, s_src, MAX_LEN) == 0);
+    // COMPAT decoder ถือ 128 เป็น NOP → stream LONG ไม่ใช่ของมัน ต้องไม่ได้ข้อมูลเดิม
+    CHECK(rle_decode(RLE_MODE_COMPAT, s_old, llen, s_out, sizeof(s_out)) != MAX_LEN);
+
+    // run ยาวข้ามขอบท่อนของ encoder + ปนกับ literal
+    for (int kind = 0; kind < 4; kind++)
+    {
+        size_t n = gen(s_src, MAX_LEN, kind);
+        memset(s_src + 1000, 7, 5000); // run ยาวกลาง buffer
+        size_t elen = enc_chunked(RLE_MODE_LONG, s_src, n, s_new, sizeof(s_new));
+        CHECK(elen != RLE_ERR);
+        CHECK(elen <= rle_encode(RLE_MODE_COMPAT, s_src, n, s_old, sizeof(s_old)));
+        CHECK(rle_decode(RLE_MODE_LONG, s_new, elen, s_out, sizeof(s_out)) == n && memcmp(s_out, s_src, n) == 0);
+        CHECK(dec_chunked(RLE_MODE_LONG, s_new, elen, s_out, sizeof(s_out), 97) == n &&
+              memcmp(s_out, s_src, n) == 0);
+    }
+}
+
+static void test_capped_decode(void)
+{
+    size_t n = gen(s_src, 20000, 3);
+    size_t elen = rle_encode(RLE_MODE_LONG, s_src, n, s_new, sizeof(s_new));
+
+    // output เต็มกลาง token: เขียนพอดี cap ไม่เกิน แล้วเรียกต่อได้จากที่ค้าง
+    memset(s_out, 0xEE, sizeof(s_out));
+    rle_dec_t d;
+    rle_dec_init(&d, RLE_MODE_LONG);
+    size_t used = 0, cap = n / 3;
+    size_t w = rle_dec_update(&d, s_new, elen, &used, s_out, cap);
+    CHECK(w == cap);
+    CHECK(used < elen);
+    CHECK(s_out[cap] == 0xEE);
+    CHECK(!rle_dec_finish(&d) || used < elen);
+    size_t used2 = 0;
+    size_t w2 = rle_dec_update(&d, s_new + used, elen - used, &used2, s_out + w, sizeof(s_out) - w);
+    CHECK(w + w2 == n && used + used2 == elen && rle_dec_finish(&d));
+    CHECK(memcmp(s_out, s_src, n) == 0);
+
+    // ทีละ 1 ไบต์ของ output
+    CHECK(dec_chunked(RLE_MODE_LONG, s_new, elen, s_out, sizeof(s_out), 1) == n && memcmp(s_out, s_src, n) == 0);
+
+    // one-shot ที่ output ไม่พอ: RLE_ERR และไม่เขียนเกิน cap
+    memset(s_out, 0xEE, sizeof(s_out));
+    CHECK(rle_decode(RLE_MODE_LONG, s_new, elen, s_out, n - 1) == RLE_ERR);
+    CHECK(s_out[n - 1] == 0xEE);
+
+    // stream ถูกตัดกลาง literal/run: finish ต้องบอกว่าไม่ครบ
+    CHECK(rle_decode(RLE_MODE_LONG, s_new, elen - 1, s_out, sizeof(s_out)) == RLE_ERR);
+
+    // encoder ที่ out_cap ไม่ถึง bound ต้องปฏิเสธ ไม่เขียนเกิน
+    rle_enc_t e;
+    rle_enc_init(&e, RLE_MODE_COMPAT);
+    CHECK(rle_enc_update(&e, s_src, 1000, s_new, RLE_ENC_BOUND(1000) - 1) == RLE_ERR);
+}
+
+int main(void)
+{
+    test_compat_identical();
+    test_long_mode();
+    test_capped_decode();
+    printf("%s: %d failure(s)\n", s_fail ? "FAIL" : "OK", s_fail);
+    return s_fail ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "alloc_trace.h"
+
+static const char *TAG = "TRACE";
+
+#define RING_MASK (ALLOC_TRACE_RING_LEN - 1)
+
+_Static_assert((ALLOC_TRACE_RING_LEN & RING_MASK) == 0, "ALLOC_TRACE_RING_LEN must be a power of two");
+
+/* ---------- ริงต่อ core ----------
+   head: ตำแหน่งถัดไปที่ผู้เขียนจอง (CAS)
+   tail: ตำแหน่งถัดไปที่ drain อ่าน (drain ตัวเดียวเขียน)
+   ช่อง pos พร้อมอ่านเมื่อ rec.seq == pos + 1 → ริงเริ่มจากศูนย์ได้เลยไม่ต้อง init
+   ---------------------------------- */
+typedef struct
+{
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+    alloc_trace_rec_t recs[ALLOC_TRACE_RING_LEN];
+} trace_ring_t;
+
+static trace_ring_t s_rings[portNUM_PROCESSORS];
+static uint32_t s_emitted = 0;
+static uint32_t s_drained = 0;
+static uint32_t s_draining = 0; // กันสอง task drain พร้อมกัน (ริงรองรับผู้อ่านคนเดียว)
+static TaskHandle_t s_drain_task = NULL;
+static alloc_trace_sink_t s_sink = NULL;
+static void *s_sink_ctx = NULL;
+
+void alloc_trace_emit(uint8_t op, void *ptr, size_t size, uint32_t caps, const char *desc)
+{
+    int core = xPortGetCoreID();
+    trace_ring_t *r = &s_rings[core];
+
+    uint32_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    uint32_t fill;
+    do
+    {
+        fill = pos - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (fill >= ALLOC_TRACE_RING_LEN)
+        {
+            __atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&r->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    alloc_trace_rec_t *rec = &r->recs[pos & RING_MASK];
+    rec->op = op;
+    rec->core = (uint8_t)core;
+    rec->ptr = ptr;
+    rec->size = (uint32_t)size;
+    rec->caps = caps;
+    rec->desc = desc;
+    rec->ts_us = esp_timer_get_time();
+    __atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE); // publish
+
+    __atomic_fetch_add(&s_emitted, 1, __ATOMIC_RELAXED);
+    if (fill == ALLOC_TRACE_RING_LEN / 2 && s_drain_task)
+        xTaskNotifyGive(s_drain_task); // ปลุกครั้งเดียวตอนข้ามครึ่ง ไม่ต้องรอรอบ
+}
+
+// record ถัดไปของริงที่ publish แล้ว (NULL = ว่าง หรือผู้เขียนจองแล้วแต่ยังเขียนไม่เสร็จ)
+static const alloc_trace_rec_t *ring_peek(trace_ring_t *r)
+{
+    uint32_t tail = r->tail;
+    if (tail == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+        return NULL;
+    const alloc_trace_rec_t *rec = &r->recs[tail & RING_MASK];
+    return __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == tail + 1 ? rec : NULL;
+}
+
+size_t alloc_trace_drain(alloc_trace_sink_t sink, void *ctx, size_t max)
+{
+    uint32_t expect = 0;
+    if (!sink || !__atomic_compare_exchange_n(&s_draining, &expect, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 0;
+
+    size_t n = 0;
+    while (n < max)
+    {
+        // เลือก record ที่เก่าสุดจากทุก core → ลำดับรวมใกล้เคียงเวลาจริง
+        trace_ring_t *pick = NULL;
+        const alloc_trace_rec_t *best = NULL;
+        for (int c = 0; c < portNUM_PROCESSORS; c++)
+        {
+            const alloc_trace_rec_t *rec = ring_peek(&s_rings[c]);
+            if (rec && (!best || rec->ts_us < best->ts_us))
+            {
+                best = rec;
+                pick = &s_rings[c];
+            }
+        }
+        if (!best)
+            break;
+
+        alloc_trace_rec_t copy = *best; // คัดลอกก่อนคืนช่องให้ผู้เขียน
+        __atomic_store_n(&pick->tail, pick->tail + 1, __ATOMIC_RELEASE);
+        sink(&copy, ctx);
+        n++;
+    }
+
+    __atomic_fetch_add(&s_drained, (uint32_t)n, __ATOMIC_RELAXED);
+    __atomic_store_n(&s_draining, 0, __ATOMIC_RELEASE);
+    return n;
+}
+
+static void drain_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ALLOC_TRACE_DRAIN_PERIOD_MS));
+        while (alloc_trace_drain(s_sink, s_sink_ctx, ALLOC_TRACE_DRAIN_BATCH) == ALLOC_TRACE_DRAIN_BATCH)
+            taskYIELD();
+    }
+}
+
+bool alloc_trace_start(alloc_trace_sink_t sink, void *ctx, UBaseType_t prio)
+{
+    if (!sink || s_drain_task)
+        return false;
+    s_sink = sink;
+    s_sink_ctx = ctx;
+    if (xTaskCreate(drain_task, "TraceDrain", 3072, NULL, prio, &s_drain_task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "drain task create failed");
+        s_drain_task = NULL;
+        return false;
+    }
+    return true;
+}
+
+void alloc_trace_get_stats(alloc_trace_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->emitted = __atomic_load_n(&s_emitted, __ATOMIC_RELAXED);
+    out->drained = __atomic_load_n(&s_drained, __ATOMIC_RELAXED);
+    for (int c = 0; c < portNUM_PROCESSORS; c++)
+        out->dropped += __atomic_load_n(&s_rings[c].dropped, __ATOMIC_RELAXED);
+}
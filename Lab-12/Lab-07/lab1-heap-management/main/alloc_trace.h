@@ -0,0 +1,79 @@
+#ifndef ALLOC_TRACE_H
+#define ALLOC_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+
+/* ======================
+ * Config (ปรับได้)
+ * ====================== */
+#ifndef ALLOC_TRACE_RING_LEN
+#define ALLOC_TRACE_RING_LEN 128 // record ต่อ core (ต้องเป็นกำลังสอง)
+#endif
+
+#ifndef ALLOC_TRACE_DRAIN_PERIOD_MS
+#define ALLOC_TRACE_DRAIN_PERIOD_MS 100 // drain task ตื่นเองทุกเท่านี้ (ถูกปลุกก่อนได้เมื่อริงเกินครึ่ง)
+#endif
+
+#ifndef ALLOC_TRACE_DRAIN_BATCH
+#define ALLOC_TRACE_DRAIN_BATCH 32 // record สูงสุดต่อรอบก่อน yield ให้ task อื่น
+#endif
+
+/* ======================
+ * Binary trace ring
+ * - หนึ่งริงต่อ core: ผู้เขียนจองช่องด้วย CAS บน head ของ core ตัวเอง (task บน core เดียวกันแย่งกันได้)
+ *   แล้ว publish ด้วย seq ของช่อง → ไม่มี lock ไม่มีการ format บนเส้นทาง alloc
+ * - ริงเต็ม = ทิ้ง record นั้นและนับ dropped (ผู้เขียนไม่รอ)
+ * - drain task ตัวเดียวอ่านทุกริง เรียงตามเวลา แล้วส่งให้ sink (format/export)
+ * - desc เก็บแค่ pointer: ต้องเป็น string ที่อยู่ตลอด (literal/static) เพราะถูกอ่านทีหลัง
+ * ====================== */
+typedef enum
+{
+    ALLOC_TRACE_ALLOC = 1,
+    ALLOC_TRACE_FREE,
+    ALLOC_TRACE_ALLOC_FAIL,
+    ALLOC_TRACE_FREE_UNTRACKED, // free pointer ที่ไม่ได้ติดตามไว้
+    ALLOC_TRACE_TRACK_NOMEM,    // จองสำเร็จแต่ตัวติดตามไม่มีที่เก็บ
+    ALLOC_TRACE_REGISTER,       // register_allocation_manual
+    ALLOC_TRACE_UNREGISTER,
+    ALLOC_TRACE_UNREGISTER_MISS,
+    ALLOC_TRACE_REGISTER_NOMEM,
+} alloc_trace_op_t;
+
+typedef struct
+{
+    uint32_t seq; // ภายใน: สถานะช่องของริง
+    uint8_t op;   // alloc_trace_op_t
+    uint8_t core;
+    uint16_t reserved;
+    void *ptr;
+    uint32_t size;
+    uint32_t caps;
+    const char *desc;
+    int64_t ts_us;
+} alloc_trace_rec_t;
+
+typedef struct
+{
+    uint32_t emitted;
+    uint32_t dropped; // ริงเต็มตอนเขียน
+    uint32_t drained;
+} alloc_trace_stats_t;
+
+typedef void (*alloc_trace_sink_t)(const alloc_trace_rec_t *rec, void *ctx);
+
+// เรียกได้จากทุก task (ไม่ block) ก่อน start ก็เขียนได้ แค่ยังไม่มีคน drain
+void alloc_trace_emit(uint8_t op, void *ptr, size_t size, uint32_t caps, const char *desc);
+
+// สร้าง drain task (priority ต่ำ) ที่ส่ง record ให้ sink ตามลำดับเวลา
+bool alloc_trace_start(alloc_trace_sink_t sink, void *ctx, UBaseType_t prio);
+
+// drain ทันทีจาก task ที่เรียก (สูงสุด max record) คืนจำนวนที่ส่งให้ sink
+size_t alloc_trace_drain(alloc_trace_sink_t sink, void *ctx, size_t max);
+
+void alloc_trace_get_stats(alloc_trace_stats_t *out);
+
+#endif /* ALLOC_TRACE_H */
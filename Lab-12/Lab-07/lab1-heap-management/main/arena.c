@@ -0,0 +1,291 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "arena.h"
+
+static const char *TAG = "ARENA";
+
+#define ALIGN_UP_SZ(x, a) (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
+#define BLOCK_HDR ALIGN_UP_SZ(sizeof(arena_block_t), ARENA_MIN_ALIGN)
+
+_Static_assert((ARENA_MIN_ALIGN & (ARENA_MIN_ALIGN - 1)) == 0, "ARENA_MIN_ALIGN must be a power of two");
+
+static void *default_block_alloc(size_t size, uint32_t caps, const char *desc)
+{
+    (void)desc;
+    return heap_caps_malloc(size, caps);
+}
+
+static void default_block_free(void *ptr, const char *desc)
+{
+    (void)desc;
+    heap_caps_free(ptr);
+}
+
+static arena_block_alloc_t s_block_alloc = default_block_alloc;
+static arena_block_free_t s_block_free = default_block_free;
+
+void arena_set_block_allocator(arena_block_alloc_t alloc_fn, arena_block_free_t free_fn)
+{
+    s_block_alloc = alloc_fn ? alloc_fn : default_block_alloc;
+    s_block_free = free_fn ? free_fn : default_block_free;
+}
+
+// สถิติ: ARENA_SHARED หลาย task เขียนพร้อมกัน → atomic, ARENA_LOCAL เขียนตรง ๆ
+#define ARENA_STAT_ADD(ar, field, n)                                            \
+    do                                                                          \
+    {                                                                           \
+        if ((ar)->kind == ARENA_SHARED)                                         \
+            __atomic_fetch_add(&(ar)->field, (n), __ATOMIC_RELAXED);            \
+        else                                                                    \
+            (ar)->field += (n);                                                 \
+    } while (0)
+
+// header + data อยู่ในก้อนเดียวกัน data เริ่มที่ขอบ ARENA_MIN_ALIGN
+static arena_block_t *block_new(arena_t *ar, size_t cap)
+{
+    uint8_t *mem = (uint8_t *)s_block_alloc(BLOCK_HDR + cap + ARENA_MIN_ALIGN, ar->caps, ar->name);
+    if (!mem)
+        return NULL;
+    arena_block_t *b = (arena_block_t *)mem;
+    b->prev = NULL;
+    b->cap = cap;
+    b->off = 0;
+    b->data = (uint8_t *)ALIGN_UP_SZ((uintptr_t)(mem + BLOCK_HDR), ARENA_MIN_ALIGN);
+    return b;
+}
+
+static void block_free(arena_t *ar, arena_block_t *b)
+{
+    s_block_free(b, ar->name);
+}
+
+// offset (จาก data) ที่ทำให้ address ลงขอบ align
+static inline size_t aligned_off(const arena_block_t *b, size_t off, size_t align)
+{
+    return (size_t)(ALIGN_UP_SZ((uintptr_t)b->data + off, align) - (uintptr_t)b->data);
+}
+
+// ARENA_LOCAL: ไม่มีใครแย่ง
+static void *bump_local(arena_block_t *b, size_t size, size_t align)
+{
+    size_t at = aligned_off(b, b->off, align);
+    if (at > b->cap || size > b->cap - at)
+        return NULL;
+    b->off = at + size;
+    return b->data + at;
+}
+
+// ARENA_SHARED: align <= ARENA_MIN_ALIGN ใช้ fetch-add ครั้งเดียว (offset เป็นพหุคูณอยู่แล้ว)
+// align ใหญ่กว่าใช้ CAS loop; จองไม่พอ = block เต็ม (off อาจเลย cap ไปแล้วก็ไม่เป็นไร)
+static void *bump_shared(arena_block_t *b, size_t size, size_t align)
+{
+    if (size > b->cap)
+        return NULL;
+    if (align <= ARENA_MIN_ALIGN)
+    {
+        size_t at = __atomic_fetch_add(&b->off, size, __ATOMIC_RELAXED);
+        return (at <= b->cap && size <= b->cap - at) ? b->data + at : NULL;
+    }
+    size_t off = __atomic_load_n(&b->off, __ATOMIC_RELAXED);
+    size_t at;
+    do
+    {
+        at = aligned_off(b, off, align);
+        if (at > b->cap || size > b->cap - at)
+            return NULL;
+    } while (!__atomic_compare_exchange_n(&b->off, &off, at + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return b->data + at;
+}
+
+int arena_init(arena_t *ar, arena_kind_t kind, size_t block_size, uint32_t caps, const char *name)
+{
+    if (!ar || !block_size)
+        return -1;
+    memset(ar, 0, sizeof(*ar));
+    ar->kind = kind;
+    ar->block_size = ALIGN_UP_SZ(block_size, ARENA_MIN_ALIGN);
+    ar->caps = caps ? caps : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ar->name = name ? name : "ARENA";
+    if (kind == ARENA_SHARED)
+    {
+        ar->grow_lock = xSemaphoreCreateMutex();
+        if (!ar->grow_lock)
+            return -2;
+    }
+    ar->head = block_new(ar, ar->block_size);
+    if (!ar->head)
+    {
+        if (ar->grow_lock)
+            vSemaphoreDelete(ar->grow_lock);
+        ar->grow_lock = NULL;
+        return -3;
+    }
+    ar->blocks = ar->peak_blocks = 1;
+    return 0;
+}
+
+// ต่อ block ใหม่ที่หัว chain ถ้าหัวยังเป็น seen (อีก task อาจต่อให้แล้ว) false = heap ไม่พอ
+static bool arena_grow(arena_t *ar, arena_block_t *seen, size_t size, size_t align)
+{
+    if (ar->kind == ARENA_SHARED)
+        xSemaphoreTake(ar->grow_lock, portMAX_DELAY);
+
+    bool ok = true;
+    if (__atomic_load_n(&ar->head, __ATOMIC_ACQUIRE) == seen)
+    {
+        size_t need = size + (align > ARENA_MIN_ALIGN ? align : 0);
+        arena_block_t *b = block_new(ar, need > ar->block_size ? ALIGN_UP_SZ(need, ARENA_MIN_ALIGN) : ar->block_size);
+        if (b)
+        {
+            b->prev = seen;
+            __atomic_store_n(&ar->head, b, __ATOMIC_RELEASE); // publish หลังเตรียม block เสร็จ
+            uint32_t blocks = ++ar->blocks;                   // ใต้ grow_lock
+            if (blocks > ar->peak_blocks)
+                ar->peak_blocks = blocks;
+            ar->grows++;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    if (ar->kind == ARENA_SHARED)
+        xSemaphoreGive(ar->grow_lock);
+    return ok;
+}
+
+void *arena_alloc(arena_t *ar, size_t size, size_t align)
+{
+    if (!ar || !ar->head || !size)
+        return NULL;
+    if (align < ARENA_MIN_ALIGN)
+        align = ARENA_MIN_ALIGN;
+    if (align & (align - 1))
+        return NULL;
+    size = ALIGN_UP_SZ(size, ARENA_MIN_ALIGN);
+
+#if ARENA_CHECK_OWNER
+    if (ar->kind == ARENA_LOCAL)
+    {
+        TaskHandle_t me = xTaskGetCurrentTaskHandle();
+        if (!ar->owner)
+            ar->owner = me;
+        else if (ar->owner != me)
+        {
+            ESP_LOGE(TAG, "%s: ARENA_LOCAL used from another task", ar->name);
+            ar->fails++;
+            return NULL;
+        }
+    }
+#endif
+
+    for (;;)
+    {
+        arena_block_t *b = __atomic_load_n(&ar->head, __ATOMIC_ACQUIRE);
+        void *p = ar->kind == ARENA_SHARED ? bump_shared(b, size, align) : bump_local(b, size, align);
+        if (p)
+        {
+            ARENA_STAT_ADD(ar, allocs, 1);
+            ARENA_STAT_ADD(ar, bytes, size);
+            return p;
+        }
+        if (!arena_grow(ar, b, size, align))
+        {
+            ARENA_STAT_ADD(ar, fails, 1);
+            return NULL;
+        }
+    }
+}
+
+arena_marker_t arena_save(arena_t *ar)
+{
+    arena_marker_t m = {0};
+    if (!ar || !ar->head)
+        return m;
+    m.block = __atomic_load_n(&ar->head, __ATOMIC_ACQUIRE);
+    m.off = __atomic_load_n(&m.block->off, __ATOMIC_RELAXED);
+    if (m.off > m.block->cap)
+        m.off = m.block->cap;
+    m.bytes = ar->bytes;
+    return m;
+}
+
+// คืน block ที่ต่อหลัง marker แล้วย้อน offset (marker ต้องมาจาก arena นี้และยังไม่ถูก restore ข้ามไป)
+void arena_restore(arena_t *ar, arena_marker_t m)
+{
+    if (!ar || !ar->head || !m.block)
+        return;
+    while (ar->head != m.block)
+    {
+        arena_block_t *b = ar->head;
+        if (!b->prev)
+        {
+            ESP_LOGE(TAG, "%s: restore with a stale marker", ar->name);
+            return;
+        }
+        ar->head = b->prev;
+        ar->blocks--;
+        block_free(ar, b);
+    }
+    ar->head->off = m.off;
+    ar->bytes = m.bytes;
+}
+
+void arena_reset(arena_t *ar)
+{
+    if (!ar || !ar->head)
+        return;
+    while (ar->head->prev)
+    {
+        arena_block_t *b = ar->head;
+        ar->head = b->prev;
+        block_free(ar, b);
+    }
+    ar->head->off = 0;
+    ar->blocks = 1;
+    ar->bytes = 0;
+}
+
+void arena_destroy(arena_t *ar)
+{
+    if (!ar)
+        return;
+    while (ar->head)
+    {
+        arena_block_t *b = ar->head;
+        ar->head = b->prev;
+        block_free(ar, b);
+    }
+    if (ar->grow_lock)
+        vSemaphoreDelete(ar->grow_lock);
+    memset(ar, 0, sizeof(*ar));
+}
+
+void arena_get_stats(arena_t *ar, arena_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!ar)
+        return;
+    out->allocs = __atomic_load_n(&ar->allocs, __ATOMIC_RELAXED);
+    out->fails = __atomic_load_n(&ar->fails, __ATOMIC_RELAXED);
+    out->bytes = __atomic_load_n(&ar->bytes, __ATOMIC_RELAXED);
+    if (ar->kind == ARENA_SHARED)
+        xSemaphoreTake(ar->grow_lock, portMAX_DELAY); // chain ไม่เปลี่ยนระหว่างไล่
+    out->blocks = ar->blocks;
+    out->peak_blocks = ar->peak_blocks;
+    out->grows = ar->grows;
+    for (arena_block_t *b = ar->head; b; b = b->prev)
+        out->capacity += b->cap;
+    if (ar->kind == ARENA_SHARED)
+        xSemaphoreGive(ar->grow_lock);
+}
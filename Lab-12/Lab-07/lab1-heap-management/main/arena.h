@@ -0,0 +1,98 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+/* ======================
+ * Config (ปรับได้)
+ * ====================== */
+#ifndef ARENA_MIN_ALIGN
+#define ARENA_MIN_ALIGN 8 // ทุก offset เป็นพหุคูณของค่านี้ → align <= ค่านี้ใช้ fetch-add ได้ตรง ๆ
+#endif
+
+#ifndef ARENA_CHECK_OWNER
+#define ARENA_CHECK_OWNER 1 // 1 = ARENA_LOCAL ตรวจว่าถูกใช้จาก task เจ้าของเท่านั้น
+#endif
+
+/* ======================
+ * Arena allocator
+ * - ARENA_LOCAL : ของ task เดียว ไม่มี lock/atomic เลย
+ * - ARENA_SHARED: หลาย task จองพร้อมกันได้ bump ด้วย atomic fetch-add บน offset ของ block ปัจจุบัน
+ *                 ใช้ mutex เฉพาะตอนต่อ block ใหม่ (slow path)
+ * - block เต็ม → ต่อ block ใหม่เข้าหัว chain (ขนาด block_size หรือใหญ่กว่าถ้าคำขอใหญ่)
+ * - marker: arena_save / arena_restore คืนทุกอย่างที่จองหลัง marker (รวม block ที่ต่อเพิ่ม) แบบ scope
+ * - arena_reset: คืน block ที่ต่อเพิ่มทั้งหมด เหลือ block แรกแล้วเริ่ม offset ใหม่
+ * - restore/reset/destroy ของ ARENA_SHARED ต้องเรียกตอนไม่มีใครจองอยู่ (ผู้เรียกดูแลเอง)
+ * - ไม่ติดตามรายก้อน: ตัวติดตามเห็นเฉพาะ block (ผ่าน arena_set_block_allocator)
+ * ====================== */
+typedef enum
+{
+    ARENA_LOCAL = 0,
+    ARENA_SHARED,
+} arena_kind_t;
+
+typedef struct arena_block_t
+{
+    struct arena_block_t *prev; // block ที่เก่ากว่าใน chain
+    size_t cap;
+    size_t off; // ARENA_SHARED: เพิ่มด้วย atomic (อาจเกิน cap ได้ = block เต็ม)
+    uint8_t *data;
+} arena_block_t;
+
+typedef struct
+{
+    arena_block_t *head; // block ปัจจุบัน
+    size_t block_size;
+    uint32_t caps;
+    arena_kind_t kind;
+    const char *name;
+    SemaphoreHandle_t grow_lock; // ARENA_SHARED เท่านั้น
+    TaskHandle_t owner;          // ARENA_LOCAL: task แรกที่จอง
+    // สถิติ (ARENA_SHARED อัปเดตแบบ atomic)
+    uint32_t allocs;
+    uint32_t fails;
+    uint32_t blocks;
+    uint32_t peak_blocks;
+    uint32_t grows;
+    size_t bytes; // bytes ที่ขอ (รวม padding จาก align) ตั้งแต่ reset/restore ล่าสุด
+} arena_t;
+
+typedef struct
+{
+    arena_block_t *block;
+    size_t off;
+    size_t bytes;
+} arena_marker_t;
+
+typedef struct
+{
+    uint32_t allocs;
+    uint32_t fails;
+    uint32_t blocks;
+    uint32_t peak_blocks;
+    uint32_t grows;
+    size_t bytes;
+    size_t capacity; // รวมทุก block ใน chain
+} arena_stats_t;
+
+// ตัวจอง/คืน block (ค่าเริ่มต้น heap_caps_malloc/heap_caps_free) ตั้งครั้งเดียวก่อนสร้าง arena
+typedef void *(*arena_block_alloc_t)(size_t size, uint32_t caps, const char *desc);
+typedef void (*arena_block_free_t)(void *ptr, const char *desc);
+void arena_set_block_allocator(arena_block_alloc_t alloc_fn, arena_block_free_t free_fn);
+
+// 0 = สำเร็จ (จอง block แรกทันที)
+int arena_init(arena_t *ar, arena_kind_t kind, size_t block_size, uint32_t caps, const char *name);
+void *arena_alloc(arena_t *ar, size_t size, size_t align);
+arena_marker_t arena_save(arena_t *ar);
+void arena_restore(arena_t *ar, arena_marker_t m);
+void arena_reset(arena_t *ar);
+void arena_destroy(arena_t *ar);
+void arena_get_stats(arena_t *ar, arena_stats_t *out);
+
+#endif /* ARENA_H */
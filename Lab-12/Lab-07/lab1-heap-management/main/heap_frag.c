@@ -0,0 +1,242 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "heap_frag.h"
+
+// ไฟล์นี้ไม่แตะ API ของ IDF (ยกเว้น lock ของผลที่ publish) → build บน host ได้ ดู host_test/
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+#define FRAG_LOCK() portENTER_CRITICAL(&s_mux)
+#define FRAG_UNLOCK() portEXIT_CRITICAL(&s_mux)
+#else
+#define FRAG_LOCK() ((void)0) // host test: step/get จาก thread เดียว
+#define FRAG_UNLOCK() ((void)0)
+#endif
+
+static const uint32_t s_req[HEAP_FRAG_NREQ] = HEAP_FRAG_REQ_SIZES;
+_Static_assert(sizeof((uint32_t[])HEAP_FRAG_REQ_SIZES) == sizeof(uint32_t) * HEAP_FRAG_NREQ,
+               "HEAP_FRAG_REQ_SIZES must list HEAP_FRAG_NREQ sizes");
+
+static const char *const s_names[HEAP_FRAG_NCLASS] = {"INTERNAL", "SPIRAM", "DMA"};
+
+typedef struct
+{
+    int64_t ts_us;
+    uint32_t free_bytes;
+    uint32_t largest;
+    float frag;
+} frag_hist_t;
+
+// สถานะ sweep: ผู้ step คนเดียว (s_stepping) ผลที่ publish แล้วอ่านใต้ FRAG_LOCK
+static heap_frag_backend_t s_backend;
+static bool s_ready = false;
+static uint32_t s_stepping = 0;
+static int s_cls = 0, s_region = 0;
+static uintptr_t s_resume = 0;
+static heap_frag_sums_t s_acc;
+static int64_t s_sweep_t0 = 0;
+static uint32_t s_sweep_steps = 0;
+static uint32_t s_sweep_no = 0;
+
+static heap_frag_report_t s_report[HEAP_FRAG_NCLASS];
+static bool s_have[HEAP_FRAG_NCLASS];
+static frag_hist_t s_hist[HEAP_FRAG_NCLASS][HEAP_FRAG_HISTORY];
+static uint8_t s_hist_len[HEAP_FRAG_NCLASS], s_hist_head[HEAP_FRAG_NCLASS];
+
+static inline int64_t now_us(void)
+{
+    return s_backend.now_us ? s_backend.now_us() : 0;
+}
+
+static inline int bucket_of(size_t size)
+{
+    if (size < 16)
+        return 0;
+    int b = 31 - __builtin_clz((uint32_t)size) - 3; // 16..31 → 1
+    return b >= HEAP_FRAG_BUCKETS ? HEAP_FRAG_BUCKETS - 1 : b;
+}
+
+static void visit_block(const heap_frag_block_t *b, void *arg)
+{
+    heap_frag_sums_t *a = (heap_frag_sums_t *)arg;
+    if (b->used)
+    {
+        a->used_blocks++;
+        a->used_bytes += (uint32_t)b->size;
+        return;
+    }
+    a->free_blocks++;
+    a->free_bytes += (uint32_t)b->size;
+    if (b->size > a->largest)
+        a->largest = (uint32_t)b->size;
+    a->hist[bucket_of(b->size)]++;
+    for (int i = 0; i < HEAP_FRAG_NREQ; i++)
+        a->capacity[i] += (uint32_t)((b->size + HEAP_FRAG_BLOCK_OVERHEAD) / (s_req[i] + HEAP_FRAG_BLOCK_OVERHEAD));
+}
+
+// ปิด sweep ของ class: คำนวณ metric + แนวโน้ม แล้ว publish
+static void publish(int cls)
+{
+    heap_frag_report_t r;
+    memset(&r, 0, sizeof(r));
+    r.s = s_acc;
+    memcpy(r.req_size, s_req, sizeof(r.req_size));
+    r.frag = r.s.free_bytes ? 1.0f - (float)r.s.largest / (float)r.s.free_bytes : 0.0f;
+    for (int i = 0; i < HEAP_FRAG_NREQ; i++)
+    {
+        float ideal = (float)r.s.free_bytes / (float)(s_req[i] + HEAP_FRAG_BLOCK_OVERHEAD);
+        r.cap_loss[i] = ideal >= 1.0f ? 1.0f - (float)r.s.capacity[i] / ideal : 0.0f;
+        if (r.cap_loss[i] < 0.0f)
+            r.cap_loss[i] = 0.0f;
+    }
+    r.sweep = s_sweep_no;
+    r.ts_us = now_us();
+    r.sweep_us = (uint32_t)(r.ts_us - s_sweep_t0);
+    r.steps = s_sweep_steps;
+
+    frag_hist_t *h = s_hist[cls];
+    h[s_hist_head[cls]] = (frag_hist_t){r.ts_us, r.s.free_bytes, r.s.largest, r.frag};
+    s_hist_head[cls] = (uint8_t)((s_hist_head[cls] + 1) % HEAP_FRAG_HISTORY);
+    if (s_hist_len[cls] < HEAP_FRAG_HISTORY)
+        s_hist_len[cls]++;
+    const frag_hist_t *oldest = &h[(s_hist_head[cls] + HEAP_FRAG_HISTORY - s_hist_len[cls]) % HEAP_FRAG_HISTORY];
+    r.trend_len = s_hist_len[cls];
+    r.free_delta = (int32_t)(r.s.free_bytes - oldest->free_bytes);
+    r.largest_delta = (int32_t)(r.s.largest - oldest->largest);
+    r.frag_delta = r.frag - oldest->frag;
+
+    FRAG_LOCK();
+    s_report[cls] = r;
+    s_have[cls] = true;
+    FRAG_UNLOCK();
+}
+
+static void begin_class(void)
+{
+    memset(&s_acc, 0, sizeof(s_acc));
+    s_region = 0;
+    s_resume = 0;
+    s_sweep_t0 = now_us();
+    s_sweep_steps = 0;
+}
+
+uint32_t heap_frag_step(uint32_t budget)
+{
+    uint32_t expect = 0;
+    if (!s_ready || !budget ||
+        !__atomic_compare_exchange_n(&s_stepping, &expect, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 0;
+
+    uint32_t visited = 0;
+    s_sweep_steps++;
+    while (visited < budget)
+    {
+        uint32_t before = s_acc.free_blocks + s_acc.used_blocks;
+        heap_frag_walk_rc_t rc = s_backend.walk(s_backend.ctx, (heap_frag_class_t)s_cls, s_region, &s_resume,
+                                                budget - visited, visit_block, &s_acc);
+        visited += s_acc.free_blocks + s_acc.used_blocks - before;
+        if (rc == HEAP_FRAG_WALK_MORE)
+            break;
+        if (rc == HEAP_FRAG_WALK_REGION_DONE)
+        {
+            s_acc.regions++;
+            s_region++;
+            s_resume = 0;
+            continue;
+        }
+        // ครบทุก region ของ class นี้
+        publish(s_cls);
+        if (++s_cls == HEAP_FRAG_NCLASS)
+        {
+            s_cls = 0;
+            s_sweep_no++;
+            begin_class();
+            break; // จบ sweep: step หน้าค่อยเริ่มรอบใหม่
+        }
+        begin_class();
+        s_sweep_steps = 1; // class ถัดไปเริ่มใน step นี้
+    }
+
+    __atomic_store_n(&s_stepping, 0, __ATOMIC_RELEASE);
+    return visited;
+}
+
+void heap_frag_sweep(void)
+{
+    uint32_t target = s_sweep_no + 1;
+    while (s_ready && s_sweep_no != target)
+        heap_frag_step(HEAP_FRAG_STEP_BUDGET);
+}
+
+/* ---------- backend: stand-in (host/test) ---------- */
+static heap_frag_walk_rc_t standin_walk(void *ctx, heap_frag_class_t cls, int region, uintptr_t *resume,
+                                        uint32_t budget, heap_frag_visit_t visit, void *arg)
+{
+    const heap_frag_standin_t *h = (const heap_frag_standin_t *)ctx;
+    for (int idx = 0; h->blocks; h++)
+    {
+        if (!(h->classes & HEAP_FRAG_CLASS_BIT(cls)) || idx++ != region)
+            continue;
+        uint32_t seen = 0;
+        for (size_t i = 0; i < h->nblocks; i++)
+        {
+            if (h->blocks[i].addr < *resume)
+                continue;
+            if (seen == budget)
+            {
+                *resume = h->blocks[i].addr;
+                return HEAP_FRAG_WALK_MORE;
+            }
+            visit(&h->blocks[i], arg);
+            seen++;
+        }
+        return HEAP_FRAG_WALK_REGION_DONE;
+    }
+    return HEAP_FRAG_WALK_NO_REGION;
+}
+
+void heap_frag_standin_backend(heap_frag_backend_t *out, const heap_frag_standin_t *heaps)
+{
+    out->walk = standin_walk;
+    out->now_us = NULL;
+    out->ctx = (void *)heaps;
+}
+
+bool heap_frag_init(const heap_frag_backend_t *backend)
+{
+    uint32_t expect = 0;
+    if (!backend || !backend->walk ||
+        !__atomic_compare_exchange_n(&s_stepping, &expect, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false; // ห้ามเปลี่ยน backend กลาง step
+    s_backend = *backend;
+    s_cls = 0;
+    s_sweep_no = 0;
+    begin_class();
+    FRAG_LOCK();
+    memset(s_have, 0, sizeof(s_have));
+    memset(s_hist_len, 0, sizeof(s_hist_len));
+    memset(s_hist_head, 0, sizeof(s_hist_head));
+    FRAG_UNLOCK();
+    s_ready = true;
+    __atomic_store_n(&s_stepping, 0, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool heap_frag_get(heap_frag_class_t cls, heap_frag_report_t *out)
+{
+    if ((unsigned)cls >= HEAP_FRAG_NCLASS || !out)
+        return false;
+    FRAG_LOCK();
+    bool have = s_have[cls];
+    if (have)
+        *out = s_report[cls];
+    FRAG_UNLOCK();
+    return have;
+}
+
+const char *heap_frag_class_name(heap_frag_class_t cls)
+{
+    return (unsigned)cls < HEAP_FRAG_NCLASS ? s_names[cls] : "?";
+}
@@ -0,0 +1,141 @@
+#ifndef HEAP_FRAG_H
+#define HEAP_FRAG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ======================
+ * Config (ปรับได้)
+ * ====================== */
+#ifndef HEAP_FRAG_STEP_BUDGET
+#define HEAP_FRAG_STEP_BUDGET 64 // block สูงสุดต่อ step ของ backend ที่เดินต่อกลาง region ได้ (ไม่ใช่ขอบเขตของ heap lock)
+#endif
+
+#ifndef HEAP_FRAG_STEP_MS
+#define HEAP_FRAG_STEP_MS 20 // พักระหว่าง step ของ task โปรไฟล์
+#endif
+
+#ifndef HEAP_FRAG_HISTORY
+#define HEAP_FRAG_HISTORY 8 // sweep ที่เก็บไว้ดูแนวโน้มต่อ capability
+#endif
+
+#ifndef HEAP_FRAG_BLOCK_OVERHEAD
+#define HEAP_FRAG_BLOCK_OVERHEAD 8 // header ต่อก้อนของ allocator (ประมาณ, ใช้คิด capacity)
+#endif
+
+// ขนาดคำขอที่ใช้บ่อยของแอป: รายงานว่าจองได้อีกกี่ก้อนจาก free block ที่มีจริง
+#ifndef HEAP_FRAG_REQ_SIZES
+#define HEAP_FRAG_REQ_SIZES {64, 256, 1024, 4096, 16384}
+#endif
+#define HEAP_FRAG_NREQ 5
+
+#define HEAP_FRAG_BUCKETS 20 // free block ตาม log2 ของขนาด: [<16], [16,32), ... , [>=4M]
+
+/* ======================
+ * Fragmentation profiler
+ * - หนึ่ง sweep เดินทุก region ของทุก class แบ่งเป็นหลาย step (ผลของ sweep จึงไม่ใช่ snapshot ณ เวลาเดียว)
+ * - ต่อ class: histogram ของ free block, จำนวนก้อนที่จองได้ต่อขนาดคำขอ, แนวโน้มจาก sweep ก่อน ๆ
+ * - แหล่ง block เป็น backend:
+ *   heap_frag.c     : ส่วนคำนวณ + stand-in ที่เดินจาก array ของ block (คอมไพล์บน host ได้ ดู host_test/)
+ *   heap_frag_esp.c : heap_caps_walk (IDF >= 5.3) + task โปรไฟล์ + print
+ * - heap_caps_walk เริ่มจาก block แรกของ heap เสมอและถือ heap lock ตลอดการ walk
+ *   → backend ESP เดินครบหนึ่ง region ต่อ step (ไม่แบ่งตาม budget): ถือ lock O(block ใน region) ต่อ step
+ *     แต่ทั้ง sweep เป็น O(block ทั้งหมด) ไม่ใช่ O(N²/budget) แบบ walk ซ้ำจากต้นแล้วข้ามไปถึง resume
+ * ====================== */
+typedef enum
+{
+    HEAP_FRAG_INTERNAL = 0,
+    HEAP_FRAG_SPIRAM,
+    HEAP_FRAG_DMA,
+    HEAP_FRAG_NCLASS
+} heap_frag_class_t;
+
+typedef struct
+{
+    uintptr_t addr;
+    size_t size;
+    bool used;
+} heap_frag_block_t;
+
+typedef enum
+{
+    HEAP_FRAG_WALK_MORE = 0,    // budget หมด *resume = block ถัดไป
+    HEAP_FRAG_WALK_REGION_DONE, // region นี้หมดแล้ว
+    HEAP_FRAG_WALK_NO_REGION,   // ไม่มี region ลำดับนี้ใน caps นี้ (ครบทุก region แล้ว)
+} heap_frag_walk_rc_t;
+
+typedef void (*heap_frag_visit_t)(const heap_frag_block_t *b, void *arg);
+
+typedef struct
+{
+    // เดิน region ลำดับ region ของ class จาก address >= *resume ส่ง block ให้ visit
+    // ควรหยุดที่ budget ก้อน (คืน MORE + *resume) ถ้าทำได้ถูก ๆ; backend ที่ต่อกลาง region ไม่ได้เดินจนจบ region
+    heap_frag_walk_rc_t (*walk)(void *ctx, heap_frag_class_t cls, int region, uintptr_t *resume, uint32_t budget,
+                                heap_frag_visit_t visit, void *arg);
+    int64_t (*now_us)(void); // NULL → เวลาในรายงานเป็น 0
+    void *ctx;
+} heap_frag_backend_t;
+
+#define HEAP_FRAG_CLASS_BIT(cls) (1u << (cls))
+
+// heap จำลอง: region หนึ่งต่อ entry (block เรียงตาม address) array ปิดท้ายด้วย entry ที่ blocks == NULL
+typedef struct
+{
+    uint32_t classes; // HEAP_FRAG_CLASS_BIT() ของทุก class ที่ region นี้นับอยู่ (เช่น INTERNAL | DMA)
+    const heap_frag_block_t *blocks;
+    size_t nblocks;
+} heap_frag_standin_t;
+
+typedef struct
+{
+    uint32_t free_bytes;
+    uint32_t used_bytes;
+    uint32_t free_blocks;
+    uint32_t used_blocks;
+    uint32_t largest;
+    uint16_t regions;
+    uint32_t hist[HEAP_FRAG_BUCKETS];
+    uint32_t capacity[HEAP_FRAG_NREQ]; // จองขนาด req_size[i] ได้อีกกี่ก้อน
+} heap_frag_sums_t;
+
+typedef struct
+{
+    heap_frag_sums_t s;
+    uint32_t req_size[HEAP_FRAG_NREQ];
+    float frag;                     // 1 - largest/free (แบบเดิม)
+    float cap_loss[HEAP_FRAG_NREQ]; // 1 - capacity / (free / (req + overhead)) = เสียไปเพราะแตกเป็นชิ้น
+    uint32_t sweep;                 // ลำดับ sweep ที่ได้ผลนี้
+    int64_t ts_us;
+    uint32_t sweep_us; // เวลาจริงตั้งแต่เริ่มถึงจบ sweep ของ class นี้
+    uint32_t steps;
+    // แนวโน้ม: sweep ล่าสุดเทียบกับเก่าสุดในหน้าต่าง HEAP_FRAG_HISTORY
+    uint8_t trend_len;
+    int32_t free_delta;
+    int32_t largest_delta;
+    float frag_delta;
+} heap_frag_report_t;
+
+// ล้างผลเก่าแล้วใช้ backend นี้ (false ถ้า backend ไม่ครบหรือมี step กำลังทำงานอยู่)
+bool heap_frag_init(const heap_frag_backend_t *backend);
+// ทำงานหนึ่ง step (ไม่เกิน budget block) คืนจำนวน block ที่เดิน
+uint32_t heap_frag_step(uint32_t budget);
+// เดินจนครบหนึ่ง sweep ทุก class (สำหรับ test/host)
+void heap_frag_sweep(void);
+// false = ยังไม่มี sweep ที่เสร็จของ class นี้
+bool heap_frag_get(heap_frag_class_t cls, heap_frag_report_t *out);
+const char *heap_frag_class_name(heap_frag_class_t cls);
+
+void heap_frag_standin_backend(heap_frag_backend_t *out, const heap_frag_standin_t *heaps);
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+
+// heap_caps_walk (false ถ้า IDF < 5.3 ไม่มี walk API)
+bool heap_frag_esp_backend(heap_frag_backend_t *out);
+// task priority ต่ำ: step ทุก HEAP_FRAG_STEP_MS
+bool heap_frag_start(UBaseType_t prio);
+void heap_frag_print(void);
+#endif
+
+#endif /* HEAP_FRAG_H */
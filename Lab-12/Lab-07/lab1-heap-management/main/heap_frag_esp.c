@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_heap_caps.h"
+#include "esp_idf_version.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "heap_frag.h"
+
+static const char *TAG = "FRAG";
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#define HEAP_FRAG_HAVE_WALK 1
+#else
+#define HEAP_FRAG_HAVE_WALK 0
+#endif
+
+static TaskHandle_t s_task = NULL;
+
+/* ---------- backend: heap_caps_walk ----------
+   walk ทีละ heap (แต่ละ heap ถูก lock ระหว่าง walk ของมัน) callback คืน false = เลิก walk heap นั้น
+   heap_caps_walk เริ่มที่ block แรกเสมอ ต่อจากกลาง heap ไม่ได้ → ถ้าแบ่งตาม budget แต่ละ step
+   ต้องเดินข้าม block ก่อน resume ใต้ lock ซ้ำอีก (ทั้ง sweep O(N²/budget))
+   จึงเดินครบ region เป้าหมายในครั้งเดียว (lock O(region) ต่อ step) heap อื่นหยุดตั้งแต่ block แรก
+   ---------------------------------------------- */
+#if HEAP_FRAG_HAVE_WALK
+static const uint32_t s_caps[HEAP_FRAG_NCLASS] = {
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_SPIRAM,
+    MALLOC_CAP_DMA,
+};
+
+typedef struct
+{
+    int target;
+    int idx;
+    intptr_t cur_start;
+    bool found;
+    heap_frag_visit_t visit;
+    void *arg;
+} esp_walk_t;
+
+static bool esp_walker(walk_heap_info_t heap_info, walk_block_info_t block_info, void *user_data)
+{
+    esp_walk_t *w = (esp_walk_t *)user_data;
+    if (w->idx < 0 || heap_info.start != w->cur_start)
+    {
+        w->cur_start = heap_info.start;
+        w->idx++;
+    }
+    if (w->idx != w->target)
+        return false;
+    w->found = true;
+    heap_frag_block_t b = {(uintptr_t)block_info.ptr, block_info.size, block_info.used};
+    w->visit(&b, w->arg);
+    return true;
+}
+
+// budget/resume ไม่ใช้: เดินจบ region ทุกครั้ง (ดูด้านบน)
+static heap_frag_walk_rc_t esp_walk(void *ctx, heap_frag_class_t cls, int region, uintptr_t *resume,
+                                    uint32_t budget, heap_frag_visit_t visit, void *arg)
+{
+    (void)ctx;
+    (void)resume;
+    (void)budget;
+    esp_walk_t w = {.target = region, .idx = -1, .visit = visit, .arg = arg};
+    heap_caps_walk(s_caps[cls], esp_walker, &w);
+    return w.found ? HEAP_FRAG_WALK_REGION_DONE : HEAP_FRAG_WALK_NO_REGION;
+}
+#endif
+
+bool heap_frag_esp_backend(heap_frag_backend_t *out)
+{
+#if HEAP_FRAG_HAVE_WALK
+    *out = (heap_frag_backend_t){.walk = esp_walk, .now_us = esp_timer_get_time, .ctx = NULL};
+    return true;
+#else
+    (void)out;
+    ESP_LOGW(TAG, "heap_caps_walk needs ESP-IDF 5.3+, profiler disabled");
+    return false;
+#endif
+}
+
+static void frag_task(void *pvParameters)
+{
+    while (1)
+    {
+        heap_frag_step(HEAP_FRAG_STEP_BUDGET);
+        vTaskDelay(pdMS_TO_TICKS(HEAP_FRAG_STEP_MS));
+    }
+}
+
+bool heap_frag_start(UBaseType_t prio)
+{
+    if (s_task)
+        return false;
+    if (xTaskCreate(frag_task, "HeapFrag", 3072, NULL, prio, &s_task) != pdPASS)
+    {
+        s_task = NULL;
+        return false;
+    }
+    return true;
+}
+
+void heap_frag_print(void)
+{
+    ESP_LOGI(TAG, "\n🧩 ═══ FRAGMENTATION PROFILE ═══");
+    for (int c = 0; c < HEAP_FRAG_NCLASS; c++)
+    {
+        heap_frag_report_t r;
+        if (!heap_frag_get((heap_frag_class_t)c, &r))
+            continue;
+        if (!r.s.regions)
+            continue; // ไม่มี heap ของ capability นี้ (เช่นไม่มี PSRAM)
+        ESP_LOGI(TAG, "%-8s sweep #%lu (%u regions, %lu steps, %lu ms): free %lu B in %lu blocks, largest %lu, frag %.1f%%",
+                 heap_frag_class_name((heap_frag_class_t)c), (unsigned long)r.sweep, (unsigned)r.s.regions,
+                 (unsigned long)r.steps, (unsigned long)(r.sweep_us / 1000), (unsigned long)r.s.free_bytes,
+                 (unsigned long)r.s.free_blocks, (unsigned long)r.s.largest, r.frag * 100.0f);
+
+        char line[160];
+        size_t off = 0;
+        for (int i = 0; i < HEAP_FRAG_NREQ; i++)
+            off += snprintf(line + off, sizeof(line) - off, " %lu:%lu(-%.0f%%)", (unsigned long)r.req_size[i],
+                            (unsigned long)r.s.capacity[i], r.cap_loss[i] * 100.0f);
+        ESP_LOGI(TAG, "         fits size:count(loss)%s", line);
+
+        off = 0;
+        line[0] = '\0';
+        for (int b = 0; b < HEAP_FRAG_BUCKETS && off < sizeof(line) - 16; b++)
+            if (r.s.hist[b])
+                off += snprintf(line + off, sizeof(line) - off, " %s%lu:%lu", b ? "" : "<", (unsigned long)(b ? 8u << b : 16u),
+                                (unsigned long)r.s.hist[b]);
+        ESP_LOGI(TAG, "         free hist (>=size:n)%s", line);
+
+        if (r.trend_len > 1)
+            ESP_LOGI(TAG, "         trend over %u sweeps: free %+ld B, largest %+ld B, frag %+.1f pts",
+                     (unsigned)r.trend_len, (long)r.free_delta, (long)r.largest_delta, r.frag_delta * 100.0f);
+    }
+}
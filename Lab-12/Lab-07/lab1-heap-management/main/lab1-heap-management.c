@@ -15,10 +15,16 @@
 #include "esp_timer.h"
 #include "esp_system.h"
 #include "esp_random.h" // ✅ IDF 5+ ต้อง include แยก
+#include "esp_cpu.h"
+#include "esp_debug_helpers.h"
 #include "driver/gpio.h"
 
 // (ถ้ามีในโปรเจ็กต์) เดโม shared memory
 #include "shared_memory.h"
+#include "alloc_trace.h"
+#include "arena.h"
+#include "rle_codec.h"
+#include "heap_frag.h"
 
 // mbedTLS AES (มากับ ESP-IDF อยู่แล้ว)
 #include "mbedtls/aes.h"
@@ -40,7 +46,52 @@ static const char *TAG = "HEAP_MGMT";
 #define LOW_MEMORY_THRESHOLD 50000      // 50KB
 #define CRITICAL_MEMORY_THRESHOLD 20000 // 20KB
 #define FRAGMENTATION_THRESHOLD 0.30f
-#define MAX_ALLOCATIONS 100
+#ifndef TRACK_INITIAL_CAPACITY
+#define TRACK_INITIAL_CAPACITY 64 // record เริ่มต้นของตัวติดตาม (โตเท่าตัวเมื่อเต็ม ไม่มีเพดาน)
+#endif
+#ifndef TRACK_BENCH_ENABLE
+#define TRACK_BENCH_ENABLE 0 // 1 = วัด lookup ของตัวติดตามที่ 100/1k/10k live entries ตอนบูต
+#endif
+#ifndef TRACK_SITE_DEPTH
+#define TRACK_SITE_DEPTH 1 // 1 = แค่จุดที่เรียก tracked_malloc, >1 = backtrace สั้น (Xtensa เท่านั้น)
+#endif
+#ifndef TRACK_MAX_SITES
+#define TRACK_MAX_SITES 64 // call-site ที่แยกนับได้ (กำลังสอง) เกินนี้รวมเป็น "(other)"
+#endif
+#ifndef TRACK_LEAK_TOP_N
+#define TRACK_LEAK_TOP_N 5
+#endif
+#ifndef TRACK_LEAK_GROW_STREAK
+#define TRACK_LEAK_GROW_STREAK 3 // live bytes ของ site โตติดกันกี่รายงาน → สงสัยว่ารั่ว
+#endif
+
+#ifndef DPOOL_KEEP_EMPTY
+#define DPOOL_KEEP_EMPTY 1 // page ว่างสำรองของ class ที่ยัง "ร้อน" (กัน grow/shrink สลับไปมา)
+#endif
+#ifndef DPOOL_RECLAIM_BUDGET
+#define DPOOL_RECLAIM_BUDGET 2 // page สูงสุดที่ reclaimer คืน heap ต่อหนึ่ง step
+#endif
+#ifndef DPOOL_RECLAIM_PERIOD_MS
+#define DPOOL_RECLAIM_PERIOD_MS 1000
+#endif
+#ifndef DPOOL_RECLAIM_COLD_STEPS
+#define DPOOL_RECLAIM_COLD_STEPS 5 // class ไม่ต้องสร้าง page ใหม่ติดกันกี่ step → คืน page สำรองด้วย
+#endif
+#ifndef DPOOL_BENCH_ENABLE
+#define DPOOL_BENCH_ENABLE 0 // 1 = วัด throughput alloc/free ของ slab ด้วย 1/2/4/8 task ตอนบูต
+#endif
+#ifndef SECURE_CHUNK_SIZE
+#define SECURE_CHUNK_SIZE 256 // ไบต์ต่อ chunk ของ secure blob (พหุคูณของ 16)
+#endif
+#ifndef RLE_BENCH_ENABLE
+#define RLE_BENCH_ENABLE 0 // 1 = วัด MB/s ของ RLE (compat/long) บนข้อมูลแบบเซนเซอร์และสุ่มตอนบูต
+#endif
+#ifndef SECURE_BENCH_ENABLE
+#define SECURE_BENCH_ENABLE 0 // 1 = เทียบ secure blob แบบ chunked กับทางเดิม (MB/s + latency อ่าน field เดียว)
+#endif
+#ifndef ARENA_BENCH_ENABLE
+#define ARENA_BENCH_ENABLE 0 // 1 = เทียบ arena (local/shared) กับ heap_caps_malloc สำหรับ burst ของ object เล็กตอนบูต
+#endif
 
 #ifndef ALIGN_UP
 #define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
@@ -56,9 +107,29 @@ typedef struct
     uint32_t caps;
     const char *description;
     uint64_t timestamp;
+    uint16_t site; // index ใน track_sites[] (TRACK_SITE_NONE = ไม่นับ)
     bool is_active;
 } memory_allocation_t;
 
+// จุดเรียก (PC ของคำสั่ง call) ใช้เป็น key ของ site; idf.py monitor แปลง 0x4xxxxxxx เป็นชื่อฟังก์ชันให้
+typedef struct
+{
+    uint32_t pc[TRACK_SITE_DEPTH];
+} track_site_key_t;
+
+// ตัวนับต่อ call-site อัปเดตตอน insert/remove (ไม่ต้องไล่ allocation ตอนรายงาน)
+typedef struct
+{
+    track_site_key_t key;
+    const char *desc;        // description แรกที่มาจาก site นี้ (ช่วยอ่านรายงาน)
+    uint32_t live_bytes;
+    uint32_t live_count;
+    uint32_t allocs;         // สะสม
+    uint32_t reported_bytes; // live_bytes ตอนรายงานครั้งก่อน (ใช้หา growth)
+    uint8_t grow_streak;     // รายงานติดกันที่ live_bytes เพิ่มขึ้น
+    bool used;
+} track_site_t;
+
 typedef struct
 {
     uint32_t total_allocations;
@@ -75,7 +146,27 @@ typedef struct
 /* =========================
  *        GLOBALS
  * ========================= */
-static memory_allocation_t allocations[MAX_ALLOCATIONS];
+// ตัวติดตาม: record อยู่ใน array ที่โตได้ + stack ของ slot ว่าง (จอง/คืน slot O(1))
+// ค้นจาก ptr ผ่าน index แบบ open addressing (linear probe) ที่เก็บเลข slot
+// ทั้งหมดแก้ใต้ memory_mutex
+#define TRACK_EMPTY (-1)
+#define TRACK_TOMB (-2) // ช่องที่ถูกลบ (probe ต้องเดินผ่าน) ล้างทิ้งตอน rebuild
+
+static memory_allocation_t *allocations = NULL;
+static uint32_t track_capacity = 0;       // จำนวน record ใน allocations[]
+static uint32_t *track_free_stack = NULL; // slot ว่าง (LIFO)
+static uint32_t track_free_top = 0;
+static int32_t *track_index = NULL;       // TRACK_EMPTY / TRACK_TOMB / slot
+static uint32_t track_index_cap = 0;      // กำลังสองเสมอ
+static uint32_t track_index_used = 0;     // live + tombstone (ใช้คุม load factor)
+static uint32_t track_live = 0;
+
+#define TRACK_SITE_OTHER TRACK_MAX_SITES // ช่องรวมเมื่อตาราง site เต็ม
+#define TRACK_SITE_NONE 0xFFFFu
+_Static_assert((TRACK_MAX_SITES & (TRACK_MAX_SITES - 1)) == 0 && TRACK_MAX_SITES < TRACK_SITE_NONE,
+               "TRACK_MAX_SITES must be a power of two below 0xFFFF");
+static track_site_t track_sites[TRACK_MAX_SITES + 1];
+static uint32_t track_sites_used = 0;
 static memory_stats_t stats = {0};
 static SemaphoreHandle_t memory_mutex = NULL;
 static bool memory_monitoring_enabled = true;
@@ -84,8 +175,9 @@ static bool memory_monitoring_enabled = true;
  *  FORWARD DECLARATIONS
  * ========================= */
 // tracking helpers
-static int find_free_allocation_slot(void);
-static int find_allocation_by_ptr(void *ptr);
+static int track_insert(void *ptr, size_t size, uint32_t caps, const char *description,
+                        const track_site_key_t *site);
+static int track_remove(void *ptr);
 static void *tracked_malloc(size_t size, uint32_t caps, const char *description);
 static void tracked_free(void *ptr, const char *description);
 
@@ -98,56 +190,228 @@ static void analyze_memory_status(void);
 static void print_allocation_summary(void);
 static void detect_memory_leaks(void);
 
-// RLE helpers
-static size_t rle_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity);
-static size_t rle_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity);
-
 // secure memory helpers
 static void secure_wipe(void *p, size_t n);
 
 /* =========================
  *   TRACKING UTILITIES
  * ========================= */
-static int find_free_allocation_slot(void)
+// ที่เก็บของตัวติดตามเอง: ใช้ SPIRAM ถ้ามี (ตารางใหญ่ได้หลายหมื่น entry) ไม่งั้น internal
+static void *track_realloc(void *p, size_t n)
 {
-    for (int i = 0; i < MAX_ALLOCATIONS; i++)
+    void *q = NULL;
+    if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0)
+        q = heap_caps_realloc(p, n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return q ? q : heap_caps_realloc(p, n, MALLOC_CAP_8BIT);
+}
+
+// address จาก heap ลงตัว 4/8/16 → ผสมบิตก่อน mask ไม่งั้นบิตล่างซ้ำกันหมด
+static inline uint32_t track_hash(const void *ptr)
+{
+    uint32_t x = (uint32_t)(uintptr_t)ptr;
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// สร้าง index ใหม่ขนาด new_cap จาก record ที่ active (tombstone หายไปในตัว)
+static bool track_index_rebuild(uint32_t new_cap)
+{
+    int32_t *idx = (int32_t *)track_realloc(NULL, new_cap * sizeof(int32_t));
+    if (!idx)
+        return false;
+    for (uint32_t i = 0; i < new_cap; i++)
+        idx[i] = TRACK_EMPTY;
+    for (uint32_t slot = 0; slot < track_capacity; slot++)
     {
-        if (!allocations[i].is_active)
-            return i;
+        if (!allocations[slot].is_active)
+            continue;
+        uint32_t pos = track_hash(allocations[slot].ptr) & (new_cap - 1);
+        while (idx[pos] != TRACK_EMPTY)
+            pos = (pos + 1) & (new_cap - 1);
+        idx[pos] = (int32_t)slot;
     }
-    return -1;
+    heap_caps_free(track_index);
+    track_index = idx;
+    track_index_cap = new_cap;
+    track_index_used = track_live;
+    return true;
 }
 
-static int find_allocation_by_ptr(void *ptr)
+// เพิ่ม record เท่าตัว แล้วดัน slot ใหม่ลง stack (กลับด้าน → slot เลขต่ำออกก่อน)
+static bool track_grow_records(void)
 {
-    for (int i = 0; i < MAX_ALLOCATIONS; i++)
+    uint32_t new_cap = track_capacity ? track_capacity * 2 : TRACK_INITIAL_CAPACITY;
+    memory_allocation_t *recs =
+        (memory_allocation_t *)track_realloc(allocations, new_cap * sizeof(memory_allocation_t));
+    if (!recs)
+        return false;
+    allocations = recs;
+    uint32_t *stack = (uint32_t *)track_realloc(track_free_stack, new_cap * sizeof(uint32_t));
+    if (!stack)
+        return false; // records โตแล้วแต่ยังไม่ใช้ slot ใหม่ ลองใหม่ครั้งหน้าได้
+    track_free_stack = stack;
+    memset(&allocations[track_capacity], 0, (new_cap - track_capacity) * sizeof(memory_allocation_t));
+    for (uint32_t slot = new_cap; slot > track_capacity; slot--)
+        track_free_stack[track_free_top++] = slot - 1;
+    track_capacity = new_cap;
+    return true;
+}
+
+// ตำแหน่งใน index ของ ptr (-1 = ไม่พบ)
+static int32_t track_lookup(const void *ptr)
+{
+    if (!track_index_cap)
+        return -1;
+    uint32_t mask = track_index_cap - 1;
+    for (uint32_t pos = track_hash(ptr) & mask;; pos = (pos + 1) & mask)
     {
-        if (allocations[i].is_active && allocations[i].ptr == ptr)
-            return i;
+        int32_t slot = track_index[pos];
+        if (slot == TRACK_EMPTY)
+            return -1;
+        if (slot >= 0 && allocations[slot].ptr == ptr)
+            return (int32_t)pos;
     }
-    return -1;
 }
 
-static void *tracked_malloc(size_t size, uint32_t caps, const char *description)
+// เก็บจุดเรียก: ret = __builtin_return_address(0) ของ tracked_malloc (ต้องไม่ถูก inline)
+// TRACK_SITE_DEPTH > 1 บน Xtensa: ไล่ backtrace หาเฟรมของ ret แล้วเก็บเฟรมถัดขึ้นไปต่อ
+static void track_capture_site(track_site_key_t *k, void *ret)
+{
+    memset(k, 0, sizeof(*k));
+    k->pc[0] = (uint32_t)esp_cpu_get_call_addr((intptr_t)ret);
+#if TRACK_SITE_DEPTH > 1 && CONFIG_IDF_TARGET_ARCH_XTENSA
+    esp_backtrace_frame_t f;
+    esp_backtrace_get_start(&f.pc, &f.sp, &f.next_pc);
+    int n = 0;
+    for (int depth = 0; depth < 16 && n < TRACK_SITE_DEPTH; depth++)
+    {
+        uint32_t pc = esp_cpu_process_stack_pc(f.pc);
+        if (n > 0)
+            k->pc[n++] = pc;
+        else if (pc == (uint32_t)esp_cpu_process_stack_pc((uint32_t)(uintptr_t)ret))
+            n = 1; // เจอเฟรมของผู้เรียก (pc[0] เก็บแล้ว)
+        if (!esp_backtrace_get_next_frame(&f))
+            break;
+    }
+#endif
+}
+
+// หา/สร้าง site ของ key (ใต้ memory_mutex) ตารางเต็ม → TRACK_SITE_OTHER
+static uint16_t track_site_get(const track_site_key_t *k, const char *desc)
+{
+    uint32_t h = 0;
+    for (int i = 0; i < TRACK_SITE_DEPTH; i++)
+        h = track_hash((void *)(uintptr_t)(k->pc[i] ^ h));
+    for (uint32_t n = 0, pos = h & (TRACK_MAX_SITES - 1); n < TRACK_MAX_SITES;
+         n++, pos = (pos + 1) & (TRACK_MAX_SITES - 1))
+    {
+        track_site_t *st = &track_sites[pos];
+        if (st->used && memcmp(&st->key, k, sizeof(*k)) == 0)
+            return (uint16_t)pos;
+        if (!st->used)
+        {
+            if ((track_sites_used + 1) * 4 > TRACK_MAX_SITES * 3)
+                break; // เก็บที่ว่างไว้ให้ probe สั้น
+            st->used = true;
+            st->key = *k;
+            st->desc = desc;
+            track_sites_used++;
+            return (uint16_t)pos;
+        }
+    }
+    track_sites[TRACK_SITE_OTHER].used = true;
+    track_sites[TRACK_SITE_OTHER].desc = "(other)";
+    return TRACK_SITE_OTHER;
+}
+
+// คืน slot ของ record ใหม่ (-1 = ที่เก็บของตัวติดตามไม่พอ) site = NULL ไม่นับเข้าตาราง call-site
+static int track_insert(void *ptr, size_t size, uint32_t caps, const char *description,
+                        const track_site_key_t *site)
+{
+    // load factor (รวม tombstone) เกิน 3/4 → rebuild: live เกินครึ่งจึงขยาย ไม่งั้นแค่ล้าง tombstone
+    if ((track_index_used + 1) * 4 > track_index_cap * 3)
+    {
+        uint32_t cap = track_index_cap ? track_index_cap : TRACK_INITIAL_CAPACITY * 2;
+        if ((track_live + 1) * 2 > cap)
+            cap *= 2;
+        if (!track_index_rebuild(cap))
+            return -1;
+    }
+    if (track_free_top == 0 && !track_grow_records())
+        return -1;
+
+    uint32_t slot = track_free_stack[--track_free_top];
+    memory_allocation_t *a = &allocations[slot];
+    a->ptr = ptr;
+    a->size = size;
+    a->caps = caps;
+    a->description = description;
+    a->timestamp = esp_timer_get_time();
+    a->site = TRACK_SITE_NONE;
+    a->is_active = true;
+    if (site)
+    {
+        track_site_t *st = &track_sites[a->site = track_site_get(site, description)];
+        st->live_bytes += (uint32_t)size;
+        st->live_count++;
+        st->allocs++;
+    }
+
+    uint32_t mask = track_index_cap - 1;
+    uint32_t pos = track_hash(ptr) & mask;
+    while (track_index[pos] >= 0)
+        pos = (pos + 1) & mask;
+    if (track_index[pos] == TRACK_EMPTY)
+        track_index_used++; // ทับ tombstone ไม่เพิ่มช่องที่ใช้
+    track_index[pos] = (int32_t)slot;
+    track_live++;
+    return (int)slot;
+}
+
+// ถอด ptr ออก คืน slot เดิม (record ยังอ่านได้จนกว่าจะถูกใช้ซ้ำ) หรือ -1 ถ้าไม่ได้ติดตามไว้
+static int track_remove(void *ptr)
+{
+    int32_t pos = track_lookup(ptr);
+    if (pos < 0)
+        return -1;
+    int32_t slot = track_index[pos];
+    track_index[pos] = TRACK_TOMB;
+    allocations[slot].is_active = false;
+    if (allocations[slot].site != TRACK_SITE_NONE)
+    {
+        track_site_t *st = &track_sites[allocations[slot].site];
+        st->live_bytes -= (uint32_t)allocations[slot].size;
+        st->live_count--;
+    }
+    track_free_stack[track_free_top++] = (uint32_t)slot;
+    track_live--;
+    return (int)slot;
+}
+
+// log ไม่ทำบนเส้นทาง alloc: ใต้ mutex แค่อัปเดตตัวติดตาม แล้วเขียน record ลง trace ring (lock-free)
+// หลังปล่อย mutex ส่วนการ format ให้ drain task (ดู trace_log_sink)
+// noinline: return address ต้องเป็นของผู้เรียกจริง (ใช้เป็น call-site)
+static __attribute__((noinline)) void *tracked_malloc(size_t size, uint32_t caps, const char *description)
 {
     void *ptr = heap_caps_malloc(size, caps);
 
     if (memory_monitoring_enabled && memory_mutex)
     {
+        track_site_key_t site;
+        track_capture_site(&site, __builtin_return_address(0));
         if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
         {
+            uint8_t op = ALLOC_TRACE_ALLOC_FAIL;
             if (ptr)
             {
-                int slot = find_free_allocation_slot();
-                if (slot >= 0)
+                op = ALLOC_TRACE_TRACK_NOMEM;
+                if (track_insert(ptr, size, caps, description, &site) >= 0)
                 {
-                    allocations[slot].ptr = ptr;
-                    allocations[slot].size = size;
-                    allocations[slot].caps = caps;
-                    allocations[slot].description = description;
-                    allocations[slot].timestamp = esp_timer_get_time();
-                    allocations[slot].is_active = true;
-
+                    op = ALLOC_TRACE_ALLOC;
                     stats.total_allocations++;
                     stats.current_allocations++;
                     stats.total_bytes_allocated += size;
@@ -155,22 +419,14 @@ static void *tracked_malloc(size_t size, uint32_t caps, const char *description)
                     size_t current_usage = stats.total_bytes_allocated - stats.total_bytes_deallocated;
                     if (current_usage > stats.peak_usage)
                         stats.peak_usage = current_usage;
-
-                    ESP_LOGI(TAG, "✅ Allocated %u bytes at %p (%s)",
-                             (unsigned)size, ptr, description ? description : "-");
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "⚠️ Allocation tracking full!");
                 }
             }
             else
             {
                 stats.allocation_failures++;
-                ESP_LOGE(TAG, "❌ Failed to allocate %u bytes (%s)",
-                         (unsigned)size, description ? description : "-");
             }
             xSemaphoreGive(memory_mutex);
+            alloc_trace_emit(op, ptr, size, caps, description);
         }
     }
     return ptr;
@@ -185,22 +441,19 @@ static void tracked_free(void *ptr, const char *description)
     {
         if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
         {
-            int slot = find_allocation_by_ptr(ptr);
+            size_t size = 0;
+            uint32_t caps = 0;
+            int slot = track_remove(ptr);
             if (slot >= 0)
             {
-                allocations[slot].is_active = false;
+                size = allocations[slot].size;
+                caps = allocations[slot].caps;
                 stats.total_deallocations++;
                 stats.current_allocations--;
-                stats.total_bytes_deallocated += allocations[slot].size;
-
-                ESP_LOGI(TAG, "🗑️ Freed %u bytes at %p (%s)",
-                         (unsigned)allocations[slot].size, ptr, description ? description : "-");
-            }
-            else
-            {
-                ESP_LOGW(TAG, "⚠️ Freeing untracked pointer %p (%s)", ptr, description ? description : "-");
+                stats.total_bytes_deallocated += size;
             }
             xSemaphoreGive(memory_mutex);
+            alloc_trace_emit(slot >= 0 ? ALLOC_TRACE_FREE : ALLOC_TRACE_FREE_UNTRACKED, ptr, size, caps, description);
         }
     }
     heap_caps_free(ptr);
@@ -209,22 +462,19 @@ static void tracked_free(void *ptr, const char *description)
 /* =========================
  *  MANUAL REGISTER HELPERS
  * ========================= */
-static void register_allocation_manual(void *ptr, size_t size, uint32_t caps, const char *description)
+static __attribute__((noinline)) void register_allocation_manual(void *ptr, size_t size, uint32_t caps,
+                                                                 const char *description)
 {
     if (!ptr || !memory_mutex)
         return;
+    track_site_key_t site;
+    track_capture_site(&site, __builtin_return_address(0));
     if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
     {
-        int slot = find_free_allocation_slot();
-        if (slot >= 0)
+        uint8_t op = ALLOC_TRACE_REGISTER_NOMEM;
+        if (track_insert(ptr, size, caps, description, &site) >= 0)
         {
-            allocations[slot].ptr = ptr;
-            allocations[slot].size = size;
-            allocations[slot].caps = caps;
-            allocations[slot].description = description;
-            allocations[slot].timestamp = esp_timer_get_time();
-            allocations[slot].is_active = true;
-
+            op = ALLOC_TRACE_REGISTER;
             stats.total_allocations++;
             stats.current_allocations++;
             stats.total_bytes_allocated += size;
@@ -232,15 +482,9 @@ static void register_allocation_manual(void *ptr, size_t size, uint32_t caps, co
             size_t current_usage = stats.total_bytes_allocated - stats.total_bytes_deallocated;
             if (current_usage > stats.peak_usage)
                 stats.peak_usage = current_usage;
-
-            ESP_LOGI(TAG, "✅ Registered manual %u bytes at %p (%s)",
-                     (unsigned)size, ptr, description ? description : "-");
-        }
-        else
-        {
-            ESP_LOGW(TAG, "⚠️ Manual tracking full for %p (%s)", ptr, description ? description : "-");
         }
         xSemaphoreGive(memory_mutex);
+        alloc_trace_emit(op, ptr, size, caps, description);
     }
 }
 
@@ -250,22 +494,56 @@ static void unregister_allocation_manual(void *ptr, const char *description)
         return;
     if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(100)) == pdTRUE)
     {
-        int slot = find_allocation_by_ptr(ptr);
+        size_t size = 0;
+        int slot = track_remove(ptr);
         if (slot >= 0)
         {
-            allocations[slot].is_active = false;
+            size = allocations[slot].size;
             stats.total_deallocations++;
             stats.current_allocations--;
-            stats.total_bytes_deallocated += allocations[slot].size;
-
-            ESP_LOGI(TAG, "🗑️ Unregistered manual %u bytes at %p (%s)",
-                     (unsigned)allocations[slot].size, ptr, description ? description : "-");
-        }
-        else
-        {
-            ESP_LOGW(TAG, "⚠️ Unregister: pointer not found %p (%s)", ptr, description ? description : "-");
+            stats.total_bytes_deallocated += size;
         }
         xSemaphoreGive(memory_mutex);
+        alloc_trace_emit(slot >= 0 ? ALLOC_TRACE_UNREGISTER : ALLOC_TRACE_UNREGISTER_MISS, ptr, size, 0, description);
+    }
+}
+
+// drain task: แปลง record กลับเป็นข้อความเดิมของ lab
+static void trace_log_sink(const alloc_trace_rec_t *r, void *ctx)
+{
+    (void)ctx;
+    const char *d = r->desc ? r->desc : "-";
+    switch (r->op)
+    {
+    case ALLOC_TRACE_ALLOC:
+        ESP_LOGI(TAG, "✅ Allocated %u bytes at %p (%s)", (unsigned)r->size, r->ptr, d);
+        break;
+    case ALLOC_TRACE_FREE:
+        ESP_LOGI(TAG, "🗑️ Freed %u bytes at %p (%s)", (unsigned)r->size, r->ptr, d);
+        break;
+    case ALLOC_TRACE_ALLOC_FAIL:
+        ESP_LOGE(TAG, "❌ Failed to allocate %u bytes (%s)", (unsigned)r->size, d);
+        break;
+    case ALLOC_TRACE_FREE_UNTRACKED:
+        ESP_LOGW(TAG, "⚠️ Freeing untracked pointer %p (%s)", r->ptr, d);
+        break;
+    case ALLOC_TRACE_TRACK_NOMEM:
+        ESP_LOGW(TAG, "⚠️ Allocation tracking: no memory for tracker (%p untracked)", r->ptr);
+        break;
+    case ALLOC_TRACE_REGISTER:
+        ESP_LOGI(TAG, "✅ Registered manual %u bytes at %p (%s)", (unsigned)r->size, r->ptr, d);
+        break;
+    case ALLOC_TRACE_UNREGISTER:
+        ESP_LOGI(TAG, "🗑️ Unregistered manual %u bytes at %p (%s)", (unsigned)r->size, r->ptr, d);
+        break;
+    case ALLOC_TRACE_UNREGISTER_MISS:
+        ESP_LOGW(TAG, "⚠️ Unregister: pointer not found %p (%s)", r->ptr, d);
+        break;
+    case ALLOC_TRACE_REGISTER_NOMEM:
+        ESP_LOGW(TAG, "⚠️ Manual tracking: no memory for tracker (%p %s)", r->ptr, d);
+        break;
+    default:
+        break;
     }
 }
 
@@ -290,6 +568,10 @@ static void analyze_memory_status(void)
     ESP_LOGI(TAG, "Total Free:           %u", (unsigned)total_free);
     ESP_LOGI(TAG, "Minimum Ever Free:    %u", (unsigned)esp_get_minimum_free_heap_size());
     ESP_LOGI(TAG, "Internal Fragmentation: %.1f%%", internal_fragmentation * 100.0f);
+    heap_frag_report_t fr;
+    if (heap_frag_get(HEAP_FRAG_INTERNAL, &fr))
+        ESP_LOGI(TAG, "Free Blocks: %lu (1KB fits %lu, -%.0f%% by fragmentation)", (unsigned long)fr.s.free_blocks,
+                 (unsigned long)fr.s.capacity[2], fr.cap_loss[2] * 100.0f);
 
     if (internal_free < CRITICAL_MEMORY_THRESHOLD)
     {
@@ -339,6 +621,12 @@ static void print_allocation_summary(void)
         ESP_LOGI(TAG, "Total Allocations:    %lu", (unsigned long)stats.total_allocations);
         ESP_LOGI(TAG, "Total Deallocations:  %lu", (unsigned long)stats.total_deallocations);
         ESP_LOGI(TAG, "Current Allocations:  %lu", (unsigned long)stats.current_allocations);
+        alloc_trace_stats_t ts;
+        alloc_trace_get_stats(&ts);
+        ESP_LOGI(TAG, "Trace Records:        %lu emitted, %lu logged, %lu dropped", (unsigned long)ts.emitted,
+                 (unsigned long)ts.drained, (unsigned long)ts.dropped);
+        ESP_LOGI(TAG, "Tracker:              %lu slots, index %lu (tombstones %lu)", (unsigned long)track_capacity,
+                 (unsigned long)track_index_cap, (unsigned long)(track_index_used - track_live));
         ESP_LOGI(TAG, "Total Allocated:      %llu", (unsigned long long)stats.total_bytes_allocated);
         ESP_LOGI(TAG, "Total Deallocated:    %llu", (unsigned long long)stats.total_bytes_deallocated);
         ESP_LOGI(TAG, "Peak Usage:           %llu", (unsigned long long)stats.peak_usage);
@@ -349,13 +637,13 @@ static void print_allocation_summary(void)
         if (stats.current_allocations > 0)
         {
             ESP_LOGI(TAG, "\n🔍 ═══ ACTIVE ALLOCATIONS ═══");
-            for (int i = 0; i < MAX_ALLOCATIONS; i++)
+            for (uint32_t i = 0; i < track_capacity; i++)
             {
                 if (allocations[i].is_active)
                 {
                     uint64_t age_ms = (esp_timer_get_time() - allocations[i].timestamp) / 1000ULL;
-                    ESP_LOGI(TAG, "Slot %d: %u bytes @%p (%s) age=%llu ms",
-                             i, (unsigned)allocations[i].size, allocations[i].ptr,
+                    ESP_LOGI(TAG, "Slot %lu: %u bytes @%p (%s) age=%llu ms",
+                             (unsigned long)i, (unsigned)allocations[i].size, allocations[i].ptr,
                              allocations[i].description ? allocations[i].description : "-",
                              (unsigned long long)age_ms);
                 }
@@ -365,134 +653,164 @@ static void print_allocation_summary(void)
     }
 }
 
-static void detect_memory_leaks(void)
+// เลือก site ที่ค่าสูงสุด n อันดับ (O(sites * n)) by_growth = เทียบกับรายงานครั้งก่อน
+static int track_top_sites(uint16_t *out, int n, bool by_growth)
 {
-    if (!memory_mutex)
-        return;
-    if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
+    int cnt = 0;
+    int32_t val[TRACK_LEAK_TOP_N];
+    for (uint16_t i = 0; i <= TRACK_MAX_SITES; i++)
     {
-        uint64_t now = esp_timer_get_time();
-        int leak_count = 0;
-        size_t leaked_bytes = 0;
-        for (int i = 0; i < MAX_ALLOCATIONS; i++)
+        const track_site_t *st = &track_sites[i];
+        if (!st->used)
+            continue;
+        int32_t v = by_growth ? (int32_t)(st->live_bytes - st->reported_bytes) : (int32_t)st->live_bytes;
+        if (v <= 0)
+            continue;
+        int at = cnt < n ? cnt++ : n;
+        while (at > 0 && val[at - 1] < v)
         {
-            if (allocations[i].is_active)
+            if (at < n)
             {
-                uint64_t age_ms = (now - allocations[i].timestamp) / 1000ULL;
-                if (age_ms > 30000ULL)
-                {
-                    ESP_LOGW(TAG, "POTENTIAL LEAK: %u @%p (%s) age=%llu ms",
-                             (unsigned)allocations[i].size, allocations[i].ptr,
-                             allocations[i].description ? allocations[i].description : "-",
-                             (unsigned long long)age_ms);
-                    leak_count++;
-                    leaked_bytes += allocations[i].size;
-                }
+                val[at] = val[at - 1];
+                out[at] = out[at - 1];
             }
+            at--;
         }
-        if (leak_count > 0)
+        if (at < n)
         {
-            ESP_LOGW(TAG, "Found %d potential leaks totaling %u bytes",
-                     leak_count, (unsigned)leaked_bytes);
-            gpio_set_level(LED_MEMORY_ERROR, 1);
+            val[at] = v;
+            out[at] = i;
         }
-        else
-        {
-            gpio_set_level(LED_MEMORY_ERROR, 0);
-            ESP_LOGI(TAG, "No memory leaks detected");
-        }
-        xSemaphoreGive(memory_mutex);
     }
+    return cnt;
 }
 
-/* =========================
- *       RLE HELPERS
- * ========================= */
-static size_t rle_compress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity)
+typedef struct
 {
-    size_t in_pos = 0, out_pos = 0;
-    while (in_pos < in_len)
-    {
-        size_t run_len = 1;
-        while (in_pos + run_len < in_len && run_len < 127 && in[in_pos + run_len] == in[in_pos])
-            run_len++;
-        if (run_len >= 3)
-        {
-            uint8_t header = (uint8_t)(257 - run_len); // 129..255
-            if (out_pos + 2 > out_capacity)
-                break;
-            out[out_pos++] = header;
-            out[out_pos++] = in[in_pos];
-            in_pos += run_len;
-        }
-        else
-        {
-            size_t lit_start = in_pos, lit_len = 0;
-            while (in_pos < in_len && lit_len < 128)
-            {
-                if (in_pos + 2 < in_len && in[in_pos] == in[in_pos + 1] && in[in_pos] == in[in_pos + 2])
-                    break;
-                in_pos++;
-                lit_len++;
-            }
-            if (lit_len > 0)
-            {
-                if (out_pos + 1 + lit_len > out_capacity)
-                    break;
-                out[out_pos++] = (uint8_t)(lit_len - 1);
-                memcpy(out + out_pos, in + lit_start, lit_len);
-                out_pos += lit_len;
-            }
-        }
-    }
-    return out_pos;
+    track_site_key_t key;
+    const char *desc;
+    uint32_t live_bytes;
+    uint32_t live_count;
+    int32_t growth;
+    uint8_t streak;
+} track_site_report_t;
+
+static void track_site_copy(track_site_report_t *r, uint16_t i)
+{
+    const track_site_t *st = &track_sites[i];
+    r->key = st->key;
+    r->desc = st->desc;
+    r->live_bytes = st->live_bytes;
+    r->live_count = st->live_count;
+    r->growth = (int32_t)(st->live_bytes - st->reported_bytes);
+    r->streak = st->grow_streak;
 }
 
-static size_t rle_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_capacity)
+static void track_site_print(const char *what, int rank, const track_site_report_t *r)
 {
-    size_t in_pos = 0, out_pos = 0;
-    while (in_pos < in_len && out_pos < out_capacity)
+    char pcs[12 * TRACK_SITE_DEPTH + 1];
+    size_t off = 0;
+    pcs[0] = '\0';
+    for (int d = 0; d < TRACK_SITE_DEPTH && r->key.pc[d]; d++)
+        off += snprintf(pcs + off, sizeof(pcs) - off, "%s0x%08lx", d ? ":" : "", (unsigned long)r->key.pc[d]);
+    ESP_LOGW(TAG, "%s #%d %s  live=%lu B in %lu  growth=%+ld B  streak=%u (%s)", what, rank + 1,
+             pcs[0] ? pcs : "(other)", (unsigned long)r->live_bytes, (unsigned long)r->live_count,
+             (long)r->growth, (unsigned)r->streak, r->desc ? r->desc : "-");
+}
+
+// จัดอันดับ call-site ตาม live bytes และ growth ตั้งแต่รายงานก่อน (O(sites) ไม่ไล่ allocation)
+// site ที่ live bytes โตติดกัน TRACK_LEAK_GROW_STREAK รายงาน = สงสัยรั่ว
+static void detect_memory_leaks(void)
+{
+    if (!memory_mutex)
+        return;
+    track_site_report_t top_live[TRACK_LEAK_TOP_N], top_grow[TRACK_LEAK_TOP_N];
+    int n_live = 0, n_grow = 0, suspects = 0;
+    uint32_t suspect_bytes = 0;
+
+    // ใต้ mutex แค่คัดลอกผลแล้วเลื่อน baseline ส่วนการพิมพ์ทำหลังปล่อย
+    if (xSemaphoreTake(memory_mutex, pdMS_TO_TICKS(1000)) != pdTRUE)
+        return;
+    uint16_t idx[TRACK_LEAK_TOP_N];
+    n_live = track_top_sites(idx, TRACK_LEAK_TOP_N, false);
+    for (int i = 0; i < n_live; i++)
+        track_site_copy(&top_live[i], idx[i]);
+    n_grow = track_top_sites(idx, TRACK_LEAK_TOP_N, true);
+    for (int i = 0; i < n_grow; i++)
+        track_site_copy(&top_grow[i], idx[i]);
+    for (uint16_t i = 0; i <= TRACK_MAX_SITES; i++)
     {
-        uint8_t header = in[in_pos++];
-        if (header <= 127)
+        track_site_t *st = &track_sites[i];
+        if (!st->used)
+            continue;
+        if (st->live_bytes > st->reported_bytes)
         {
-            size_t lit_len = (size_t)header + 1;
-            if (in_pos + lit_len > in_len || out_pos + lit_len > out_capacity)
-                break;
-            memcpy(out + out_pos, in + in_pos, lit_len);
-            in_pos += lit_len;
-            out_pos += lit_len;
+            if (st->grow_streak < UINT8_MAX)
+                st->grow_streak++;
         }
-        else if (header >= 129)
+        else
         {
-            size_t rep_len = 257 - (size_t)header;
-            if (in_pos >= in_len || out_pos + rep_len > out_capacity)
-                break;
-            uint8_t value = in[in_pos++];
-            memset(out + out_pos, value, rep_len);
-            out_pos += rep_len;
+            st->grow_streak = 0;
         }
-        else
+        st->reported_bytes = st->live_bytes;
+        if (st->grow_streak >= TRACK_LEAK_GROW_STREAK)
         {
-            // 128 = NOP
+            suspects++;
+            suspect_bytes += st->live_bytes;
         }
     }
-    return out_pos;
+    uint32_t sites = track_sites_used;
+    xSemaphoreGive(memory_mutex);
+
+    ESP_LOGI(TAG, "\n🧭 ═══ LEAK RANKING (%lu call-sites) ═══", (unsigned long)sites);
+    for (int i = 0; i < n_live; i++)
+        track_site_print("TOP LIVE", i, &top_live[i]);
+    for (int i = 0; i < n_grow; i++)
+        track_site_print("TOP GROWTH", i, &top_grow[i]);
+
+    if (suspects > 0)
+    {
+        ESP_LOGW(TAG, "Found %d call-site(s) growing for %d+ reports, %lu bytes live",
+                 suspects, TRACK_LEAK_GROW_STREAK, (unsigned long)suspect_bytes);
+        gpio_set_level(LED_MEMORY_ERROR, 1);
+    }
+    else
+    {
+        gpio_set_level(LED_MEMORY_ERROR, 0);
+        ESP_LOGI(TAG, "No memory leaks detected");
+    }
 }
 
 /* =========================
  *   SECURE MEMORY (AES-CTR)
  * ========================= */
+// รูปแบบ chunked: counter ของ AES block b = nonce(12) || be32(b) → chunk c เริ่มที่ block c * (CHUNK/16)
+// ถอด chunk ไหนก็ได้โดยไม่ต้องแตะ chunk อื่น (secure_read ถอดเฉพาะไบต์ที่ขอ)
+// key schedule อยู่ใน context ของ blob (setkey ครั้งเดียวตอน store; ใช้ AES hardware ผ่าน mbedtls port ของ IDF)
+// งานทำทีละ chunk: ถือ AES peripheral สั้น ๆ ต่อครั้ง และ stream ออกได้โดยไม่ต้องมี plaintext ทั้งก้อน
+#define SECURE_CTR_BLOCKS(off) ((uint32_t)((off) >> 4))
+_Static_assert(SECURE_CHUNK_SIZE % 16 == 0, "SECURE_CHUNK_SIZE must be a multiple of the AES block");
+
 typedef struct secure_blob_t
 {
     uint8_t *cipher;
     size_t len;
-    uint8_t key[16];
-    uint8_t iv[16];
+    mbedtls_aes_context aes; // expanded key แคชต่อ blob
+    uint8_t nonce[12];
     bool in_use;
     const char *desc;
 } secure_blob_t;
 
+typedef struct
+{
+    const void *plain;
+    size_t len;
+    const char *desc;
+} secure_item_t;
+
+// รับ plaintext ทีละ chunk (buffer ถูกล้างหลังคืน) คืนค่าไม่ใช่ 0 = หยุด
+typedef int (*secure_sink_t)(const uint8_t *chunk, size_t n, size_t off, void *ctx);
+
 static void secure_wipe(void *p, size_t n)
 {
     volatile uint8_t *v = (volatile uint8_t *)p;
@@ -516,37 +834,76 @@ static void fill_random(uint8_t *dst, size_t n)
     }
 }
 
-static int aes_ctr_crypt(uint8_t *in, size_t len, uint8_t *out, const uint8_t key[16], const uint8_t iv[16])
+// XOR keystream ช่วง [off, off + len) ของ blob (in/out ซ้อนกันได้)
+static int secure_ctr_range(const secure_blob_t *sb, size_t off, const uint8_t *in, uint8_t *out, size_t len)
 {
-    mbedtls_aes_context ctx;
-    mbedtls_aes_init(&ctx);
-
-    unsigned char stream_block[16] = {0};
-    unsigned char nonce_counter[16];
-    size_t nc_off = 0;
-    memcpy(nonce_counter, iv, 16);
+    mbedtls_aes_context *aes = (mbedtls_aes_context *)&sb->aes; // crypt ไม่แก้ context
+    unsigned char ctr[16], stream[16];
+    size_t nc_off = off & 15;
+    uint32_t blk = SECURE_CTR_BLOCKS(off);
+    memcpy(ctr, sb->nonce, 12);
+    ctr[12] = (uint8_t)(blk >> 24);
+    ctr[13] = (uint8_t)(blk >> 16);
+    ctr[14] = (uint8_t)(blk >> 8);
+    ctr[15] = (uint8_t)blk;
+
+    int rc = 0;
+    if (nc_off)
+    {
+        // เริ่มกลาง block: keystream ของ block นี้ แล้วเลื่อน counter ไป block ถัดไป
+        rc = mbedtls_aes_crypt_ecb(aes, MBEDTLS_AES_ENCRYPT, ctr, stream);
+        for (int k = 15; k >= 12; k--)
+            if (++ctr[k])
+                break;
+    }
+    if (rc == 0)
+        rc = mbedtls_aes_crypt_ctr(aes, len, &nc_off, ctr, stream, in, out);
+    secure_wipe(stream, sizeof(stream));
+    secure_wipe(ctr, sizeof(ctr));
+    return rc;
+}
 
-    int rc = mbedtls_aes_setkey_enc(&ctx, key, 128);
-    if (rc != 0)
+// ทั้งช่วงทีละ chunk
+static int secure_ctr_chunked(const secure_blob_t *sb, size_t off, const uint8_t *in, uint8_t *out, size_t len)
+{
+    while (len)
     {
-        mbedtls_aes_free(&ctx);
-        return rc;
+        size_t n = SECURE_CHUNK_SIZE - (off % SECURE_CHUNK_SIZE);
+        if (n > len)
+            n = len;
+        int rc = secure_ctr_range(sb, off, in, out, n);
+        if (rc != 0)
+            return rc;
+        off += n;
+        in += n;
+        out += n;
+        len -= n;
     }
+    return 0;
+}
 
-    rc = mbedtls_aes_crypt_ctr(&ctx, len, &nc_off, nonce_counter, stream_block, in, out);
-    mbedtls_aes_free(&ctx);
-    secure_wipe(stream_block, sizeof(stream_block));
-    secure_wipe(nonce_counter, sizeof(nonce_counter));
-    return rc;
+static void secure_free(secure_blob_t *sb)
+{
+    if (!sb)
+        return;
+    if (sb->cipher)
+    {
+        secure_wipe(sb->cipher, sb->len);
+        tracked_free(sb->cipher, sb->desc ? sb->desc : "SecureCipher");
+    }
+    mbedtls_aes_free(&sb->aes);
+    secure_wipe(sb, sizeof(*sb));
 }
 
-static int secure_store(secure_blob_t *sb, const void *plaintext, size_t len, uint32_t caps_cipher, const char *desc)
+// key/nonce มาจากผู้เรียก (batch สุ่มทีเดียวทั้งชุด) key ถูกใช้แค่ setkey แล้วผู้เรียกล้างทิ้ง
+static int secure_store_keyed(secure_blob_t *sb, const void *plaintext, size_t len, uint32_t caps_cipher,
+                              const char *desc, const uint8_t key[16], const uint8_t nonce[12])
 {
-    if (!sb || !plaintext || !len)
+    if (!sb || !plaintext || !len || SECURE_CTR_BLOCKS(len - 1) == UINT32_MAX)
         return -1;
     memset(sb, 0, sizeof(*sb));
-    fill_random(sb->key, sizeof(sb->key));
-    fill_random(sb->iv, sizeof(sb->iv));
+    mbedtls_aes_init(&sb->aes);
+    memcpy(sb->nonce, nonce, sizeof(sb->nonce));
     sb->len = len;
     sb->desc = desc;
 
@@ -557,18 +914,58 @@ static int secure_store(secure_blob_t *sb, const void *plaintext, size_t len, ui
     {
         sb->cipher = (uint8_t *)tracked_malloc(len, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, desc ? desc : "SecureCipherInt");
         if (!sb->cipher)
+        {
+            secure_free(sb);
             return -2;
+        }
     }
 
-    int rc = aes_ctr_crypt((uint8_t *)plaintext, len, sb->cipher, sb->key, sb->iv);
-    if (rc != 0)
+    if (mbedtls_aes_setkey_enc(&sb->aes, key, 128) != 0 ||
+        secure_ctr_chunked(sb, 0, (const uint8_t *)plaintext, sb->cipher, len) != 0)
     {
-        tracked_free(sb->cipher, desc ? desc : "SecureCipher");
-        memset(sb, 0, sizeof(*sb));
+        secure_free(sb);
         return -3;
     }
     sb->in_use = true;
-    ESP_LOGI(TAG, "🔒 secure_store: len=%u desc=%s", (unsigned)len, desc ? desc : "-");
+    return 0;
+}
+
+static int secure_store(secure_blob_t *sb, const void *plaintext, size_t len, uint32_t caps_cipher, const char *desc)
+{
+    uint8_t kn[16 + 12];
+    fill_random(kn, sizeof(kn));
+    int rc = secure_store_keyed(sb, plaintext, len, caps_cipher, desc, kn, kn + 16);
+    secure_wipe(kn, sizeof(kn));
+    if (rc == 0)
+        ESP_LOGI(TAG, "🔒 secure_store: len=%u desc=%s", (unsigned)len, desc ? desc : "-");
+    return rc;
+}
+
+// หลาย blob ในครั้งเดียว: สุ่ม key/nonce ทั้งชุดรวดเดียว ล้มกลางทาง = คืนที่ทำไปแล้วทั้งหมด
+static int secure_store_batch(secure_blob_t *sbs, const secure_item_t *items, size_t n, uint32_t caps_cipher)
+{
+    if (!sbs || !items || !n)
+        return -1;
+    uint8_t kn[8][16 + 12];
+    for (size_t base = 0; base < n; base += 8)
+    {
+        size_t cnt = (n - base) < 8 ? (n - base) : 8;
+        fill_random(&kn[0][0], sizeof(kn[0]) * cnt);
+        for (size_t i = 0; i < cnt; i++)
+        {
+            const secure_item_t *it = &items[base + i];
+            int rc = secure_store_keyed(&sbs[base + i], it->plain, it->len, caps_cipher, it->desc, kn[i], kn[i] + 16);
+            if (rc != 0)
+            {
+                secure_wipe(kn, sizeof(kn));
+                for (size_t j = 0; j < base + i; j++)
+                    secure_free(&sbs[j]);
+                return rc;
+            }
+        }
+    }
+    secure_wipe(kn, sizeof(kn));
+    ESP_LOGI(TAG, "🔒 secure_store_batch: %u blobs", (unsigned)n);
     return 0;
 }
 
@@ -578,61 +975,124 @@ static int secure_load(const secure_blob_t *sb, void *out_plain, size_t out_capa
         return -1;
     if (!out_plain || out_capacity < sb->len)
         return -2;
-    int rc = aes_ctr_crypt(sb->cipher, sb->len, (uint8_t *)out_plain, sb->key, sb->iv);
-    if (rc != 0)
+    if (secure_ctr_chunked(sb, 0, sb->cipher, (uint8_t *)out_plain, sb->len) != 0)
         return -3;
     return (int)sb->len;
 }
 
-static void secure_free(secure_blob_t *sb)
+// random access: ถอดเฉพาะ [off, off + len) (แตะแค่ chunk ที่ช่วงนี้คร่อม)
+static int secure_read(const secure_blob_t *sb, size_t off, void *out, size_t len)
 {
-    if (!sb)
-        return;
-    if (sb->cipher)
+    if (!sb || !sb->in_use || !sb->cipher || !out)
+        return -1;
+    if (off > sb->len || len > sb->len - off)
+        return -2;
+    if (secure_ctr_chunked(sb, off, sb->cipher + off, (uint8_t *)out, len) != 0)
+        return -3;
+    return (int)len;
+}
+
+// streaming decrypt: plaintext อยู่บน stack ทีละ chunk เท่านั้น
+static int secure_load_stream(const secure_blob_t *sb, secure_sink_t sink, void *ctx)
+{
+    if (!sb || !sb->in_use || !sb->cipher || !sink)
+        return -1;
+    uint8_t buf[SECURE_CHUNK_SIZE];
+    int rc = 0;
+    for (size_t off = 0; off < sb->len && rc == 0; off += SECURE_CHUNK_SIZE)
     {
-        secure_wipe(sb->cipher, sb->len);
-        tracked_free(sb->cipher, sb->desc ? sb->desc : "SecureCipher");
+        size_t n = sb->len - off < SECURE_CHUNK_SIZE ? sb->len - off : SECURE_CHUNK_SIZE;
+        if (secure_ctr_range(sb, off, sb->cipher + off, buf, n) != 0)
+            rc = -3;
+        else if (sink(buf, n, off, ctx) != 0)
+            rc = -4;
     }
-    secure_wipe(sb->key, sizeof(sb->key));
-    secure_wipe(sb->iv, sizeof(sb->iv));
-    memset(sb, 0, sizeof(*sb));
+    secure_wipe(buf, sizeof(buf));
+    return rc;
 }
 
 /* =========================
  *   DYNAMIC MEMORY POOLS
  *   (1) Grow/Shrink Slab Pools
- *   (2) Bump-Pointer Arena
+ *   (2) Bump-Pointer Arena (arena.c)
  * ========================= */
 // ---- Slab Pools ----
+// แต่ละ class มีลิสต์ partial/full/empty → alloc ได้ page ที่มีที่ว่างใน O(1)
+// สถานะบล็อกเก็บเป็น bitmap ต่อ page (1 = ว่าง) หาช่องว่างด้วย ctz
+// free ไม่ใช้ lock: OR บิตลง remote_map ของ page แล้วคิว page ไว้ให้ผู้ alloc ครั้งถัดไป fold กลับ
+// used == 0 ยังไม่พอจะคืน page: ผู้ free อาจ OR บิตเสร็จ (ถูก fold ไปแล้ว) แต่ยังไม่ได้ push page
+// → นับ free ที่กำลังทำงานใน free_inflight; คืน page ได้เมื่อค่านี้เป็น 0 และ page ไม่อยู่ในสแตก remote
+#define DPOOL_NCLASS 6
+#define DPOOL_MAX_BLOCKS 128 // ต้อง >= _choose_blocks_per_page() สูงสุด
+#define DPOOL_MAP_WORDS (DPOOL_MAX_BLOCKS / 32)
+
+enum
+{
+    DPOOL_LIST_PARTIAL = 0,
+    DPOOL_LIST_FULL,
+    DPOOL_LIST_EMPTY,
+    DPOOL_LIST_COUNT
+};
+
 typedef struct dpool_page_t
 {
-    struct dpool_page_t *next;
+    struct dpool_page_t *next; // ลิสต์ partial/full/empty ของ class
+    struct dpool_page_t *prev;
+    struct dpool_page_t *remote_next; // สแตก page ที่มี remote free รอ fold
     uint8_t *base;
-    uint16_t block_size;
+    uint16_t stride; // header + block (align 8)
     uint16_t blocks;
-    uint16_t free_count;
-    void *free_list;
+    uint16_t used; // บล็อกที่ออกไปแล้ว (ยังไม่หัก remote free ที่ยังไม่ fold)
+    uint8_t list;  // DPOOL_LIST_*
+    uint8_t sizeclass;
+    uint32_t remote_queued;                // 1 = อยู่ในสแตก remote แล้ว
+    uint32_t free_inflight;                // dpool_free ที่เริ่มแตะ page นี้แต่ยังไม่จบ
+    uint32_t free_map[DPOOL_MAP_WORDS];   // 1 = ว่าง (แก้ใต้ lock ของ class)
+    uint32_t remote_map[DPOOL_MAP_WORDS]; // 1 = ถูก free แล้วแต่ยังไม่ fold (atomic OR)
 } dpool_page_t;
 
 typedef struct dpool_block_hdr_t
 {
     dpool_page_t *owner;
     uint16_t sizeclass;
+    uint16_t index; // ตำแหน่งบล็อกใน page (บิตใน map)
 } dpool_block_hdr_t;
 
 typedef struct dpool_class_t
 {
     uint16_t size;
     uint16_t blocks_per_page;
-    dpool_page_t *pages;
+    portMUX_TYPE lock;                   // สั้นและ O(1): ตัด/ต่อลิสต์ + บิต
+    dpool_page_t *lists[DPOOL_LIST_COUNT]; // หัวลิสต์ partial/full/empty
+    uint16_t npages[DPOOL_LIST_COUNT];
+    dpool_page_t *remote_head; // Treiber stack (push แบบ CAS, pop ทั้งก้อนด้วย exchange)
+    uint32_t double_frees;
+    // page churn (แก้ใต้ lock) + hysteresis ของ reclaimer
+    uint32_t pages_created;
+    uint32_t pages_released;
+    uint32_t grows_since_step; // page ใหม่ตั้งแต่ reclaim step ก่อน
+    uint16_t cold_steps;       // step ติดกันที่ไม่มี page ใหม่
 } dpool_class_t;
 
+typedef struct
+{
+    uint32_t steps;
+    uint32_t pages_released;
+    uint16_t last_pages; // งานของ step ล่าสุด
+    uint32_t last_us;
+    uint32_t max_us;
+} dpool_reclaim_stats_t;
+
 typedef struct dynamic_pool_mgr_t
 {
     uint32_t caps;
-    SemaphoreHandle_t lock;
-#define DPOOL_NCLASS 6
+    bool ready;
+    bool track; // true = alloc/free ผ่าน register_allocation_manual (ช้ากว่า ได้ leak ranking)
     dpool_class_t cls[DPOOL_NCLASS];
+    uint8_t reclaim_cursor; // class ที่ step ถัดไปเริ่มคืน page (round-robin)
+    volatile bool reclaim_stop;
+    TaskHandle_t reclaim_task;
+    dpool_reclaim_stats_t reclaim;
 } dynamic_pool_mgr_t;
 
 static inline uint16_t _choose_blocks_per_page(uint16_t blk)
@@ -651,22 +1111,21 @@ static inline uint16_t _choose_blocks_per_page(uint16_t blk)
         return 4;
 }
 
-static int dpool_init(dynamic_pool_mgr_t *pm, uint32_t caps)
+static int dpool_init(dynamic_pool_mgr_t *pm, uint32_t caps, bool track)
 {
     if (!pm)
         return -1;
     memset(pm, 0, sizeof(*pm));
     pm->caps = caps ? caps : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-    pm->lock = xSemaphoreCreateMutex();
-    if (!pm->lock)
-        return -2;
+    pm->track = track;
     const uint16_t sizes[DPOOL_NCLASS] = {64, 128, 256, 512, 1024, 2048};
     for (int i = 0; i < DPOOL_NCLASS; i++)
     {
         pm->cls[i].size = sizes[i];
         pm->cls[i].blocks_per_page = _choose_blocks_per_page(sizes[i]);
-        pm->cls[i].pages = NULL;
+        pm->cls[i].lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
     }
+    pm->ready = true;
     return 0;
 }
 
@@ -687,6 +1146,75 @@ static int _class_index_for_size(size_t size)
     return -1;
 }
 
+// ---- ลิสต์สองทาง (ใต้ c->lock) ----
+static void _dpool_list_push(dpool_class_t *c, dpool_page_t *pg, uint8_t list)
+{
+    pg->list = list;
+    pg->prev = NULL;
+    pg->next = c->lists[list];
+    if (pg->next)
+        pg->next->prev = pg;
+    c->lists[list] = pg;
+    c->npages[list]++;
+}
+
+static void _dpool_list_unlink(dpool_class_t *c, dpool_page_t *pg)
+{
+    if (pg->prev)
+        pg->prev->next = pg->next;
+    else
+        c->lists[pg->list] = pg->next;
+    if (pg->next)
+        pg->next->prev = pg->prev;
+    c->npages[pg->list]--;
+    pg->next = pg->prev = NULL;
+}
+
+static void _dpool_list_move(dpool_class_t *c, dpool_page_t *pg, uint8_t list)
+{
+    if (pg->list == list)
+        return;
+    _dpool_list_unlink(c, pg);
+    _dpool_list_push(c, pg, list);
+}
+
+static uint8_t _dpool_list_for(const dpool_page_t *pg)
+{
+    if (pg->used == 0)
+        return DPOOL_LIST_EMPTY;
+    return pg->used == pg->blocks ? DPOOL_LIST_FULL : DPOOL_LIST_PARTIAL;
+}
+
+// เอาบล็อกที่ถูก free จากทุก page ในสแตก remote กลับเข้า free_map (ใต้ c->lock)
+static void _dpool_collect_remote(dpool_class_t *c)
+{
+    dpool_page_t *pg = __atomic_exchange_n(&c->remote_head, NULL, __ATOMIC_ACQUIRE);
+    while (pg)
+    {
+        dpool_page_t *nx = pg->remote_next;
+        // ล้าง flag ก่อนอ่าน map: free ที่เข้ามาหลังจากนี้จะคิว page ใหม่เอง
+        __atomic_store_n(&pg->remote_queued, 0, __ATOMIC_RELEASE);
+        for (int w = 0; w < DPOOL_MAP_WORDS; w++)
+        {
+            uint32_t bits = __atomic_exchange_n(&pg->remote_map[w], 0, __ATOMIC_ACQUIRE);
+            pg->free_map[w] |= bits;
+            pg->used -= (uint16_t)__builtin_popcount(bits);
+        }
+        _dpool_list_move(c, pg, _dpool_list_for(pg));
+        pg = nx;
+    }
+}
+
+// page ว่างที่คืน heap ได้จริง (ใต้ c->lock): ไม่มี dpool_free ค้างอยู่กลางทาง และไม่อยู่ในสแตก remote
+// free ที่บิตถูก fold แล้วเพิ่ม free_inflight ก่อน fetch_or (release) → exchange ใน collect (acquire) เห็นค่านั้นเสมอ
+static bool _dpool_page_idle(dpool_page_t *pg)
+{
+    return pg->used == 0 &&
+           __atomic_load_n(&pg->free_inflight, __ATOMIC_ACQUIRE) == 0 &&
+           __atomic_load_n(&pg->remote_queued, __ATOMIC_RELAXED) == 0;
+}
+
+// สร้าง page ใหม่ (นอก lock: tracked_malloc ใช้ mutex)
 static dpool_page_t *_alloc_new_page(dynamic_pool_mgr_t *pm, int ci)
 {
     dpool_class_t *c = &pm->cls[ci];
@@ -695,7 +1223,7 @@ static dpool_page_t *_alloc_new_page(dynamic_pool_mgr_t *pm, int ci)
 
     const size_t hdr_sz = sizeof(dpool_block_hdr_t);
     const size_t one = ALIGN_UP(hdr_sz + bsz, 8);
-    const size_t total = sizeof(dpool_page_t) + (one * blocks);
+    const size_t total = ALIGN_UP(sizeof(dpool_page_t), 8) + (one * blocks);
 
     uint8_t *mem = (uint8_t *)tracked_malloc(total, pm->caps, "DPOOL_PAGE");
     if (!mem)
@@ -703,212 +1231,302 @@ static dpool_page_t *_alloc_new_page(dynamic_pool_mgr_t *pm, int ci)
 
     dpool_page_t *pg = (dpool_page_t *)mem;
     memset(pg, 0, sizeof(*pg));
-    pg->base = mem + sizeof(dpool_page_t);
-    pg->block_size = bsz;
+    pg->base = mem + ALIGN_UP(sizeof(dpool_page_t), 8);
+    pg->stride = (uint16_t)one;
     pg->blocks = blocks;
-    pg->free_count = blocks;
-    pg->free_list = NULL;
+    pg->sizeclass = (uint8_t)ci;
 
     for (int i = 0; i < blocks; i++)
     {
-        uint8_t *blk_base = pg->base + ((size_t)i * one);
-        dpool_block_hdr_t *bh = (dpool_block_hdr_t *)blk_base;
+        dpool_block_hdr_t *bh = (dpool_block_hdr_t *)(pg->base + ((size_t)i * one));
         bh->owner = pg;
         bh->sizeclass = (uint16_t)ci;
-        void *payload = (void *)(blk_base + hdr_sz);
-        *((void **)payload) = pg->free_list;
-        pg->free_list = payload;
+        bh->index = (uint16_t)i;
+        pg->free_map[i >> 5] |= 1u << (i & 31);
     }
 
-    pg->next = c->pages;
-    c->pages = pg;
-
     ESP_LOGI(TAG, "🧩 DPOOL new page: class=%d size=%u blocks=%u total=%u@%p",
              ci, (unsigned)bsz, (unsigned)blocks, (unsigned)total, mem);
     return pg;
 }
 
-static void *_dpool_alloc_locked(dynamic_pool_mgr_t *pm, size_t size, const char *desc)
+// ตัดบล็อกแรกที่ว่างจาก page (ใต้ c->lock) page ต้องมีที่ว่าง
+static void *_dpool_take_block(dpool_class_t *c, dpool_page_t *pg)
+{
+    for (int w = 0; w < DPOOL_MAP_WORDS; w++)
+    {
+        uint32_t m = pg->free_map[w];
+        if (!m)
+            continue;
+        int bit = __builtin_ctz(m);
+        pg->free_map[w] = m & (m - 1);
+        pg->used++;
+        _dpool_list_move(c, pg, _dpool_list_for(pg));
+        size_t idx = ((size_t)w << 5) + (size_t)bit;
+        return pg->base + idx * pg->stride + sizeof(dpool_block_hdr_t);
+    }
+    return NULL;
+}
+
+static void *dpool_alloc(dynamic_pool_mgr_t *pm, size_t size, const char *desc)
 {
+    if (!pm || !pm->ready || !size)
+        return NULL;
     int ci = _class_index_for_size(size);
     if (ci < 0)
         return NULL;
     dpool_class_t *c = &pm->cls[ci];
+    dpool_page_t *fresh = NULL;
+    void *payload = NULL;
 
-    dpool_page_t *pg = c->pages;
-    while (pg && !pg->free_list)
-        pg = pg->next;
-
-    if (!pg)
+    for (;;)
     {
-        pg = _alloc_new_page(pm, ci);
+        portENTER_CRITICAL(&c->lock);
+        if (fresh)
+        {
+            _dpool_list_push(c, fresh, DPOOL_LIST_EMPTY);
+            c->pages_created++;
+            c->grows_since_step++;
+            fresh = NULL;
+        }
+        dpool_page_t *pg = c->lists[DPOOL_LIST_PARTIAL];
+        if (!pg && c->remote_head)
+        {
+            _dpool_collect_remote(c);
+            pg = c->lists[DPOOL_LIST_PARTIAL];
+        }
         if (!pg)
+            pg = c->lists[DPOOL_LIST_EMPTY];
+        if (pg)
+            payload = _dpool_take_block(c, pg);
+        portEXIT_CRITICAL(&c->lock);
+
+        if (payload)
+            break;
+        fresh = _alloc_new_page(pm, ci);
+        if (!fresh)
             return NULL;
     }
 
-    void *payload = pg->free_list;
-    pg->free_list = *((void **)payload);
-    if (pg->free_count)
-        pg->free_count--;
-
-    register_allocation_manual(payload, c->size, pm->caps, desc ? desc : "DPOOL");
+    if (pm->track)
+        register_allocation_manual(payload, c->size, pm->caps, desc ? desc : "DPOOL");
     return payload;
 }
 
-static void dpool_release_empty_pages_locked(dynamic_pool_mgr_t *pm, int ci)
+// ไม่ใช้ lock: เรียกจาก task ไหนก็ได้ บล็อกกลับเข้า page ตอนผู้ alloc ถัดไป collect
+static void dpool_free(dynamic_pool_mgr_t *pm, void *ptr, const char *desc)
 {
-    dpool_class_t *c = &pm->cls[ci];
-    dpool_page_t **pp = &c->pages;
-    while (*pp)
+    if (!pm || !pm->ready || !ptr)
+        return;
+    if (pm->track)
+        unregister_allocation_manual(ptr, desc ? desc : "DPOOL"); // สถิติ
+
+    dpool_block_hdr_t *bh = (dpool_block_hdr_t *)((uint8_t *)ptr - sizeof(dpool_block_hdr_t));
+    dpool_page_t *pg = bh->owner;
+    dpool_class_t *c = &pm->cls[pg->sizeclass];
+    const int w = bh->index >> 5;
+    const uint32_t bit = 1u << (bh->index & 31);
+
+    // ตั้งแต่ OR บิตจนถึง push เสร็จ page อาจถูก fold จน used == 0 แล้ว → กันไม่ให้ถูกคืน heap ระหว่างนี้
+    __atomic_fetch_add(&pg->free_inflight, 1, __ATOMIC_RELAXED);
+
+    // บิตใน free_map ถูกล้างตอนบล็อกนี้ถูก alloc (happens-before ผ่าน pointer ที่ได้มา)
+    if ((__atomic_load_n(&pg->free_map[w], __ATOMIC_RELAXED) & bit) ||
+        (__atomic_fetch_or(&pg->remote_map[w], bit, __ATOMIC_RELEASE) & bit))
     {
-        dpool_page_t *pg = *pp;
-        if (pg->free_count == pg->blocks)
-        {
-            *pp = pg->next;
-            tracked_free(pg, "DPOOL_PAGE");
-        }
-        else
+        __atomic_fetch_sub(&pg->free_inflight, 1, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&c->double_frees, 1, __ATOMIC_RELAXED);
+        ESP_LOGE(TAG, "❌ DPOOL double free %p (%s)", ptr, desc ? desc : "DPOOL");
+        return;
+    }
+    if (!__atomic_exchange_n(&pg->remote_queued, 1, __ATOMIC_ACQ_REL))
+    {
+        dpool_page_t *head = __atomic_load_n(&c->remote_head, __ATOMIC_RELAXED);
+        do
         {
-            pp = &pg->next;
-        }
+            pg->remote_next = head;
+        } while (!__atomic_compare_exchange_n(&c->remote_head, &head, pg, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
     }
+    // หลังบรรทัดนี้ห้ามแตะ pg: ถ้าบล็อกถูก fold แล้ว page อาจถูกคืน heap ได้ทันที
+    __atomic_fetch_sub(&pg->free_inflight, 1, __ATOMIC_RELEASE);
 }
 
-static void dpool_defrag_hint(dynamic_pool_mgr_t *pm)
+// ---- Incremental reclaimer ----
+// หนึ่ง step: fold remote free + อัปเดตความร้อนของทุก class (O(classes))
+// แล้วคืน page ว่างส่วนเกินได้ไม่เกิน budget page โดยเริ่มจาก class ที่ค้างจาก step ก่อน
+// class ที่ยังสร้าง page ใหม่ใน DPOOL_RECLAIM_COLD_STEPS step หลังสุดเก็บ page สำรอง DPOOL_KEEP_EMPTY ไว้
+// แต่ละ class อยู่ใน critical section แค่ช่วงตัด page ออกจากลิสต์ ตัว free ทำนอก lock
+static int dpool_reclaim_step(dynamic_pool_mgr_t *pm, int budget)
 {
-    if (!pm || !pm->lock)
-        return;
-    if (xSemaphoreTake(pm->lock, pdMS_TO_TICKS(100)) == pdTRUE)
+    if (!pm || !pm->ready)
+        return 0;
+    uint64_t t0 = esp_timer_get_time();
+    dpool_page_t *victims = NULL;
+    int taken = 0, next = -1;
+
+    for (int n = 0; n < DPOOL_NCLASS; n++)
     {
-        for (int i = 0; i < DPOOL_NCLASS; i++)
-            dpool_release_empty_pages_locked(pm, i);
-        xSemaphoreGive(pm->lock);
+        int ci = (pm->reclaim_cursor + n) % DPOOL_NCLASS;
+        dpool_class_t *c = &pm->cls[ci];
+        portENTER_CRITICAL(&c->lock);
+        _dpool_collect_remote(c);
+        if (c->grows_since_step)
+            c->cold_steps = 0;
+        else if (c->cold_steps < UINT16_MAX)
+            c->cold_steps++;
+        c->grows_since_step = 0;
+        uint16_t keep = c->cold_steps < DPOOL_RECLAIM_COLD_STEPS ? DPOOL_KEEP_EMPTY : 0;
+        dpool_page_t *pg = c->lists[DPOOL_LIST_EMPTY];
+        while (pg && taken < budget && c->npages[DPOOL_LIST_EMPTY] > keep)
+        {
+            // ลิสต์ EMPTY บอกแค่ used == 0: dpool_free ที่บิตถูก fold แล้วอาจยังจะเขียน remote_next
+            // page แบบนั้นข้ามไปก่อน step ถัดไปค่อยคืน
+            dpool_page_t *nx = pg->next;
+            if (_dpool_page_idle(pg))
+            {
+                _dpool_list_unlink(c, pg);
+                c->pages_released++;
+                pg->next = victims;
+                victims = pg;
+                taken++;
+            }
+            pg = nx;
+        }
+        if (next < 0 && c->npages[DPOOL_LIST_EMPTY] > keep)
+            next = ci; // budget หมดแต่ยังมีงานค้าง: step หน้าเริ่มที่ class นี้
+        portEXIT_CRITICAL(&c->lock);
     }
-}
+    pm->reclaim_cursor = (uint8_t)(next >= 0 ? next : (pm->reclaim_cursor + 1) % DPOOL_NCLASS);
 
-static void *dpool_alloc(dynamic_pool_mgr_t *pm, size_t size, const char *desc)
-{
-    if (!pm || !pm->lock || !size)
-        return NULL;
-    void *p = NULL;
-    if (xSemaphoreTake(pm->lock, pdMS_TO_TICKS(100)) == pdTRUE)
+    while (victims)
     {
-        p = _dpool_alloc_locked(pm, size, desc);
-        xSemaphoreGive(pm->lock);
+        dpool_page_t *nx = victims->next;
+        tracked_free(victims, "DPOOL_PAGE");
+        victims = nx;
     }
-    return p;
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    pm->reclaim.steps++;
+    pm->reclaim.pages_released += (uint32_t)taken;
+    pm->reclaim.last_pages = (uint16_t)taken;
+    pm->reclaim.last_us = us;
+    if (us > pm->reclaim.max_us)
+        pm->reclaim.max_us = us;
+    return taken;
 }
 
-static void dpool_free(dynamic_pool_mgr_t *pm, void *ptr, const char *desc)
+static void dpool_reclaim_task(void *arg)
 {
-    if (!pm || !pm->lock || !ptr)
-        return;
-    unregister_allocation_manual(ptr, desc ? desc : "DPOOL"); // สถิติ
-
-    if (xSemaphoreTake(pm->lock, pdMS_TO_TICKS(100)) == pdTRUE)
+    dynamic_pool_mgr_t *pm = (dynamic_pool_mgr_t *)arg;
+    while (!pm->reclaim_stop)
     {
-        dpool_block_hdr_t *bh = (dpool_block_hdr_t *)((uint8_t *)ptr - sizeof(dpool_block_hdr_t));
-        dpool_page_t *pg = bh->owner;
-        *((void **)ptr) = pg->free_list;
-        pg->free_list = ptr;
-        if (pg->free_count < 0xFFFF)
-            pg->free_count++;
-        xSemaphoreGive(pm->lock);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DPOOL_RECLAIM_PERIOD_MS));
+        if (!pm->reclaim_stop)
+            dpool_reclaim_step(pm, DPOOL_RECLAIM_BUDGET);
     }
+    pm->reclaim_task = NULL;
+    vTaskDelete(NULL);
 }
 
-static void dpool_dump(dynamic_pool_mgr_t *pm)
+// reclaimer เป็น task priority ต่ำ ตื่นทุก DPOOL_RECLAIM_PERIOD_MS (หรือเมื่อถูก hint)
+static bool dpool_reclaim_start(dynamic_pool_mgr_t *pm, UBaseType_t prio)
 {
-    if (!pm || !pm->lock)
-        return;
-    if (xSemaphoreTake(pm->lock, pdMS_TO_TICKS(200)) == pdTRUE)
+    if (!pm || !pm->ready || pm->reclaim_task)
+        return false;
+    pm->reclaim_stop = false;
+    if (xTaskCreate(dpool_reclaim_task, "DpReclaim", 3072, pm, prio, &pm->reclaim_task) != pdPASS)
     {
-        ESP_LOGI(TAG, "🔎 DPOOL DUMP:");
-        for (int i = 0; i < DPOOL_NCLASS; i++)
-        {
-            dpool_class_t *c = &pm->cls[i];
-            int pages = 0, free_blocks = 0, total_blocks = 0;
-            for (dpool_page_t *pg = c->pages; pg; pg = pg->next)
-            {
-                pages++;
-                free_blocks += pg->free_count;
-                total_blocks += pg->blocks;
-            }
-            ESP_LOGI(TAG, "  class[%d]: size=%u pages=%d free=%d/%d",
-                     i, (unsigned)c->size, pages, free_blocks, total_blocks);
-        }
-        xSemaphoreGive(pm->lock);
+        pm->reclaim_task = NULL;
+        return false;
     }
+    return true;
 }
 
-// ---- Bump Arena ----
-typedef struct bump_arena_t
-{
-    uint8_t *buf;
-    size_t cap;
-    size_t off;
-    uint32_t caps;
-    SemaphoreHandle_t lock;
-} bump_arena_t;
-
-static int arena_init(bump_arena_t *ar, size_t capacity, uint32_t caps)
+// ไม่ทำงานเองแล้ว: ปลุก reclaimer ให้ทำ step ถัดไปเร็วขึ้น (ไม่มี reclaimer → ทำหนึ่ง step ตรงนี้)
+static void dpool_defrag_hint(dynamic_pool_mgr_t *pm)
 {
-    if (!ar || !capacity)
-        return -1;
-    memset(ar, 0, sizeof(*ar));
-    ar->caps = caps ? caps : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-    ar->buf = (uint8_t *)tracked_malloc(capacity, ar->caps, "ARENA_BUF");
-    if (!ar->buf)
-        return -2;
-    ar->cap = capacity;
-    ar->lock = xSemaphoreCreateMutex();
-    return ar->lock ? 0 : -3;
+    if (!pm || !pm->ready)
+        return;
+    if (pm->reclaim_task)
+        xTaskNotifyGive(pm->reclaim_task);
+    else
+        dpool_reclaim_step(pm, DPOOL_RECLAIM_BUDGET);
 }
 
-static void *arena_alloc(bump_arena_t *ar, size_t size, size_t align, const char *desc)
+#if DPOOL_BENCH_ENABLE
+// คืนทุก page (ผู้เรียกต้องแน่ใจว่าไม่มีบล็อกค้างใช้อยู่แล้ว) — มีแค่ benchmark ที่สร้าง/ทิ้ง pool
+static void dpool_destroy(dynamic_pool_mgr_t *pm)
 {
-    if (!ar || !ar->lock || !size)
-        return NULL;
-    void *p = NULL;
-    if (xSemaphoreTake(ar->lock, pdMS_TO_TICKS(50)) == pdTRUE)
+    if (!pm || !pm->ready)
+        return;
+    if (pm->reclaim_task)
     {
-        size_t a = (align == 0) ? 8 : align;
-        size_t off_aligned = ALIGN_UP(ar->off, a);
-        if (off_aligned + size <= ar->cap)
-        {
-            p = ar->buf + off_aligned;
-            ar->off = off_aligned + size;
-            register_allocation_manual(p, size, ar->caps, desc ? desc : "ARENA");
-        }
-        xSemaphoreGive(ar->lock);
+        pm->reclaim_stop = true;
+        xTaskNotifyGive(pm->reclaim_task);
+        while (pm->reclaim_task)
+            vTaskDelay(1);
     }
-    return p;
-}
-
-static void arena_reset(bump_arena_t *ar)
-{
-    if (!ar || !ar->lock)
-        return;
-    if (xSemaphoreTake(ar->lock, pdMS_TO_TICKS(50)) == pdTRUE)
+    for (int i = 0; i < DPOOL_NCLASS; i++)
     {
-        // บันทึกสถิติแบบง่าย: “free” ก้อนใหญ่
-        ar->off = 0;
-        xSemaphoreGive(ar->lock);
+        dpool_class_t *c = &pm->cls[i];
+        portENTER_CRITICAL(&c->lock);
+        _dpool_collect_remote(c);
+        portEXIT_CRITICAL(&c->lock);
+        for (int l = 0; l < DPOOL_LIST_COUNT; l++)
+        {
+            while (c->lists[l])
+            {
+                dpool_page_t *pg = c->lists[l];
+                // free ที่คืนบล็อกสุดท้ายอาจยังไม่ออกจาก dpool_free
+                while (__atomic_load_n(&pg->free_inflight, __ATOMIC_ACQUIRE))
+                    vTaskDelay(1);
+                if (pg->used)
+                    ESP_LOGW(TAG, "DPOOL destroy: class[%d] page %p still has %u blocks", i, pg, (unsigned)pg->used);
+                _dpool_list_unlink(c, pg);
+                tracked_free(pg, "DPOOL_PAGE");
+            }
+        }
     }
+    memset(pm, 0, sizeof(*pm));
 }
+#endif
 
-static void arena_destroy(bump_arena_t *ar)
+static void dpool_dump(dynamic_pool_mgr_t *pm)
 {
-    if (!ar)
+    if (!pm || !pm->ready)
         return;
-    if (ar->buf)
+    ESP_LOGI(TAG, "🔎 DPOOL DUMP:");
+    for (int i = 0; i < DPOOL_NCLASS; i++)
     {
-        secure_wipe(ar->buf, ar->cap);
-        tracked_free(ar->buf, "ARENA_BUF");
+        dpool_class_t *c = &pm->cls[i];
+        int pages = 0, free_blocks = 0, total_blocks = 0, pending = 0;
+        uint16_t np[DPOOL_LIST_COUNT];
+        portENTER_CRITICAL(&c->lock);
+        for (int l = 0; l < DPOOL_LIST_COUNT; l++)
+        {
+            np[l] = c->npages[l];
+            for (dpool_page_t *pg = c->lists[l]; pg; pg = pg->next)
+            {
+                pages++;
+                free_blocks += pg->blocks - pg->used;
+                total_blocks += pg->blocks;
+                for (int w = 0; w < DPOOL_MAP_WORDS; w++)
+                    pending += __builtin_popcount(__atomic_load_n(&pg->remote_map[w], __ATOMIC_RELAXED));
+            }
+        }
+        portEXIT_CRITICAL(&c->lock);
+        ESP_LOGI(TAG, "  class[%d]: size=%u pages=%d (partial %u full %u empty %u) free=%d/%d remote=%d dfree=%lu"
+                      " churn +%lu/-%lu%s",
+                 i, (unsigned)c->size, pages, (unsigned)np[DPOOL_LIST_PARTIAL], (unsigned)np[DPOOL_LIST_FULL],
+                 (unsigned)np[DPOOL_LIST_EMPTY], free_blocks + pending, total_blocks, pending,
+                 (unsigned long)__atomic_load_n(&c->double_frees, __ATOMIC_RELAXED),
+                 (unsigned long)c->pages_created, (unsigned long)c->pages_released,
+                 c->cold_steps >= DPOOL_RECLAIM_COLD_STEPS ? " (cold)" : "");
     }
-    if (ar->lock)
-        vSemaphoreDelete(ar->lock);
-    memset(ar, 0, sizeof(*ar));
+    ESP_LOGI(TAG, "  reclaim: steps=%lu released=%lu last=%u pages/%lu us max=%lu us",
+             (unsigned long)pm->reclaim.steps, (unsigned long)pm->reclaim.pages_released,
+             (unsigned)pm->reclaim.last_pages, (unsigned long)pm->reclaim.last_us,
+             (unsigned long)pm->reclaim.max_us);
 }
 
 /* =========================
@@ -957,15 +1575,15 @@ static void memory_pool_test_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "🏊 Memory pool mini test started");
     const size_t sizes[] = {64, 128, 256, 512, 1024};
+    // desc ถูกเก็บเป็น pointer (ตัวติดตาม + trace ring อ่านทีหลัง) → ต้องเป็น string ที่อยู่ตลอด
+    static const char *const names[] = {"Pool64", "Pool128", "Pool256", "Pool512", "Pool1024"};
     void *p[5][6] = {{0}};
     while (1)
     {
         for (int s = 0; s < 5; s++)
             for (int i = 0; i < 6; i++)
             {
-                char d[24];
-                snprintf(d, sizeof(d), "Pool%u_%u", s, i);
-                p[s][i] = tracked_malloc(sizes[s], MALLOC_CAP_INTERNAL, d);
+                p[s][i] = tracked_malloc(sizes[s], MALLOC_CAP_INTERNAL, names[s]);
                 if (p[s][i])
                     memset(p[s][i], 0x55 + s, sizes[s]);
             }
@@ -1010,17 +1628,42 @@ static void large_allocation_test_task(void *pvParameters)
                     ((uint8_t *)buf)[i + j] = (uint8_t)(esp_random() & 0xFF);
                 i += mix;
             }
-            void *c = tracked_malloc(n + 64, MALLOC_CAP_INTERNAL, "RLE_C");
-            void *d = tracked_malloc(n, MALLOC_CAP_INTERNAL, "RLE_D");
-            if (c && d)
+            // streaming: ป้อนทีละ RLE_DEMO_CHUNK ผ่าน staging buffer (เหมือนส่งออก sink/ไฟล์)
+            const size_t RLE_DEMO_CHUNK = 4096;
+            const size_t stage_cap = RLE_ENC_BOUND(RLE_DEMO_CHUNK);
+            uint8_t *c = (uint8_t *)tracked_malloc(RLE_ENC_BOUND(n), MALLOC_CAP_INTERNAL, "RLE_C");
+            uint8_t *d = (uint8_t *)tracked_malloc(n, MALLOC_CAP_INTERNAL, "RLE_D");
+            uint8_t *stage = (uint8_t *)tracked_malloc(stage_cap, MALLOC_CAP_INTERNAL, "RLE_STAGE");
+            if (c && d && stage)
             {
+                rle_enc_t enc;
+                rle_enc_init(&enc, RLE_MODE_LONG);
+                size_t clen = 0;
                 uint64_t cs = esp_timer_get_time();
-                size_t clen = rle_compress(buf, n, c, n + 64);
+                for (size_t off = 0; off < n; off += RLE_DEMO_CHUNK)
+                {
+                    size_t take = (n - off) < RLE_DEMO_CHUNK ? (n - off) : RLE_DEMO_CHUNK;
+                    size_t w = rle_enc_update(&enc, (const uint8_t *)buf + off, take, stage, stage_cap);
+                    memcpy(c + clen, stage, w);
+                    clen += w;
+                }
+                clen += rle_enc_finish(&enc, c + clen, RLE_ENC_BOUND(n) - clen);
                 uint64_t ce = esp_timer_get_time();
+
+                rle_dec_t dec;
+                rle_dec_init(&dec, RLE_MODE_LONG);
+                size_t dlen = 0;
                 uint64_t ds = esp_timer_get_time();
-                size_t dlen = rle_decompress(c, clen, d, n);
+                for (size_t off = 0; off < clen;)
+                {
+                    size_t used = 0, take = (clen - off) < 1024 ? (clen - off) : 1024;
+                    dlen += rle_dec_update(&dec, c + off, take, &used, d + dlen, n - dlen);
+                    if (!used)
+                        break; // output เต็มแต่ input ยังเหลือ = stream เสีย
+                    off += used;
+                }
                 uint64_t de = esp_timer_get_time();
-                bool ok = (dlen == n) && (memcmp(buf, d, n) == 0);
+                bool ok = (dlen == n) && rle_dec_finish(&dec) && (memcmp(buf, d, n) == 0);
                 ESP_LOGI(TAG, "🔁 RLE: orig=%u comp=%u (%.2f%%) enc_us=%llu dec_us=%llu ok=%d",
                          (unsigned)n, (unsigned)clen, clen ? 100.f * (float)clen / (float)n : 0.f,
                          (unsigned long long)(ce - cs), (unsigned long long)(de - ds), ok);
@@ -1029,6 +1672,8 @@ static void large_allocation_test_task(void *pvParameters)
                 tracked_free(c, "RLE_C");
             if (d)
                 tracked_free(d, "RLE_D");
+            if (stage)
+                tracked_free(stage, "RLE_STAGE");
             tracked_free(buf, "Large");
         }
         else
@@ -1047,6 +1692,7 @@ static void memory_monitor_task(void *pvParameters)
     {
         vTaskDelay(pdMS_TO_TICKS(10000));
         analyze_memory_status();
+        heap_frag_print();
         print_allocation_summary();
         detect_memory_leaks();
         if (!heap_caps_check_integrity_all(true))
@@ -1090,6 +1736,21 @@ static void heap_integrity_test_task(void *pvParameters)
     }
 }
 
+typedef struct
+{
+    const char *expect;
+    size_t *pos;
+} secure_cmp_t;
+
+static int secure_cmp_sink(const uint8_t *chunk, size_t n, size_t off, void *ctx)
+{
+    secure_cmp_t *c = (secure_cmp_t *)ctx;
+    if (off != *c->pos || memcmp(chunk, c->expect + off, n) != 0)
+        return -1;
+    *c->pos += n;
+    return 0;
+}
+
 static void sensitive_data_demo_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "🔐 Sensitive data demo started");
@@ -1121,9 +1782,39 @@ static void sensitive_data_demo_task(void *pvParameters)
     }
     tmp[slen] = '\0';
     ESP_LOGI(TAG, "🔓 Decrypted(use briefly): %s", (char *)tmp);
+
+    // อ่านเฉพาะ field (ถอดแค่ไบต์ของ Token ไม่ต้องถอดทั้ง blob)
+    const char *tok = strstr(secret, "Token=");
+    if (tok)
+    {
+        size_t off = (size_t)(tok - secret) + 6, flen = strcspn(tok + 6, ";");
+        if (secure_read(&sb, off, tmp, flen) == (int)flen)
+        {
+            tmp[flen] = '\0';
+            ESP_LOGI(TAG, "🔓 Field read @%u (%u bytes): %s", (unsigned)off, (unsigned)flen, (char *)tmp);
+        }
+    }
     secure_wipe(tmp, slen);
     tracked_free(tmp, "Tmp");
     secure_free(&sb);
+
+    // batch: หลาย secret ในครั้งเดียว แล้วตรวจแบบ streaming (plaintext ไม่เคยอยู่ครบทั้งก้อน)
+    static const char *const secrets[] = {"wifi-psk=hunter2", "api-key=0123456789abcdef", "pin=4321"};
+    secure_item_t items[3];
+    secure_blob_t blobs[3];
+    for (int i = 0; i < 3; i++)
+        items[i] = (secure_item_t){.plain = secrets[i], .len = strlen(secrets[i]), .desc = "SecureBatch"};
+    if (secure_store_batch(blobs, items, 3, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) == 0)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            size_t pos = 0;
+            int src = secure_load_stream(&blobs[i], secure_cmp_sink, &(secure_cmp_t){secrets[i], &pos});
+            ESP_LOGI(TAG, "🔐 Batch blob %d: %u bytes, stream verify %s", i, (unsigned)blobs[i].len,
+                     src == 0 && pos == blobs[i].len ? "OK" : "FAIL");
+            secure_free(&blobs[i]);
+        }
+    }
     ESP_LOGI(TAG, "🔐 Sensitive data demo finished");
     vTaskDelete(NULL);
 }
@@ -1134,15 +1825,18 @@ static void dynamic_pools_demo_task(void *arg)
     dynamic_pool_mgr_t dpm;
     uint32_t caps = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
                                                                : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-    if (dpool_init(&dpm, caps) != 0)
+    if (dpool_init(&dpm, caps, true) != 0)
     {
         ESP_LOGE(TAG, "dpool_init failed");
         vTaskDelete(NULL);
         return;
     }
+    if (!dpool_reclaim_start(&dpm, 1))
+        ESP_LOGW(TAG, "DPOOL reclaimer not started (empty pages freed only on defrag hint)");
 
-    bump_arena_t arena;
-    if (arena_init(&arena, 64 * 1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) != 0)
+    // shared arena: block 16KB ต่อ chain เมื่อเต็ม (batch ด้านล่างเกิน block แรกเสมอ)
+    arena_t arena;
+    if (arena_init(&arena, ARENA_SHARED, 16 * 1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, "ARENA_BLOCK") != 0)
     {
         ESP_LOGE(TAG, "arena_init failed");
         vTaskDelete(NULL);
@@ -1161,14 +1855,25 @@ static void dynamic_pools_demo_task(void *arg)
             if (h[i])
                 memset(h[i], 0xCD, want < 64 ? want : 64);
         }
-        // Arena batch then reset
+        // Arena batch + scratch แบบ scope (marker) แล้ว reset ทั้งก้อน
         for (int k = 0; k < 10; k++)
         {
             size_t ask = 1024 + (esp_random() % 2048);
-            void *p = arena_alloc(&arena, ask, 16, "ARENA_DEMO");
+            void *p = arena_alloc(&arena, ask, 16);
             if (p)
                 memset(p, 0xA5, ask < 128 ? ask : 128);
         }
+        arena_marker_t mark = arena_save(&arena);
+        uint8_t *scratch = (uint8_t *)arena_alloc(&arena, 4096, 8);
+        if (scratch)
+            memset(scratch, 0x5A, 4096);
+        arena_restore(&arena, mark);
+
+        arena_stats_t as;
+        arena_get_stats(&arena, &as);
+        ESP_LOGI(TAG, "🧱 ARENA: allocs=%lu bytes=%u/%u blocks=%lu (peak %lu) grows=%lu fails=%lu",
+                 (unsigned long)as.allocs, (unsigned)as.bytes, (unsigned)as.capacity, (unsigned long)as.blocks,
+                 (unsigned long)as.peak_blocks, (unsigned long)as.grows, (unsigned long)as.fails);
         arena_reset(&arena);
 
         dpool_dump(&dpm);
@@ -1186,6 +1891,429 @@ static void dynamic_pools_demo_task(void *arg)
     }
 }
 
+#if TRACK_BENCH_ENABLE
+/* =========================
+ *   TRACKER BENCHMARK
+ * ========================= */
+// ใช้ pointer สมมุติ (ไม่จองจริง) เพื่อวัดเฉพาะตัวติดตาม เรียกก่อนสร้าง task อื่น
+// เทียบกับการไล่ array แบบเดิม (linear scan) บน record ชุดเดียวกัน
+static void track_bench(void)
+{
+    static const uint32_t sizes[] = {100, 1000, 10000};
+    const uint32_t lookups = 10000;
+    uintptr_t base = 0x3FC80000u;
+
+    xSemaphoreTake(memory_mutex, portMAX_DELAY);
+    ESP_LOGI(TAG, "\n⏱️ ═══ TRACKER BENCH (hash vs linear) ═══");
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+    {
+        uint32_t n = sizes[k];
+        uint32_t ok = 0;
+        for (uint32_t i = 0; i < n; i++)
+            ok += track_insert((void *)(base + i * 48u), 48, MALLOC_CAP_8BIT, "bench", NULL) >= 0;
+        if (ok < n)
+        {
+            ESP_LOGW(TAG, "n=%-5lu | no memory for tracker (%lu inserted)", (unsigned long)n, (unsigned long)ok);
+            for (uint32_t i = 0; i < n; i++)
+                track_remove((void *)(base + i * 48u));
+            break;
+        }
+
+        uint32_t hits = 0;
+        uint64_t t0 = esp_timer_get_time();
+        for (uint32_t i = 0; i < lookups; i++)
+            hits += track_lookup((void *)(base + (esp_random() % n) * 48u)) >= 0;
+        uint64_t hash_us = esp_timer_get_time() - t0;
+
+        uint32_t scan_n = lookups / 10; // linear ช้ามาก วัดแค่ 1/10 แล้วคูณกลับ
+        t0 = esp_timer_get_time();
+        for (uint32_t i = 0; i < scan_n; i++)
+        {
+            void *want = (void *)(base + (esp_random() % n) * 48u);
+            for (uint32_t slot = 0; slot < track_capacity; slot++)
+                if (allocations[slot].is_active && allocations[slot].ptr == want)
+                {
+                    hits++;
+                    break;
+                }
+        }
+        uint64_t scan_us = esp_timer_get_time() - t0;
+
+        // churn: free + alloc คู่กัน (วัด tombstone + free-slot stack)
+        t0 = esp_timer_get_time();
+        for (uint32_t i = 0; i < lookups; i++)
+        {
+            uintptr_t p = base + (esp_random() % n) * 48u;
+            track_remove((void *)p);
+            track_insert((void *)p, 48, MALLOC_CAP_8BIT, "bench", NULL);
+        }
+        uint64_t churn_us = esp_timer_get_time() - t0;
+
+        ESP_LOGI(TAG, "n=%-5lu | lookup %4lu ns  linear %7lu ns  churn %4lu ns/pair  (hits %lu, index %lu)",
+                 (unsigned long)n, (unsigned long)(hash_us * 1000 / lookups),
+                 (unsigned long)(scan_us * 1000 / scan_n), (unsigned long)(churn_us * 1000 / lookups),
+                 (unsigned long)hits, (unsigned long)track_index_cap);
+
+        for (uint32_t i = 0; i < n; i++)
+            track_remove((void *)(base + i * 48u));
+    }
+
+    // คืนที่เก็บที่โตไประหว่าง bench (ยังไม่มี record จริง) ให้เริ่มจากขนาดตั้งต้นใหม่
+    heap_caps_free(allocations);
+    heap_caps_free(track_free_stack);
+    heap_caps_free(track_index);
+    allocations = NULL;
+    track_free_stack = NULL;
+    track_index = NULL;
+    track_capacity = track_free_top = track_index_cap = track_index_used = track_live = 0;
+    xSemaphoreGive(memory_mutex);
+
+    // ต้นทุน alloc+free ต่อคู่: heap ตรง vs ผ่านตัวติดตาม (log ไปอยู่ใน trace ring แล้ว)
+    const int pairs = 1000;
+    uint64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < pairs; i++)
+        heap_caps_free(heap_caps_malloc(64, MALLOC_CAP_8BIT));
+    uint64_t raw_us = esp_timer_get_time() - t0;
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < pairs; i++)
+        tracked_free(tracked_malloc(64, MALLOC_CAP_8BIT, "bench"), "bench");
+    uint64_t trk_us = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "malloc+free 64B | raw %lu ns  tracked %lu ns", (unsigned long)(raw_us * 1000 / pairs),
+             (unsigned long)(trk_us * 1000 / pairs));
+    ESP_LOGI(TAG, "═══════════════════════════════");
+}
+#endif
+
+#if DPOOL_BENCH_ENABLE
+/* =========================
+ *   SLAB THROUGHPUT BENCHMARK
+ * ========================= */
+// ทุก task แชร์ pool เดียวกัน: จอง 1..512 B เก็บไว้ 8 ก้อนแล้วคืนก้อนเก่าสุด (FIFO)
+// วัดทั้ง track=false (fast path ล้วน) และ track=true (ผ่านตัวติดตามด้วย)
+// baseline "locked" = ทุก alloc/free ถือ mutex ตัวเดียวของ pool แบบเดิม (ก่อนแยกเป็น per-class + free ไร้ lock)
+#define DPOOL_BENCH_PAIRS 4000
+#define DPOOL_BENCH_WINDOW 8
+
+typedef struct
+{
+    dynamic_pool_mgr_t *pm;
+    SemaphoreHandle_t done;
+    SemaphoreHandle_t big_lock; // != NULL = baseline locked
+    uint32_t seed;
+    uint32_t fails;
+} dpool_bench_arg_t;
+
+static void dpool_bench_task(void *arg)
+{
+    dpool_bench_arg_t *a = (dpool_bench_arg_t *)arg;
+    void *win[DPOOL_BENCH_WINDOW] = {0};
+    uint32_t x = a->seed;
+    for (int i = 0; i < DPOOL_BENCH_PAIRS; i++)
+    {
+        void **slot = &win[i % DPOOL_BENCH_WINDOW];
+        x = x * 1664525u + 1013904223u;
+        if (a->big_lock)
+            xSemaphoreTake(a->big_lock, portMAX_DELAY);
+        if (*slot)
+            dpool_free(a->pm, *slot, "DPOOL_BENCH");
+        if (a->big_lock)
+        {
+            xSemaphoreGive(a->big_lock); // แบบเดิม: free กับ alloc ถือ lock แยกครั้งกัน
+            xSemaphoreTake(a->big_lock, portMAX_DELAY);
+        }
+        *slot = dpool_alloc(a->pm, 1 + (x >> 23), "DPOOL_BENCH");
+        if (a->big_lock)
+            xSemaphoreGive(a->big_lock);
+        if (!*slot)
+            a->fails++;
+    }
+    for (int i = 0; i < DPOOL_BENCH_WINDOW; i++)
+        if (win[i])
+            dpool_free(a->pm, win[i], "DPOOL_BENCH");
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static void dpool_bench(void)
+{
+    static const int tasks[] = {1, 2, 4, 8};
+    static dpool_bench_arg_t args[8];
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(8, 0);
+    SemaphoreHandle_t big_lock = xSemaphoreCreateMutex();
+    if (!done || !big_lock)
+    {
+        if (done)
+            vSemaphoreDelete(done);
+        if (big_lock)
+            vSemaphoreDelete(big_lock);
+        return;
+    }
+    ESP_LOGI(TAG, "\n⏱️ ═══ DPOOL BENCH (%d alloc+free pairs/task) ═══", DPOOL_BENCH_PAIRS);
+    for (int run = 0; run < 4; run++)
+    {
+        int track = run & 1;
+        bool locked = run < 2; // baseline ก่อน แล้วค่อย slab ปัจจุบัน
+        for (size_t k = 0; k < sizeof(tasks) / sizeof(tasks[0]); k++)
+        {
+            dynamic_pool_mgr_t pm;
+            dpool_init(&pm, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, track);
+            uint32_t fails = 0;
+            uint64_t t0 = esp_timer_get_time();
+            for (int t = 0; t < tasks[k]; t++)
+            {
+                args[t] = (dpool_bench_arg_t){
+                    .pm = &pm, .done = done, .big_lock = locked ? big_lock : NULL, .seed = 0x9E3779B9u * (t + 1)};
+                xTaskCreate(dpool_bench_task, "DpBench", 2048, &args[t], 5, NULL);
+            }
+            for (int t = 0; t < tasks[k]; t++)
+            {
+                xSemaphoreTake(done, portMAX_DELAY);
+                fails += args[t].fails;
+            }
+            uint64_t us = esp_timer_get_time() - t0;
+            uint64_t pairs = (uint64_t)DPOOL_BENCH_PAIRS * tasks[k];
+            ESP_LOGI(TAG, "%-6s track=%d tasks=%d | %lu pairs/s  %lu ns/pair  (fails %lu)",
+                     locked ? "locked" : "slab", track, tasks[k],
+                     (unsigned long)(us ? pairs * 1000000ull / us : 0), (unsigned long)(us * 1000 / pairs),
+                     (unsigned long)fails);
+            dpool_destroy(&pm);
+        }
+    }
+    vSemaphoreDelete(big_lock);
+    vSemaphoreDelete(done);
+    ESP_LOGI(TAG, "═══════════════════════════════");
+}
+#endif
+
+#if ARENA_BENCH_ENABLE
+/* =========================
+ *   ARENA BENCHMARK
+ * ========================= */
+// burst ของ object เล็ก (16..128 B) แล้วคืนทั้งหมด: heap_caps_malloc/free ทีละก้อน vs arena reset ครั้งเดียว
+#define ARENA_BENCH_BURST 256
+#define ARENA_BENCH_ROUNDS 50
+
+static void arena_bench(void)
+{
+    static void *ptrs[ARENA_BENCH_BURST];
+    static uint16_t sizes[ARENA_BENCH_BURST];
+    const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    uint32_t x = 12345;
+    for (int i = 0; i < ARENA_BENCH_BURST; i++)
+    {
+        x = x * 1664525u + 1013904223u;
+        sizes[i] = (uint16_t)(16 + (x >> 25)); // 16..143
+    }
+    const uint32_t n = ARENA_BENCH_BURST * ARENA_BENCH_ROUNDS;
+    ESP_LOGI(TAG, "\n⏱️ ═══ ARENA BENCH (%d objects x %d bursts) ═══", ARENA_BENCH_BURST, ARENA_BENCH_ROUNDS);
+
+    uint32_t fails = 0;
+    uint64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < ARENA_BENCH_ROUNDS; r++)
+    {
+        for (int i = 0; i < ARENA_BENCH_BURST; i++)
+            if (!(ptrs[i] = heap_caps_malloc(sizes[i], caps)))
+                fails++;
+        for (int i = 0; i < ARENA_BENCH_BURST; i++)
+            heap_caps_free(ptrs[i]);
+    }
+    uint64_t heap_us = esp_timer_get_time() - t0;
+
+    // block 4KB: burst (~20KB) ต้องต่อ chain ทุกรอบ → วัดต้นทุน grow + reset ด้วย
+    uint64_t arena_us[2] = {0};
+    for (int kind = ARENA_LOCAL; kind <= ARENA_SHARED; kind++)
+    {
+        arena_t ar;
+        if (arena_init(&ar, (arena_kind_t)kind, 4096, caps, "ARENA_BENCH") != 0)
+            continue;
+        t0 = esp_timer_get_time();
+        for (int r = 0; r < ARENA_BENCH_ROUNDS; r++)
+        {
+            for (int i = 0; i < ARENA_BENCH_BURST; i++)
+                if (!arena_alloc(&ar, sizes[i], 8))
+                    fails++;
+            arena_reset(&ar);
+        }
+        arena_us[kind] = esp_timer_get_time() - t0;
+        arena_destroy(&ar);
+    }
+
+    ESP_LOGI(TAG, "heap_caps %lu ns/obj | arena local %lu ns/obj  shared %lu ns/obj  (fails %lu)",
+             (unsigned long)(heap_us * 1000 / n), (unsigned long)(arena_us[ARENA_LOCAL] * 1000 / n),
+             (unsigned long)(arena_us[ARENA_SHARED] * 1000 / n), (unsigned long)fails);
+    ESP_LOGI(TAG, "═══════════════════════════════");
+}
+#endif
+
+#if RLE_BENCH_ENABLE
+/* =========================
+ *   RLE BENCHMARK
+ * ========================= */
+// sensor-like: ค่าค้างเป็นช่วงยาว + noise เป็นพัก ๆ / random: แทบไม่มี run (กรณีแย่สุดของ literal)
+#define RLE_BENCH_LEN (32 * 1024)
+#define RLE_BENCH_ROUNDS 20
+
+static void rle_bench(void)
+{
+    uint8_t *src = (uint8_t *)heap_caps_malloc(RLE_BENCH_LEN, MALLOC_CAP_8BIT);
+    uint8_t *enc = (uint8_t *)heap_caps_malloc(RLE_ENC_BOUND(RLE_BENCH_LEN), MALLOC_CAP_8BIT);
+    uint8_t *dec = (uint8_t *)heap_caps_malloc(RLE_BENCH_LEN, MALLOC_CAP_8BIT);
+    if (!src || !enc || !dec)
+    {
+        heap_caps_free(src);
+        heap_caps_free(enc);
+        heap_caps_free(dec);
+        return;
+    }
+    ESP_LOGI(TAG, "\n⏱️ ═══ RLE BENCH (%d KB x %d) ═══", RLE_BENCH_LEN / 1024, RLE_BENCH_ROUNDS);
+    for (int data = 0; data < 2; data++)
+    {
+        uint32_t x = 0xC0FFEEu;
+        for (size_t i = 0; i < RLE_BENCH_LEN;)
+        {
+            x = x * 1664525u + 1013904223u;
+            if (data == 0)
+            {
+                size_t run = 16 + (x >> 24); // ค่าคงที่ 16..271 ไบต์ แล้ว noise 0..7 ไบต์
+                uint8_t v = (uint8_t)(x >> 8);
+                for (size_t k = 0; k < run && i < RLE_BENCH_LEN; k++)
+                    src[i++] = v;
+                for (size_t k = 0; k < ((x >> 4) & 7) && i < RLE_BENCH_LEN; k++)
+                    src[i++] = (uint8_t)(x >> (k & 15));
+            }
+            else
+            {
+                src[i++] = (uint8_t)(x >> 24);
+            }
+        }
+        for (int mode = RLE_MODE_COMPAT; mode <= RLE_MODE_LONG; mode++)
+        {
+            size_t clen = 0, dlen = 0;
+            uint64_t t0 = esp_timer_get_time();
+            for (int r = 0; r < RLE_BENCH_ROUNDS; r++)
+                clen = rle_encode((rle_mode_t)mode, src, RLE_BENCH_LEN, enc, RLE_ENC_BOUND(RLE_BENCH_LEN));
+            uint64_t enc_us = esp_timer_get_time() - t0;
+            t0 = esp_timer_get_time();
+            for (int r = 0; r < RLE_BENCH_ROUNDS; r++)
+                dlen = rle_decode((rle_mode_t)mode, enc, clen, dec, RLE_BENCH_LEN);
+            uint64_t dec_us = esp_timer_get_time() - t0;
+            bool ok = dlen == RLE_BENCH_LEN && memcmp(src, dec, RLE_BENCH_LEN) == 0;
+            uint64_t bytes = (uint64_t)RLE_BENCH_LEN * RLE_BENCH_ROUNDS;
+            ESP_LOGI(TAG, "%-6s %-6s | ratio %5.1f%%  enc %6.1f MB/s  dec %6.1f MB/s  ok=%d",
+                     data ? "random" : "sensor", mode == RLE_MODE_LONG ? "long" : "compat",
+                     100.0 * (double)clen / RLE_BENCH_LEN, enc_us ? (double)bytes / (double)enc_us : 0.0,
+                     dec_us ? (double)bytes / (double)dec_us : 0.0, ok);
+        }
+    }
+    ESP_LOGI(TAG, "═══════════════════════════════");
+    heap_caps_free(src);
+    heap_caps_free(enc);
+    heap_caps_free(dec);
+}
+#endif
+
+#if SECURE_BENCH_ENABLE
+/* =========================
+ *   SECURE BLOB BENCHMARK
+ * ========================= */
+// ทางเดิม: init context + setkey ทุกครั้ง แล้ว CTR ทั้งก้อน (อ่าน field เดียวก็ต้องถอดทั้ง blob)
+static int aes_ctr_crypt_oneshot(const uint8_t *in, size_t len, uint8_t *out, const uint8_t key[16],
+                                 const uint8_t iv[16])
+{
+    mbedtls_aes_context ctx;
+    mbedtls_aes_init(&ctx);
+    unsigned char stream_block[16] = {0};
+    unsigned char nonce_counter[16];
+    size_t nc_off = 0;
+    memcpy(nonce_counter, iv, 16);
+    int rc = mbedtls_aes_setkey_enc(&ctx, key, 128);
+    if (rc == 0)
+        rc = mbedtls_aes_crypt_ctr(&ctx, len, &nc_off, nonce_counter, stream_block, in, out);
+    mbedtls_aes_free(&ctx);
+    secure_wipe(stream_block, sizeof(stream_block));
+    return rc;
+}
+
+#define SECURE_BENCH_LEN (16 * 1024)
+#define SECURE_BENCH_ROUNDS 10
+#define SECURE_BENCH_FIELD 32
+
+static void secure_bench(void)
+{
+    const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    uint8_t *plain = (uint8_t *)heap_caps_malloc(SECURE_BENCH_LEN, caps);
+    uint8_t *ct = (uint8_t *)heap_caps_malloc(SECURE_BENCH_LEN, caps);
+    uint8_t *out = (uint8_t *)heap_caps_malloc(SECURE_BENCH_LEN, caps);
+    secure_blob_t sb;
+    if (!plain || !ct || !out)
+    {
+        heap_caps_free(plain);
+        heap_caps_free(ct);
+        heap_caps_free(out);
+        return;
+    }
+    fill_random(plain, SECURE_BENCH_LEN);
+    uint8_t key[16], iv[16];
+    fill_random(key, sizeof(key));
+    fill_random(iv, sizeof(iv));
+    ESP_LOGI(TAG, "\n⏱️ ═══ SECURE BENCH (%d KB blob, chunk %d) ═══", SECURE_BENCH_LEN / 1024, SECURE_CHUNK_SIZE);
+
+    const uint64_t bytes = (uint64_t)SECURE_BENCH_LEN * SECURE_BENCH_ROUNDS;
+    uint64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < SECURE_BENCH_ROUNDS; r++)
+        aes_ctr_crypt_oneshot(plain, SECURE_BENCH_LEN, ct, key, iv);
+    uint64_t old_enc = esp_timer_get_time() - t0;
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < SECURE_BENCH_ROUNDS; r++)
+        aes_ctr_crypt_oneshot(ct, SECURE_BENCH_LEN, out, key, iv);
+    uint64_t old_dec = esp_timer_get_time() - t0;
+
+    // field เดียว: ทางเดิมถอดทั้ง blob แล้วหยิบ 32 ไบต์
+    const size_t field_off = SECURE_BENCH_LEN / 2 + 5;
+    const int reads = 100;
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < reads; r++)
+        aes_ctr_crypt_oneshot(ct, SECURE_BENCH_LEN, out, key, iv);
+    uint64_t old_field = esp_timer_get_time() - t0;
+
+    secure_wipe(key, sizeof(key));
+
+    if (secure_store(&sb, plain, SECURE_BENCH_LEN, caps, "SecureBench") != 0)
+    {
+        heap_caps_free(plain);
+        heap_caps_free(ct);
+        heap_caps_free(out);
+        return;
+    }
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < SECURE_BENCH_ROUNDS; r++)
+        secure_ctr_chunked(&sb, 0, plain, sb.cipher, SECURE_BENCH_LEN); // re-encrypt (key แคชแล้ว)
+    uint64_t new_enc = esp_timer_get_time() - t0;
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < SECURE_BENCH_ROUNDS; r++)
+        secure_load(&sb, out, SECURE_BENCH_LEN);
+    uint64_t new_dec = esp_timer_get_time() - t0;
+    bool ok = memcmp(out, plain, SECURE_BENCH_LEN) == 0;
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < reads; r++)
+        secure_read(&sb, field_off, out, SECURE_BENCH_FIELD);
+    uint64_t new_field = esp_timer_get_time() - t0;
+    ok = ok && memcmp(out, plain + field_off, SECURE_BENCH_FIELD) == 0;
+    secure_free(&sb);
+
+    ESP_LOGI(TAG, "oneshot | enc %6.2f MB/s  dec %6.2f MB/s  field(%d B) %lu us",
+             (double)bytes / (double)(old_enc ? old_enc : 1), (double)bytes / (double)(old_dec ? old_dec : 1),
+             SECURE_BENCH_FIELD, (unsigned long)(old_field / reads));
+    ESP_LOGI(TAG, "chunked | enc %6.2f MB/s  dec %6.2f MB/s  field(%d B) %lu us  ok=%d",
+             (double)bytes / (double)(new_enc ? new_enc : 1), (double)bytes / (double)(new_dec ? new_dec : 1),
+             SECURE_BENCH_FIELD, (unsigned long)(new_field / reads), ok);
+    ESP_LOGI(TAG, "═══════════════════════════════");
+    heap_caps_free(plain);
+    heap_caps_free(ct);
+    heap_caps_free(out);
+}
+#endif
+
 /* =========================
  *         app_main
  * ========================= */
@@ -1213,8 +2341,31 @@ void app_main(void)
         ESP_LOGE(TAG, "Failed to create memory mutex!");
         return;
     }
-    memset(allocations, 0, sizeof(allocations));
+    if (!alloc_trace_start(trace_log_sink, NULL, 1))
+        ESP_LOGW(TAG, "Allocation trace drain not started (allocations will not be logged)");
+    arena_set_block_allocator(tracked_malloc, tracked_free); // block ของ arena เห็นในตัวติดตาม (รายก้อนไม่)
     ESP_LOGI(TAG, "Memory tracking system initialized");
+    heap_frag_backend_t frag_be;
+    if (!heap_frag_esp_backend(&frag_be) || !heap_frag_init(&frag_be) || !heap_frag_start(1))
+        ESP_LOGW(TAG, "Fragmentation profiler not started (needs heap_caps_walk)");
+#if TRACK_BENCH_ENABLE
+    track_bench();
+#endif
+#if DPOOL_BENCH_ENABLE
+    dpool_bench();
+#endif
+#if ARENA_BENCH_ENABLE
+    arena_bench();
+#endif
+#if RLE_BENCH_ENABLE
+    rle_bench();
+#endif
+#if SECURE_BENCH_ENABLE
+    secure_bench();
+#endif
+#if SHM_BENCH_ENABLE
+    shm_bench();
+#endif
 
     // Snapshot
     analyze_memory_status();
@@ -1235,12 +2386,9 @@ void app_main(void)
     xTaskCreate(sensitive_data_demo_task, "Secure", 4096, NULL, 7, NULL);
     xTaskCreate(dynamic_pools_demo_task, "DynPools", 4096, NULL, 5, NULL);
 
-// Shared memory demo (ถ้ามีในโปรเจ็กต์)
+// Shared memory demo (เปิด/ปิดที่ menuconfig → Lab1 Heap Management, ค่าเริ่มต้นเปิด)
 #ifdef CONFIG_APP_HAVE_SHARED_MEMORY_DEMO
     shm_demo_start();
-#else
-// เรียกตรง ๆ ได้ถ้ามีซอร์สของคุณ
-// shm_demo_start();
 #endif
 
     ESP_LOGI(TAG, "All tasks created successfully");
@@ -1254,7 +2402,7 @@ void app_main(void)
 
     ESP_LOGI(TAG, "\n🔬 Features:");
     ESP_LOGI(TAG, "  • Heap Tracking / Monitor / Leak detection / Fragmentation");
-    ESP_LOGI(TAG, "  • RLE compress/decompress demo");
-    ESP_LOGI(TAG, "  • 🔒 Secure In-RAM Encryption (AES-CTR)");
-    ESP_LOGI(TAG, "  • 🧰 Dynamic Pools: Slab grow/shrink + Bump Arena");
+    ESP_LOGI(TAG, "  • Streaming RLE compress/decompress demo");
+    ESP_LOGI(TAG, "  • 🔒 Secure In-RAM Encryption (chunked AES-CTR, random-access reads)");
+    ESP_LOGI(TAG, "  • 🧰 Dynamic Pools: Slab grow/shrink (lock-free free) + Arena (local/shared, chained, markers)");
 }
@@ -0,0 +1,329 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "rle_codec.h"
+
+#define RUN_MIN 3                 // run สั้นกว่านี้เขียนเป็น literal คุ้มกว่า
+#define COMPAT_MAX_RUN 127        // เท่ากับ encoder เดิม
+#define LONG_MAX_RUN 0x7FFFFFFFu  // ตัด run ยาวมากเป็นหลาย token (LEB128 ไม่เกิน 5 ไบต์)
+#define HDR_LONG_RUN 128
+
+enum
+{
+    ST_HDR = 0,
+    ST_LIT,
+    ST_RUN_VAL,
+    ST_RUN,
+    ST_LONG_LEN,
+};
+
+/* ---------- หา run ทีละ word ----------
+   word ขนาด register ของเครื่อง (64-bit host / 32-bit ESP32) โหลดด้วย memcpy (ไม่ต้อง align)
+   little-endian: ไบต์แรกที่ต่างคือ ctz/8 ของผล xor
+   ------------------------------------- */
+#if UINTPTR_MAX > 0xFFFFFFFFu
+typedef uint64_t rle_word_t;
+#define WORD_CTZ(x) __builtin_ctzll(x)
+#else
+typedef uint32_t rle_word_t;
+#define WORD_CTZ(x) __builtin_ctz(x)
+#endif
+#define WORD_BYTES sizeof(rle_word_t)
+#define WORD_ONES ((rle_word_t)-1 / 0xFF) // 0x0101...
+#define WORD_LOW7 (WORD_ONES * 0x7F)      // 0x7F7F...
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define RLE_WORD_SCAN 1
+#else
+#define RLE_WORD_SCAN 0
+#endif
+
+static inline rle_word_t load_word(const uint8_t *p)
+{
+    rle_word_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+// บิตสูงของทุกไบต์ที่เป็นศูนย์ (แม่นทุกไบต์ ไม่มี false positive จาก carry)
+static inline rle_word_t zero_bytes(rle_word_t v)
+{
+    return ~(((v & WORD_LOW7) + WORD_LOW7) | v | WORD_LOW7);
+}
+
+// จำนวนไบต์ต้น p ที่เท่ากับ v (สูงสุด n)
+static size_t match_len(const uint8_t *p, size_t n, uint8_t v)
+{
+    size_t k = 0;
+#if defined(__SSE2__)
+    const __m128i pat16 = _mm_set1_epi8((char)v);
+    while (k + 16 <= n)
+    {
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + k)), pat16));
+        if (m != 0xFFFFu)
+            return k + (size_t)__builtin_ctz(~m);
+        k += 16;
+    }
+#endif
+#if RLE_WORD_SCAN
+    const rle_word_t pat = WORD_ONES * v;
+    while (k + WORD_BYTES <= n)
+    {
+        rle_word_t x = load_word(p + k) ^ pat;
+        if (x)
+            return k + (size_t)WORD_CTZ(x) / 8;
+        k += WORD_BYTES;
+    }
+#endif
+    while (k < n && p[k] == v)
+        k++;
+    return k;
+}
+
+// ตำแหน่งแรก i ใน [0, n - 2) ที่ p[i] == p[i+1] == p[i+2] (ไม่เจอ = n - 2 หรือ 0 ถ้า n < 3)
+static size_t find_run_start(const uint8_t *p, size_t n)
+{
+    if (n < RUN_MIN)
+        return 0;
+    size_t i = 0, end = n - 2;
+#if RLE_WORD_SCAN
+    while (i + WORD_BYTES + 2 <= n)
+    {
+        rle_word_t w0 = load_word(p + i), w1 = load_word(p + i + 1), w2 = load_word(p + i + 2);
+        rle_word_t hit = zero_bytes(w0 ^ w1) & zero_bytes(w1 ^ w2);
+        if (hit)
+            return i + (size_t)WORD_CTZ(hit) / 8;
+        i += WORD_BYTES;
+    }
+#endif
+    for (; i < end; i++)
+        if (p[i] == p[i + 1] && p[i] == p[i + 2])
+            return i;
+    return end;
+}
+
+/* ---------- encoder ---------- */
+static size_t flush_literal(rle_enc_t *e, uint8_t *out)
+{
+    if (!e->lit_len)
+        return 0;
+    out[0] = (uint8_t)(e->lit_len - 1);
+    memcpy(out + 1, e->lit, e->lit_len);
+    size_t n = 1 + (size_t)e->lit_len;
+    e->lit_len = 0;
+    return n;
+}
+
+static size_t push_literal(rle_enc_t *e, const uint8_t *src, size_t n, uint8_t *out)
+{
+    size_t o = 0;
+    while (n)
+    {
+        size_t take = RLE_MAX_LITERAL - e->lit_len;
+        if (take > n)
+            take = n;
+        memcpy(e->lit + e->lit_len, src, take);
+        e->lit_len = (uint16_t)(e->lit_len + take);
+        src += take;
+        n -= take;
+        if (e->lit_len == RLE_MAX_LITERAL)
+            o += flush_literal(e, out + o);
+    }
+    return o;
+}
+
+// เขียน run ที่จบแล้ว (len อาจ < RUN_MIN → กลายเป็น literal)
+static size_t emit_run(rle_enc_t *e, uint8_t v, uint32_t len, uint8_t *out)
+{
+    if (len < RUN_MIN)
+    {
+        uint8_t tmp[RUN_MIN - 1] = {v, v};
+        return push_literal(e, tmp, len, out);
+    }
+    size_t o = flush_literal(e, out);
+    if (len <= COMPAT_MAX_RUN)
+    {
+        out[o++] = (uint8_t)(257 - len);
+        out[o++] = v;
+        return o;
+    }
+    // RLE_MODE_LONG เท่านั้น (COMPAT ตัดที่ 127 ตั้งแต่ตอนสะสม)
+    out[o++] = HDR_LONG_RUN;
+    uint32_t x = len - 128;
+    do
+    {
+        uint8_t b = (uint8_t)(x & 0x7F);
+        x >>= 7;
+        out[o++] = x ? (uint8_t)(b | 0x80) : b;
+    } while (x);
+    out[o++] = v;
+    return o;
+}
+
+void rle_enc_init(rle_enc_t *e, rle_mode_t mode)
+{
+    memset(e, 0, sizeof(*e));
+    e->mode = mode;
+}
+
+size_t rle_enc_update(rle_enc_t *e, const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap)
+{
+    if (out_cap < RLE_ENC_BOUND(in_len))
+        return RLE_ERR;
+    const uint32_t max_run = e->mode == RLE_MODE_COMPAT ? COMPAT_MAX_RUN : LONG_MAX_RUN;
+    size_t i = 0, o = 0;
+
+    while (i < in_len)
+    {
+        if (e->run_len)
+        {
+            // ต่อ run ค้าง (อาจข้ามท่อน) ตัดที่ max_run ระหว่างทางเพื่อให้ state/output มีขอบเขต
+            size_t room = max_run - e->run_len;
+            size_t k = match_len(in + i, (in_len - i) < room ? (in_len - i) : room, e->run_val);
+            e->run_len += (uint32_t)k;
+            i += k;
+            if (e->run_len == max_run)
+            {
+                o += emit_run(e, e->run_val, e->run_len, out + o);
+                e->run_len = 0;
+                continue;
+            }
+            if (i == in_len)
+                break; // อาจยาวต่อในท่อนถัดไป
+            o += emit_run(e, e->run_val, e->run_len, out + o);
+            e->run_len = 0;
+        }
+
+        // literal จนกว่าจะเจอไบต์ซ้ำ 3 ตัว เหลือ 2 ไบต์ท้ายไว้เป็น run ค้าง (อาจต่อกับท่อนหน้า)
+        size_t lit = find_run_start(in + i, in_len - i);
+        if (lit)
+        {
+            o += push_literal(e, in + i, lit, out + o);
+            i += lit;
+        }
+        e->run_val = in[i];
+        e->run_len = 1;
+        i++;
+    }
+    return o;
+}
+
+size_t rle_enc_finish(rle_enc_t *e, uint8_t *out, size_t out_cap)
+{
+    if (out_cap < RLE_ENC_BOUND(0))
+        return RLE_ERR;
+    size_t o = 0;
+    if (e->run_len)
+        o += emit_run(e, e->run_val, e->run_len, out + o);
+    e->run_len = 0;
+    o += flush_literal(e, out + o);
+    return o;
+}
+
+/* ---------- decoder ---------- */
+void rle_dec_init(rle_dec_t *d, rle_mode_t mode)
+{
+    memset(d, 0, sizeof(*d));
+    d->mode = mode;
+}
+
+size_t rle_dec_update(rle_dec_t *d, const uint8_t *in, size_t in_len, size_t *consumed, uint8_t *out, size_t out_cap)
+{
+    size_t i = 0, o = 0;
+    while (o < out_cap)
+    {
+        if (d->state == ST_LIT || d->state == ST_RUN)
+        {
+            size_t n = d->remain;
+            if (n > out_cap - o)
+                n = out_cap - o;
+            if (d->state == ST_LIT)
+            {
+                if (n > in_len - i)
+                    n = in_len - i;
+                memcpy(out + o, in + i, n);
+                i += n;
+            }
+            else
+            {
+                memset(out + o, d->run_val, n);
+            }
+            o += n;
+            d->remain -= (uint32_t)n;
+            if (d->remain)
+                break; // input หรือ output หมด
+            d->state = ST_HDR;
+            continue;
+        }
+        if (i == in_len)
+            break;
+        uint8_t b = in[i++];
+        switch (d->state)
+        {
+        case ST_HDR:
+            if (b <= 127)
+            {
+                d->state = ST_LIT;
+                d->remain = (uint32_t)b + 1;
+            }
+            else if (b >= 129)
+            {
+                d->state = ST_RUN_VAL;
+                d->remain = 257u - b;
+            }
+            else if (d->mode == RLE_MODE_LONG)
+            {
+                d->state = ST_LONG_LEN;
+                d->remain = 0;
+                d->shift = 0;
+            }
+            break; // COMPAT: 128 = NOP
+        case ST_LONG_LEN:
+            d->remain |= (uint32_t)(b & 0x7F) << d->shift;
+            d->shift += 7;
+            if (!(b & 0x80) || d->shift >= 35)
+            {
+                d->remain += 128;
+                d->state = ST_RUN_VAL;
+            }
+            break;
+        case ST_RUN_VAL:
+            d->run_val = b;
+            d->state = ST_RUN;
+            break;
+        }
+    }
+    if (consumed)
+        *consumed = i;
+    return o;
+}
+
+bool rle_dec_finish(const rle_dec_t *d)
+{
+    return d->state == ST_HDR;
+}
+
+size_t rle_encode(rle_mode_t mode, const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap)
+{
+    rle_enc_t e;
+    rle_enc_init(&e, mode);
+    size_t n = rle_enc_update(&e, in, in_len, out, out_cap);
+    if (n == RLE_ERR)
+        return RLE_ERR;
+    size_t t = rle_enc_finish(&e, out + n, out_cap - n);
+    return t == RLE_ERR ? RLE_ERR : n + t;
+}
+
+size_t rle_decode(rle_mode_t mode, const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap)
+{
+    rle_dec_t d;
+    rle_dec_init(&d, mode);
+    size_t used = 0;
+    size_t n = rle_dec_update(&d, in, in_len, &used, out, out_cap);
+    return (used == in_len && rle_dec_finish(&d)) ? n : RLE_ERR;
+}
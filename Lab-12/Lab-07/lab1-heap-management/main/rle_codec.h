@@ -0,0 +1,66 @@
+#ifndef RLE_CODEC_H
+#define RLE_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ======================
+ * Streaming RLE codec
+ * รูปแบบ (PackBits):
+ *   header 0..127   : literal (header + 1) ไบต์ตามมา
+ *   header 129..255 : run (257 - header) = 2..128 ครั้ง ของไบต์ถัดไป (encoder ใช้ >= 3)
+ *   header 128      : RLE_MODE_COMPAT = NOP
+ *                     RLE_MODE_LONG   = long run: LEB128(len - 128) แล้วตามด้วยไบต์ค่า (run ยาวไม่จำกัด)
+ * - RLE_MODE_COMPAT ได้ stream เดียวกับ rle_compress เดิม (run สูงสุด 127) ถอดกลับกันได้ทั้งสองทาง
+ * - RLE_MODE_LONG ถอด stream ของ COMPAT ได้ (encoder เดิมไม่เคยเขียน 128)
+ * - state มีขนาดคงที่ (literal ค้างไม่เกิน 128 ไบต์) input/output ส่งเป็นท่อนได้ตามสะดวก
+ * - หา run ทีละ word (64/32-bit ตามสถาปัตยกรรม, SSE2 บน host ที่มี)
+ * ====================== */
+typedef enum
+{
+    RLE_MODE_COMPAT = 0,
+    RLE_MODE_LONG,
+} rle_mode_t;
+
+#define RLE_MAX_LITERAL 128
+#define RLE_ERR ((size_t)-1)
+
+// output ที่ต้องเผื่อต่อการเรียก update/finish หนึ่งครั้ง (literal ค้าง + header ทุก 128 ไบต์ + long run)
+#define RLE_ENC_BOUND(in_len) ((in_len) + (in_len) / RLE_MAX_LITERAL + RLE_MAX_LITERAL + 16)
+
+typedef struct
+{
+    rle_mode_t mode;
+    uint8_t run_val;
+    uint32_t run_len; // run ที่ยังอาจต่อในท่อนถัดไป
+    uint16_t lit_len;
+    uint8_t lit[RLE_MAX_LITERAL];
+} rle_enc_t;
+
+typedef struct
+{
+    rle_mode_t mode;
+    uint8_t state; // ภายใน: กำลังอ่านส่วนไหนของ stream
+    uint8_t shift; // LEB128
+    uint8_t run_val;
+    uint32_t remain; // literal/run ที่ยังเขียนไม่ครบ
+} rle_dec_t;
+
+void rle_enc_init(rle_enc_t *e, rle_mode_t mode);
+// กิน input ทั้งหมด out_cap ต้อง >= RLE_ENC_BOUND(in_len) (ไม่งั้นคืน RLE_ERR) คืนจำนวนไบต์ที่เขียน
+size_t rle_enc_update(rle_enc_t *e, const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap);
+// เขียน literal/run ที่ค้าง out_cap >= RLE_ENC_BOUND(0)
+size_t rle_enc_finish(rle_enc_t *e, uint8_t *out, size_t out_cap);
+
+void rle_dec_init(rle_dec_t *d, rle_mode_t mode);
+// ถอดจนกว่า input หมดหรือ output เต็ม (*consumed = ไบต์ input ที่ใช้) คืนจำนวนไบต์ที่เขียน
+size_t rle_dec_update(rle_dec_t *d, const uint8_t *in, size_t in_len, size_t *consumed, uint8_t *out, size_t out_cap);
+// true = stream จบตรงขอบ token (ไม่มี literal/run ค้างครึ่ง)
+bool rle_dec_finish(const rle_dec_t *d);
+
+// one-shot บน buffer เดียว (ใช้ API ข้างบน) คืน RLE_ERR ถ้า out ไม่พอ
+size_t rle_encode(rle_mode_t mode, const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap);
+size_t rle_decode(rle_mode_t mode, const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap);
+
+#endif /* RLE_CODEC_H */
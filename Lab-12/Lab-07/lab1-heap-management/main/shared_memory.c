@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -16,30 +17,68 @@
 static const char *TAG = "SHM";
 
 /* ---------- block layout ----------
-   ต่อหนึ่งบล็อก: [ void* hdr ][ payload ... ]
-   - ว่าง: hdr = next (ชี้ไปบล็อกถัดไปใน free_list)
-   - ถูก publish: hdr = (void*)(uintptr_t)used_len
+   ต่อหนึ่งบล็อก: [ blk_hdr_t ][ payload ... ]
+   - ว่าง: link = index+1 ของบล็อกถัดไปใน free list (0 = ท้าย)
+   - ถูก publish: link = payload ถัดไปในชุด (0 = ท้าย), len = used_len
    ---------------------------------- */
+typedef struct
+{
+    uintptr_t link;
+    size_t len;
+} blk_hdr_t;
+
+#define BLK_HDR_SIZE sizeof(blk_hdr_t)
+#define PAYLOAD2HDR(p) ((blk_hdr_t *)((uint8_t *)(p) - BLK_HDR_SIZE))
+#define HDR2PAYLOAD(h) ((uint8_t *)(h) + BLK_HDR_SIZE)
 
-#define BLK_HDR_SIZE (sizeof(void *))
-#define PAYLOAD2BASE(p) ((uint8_t *)(p) - BLK_HDR_SIZE)
-#define BASE2PAYLOAD(b) ((uint8_t *)(b) + BLK_HDR_SIZE)
+#define FREE_IDX(h) ((h) & 0xFFFFu)
+#define FREE_TAG(h) ((h) >> 16)
 
 /* ===== Zero-copy Block Pool ===== */
 
+static inline blk_hdr_t *_blk(const shm_pool_t *pool, uint32_t idx)
+{
+    return (blk_hdr_t *)((uint8_t *)pool->buffer + (size_t)idx * pool->block_bytes);
+}
+
+// Treiber stack บน index: tag 16 บิตเพิ่มทุกครั้งที่เปลี่ยน head กัน ABA (pop/push ซ้อนกันครบ 65536 รอบพอดีถึงพลาด)
+static void _free_push(shm_pool_t *pool, blk_hdr_t *h)
+{
+    uint32_t idx = (uint32_t)(((uint8_t *)h - (uint8_t *)pool->buffer) / pool->block_bytes);
+    uint32_t old = __atomic_load_n(&pool->free_head, __ATOMIC_RELAXED), nu;
+    do
+    {
+        __atomic_store_n(&h->link, (uintptr_t)FREE_IDX(old), __ATOMIC_RELAXED);
+        nu = ((FREE_TAG(old) + 1) << 16) | (idx + 1);
+    } while (!__atomic_compare_exchange_n(&pool->free_head, &old, nu, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static blk_hdr_t *_free_pop(shm_pool_t *pool)
+{
+    uint32_t old = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE), nu;
+    blk_hdr_t *h;
+    do
+    {
+        if (!FREE_IDX(old))
+            return NULL;
+        h = _blk(pool, FREE_IDX(old) - 1);
+        nu = ((FREE_TAG(old) + 1) << 16) | (uint32_t)__atomic_load_n(&h->link, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->free_head, &old, nu, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+    return h;
+}
+
 bool shm_pool_create(shm_pool_t *pool,
                      size_t block_size,
                      int num_blocks,
                      int queue_len,
                      uint32_t caps)
 {
-    if (!pool || num_blocks <= 0)
+    if (!pool || num_blocks <= 0 || num_blocks > SHM_POOL_MAX_BLOCKS)
         return false;
 
-    size_t aligned = block_size;
-    if (aligned < BLK_HDR_SIZE)
-        aligned = BLK_HDR_SIZE;
-    aligned = (aligned + 3U) & ~3U; // align 4
+    size_t aligned = (block_size + 3U) & ~3U; // align 4
+    if (aligned < 4)
+        aligned = 4;
 
     size_t block_bytes = BLK_HDR_SIZE + aligned;
     size_t total_bytes = block_bytes * (size_t)num_blocks;
@@ -51,14 +90,16 @@ bool shm_pool_create(shm_pool_t *pool,
     memset(pool, 0, sizeof(*pool));
     pool->buffer = buf;
     pool->block_size = aligned; // payload bytes
+    pool->block_bytes = block_bytes;
     pool->num_blocks = num_blocks;
     pool->caps = caps;
-    pool->lock = xSemaphoreCreateMutex();
+    pool->spill_mux = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    pool->free_sem = xSemaphoreCreateCounting(num_blocks, num_blocks);
     pool->q = xQueueCreate(queue_len > 0 ? queue_len : SHM_QUEUE_LENGTH, sizeof(void *));
-    if (!pool->lock || !pool->q)
+    if (!pool->free_sem || !pool->q)
     {
-        if (pool->lock)
-            vSemaphoreDelete(pool->lock);
+        if (pool->free_sem)
+            vSemaphoreDelete(pool->free_sem);
         if (pool->q)
             vQueueDelete(pool->q);
         heap_caps_free(buf);
@@ -66,13 +107,10 @@ bool shm_pool_create(shm_pool_t *pool,
         return false;
     }
 
-    pool->free_list = NULL;
-    for (int i = 0; i < num_blocks; i++)
-    {
-        uint8_t *blk_base = (uint8_t *)buf + (size_t)i * block_bytes;
-        *((void **)blk_base) = pool->free_list; // push LIFO
-        pool->free_list = blk_base;
-    }
+    // บล็อก 0 อยู่บนสุด
+    for (int i = num_blocks - 1; i >= 0; i--)
+        _blk(pool, (uint32_t)i)->link = (i + 1 < num_blocks) ? (uintptr_t)(i + 2) : 0;
+    pool->free_head = 1;
 
     ESP_LOGI(TAG, "Pool created: blocks=%d, payload=%u, total=%u",
              num_blocks, (unsigned)pool->block_size, (unsigned)total_bytes);
@@ -83,8 +121,8 @@ void shm_pool_destroy(shm_pool_t *pool)
 {
     if (!pool || !pool->buffer)
         return;
-    if (pool->lock)
-        vSemaphoreDelete(pool->lock);
+    if (pool->free_sem)
+        vSemaphoreDelete(pool->free_sem);
     if (pool->q)
         vQueueDelete(pool->q);
     heap_caps_free(pool->buffer);
@@ -93,96 +131,129 @@ void shm_pool_destroy(shm_pool_t *pool)
 
 void *shm_pool_acquire(shm_pool_t *pool, TickType_t to_ticks)
 {
-    if (!pool || !pool->lock)
+    if (!pool || !pool->free_sem)
         return NULL;
-    void *blk_base = NULL;
-
-    TickType_t start = xTaskGetTickCount();
-    while (1)
-    {
-        if (xSemaphoreTake(pool->lock, pdMS_TO_TICKS(20)) == pdTRUE)
-        {
-            if (pool->free_list)
-            {
-                blk_base = pool->free_list;
-                pool->free_list = *((void **)blk_base);
-                xSemaphoreGive(pool->lock);
-                break;
-            }
-            xSemaphoreGive(pool->lock);
-        }
-        if ((xTaskGetTickCount() - start) >= to_ticks)
-            break;
-        vTaskDelay(pdMS_TO_TICKS(1));
-    }
-
-    return blk_base ? BASE2PAYLOAD(blk_base) : NULL;
+    // ได้ semaphore = มีบล็อกรออยู่ใน stack แน่นอน (release push ก่อน give)
+    if (xSemaphoreTake(pool->free_sem, to_ticks) != pdTRUE)
+        return NULL;
+    blk_hdr_t *h = _free_pop(pool);
+    return h ? HDR2PAYLOAD(h) : NULL;
 }
 
-bool shm_pool_publish(shm_pool_t *pool, void *blk_payload, size_t used_len, TickType_t to_ticks)
+void shm_pool_release(shm_pool_t *pool, void *blk_payload)
 {
-    if (!pool || !blk_payload)
-        return false;
-    if (used_len > pool->block_size)
-        return false;
-
-    uint8_t *base = PAYLOAD2BASE(blk_payload);
-    *((void **)base) = (void *)(uintptr_t)used_len; // เก็บ used_len ไว้ใน header
-
-    return xQueueSend(pool->q, &blk_payload, to_ticks) == pdTRUE;
+    if (!pool || !blk_payload || !pool->free_sem)
+        return;
+    _free_push(pool, PAYLOAD2HDR(blk_payload));
+    xSemaphoreGive(pool->free_sem);
 }
 
-bool shm_pool_consume(shm_pool_t *pool, void **out_payload, size_t *out_len, TickType_t to_ticks)
+bool shm_pool_publish_many(shm_pool_t *pool, void *const *payloads, const size_t *used_lens, int n, TickType_t to_ticks)
 {
-    if (!pool || !out_payload)
-        return false;
-    void *payload = NULL;
-    if (xQueueReceive(pool->q, &payload, to_ticks) != pdTRUE)
+    if (!pool || !pool->q || !payloads || !used_lens || n <= 0)
         return false;
+    for (int i = 0; i < n; i++)
+        if (!payloads[i] || used_lens[i] > pool->block_size)
+            return false;
 
-    if (out_len)
+    // ร้อยเป็น chain ตามลำดับ แล้วส่งหัว chain ครั้งเดียว
+    for (int i = 0; i < n; i++)
     {
-        uint8_t *base = PAYLOAD2BASE(payload);
-        *out_len = (size_t)(uintptr_t)(*((void **)base));
+        blk_hdr_t *h = PAYLOAD2HDR(payloads[i]);
+        h->len = used_lens[i];
+        // link อาจถูก pop ที่ค้างจังหวะอ่านอยู่ (ผลถูกทิ้งเพราะ tag) → เขียนแบบ atomic
+        __atomic_store_n(&h->link, (i + 1 < n) ? (uintptr_t)payloads[i + 1] : 0, __ATOMIC_RELAXED);
     }
-    *out_payload = payload;
-    return true;
+    return xQueueSend(pool->q, &payloads[0], to_ticks) == pdTRUE;
 }
 
-void shm_pool_release(shm_pool_t *pool, void *blk_payload)
+bool shm_pool_publish(shm_pool_t *pool, void *blk_payload, size_t used_len, TickType_t to_ticks)
 {
-    if (!pool || !blk_payload || !pool->lock)
-        return;
-    uint8_t *base = PAYLOAD2BASE(blk_payload);
+    return shm_pool_publish_many(pool, &blk_payload, &used_len, 1, to_ticks);
+}
 
-    if (xSemaphoreTake(pool->lock, pdMS_TO_TICKS(50)) == pdTRUE)
+// ตัด chain ที่ max บล็อก ส่วนที่เหลือดันกลับหน้าคิว (คิวเต็ม → เก็บใน spill ให้ consume รอบหน้า)
+static int _take_chain(shm_pool_t *pool, void *chain, void **out_payloads, size_t *out_lens, int max)
+{
+    int got = 0;
+    while (chain && got < max)
     {
-        *((void **)base) = pool->free_list;
-        pool->free_list = base;
-        xSemaphoreGive(pool->lock);
+        blk_hdr_t *h = PAYLOAD2HDR(chain);
+        out_payloads[got] = chain;
+        if (out_lens)
+            out_lens[got] = h->len;
+        got++;
+        chain = (void *)h->link;
     }
+    if (chain && xQueueSendToFront(pool->q, &chain, 0) != pdTRUE)
+    {
+        portENTER_CRITICAL(&pool->spill_mux);
+        if (!pool->spill)
+        {
+            pool->spill = chain;
+        }
+        else
+        {
+            blk_hdr_t *t = PAYLOAD2HDR(pool->spill);
+            while (t->link)
+                t = PAYLOAD2HDR((void *)t->link);
+            __atomic_store_n(&t->link, (uintptr_t)chain, __ATOMIC_RELAXED);
+        }
+        portEXIT_CRITICAL(&pool->spill_mux);
+    }
+    return got;
 }
 
-/* ===== Simple SPSC Ring Buffer ===== */
+int shm_pool_consume_many(shm_pool_t *pool, void **out_payloads, size_t *out_lens, int max, TickType_t to_ticks)
+{
+    if (!pool || !pool->q || !out_payloads || max <= 0)
+        return 0;
 
-typedef struct
+    void *chain = NULL;
+    portENTER_CRITICAL(&pool->spill_mux);
+    chain = pool->spill;
+    pool->spill = NULL;
+    portEXIT_CRITICAL(&pool->spill_mux);
+
+    int got = 0;
+    if (chain)
+        got = _take_chain(pool, chain, out_payloads, out_lens, max);
+    else if (xQueueReceive(pool->q, &chain, to_ticks) == pdTRUE)
+        got = _take_chain(pool, chain, out_payloads, out_lens, max);
+    else
+        return 0;
+
+    // ยังมีที่ว่าง: เก็บชุดที่ค้างในคิวต่อโดยไม่รอ
+    while (got < max && xQueueReceive(pool->q, &chain, 0) == pdTRUE)
+        got += _take_chain(pool, chain, out_payloads + got, out_lens ? out_lens + got : NULL, max - got);
+    return got;
+}
+
+bool shm_pool_consume(shm_pool_t *pool, void **out_payload, size_t *out_len, TickType_t to_ticks)
 {
-    uint8_t hdr[2];
-} __packed_hdr_t;
+    if (!out_payload)
+        return false;
+    return shm_pool_consume_many(pool, out_payload, out_len, 1, to_ticks) == 1;
+}
+
+/* ===== Ring Buffer ===== */
 
-static inline size_t _space(const shm_ring_t *rb)
+static inline size_t _space(size_t h, size_t t, size_t c)
 {
-    size_t h = rb->head, t = rb->tail, c = rb->cap;
     return (h >= t) ? (c - (h - t) - 1) : ((t - h) - 1);
 }
 
-static inline size_t _used(const shm_ring_t *rb)
+static inline size_t _used(size_t h, size_t t, size_t c)
 {
-    size_t h = rb->head, t = rb->tail, c = rb->cap;
     return (h >= t) ? (h - t) : (c - (t - h));
 }
 
 bool shm_ring_create(shm_ring_t *rb, size_t capacity, uint32_t caps)
+{
+    return shm_ring_create_mode(rb, capacity, caps, SHM_RING_LOCKED);
+}
+
+bool shm_ring_create_mode(shm_ring_t *rb, size_t capacity, uint32_t caps, shm_ring_mode_t mode)
 {
     if (!rb || capacity < 64)
         return false;
@@ -194,16 +265,19 @@ bool shm_ring_create(shm_ring_t *rb, size_t capacity, uint32_t caps)
     memset(rb, 0, sizeof(*rb));
     rb->buf = buf;
     rb->cap = cap;
-    rb->head = rb->tail = 0;
-    rb->mtx = xSemaphoreCreateMutex();
+    rb->mode = mode;
     rb->caps = caps;
-    rb->can_read = xSemaphoreCreateBinary();
-    rb->can_write = xSemaphoreCreateBinary();
-    if (rb->can_read)
-        xSemaphoreGive(rb->can_read);
-    if (rb->can_write)
-        xSemaphoreGive(rb->can_write);
-    return rb->mtx != NULL;
+    if (mode == SHM_RING_SPSC)
+        return true;
+
+    rb->mtx = xSemaphoreCreateMutex();
+    if (!rb->mtx)
+    {
+        heap_caps_free(buf);
+        memset(rb, 0, sizeof(*rb));
+        return false;
+    }
+    return true;
 }
 
 void shm_ring_destroy(shm_ring_t *rb)
@@ -212,120 +286,514 @@ void shm_ring_destroy(shm_ring_t *rb)
         return;
     if (rb->mtx)
         vSemaphoreDelete(rb->mtx);
-    if (rb->can_read)
-        vSemaphoreDelete(rb->can_read);
-    if (rb->can_write)
-        vSemaphoreDelete(rb->can_write);
     if (rb->buf)
         heap_caps_free(rb->buf);
     memset(rb, 0, sizeof(*rb));
 }
 
-static void _ring_write_bytes(shm_ring_t *rb, const uint8_t *src, size_t n)
+size_t shm_ring_max_frame(const shm_ring_t *rb)
 {
-    size_t cap = rb->cap, h = rb->head;
-    size_t first = (n <= (cap - h)) ? n : (cap - h);
-    memcpy(rb->buf + h, src, first);
-    if (n > first)
-        memcpy(rb->buf, src + first, n - first);
-    rb->head = (h + n) % cap;
+    // ring ว่างที่ head ใดก็ตาม: ท้ายบัฟเฟอร์หรือช่วง [0, head) ต้องยาว >= cap/2 อย่างน้อยหนึ่งฝั่ง
+    size_t m = rb->cap / 2 - 2;
+    return m < SHM_RING_PAD ? m : SHM_RING_PAD - 1;
 }
 
-static void _ring_read_bytes(shm_ring_t *rb, uint8_t *dst, size_t n)
+/* ---------- วาง/หา frame ----------
+   frame ขนาด need (header+payload) ที่ head h: ท้ายบัฟเฟอร์พอ → วางที่ h
+   ไม่พอ → ทิ้ง [h, cap) เป็น padding แล้ววางที่ 0 (ต้องมีที่ว่างรวม padding)
+   ---------------------------------- */
+#define NO_SLOT SIZE_MAX
+
+static size_t _frame_slot(size_t h, size_t t, size_t cap, size_t need)
 {
-    size_t cap = rb->cap, t = rb->tail;
-    size_t first = (n <= (cap - t)) ? n : (cap - t);
-    memcpy(dst, rb->buf + t, first);
-    if (n > first)
-        memcpy(dst + first, rb->buf, n - first);
-    rb->tail = (t + n) % cap;
+    size_t space = _space(h, t, cap);
+    if (cap - h >= need)
+        return space >= need ? h : NO_SLOT;
+    return space >= (cap - h) + need ? 0 : NO_SLOT;
 }
 
-bool shm_ring_write(shm_ring_t *rb, const void *data, uint16_t len, TickType_t to_ticks)
+static inline uint16_t _hdr_get(const uint8_t *p)
 {
-    if (!rb || !rb->mtx || !data)
-        return false;
-    uint8_t hdr[2] = {(uint8_t)(len & 0xFF), (uint8_t)(len >> 8)};
-    size_t need = 2 + (size_t)len;
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void _hdr_put(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+}
+
+// frame แรกตั้งแต่ t (ต้องมีข้อมูลอยู่แล้ว) ข้าม padding คืนตำแหน่ง header
+static size_t _frame_at(const shm_ring_t *rb, size_t t, uint16_t *len)
+{
+    if (rb->cap - t >= 2)
+    {
+        uint16_t l = _hdr_get(rb->buf + t);
+        if (l != SHM_RING_PAD)
+        {
+            *len = l;
+            return t;
+        }
+    }
+    *len = _hdr_get(rb->buf);
+    return 0;
+}
+
+// writer วาง frame ที่ pos: ถ้าวนไป 0 ปิดท้ายบัฟเฟอร์ด้วย padding
+static void *_open_reserve(shm_ring_t *rb, size_t pos, uint16_t len)
+{
+    if (pos != rb->head && rb->cap - rb->head >= 2)
+        _hdr_put(rb->buf + rb->head, SHM_RING_PAD);
+    rb->wr_pos = pos;
+    rb->wr_len = len;
+    rb->wr_open = true;
+    return rb->buf + pos + 2;
+}
+
+static size_t _close_commit(shm_ring_t *rb, uint16_t used_len)
+{
+    _hdr_put(rb->buf + rb->wr_pos, used_len);
+    rb->wr_open = false;
+    return (rb->wr_pos + 2 + used_len) % rb->cap;
+}
+
+/* ---------- หลับ/ปลุกด้วย task notification (SPSC) ----------
+   ผู้รอ : ลงชื่อใน slot (seq_cst) → เช็กเงื่อนไขซ้ำ (seq_cst) → ulTaskNotifyTake
+   ผู้ปลุก: store index (release) → fence seq_cst → เห็นชื่อใน slot ก็ exchange เป็น NULL แล้ว notify
+   ลำดับนี้ไม่มี wakeup หาย notification ที่มาหลังผู้รอเลิกรอแล้วทำให้ตื่นเปล่าได้หนึ่งครั้ง (วนเช็กใหม่)
+   ------------------------------------------------------------ */
+static inline void _ring_wake(TaskHandle_t *slot)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(slot, __ATOMIC_RELAXED))
+    {
+        TaskHandle_t t = __atomic_exchange_n(slot, NULL, __ATOMIC_ACQ_REL);
+        if (t)
+            xTaskNotifyGive(t);
+    }
+}
 
+// เช็กกับ index ของอีกฝั่งที่จำไว้ก่อน ไม่พอค่อยโหลดใหม่ (ลดการดึง cache line ของอีกฝั่ง)
+static size_t _spsc_slot(shm_ring_t *rb, size_t need, int order)
+{
+    size_t pos = _frame_slot(rb->head, rb->tail_cache, rb->cap, need);
+    if (pos != NO_SLOT)
+        return pos;
+    rb->tail_cache = __atomic_load_n(&rb->tail, order);
+    return _frame_slot(rb->head, rb->tail_cache, rb->cap, need);
+}
+
+static bool _spsc_avail(shm_ring_t *rb, int order)
+{
+    if (rb->head_cache != rb->tail)
+        return true;
+    rb->head_cache = __atomic_load_n(&rb->head, order);
+    return rb->head_cache != rb->tail;
+}
+
+static void *_spsc_reserve(shm_ring_t *rb, uint16_t len, TickType_t to_ticks)
+{
+    size_t need = 2 + (size_t)len, pos;
+    TickType_t start = xTaskGetTickCount();
+    while ((pos = _spsc_slot(rb, need, __ATOMIC_ACQUIRE)) == NO_SLOT)
+    {
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= to_ticks)
+            return NULL;
+        __atomic_store_n(&rb->writer_wait, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+        if (_spsc_slot(rb, need, __ATOMIC_SEQ_CST) == NO_SLOT)
+            ulTaskNotifyTake(pdTRUE, to_ticks - waited);
+        __atomic_store_n(&rb->writer_wait, NULL, __ATOMIC_RELAXED);
+    }
+    return _open_reserve(rb, pos, len);
+}
+
+// writer publish padding+header+payload พร้อมกัน → head != tail แปลว่ามี frame ครบ
+static const void *_spsc_peek(shm_ring_t *rb, uint16_t *out_len, TickType_t to_ticks)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (!_spsc_avail(rb, __ATOMIC_ACQUIRE))
+    {
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= to_ticks)
+            return NULL;
+        __atomic_store_n(&rb->reader_wait, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+        if (!_spsc_avail(rb, __ATOMIC_SEQ_CST))
+            ulTaskNotifyTake(pdTRUE, to_ticks - waited);
+        __atomic_store_n(&rb->reader_wait, NULL, __ATOMIC_RELAXED);
+    }
+    rb->rd_pos = _frame_at(rb, rb->tail, &rb->rd_len);
+    rb->rd_open = true;
+    *out_len = rb->rd_len;
+    return rb->buf + rb->rd_pos + 2;
+}
+
+// LOCKED: วนลองจนได้ mutex และเงื่อนไขเป็นจริง สำเร็จแล้วคืนโดยยังถือ mutex
+// ระหว่างรอบใช้ vTaskDelay(pdMS_TO_TICKS(1)) = 0 tick ที่ CONFIG_FREERTOS_HZ=100 → แค่ yield แล้วลองใหม่ (busy-retry)
+static bool _locked_wait(shm_ring_t *rb, size_t need, size_t *pos, TickType_t to_ticks)
+{
     TickType_t start = xTaskGetTickCount();
     while (1)
     {
         if (xSemaphoreTake(rb->mtx, pdMS_TO_TICKS(20)) == pdTRUE)
         {
-            if (_space(rb) >= need)
-            {
-                _ring_write_bytes(rb, hdr, 2);
-                _ring_write_bytes(rb, (const uint8_t *)data, len);
-                xSemaphoreGive(rb->mtx);
+            if (need ? (*pos = _frame_slot(rb->head, rb->tail, rb->cap, need)) != NO_SLOT : rb->head != rb->tail)
                 return true;
-            }
             xSemaphoreGive(rb->mtx);
         }
         if ((xTaskGetTickCount() - start) >= to_ticks)
-            break;
+            return false;
         vTaskDelay(pdMS_TO_TICKS(1));
     }
-    return false;
+}
+
+void *shm_ring_reserve(shm_ring_t *rb, uint16_t len, TickType_t to_ticks)
+{
+    if (!rb || !rb->buf || len > shm_ring_max_frame(rb))
+        return NULL;
+    // SPSC: writer มีตัวเดียว wr_open จึงเป็นของ task นี้เอง (กัน reserve ซ้อน)
+    // LOCKED: writer อื่นที่ถือ frame อยู่ถือ mutex ด้วย → รอใน _locked_wait ตาม to_ticks
+    if (rb->mode == SHM_RING_SPSC)
+        return rb->wr_open ? NULL : _spsc_reserve(rb, len, to_ticks);
+
+    size_t pos;
+    if (!rb->mtx || !_locked_wait(rb, 2 + (size_t)len, &pos, to_ticks))
+        return NULL;
+    return _open_reserve(rb, pos, len); // ถือ mutex ต่อจนถึง commit
+}
+
+bool shm_ring_commit(shm_ring_t *rb, uint16_t used_len)
+{
+    if (!rb || !rb->wr_open || used_len > rb->wr_len)
+        return false;
+    size_t h = _close_commit(rb, used_len);
+    if (rb->mode == SHM_RING_SPSC)
+    {
+        __atomic_store_n(&rb->head, h, __ATOMIC_RELEASE);
+        _ring_wake(&rb->reader_wait);
+        return true;
+    }
+    rb->head = h;
+    xSemaphoreGive(rb->mtx);
+    return true;
+}
+
+const void *shm_ring_peek(shm_ring_t *rb, uint16_t *out_len, TickType_t to_ticks)
+{
+    if (!rb || !rb->buf || !out_len)
+        return NULL;
+    if (rb->mode == SHM_RING_SPSC)
+        return rb->rd_open ? NULL : _spsc_peek(rb, out_len, to_ticks); // rd_open อ่านได้เฉพาะ reader ตัวเดียว
+
+    if (!rb->mtx || !_locked_wait(rb, 0, NULL, to_ticks))
+        return NULL;
+    rb->rd_pos = _frame_at(rb, rb->tail, &rb->rd_len);
+    rb->rd_open = true;
+    *out_len = rb->rd_len;
+    return rb->buf + rb->rd_pos + 2; // ถือ mutex ต่อจนถึง consume
+}
+
+void shm_ring_consume(shm_ring_t *rb)
+{
+    if (!rb || !rb->rd_open)
+        return;
+    size_t t = (rb->rd_pos + 2 + rb->rd_len) % rb->cap;
+    rb->rd_open = false;
+    if (rb->mode == SHM_RING_SPSC)
+    {
+        __atomic_store_n(&rb->tail, t, __ATOMIC_RELEASE);
+        _ring_wake(&rb->writer_wait);
+        return;
+    }
+    rb->tail = t;
+    xSemaphoreGive(rb->mtx);
+}
+
+bool shm_ring_write(shm_ring_t *rb, const void *data, uint16_t len, TickType_t to_ticks)
+{
+    if (!data)
+        return false;
+    void *dst = shm_ring_reserve(rb, len, to_ticks);
+    if (!dst)
+        return false;
+    memcpy(dst, data, len);
+    return shm_ring_commit(rb, len);
 }
 
 bool shm_ring_read(shm_ring_t *rb, void *out, uint16_t *inout_len, TickType_t to_ticks)
 {
-    if (!rb || !rb->mtx || !out || !inout_len)
+    if (!out || !inout_len)
+        return false;
+    uint16_t frame_len;
+    const void *src = shm_ring_peek(rb, &frame_len, to_ticks);
+    if (!src)
         return false;
+    if (*inout_len > frame_len)
+        *inout_len = frame_len; // ส่วนที่ล้น out ถูกทิ้งไปพร้อม frame
+    memcpy(out, src, *inout_len);
+    shm_ring_consume(rb);
+    return true;
+}
 
+/* ===== MPMC Ring ===== */
+
+#define MPMC_DATA (SHM_MPMC_SLOT_SIZE - 8)
+
+static inline uint32_t _mpmc_slots_for(uint16_t len)
+{
+    return len ? ((uint32_t)len + MPMC_DATA - 1) / MPMC_DATA : 1;
+}
+
+/* ---------- wait queue ----------
+   ผู้รอ: nwait++ → ลงชื่อใน task[] → เช็กเงื่อนไขซ้ำ → หลับ (ไม่มีช่องว่าง = หลับทีละ tick)
+   ผู้ปลุก: publish → fence → nwait > 0 ก็ปลุกทุกคนที่ลงชื่อ (frame ขนาดต่างกัน ปลุกคนเดียวอาจไม่ใช่คนที่ไปต่อได้)
+   -------------------------------- */
+static int _wq_enter(shm_waitq_t *wq)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    __atomic_fetch_add(&wq->nwait, 1, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < SHM_MPMC_MAX_WAITERS; i++)
+    {
+        TaskHandle_t expect = NULL;
+        if (__atomic_compare_exchange_n(&wq->task[i], &expect, self, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            return i;
+    }
+    return -1;
+}
+
+static void _wq_sleep(int idx, TickType_t remain)
+{
+    ulTaskNotifyTake(pdTRUE, (idx < 0 && remain > 1) ? 1 : remain);
+}
+
+static void _wq_leave(shm_waitq_t *wq, int idx)
+{
+    if (idx >= 0)
+    {
+        TaskHandle_t self = xTaskGetCurrentTaskHandle();
+        __atomic_compare_exchange_n(&wq->task[idx], &self, NULL, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_sub(&wq->nwait, 1, __ATOMIC_RELAXED);
+}
+
+static void _wq_wake_all(shm_waitq_t *wq)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&wq->nwait, __ATOMIC_RELAXED))
+        return;
+    for (int i = 0; i < SHM_MPMC_MAX_WAITERS; i++)
+    {
+        if (!__atomic_load_n(&wq->task[i], __ATOMIC_RELAXED))
+            continue;
+        TaskHandle_t t = __atomic_exchange_n(&wq->task[i], NULL, __ATOMIC_SEQ_CST);
+        if (t)
+            xTaskNotifyGive(t);
+    }
+}
+
+bool shm_mpmc_create(shm_mpmc_t *q, size_t capacity, uint32_t caps)
+{
+    if (!q || capacity < 2 * SHM_MPMC_SLOT_SIZE)
+        return false;
+    uint32_t n = 2;
+    while ((size_t)n * SHM_MPMC_SLOT_SIZE < capacity)
+        n <<= 1;
+    shm_mpmc_slot_t *slots = (shm_mpmc_slot_t *)heap_caps_malloc((size_t)n * sizeof(shm_mpmc_slot_t), caps);
+    if (!slots)
+        return false;
+
+    memset(q, 0, sizeof(*q));
+    q->slots = slots;
+    q->mask = n - 1;
+    q->caps = caps;
+    for (uint32_t i = 0; i < n; i++)
+        slots[i].seq = i; // ว่าง รอ ticket i
+    return true;
+}
+
+void shm_mpmc_destroy(shm_mpmc_t *q)
+{
+    if (!q)
+        return;
+    if (q->slots)
+        heap_caps_free(q->slots);
+    memset(q, 0, sizeof(*q));
+}
+
+size_t shm_mpmc_max_frame(const shm_mpmc_t *q)
+{
+    size_t m = (size_t)(q->mask + 1) * MPMC_DATA;
+    return m < 0xFFFF ? m : 0xFFFF;
+}
+
+// ลอง claim k slot ตั้งแต่ enqueue_pos: 1 = ได้ (*pos), 0 = เต็ม, -1 = pos เก่า ลองใหม่
+static int _mpmc_try_claim(shm_mpmc_t *q, uint32_t k, uint32_t *pos)
+{
+    uint32_t p = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    for (uint32_t j = 0; j < k; j++)
+    {
+        int32_t d = (int32_t)(__atomic_load_n(&q->slots[(p + j) & q->mask].seq, __ATOMIC_ACQUIRE) - (p + j));
+        if (d < 0)
+            return __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED) == p ? 0 : -1;
+        if (d > 0)
+            return -1;
+    }
+    // slot ที่ seq == ticket เปลี่ยนได้โดยเจ้าของ ticket เท่านั้น → CAS ผ่านแปลว่าได้ทั้ง k slot
+    if (!__atomic_compare_exchange_n(&q->enqueue_pos, &p, p + k, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return -1;
+    *pos = p;
+    return 1;
+}
+
+// frame ที่ dequeue_pos: 1 = ได้ (*pos, *k), 0 = ว่าง, -1 = ลองใหม่
+static int _mpmc_try_take(shm_mpmc_t *q, uint32_t *pos, uint32_t *k)
+{
+    uint32_t p = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    shm_mpmc_slot_t *s = &q->slots[p & q->mask];
+    int32_t d = (int32_t)(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - (p + 1));
+    if (d < 0)
+        return __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED) == p ? 0 : -1;
+    if (d > 0)
+        return -1;
+    uint32_t n = _mpmc_slots_for(__atomic_load_n(&s->len, __ATOMIC_RELAXED));
+    if (!__atomic_compare_exchange_n(&q->dequeue_pos, &p, p + n, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return -1;
+    *pos = p;
+    *k = n;
+    return 1;
+}
+
+bool shm_mpmc_write(shm_mpmc_t *q, uint8_t producer, const void *data, uint16_t len, TickType_t to_ticks)
+{
+    if (!q || !q->slots || (!data && len) || producer >= SHM_MPMC_MAX_PRODUCERS || len > shm_mpmc_max_frame(q))
+        return false;
+    shm_mpmc_pstat_t *st = &q->pstat[producer];
+    uint32_t k = _mpmc_slots_for(len), pos;
     TickType_t start = xTaskGetTickCount();
-    while (1)
+    int rc;
+    while ((rc = _mpmc_try_claim(q, k, &pos)) != 1)
     {
-        if (xSemaphoreTake(rb->mtx, pdMS_TO_TICKS(20)) == pdTRUE)
+        if (rc < 0)
+            continue;
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= to_ticks)
         {
-            if (_used(rb) >= 2)
-            {
-                // peek header
-                uint8_t hdr[2];
-                size_t cap = rb->cap, t = rb->tail;
-                size_t first = (2 <= (cap - t)) ? 2 : (cap - t);
-                memcpy(hdr, rb->buf + t, first);
-                if (2 > first)
-                    memcpy(hdr + first, rb->buf, 2 - first);
-
-                uint16_t frame_len = (uint16_t)(hdr[0] | (hdr[1] << 8));
-                size_t need = 2 + (size_t)frame_len;
-
-                if (_used(rb) >= need)
-                {
-                    // consume header
-                    rb->tail = (rb->tail + 2) % cap;
-
-                    size_t to_copy = frame_len;
-                    if (to_copy > *inout_len)
-                        to_copy = *inout_len;
-                    _ring_read_bytes(rb, (uint8_t *)out, to_copy);
-
-                    size_t remain = (size_t)frame_len - to_copy;
-                    if (remain)
-                    {
-                        uint8_t tmp[32];
-                        while (remain)
-                        {
-                            size_t chunk = remain > sizeof(tmp) ? sizeof(tmp) : remain;
-                            _ring_read_bytes(rb, tmp, chunk);
-                            remain -= chunk;
-                        }
-                    }
-
-                    *inout_len = to_copy;
-                    xSemaphoreGive(rb->mtx);
-                    return true;
-                }
-            }
-            xSemaphoreGive(rb->mtx);
+            __atomic_fetch_add(&st->timeouts, 1, __ATOMIC_RELAXED);
+            return false;
         }
-        if ((xTaskGetTickCount() - start) >= to_ticks)
+        int64_t t0 = esp_timer_get_time();
+        int idx = _wq_enter(&q->producers_wait);
+        rc = _mpmc_try_claim(q, k, &pos); // ผลเช็กซ้ำหลังลงชื่อ (1 = claim ไปแล้ว)
+        if (rc == 0)
+            _wq_sleep(idx, to_ticks - waited);
+        _wq_leave(&q->producers_wait, idx);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+        __atomic_fetch_add(&st->waits, 1, __ATOMIC_RELAXED);
+        if (us > __atomic_load_n(&st->max_wait_us, __ATOMIC_RELAXED))
+            __atomic_store_n(&st->max_wait_us, us, __ATOMIC_RELAXED); // ค่าประมาณ (ไม่ CAS)
+        if (rc == 1)
             break;
-        vTaskDelay(pdMS_TO_TICKS(1));
     }
-    return false;
+
+    // คัดลอกลง slot ถัด ๆ กัน (วนรอบ array ได้) แล้วเปิดให้ consumer เห็นที่ slot แรกเป็นลำดับสุดท้าย
+    const uint8_t *src = (const uint8_t *)data;
+    for (uint32_t j = 0; j < k; j++)
+    {
+        shm_mpmc_slot_t *s = &q->slots[(pos + j) & q->mask];
+        size_t off = (size_t)j * MPMC_DATA;
+        size_t n = len - off < MPMC_DATA ? len - off : MPMC_DATA;
+        if (n)
+            memcpy(s->data, src + off, n);
+        if (j)
+            __atomic_store_n(&s->seq, pos + j + 1, __ATOMIC_RELAXED);
+    }
+    shm_mpmc_slot_t *first = &q->slots[pos & q->mask];
+    __atomic_store_n(&first->len, len, __ATOMIC_RELAXED);
+    __atomic_store_n(&first->seq, pos + 1, __ATOMIC_RELEASE);
+    _wq_wake_all(&q->consumers_wait);
+
+    __atomic_fetch_add(&st->frames, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&st->bytes, len, __ATOMIC_RELAXED);
+    return true;
+}
+
+bool shm_mpmc_read(shm_mpmc_t *q, void *out, uint16_t *inout_len, TickType_t to_ticks)
+{
+    if (!q || !q->slots || !inout_len || (!out && *inout_len))
+        return false;
+    uint32_t pos, k;
+    TickType_t start = xTaskGetTickCount();
+    int rc;
+    while ((rc = _mpmc_try_take(q, &pos, &k)) != 1)
+    {
+        if (rc < 0)
+            continue;
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= to_ticks)
+            return false;
+        int idx = _wq_enter(&q->consumers_wait);
+        rc = _mpmc_try_take(q, &pos, &k);
+        if (rc == 0)
+            _wq_sleep(idx, to_ticks - waited);
+        _wq_leave(&q->consumers_wait, idx);
+        if (rc == 1)
+            break;
+    }
+
+    uint16_t len = q->slots[pos & q->mask].len;
+    uint16_t n_out = len < *inout_len ? len : *inout_len; // ส่วนที่ล้น out ถูกทิ้ง
+    uint8_t *dst = (uint8_t *)out;
+    for (uint32_t j = 0; j < k; j++)
+    {
+        shm_mpmc_slot_t *s = &q->slots[(pos + j) & q->mask];
+        size_t off = (size_t)j * MPMC_DATA;
+        if (off < n_out)
+            memcpy(dst + off, s->data, n_out - off < MPMC_DATA ? n_out - off : MPMC_DATA);
+        __atomic_store_n(&s->seq, pos + j + q->mask + 1, __ATOMIC_RELEASE); // ว่าง รอบหน้า
+    }
+    _wq_wake_all(&q->producers_wait);
+    *inout_len = n_out;
+    return true;
+}
+
+void shm_mpmc_get_stats(const shm_mpmc_t *q, shm_mpmc_pstat_t out[SHM_MPMC_MAX_PRODUCERS])
+{
+    for (int i = 0; i < SHM_MPMC_MAX_PRODUCERS; i++)
+    {
+        out[i].frames = __atomic_load_n(&q->pstat[i].frames, __ATOMIC_RELAXED);
+        out[i].bytes = __atomic_load_n(&q->pstat[i].bytes, __ATOMIC_RELAXED);
+        out[i].waits = __atomic_load_n(&q->pstat[i].waits, __ATOMIC_RELAXED);
+        out[i].timeouts = __atomic_load_n(&q->pstat[i].timeouts, __ATOMIC_RELAXED);
+        out[i].max_wait_us = __atomic_load_n(&q->pstat[i].max_wait_us, __ATOMIC_RELAXED);
+    }
+}
+
+// Jain's fairness index ของจำนวน frame ต่อ producer ที่ active (1.0 = เท่ากันหมด)
+static float _mpmc_fairness(const shm_mpmc_pstat_t *st)
+{
+    double sum = 0, sq = 0;
+    int n = 0;
+    for (int i = 0; i < SHM_MPMC_MAX_PRODUCERS; i++)
+    {
+        if (!st[i].frames && !st[i].timeouts)
+            continue;
+        sum += st[i].frames;
+        sq += (double)st[i].frames * st[i].frames;
+        n++;
+    }
+    return (n && sq > 0) ? (float)(sum * sum / (n * sq)) : 1.0f;
+}
+
+void shm_mpmc_print_stats(const shm_mpmc_t *q)
+{
+    shm_mpmc_pstat_t st[SHM_MPMC_MAX_PRODUCERS];
+    shm_mpmc_get_stats(q, st);
+    ESP_LOGI(TAG, "MPMC producers (fairness %.3f):", _mpmc_fairness(st));
+    for (int i = 0; i < SHM_MPMC_MAX_PRODUCERS; i++)
+        if (st[i].frames || st[i].timeouts)
+            ESP_LOGI(TAG, "  P%d: %lu frames  %lu B  waits %lu  max wait %lu us  timeouts %lu", i,
+                     (unsigned long)st[i].frames, (unsigned long)st[i].bytes, (unsigned long)st[i].waits,
+                     (unsigned long)st[i].max_wait_us, (unsigned long)st[i].timeouts);
 }
 
 /* ===== Demo tasks ===== */
@@ -333,30 +801,54 @@ bool shm_ring_read(shm_ring_t *rb, void *out, uint16_t *inout_len, TickType_t to
 static shm_pool_t g_pool;
 static shm_ring_t g_ring;
 
+typedef struct
+{
+    int64_t t_pub; // เวลาที่ producer เริ่มเตรียมข้อความ
+    char text[];
+} shm_demo_msg_t;
+
+// ต้นทุนต่อข้อความของ demo: producer เขียน prod_us, consumer เขียนที่เหลือ
+static struct
+{
+    uint32_t msgs;
+    uint32_t wakeups;
+    uint64_t e2e_us;
+    uint64_t prod_us;
+    uint64_t cons_us;
+} s_pool_cost;
+
 static void shm_pool_producer(void *arg)
 {
     const char *name = (const char *)arg;
     uint32_t seq = 0;
+    void *burst[SHM_DEMO_BURST];
+    size_t lens[SHM_DEMO_BURST];
+    const size_t room = g_pool.block_size - sizeof(shm_demo_msg_t);
 
     while (1)
     {
-        void *p = shm_pool_acquire(&g_pool, pdMS_TO_TICKS(50));
-        if (p)
+        int64_t t0 = esp_timer_get_time();
+        int n = 0;
+        for (; n < SHM_DEMO_BURST; n++)
         {
-            int n = snprintf((char *)p, g_pool.block_size,
-                             "[%s] msg #%lu @%llu us",
-                             name, (unsigned long)seq++,
-                             (unsigned long long)esp_timer_get_time());
-            if (n < 0)
-                n = 0;
-            if (n > (int)g_pool.block_size)
-                n = (int)g_pool.block_size;
-
-            if (!shm_pool_publish(&g_pool, p, (size_t)n + 1, pdMS_TO_TICKS(50)))
-            {
-                shm_pool_release(&g_pool, p);
-            }
+            shm_demo_msg_t *m = (shm_demo_msg_t *)shm_pool_acquire(&g_pool, pdMS_TO_TICKS(50));
+            if (!m)
+                break;
+            m->t_pub = esp_timer_get_time();
+            int k = snprintf(m->text, room, "[%s] msg #%lu", name, (unsigned long)seq++);
+            if (k < 0)
+                k = 0;
+            if (k >= (int)room)
+                k = (int)room - 1;
+            burst[n] = m;
+            lens[n] = sizeof(*m) + (size_t)k + 1;
+        }
+        if (n && !shm_pool_publish_many(&g_pool, burst, lens, n, pdMS_TO_TICKS(50)))
+        {
+            for (int i = 0; i < n; i++)
+                shm_pool_release(&g_pool, burst[i]);
         }
+        __atomic_fetch_add(&s_pool_cost.prod_us, (uint64_t)(esp_timer_get_time() - t0), __ATOMIC_RELAXED);
         vTaskDelay(pdMS_TO_TICKS(200));
     }
 }
@@ -364,14 +856,33 @@ static void shm_pool_producer(void *arg)
 static void shm_pool_consumer(void *arg)
 {
     (void)arg;
+    void *got[SHM_DEMO_BURST * 2];
+    size_t lens[SHM_DEMO_BURST * 2];
     for (;;)
     {
-        void *payload = NULL;
-        size_t used = 0;
-        if (shm_pool_consume(&g_pool, &payload, &used, pdMS_TO_TICKS(1000)))
+        int n = shm_pool_consume_many(&g_pool, got, lens, SHM_DEMO_BURST * 2, pdMS_TO_TICKS(1000));
+        if (!n)
+            continue;
+        int64_t now = esp_timer_get_time();
+        uint32_t first_seq = 0;
+        const char *t = strchr(((const shm_demo_msg_t *)got[0])->text, '#');
+        if (t)
+            first_seq = (uint32_t)strtoul(t + 1, NULL, 10);
+        for (int i = 0; i < n; i++)
         {
-            ESP_LOGI(TAG, "POOL RX: \"%s\" (len=%u)", (char *)payload, (unsigned)used);
-            shm_pool_release(&g_pool, payload);
+            s_pool_cost.e2e_us += (uint64_t)(now - ((const shm_demo_msg_t *)got[i])->t_pub);
+            shm_pool_release(&g_pool, got[i]);
+        }
+        s_pool_cost.cons_us += (uint64_t)(esp_timer_get_time() - now);
+        ESP_LOGI(TAG, "POOL RX x%d from #%lu (len=%u, 1 wakeup)", n, (unsigned long)first_seq, (unsigned)lens[0]);
+        s_pool_cost.msgs += (uint32_t)n;
+        if (++s_pool_cost.wakeups % 10 == 0)
+        {
+            uint32_t m = s_pool_cost.msgs;
+            ESP_LOGI(TAG, "POOL cost: %lu msgs / %lu wakeups | e2e avg %lu us | producer %lu ns/msg | consumer %lu ns/msg",
+                     (unsigned long)m, (unsigned long)s_pool_cost.wakeups, (unsigned long)(s_pool_cost.e2e_us / m),
+                     (unsigned long)(__atomic_load_n(&s_pool_cost.prod_us, __ATOMIC_RELAXED) * 1000 / m),
+                     (unsigned long)(s_pool_cost.cons_us * 1000 / m));
         }
     }
 }
@@ -434,7 +945,7 @@ void shm_demo_start(void)
         return;
     }
 
-    if (!shm_ring_create(&g_ring, SHM_RING_CAPACITY, caps))
+    if (!shm_ring_create_mode(&g_ring, SHM_RING_CAPACITY, caps, SHM_RING_SPSC))
     {
         ESP_LOGE(TAG, "create ring failed");
         return;
@@ -447,3 +958,390 @@ void shm_demo_start(void)
 
     ESP_LOGI(TAG, "Shared-memory demo started");
 }
+
+#if SHM_BENCH_ENABLE
+/* ===== Benchmark: LOCKED vs SPSC, copy vs zero-copy ===== */
+#define SHM_BENCH_FRAMES 20000
+#define SHM_BENCH_FRAME_LEN 64
+#define SHM_BENCH_LAT_SAMPLES 200
+#define SHM_BENCH_ZC_RING 8192 // ให้ frame 1 KB วางได้หลายก้อน
+#define SHM_BENCH_MAX_LEN 1024
+
+typedef struct
+{
+    shm_ring_t *rb;
+    SemaphoreHandle_t done;
+    int frames;
+    uint16_t len;
+    bool zero_copy; // reserve/commit + peek/consume แทน write/read
+    bool latency;   // true = writer พัก 1 tick ก่อนส่งแต่ละ frame (reader หลับรออยู่)
+    uint32_t errors;
+    uint64_t lat_sum_us;
+    uint32_t lat_max_us;
+} shm_bench_arg_t;
+
+// frame = [int64 ts][int32 seq][ไบต์ (seq + k) ...] ผู้ส่ง "serialise" ผู้รับ "parse" + ตรวจ
+static void shm_bench_fill(uint8_t *p, uint16_t len, int seq)
+{
+    int64_t now = esp_timer_get_time();
+    memcpy(p, &now, sizeof(now));
+    memcpy(p + 8, &seq, sizeof(seq));
+    for (uint16_t k = 12; k < len; k++)
+        p[k] = (uint8_t)(seq + k);
+}
+
+static bool shm_bench_check(const uint8_t *p, uint16_t len, int seq, int64_t *ts)
+{
+    int got;
+    memcpy(ts, p, sizeof(*ts));
+    memcpy(&got, p + 8, sizeof(got));
+    uint8_t bad = 0;
+    for (uint16_t k = 12; k < len; k++)
+        bad |= (uint8_t)(p[k] ^ (uint8_t)(seq + k));
+    return got == seq && !bad;
+}
+
+static void shm_bench_tx(void *arg)
+{
+    static uint8_t msg[SHM_BENCH_MAX_LEN];
+    shm_bench_arg_t *a = (shm_bench_arg_t *)arg;
+    for (int i = 0; i < a->frames; i++)
+    {
+        if (a->latency)
+            vTaskDelay(1); // อย่างน้อย 1 tick: pdMS_TO_TICKS(2) ปัดเป็น 0 ที่ HZ=100
+        if (a->zero_copy)
+        {
+            uint8_t *p = (uint8_t *)shm_ring_reserve(a->rb, a->len, portMAX_DELAY);
+            if (!p)
+            {
+                a->errors++;
+                continue;
+            }
+            shm_bench_fill(p, a->len, i);
+            shm_ring_commit(a->rb, a->len);
+        }
+        else
+        {
+            shm_bench_fill(msg, a->len, i);
+            if (!shm_ring_write(a->rb, msg, a->len, portMAX_DELAY))
+                a->errors++;
+        }
+    }
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static void shm_bench_rx(void *arg)
+{
+    static uint8_t msg[SHM_BENCH_MAX_LEN];
+    shm_bench_arg_t *a = (shm_bench_arg_t *)arg;
+    for (int i = 0; i < a->frames; i++)
+    {
+        uint16_t len = sizeof(msg);
+        const uint8_t *p = msg;
+        if (a->zero_copy)
+            p = (const uint8_t *)shm_ring_peek(a->rb, &len, portMAX_DELAY);
+        else if (!shm_ring_read(a->rb, msg, &len, portMAX_DELAY))
+            p = NULL;
+        if (!p)
+        {
+            a->errors++;
+            continue;
+        }
+        int64_t ts = 0;
+        if (len != a->len || !shm_bench_check(p, len, i, &ts))
+            a->errors++;
+        if (a->zero_copy)
+            shm_ring_consume(a->rb);
+        uint32_t lat = a->latency ? (uint32_t)(esp_timer_get_time() - ts) : 0;
+        a->lat_sum_us += lat;
+        if (lat > a->lat_max_us)
+            a->lat_max_us = lat;
+    }
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static uint64_t shm_bench_run(shm_ring_mode_t mode, size_t ring, const shm_bench_arg_t *cfg, shm_bench_arg_t *rx,
+                              SemaphoreHandle_t done)
+{
+    shm_ring_t rb;
+    if (!shm_ring_create_mode(&rb, ring, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, mode))
+        return 0;
+    shm_bench_arg_t tx = *cfg;
+    tx.rb = &rb;
+    tx.done = done;
+    *rx = tx;
+    uint64_t t0 = esp_timer_get_time();
+    // reader priority สูงกว่า: ตื่นทันทีที่มีข้อมูล (latency) / ไม่แย่ง core กับ writer แบบ busy
+    xTaskCreate(shm_bench_rx, "ShmBenchRx", 3072, rx, 6, NULL);
+    xTaskCreate(shm_bench_tx, "ShmBenchTx", 3072, &tx, 5, NULL);
+    xSemaphoreTake(done, portMAX_DELAY);
+    xSemaphoreTake(done, portMAX_DELAY);
+    uint64_t us = esp_timer_get_time() - t0;
+    rx->errors += tx.errors;
+    shm_ring_destroy(&rb);
+    return us;
+}
+
+#define SHM_MPMC_BENCH_MS 200
+#define SHM_MPMC_BENCH_RING 4096
+
+typedef struct
+{
+    shm_mpmc_t *q;
+    SemaphoreHandle_t done;
+    uint8_t id;
+    uint8_t producers;
+    uint32_t frames; // consumer: frame ที่รับ
+    uint32_t bytes;
+    uint32_t errors;
+} shm_mpmc_bench_arg_t;
+
+static uint32_t s_mpmc_bench_stop;
+
+// frame = [id][seq 4 ไบต์][ไบต์ (seq + k) ...] ยาว 8..135 ไบต์
+static void shm_mpmc_bench_tx(void *arg)
+{
+    shm_mpmc_bench_arg_t *a = (shm_mpmc_bench_arg_t *)arg;
+    uint8_t msg[136];
+    uint32_t x = 0x9E3779B9u * (a->id + 1);
+    for (uint32_t seq = 0; !__atomic_load_n(&s_mpmc_bench_stop, __ATOMIC_RELAXED); seq++)
+    {
+        x = x * 1664525u + 1013904223u;
+        uint16_t len = (uint16_t)(8 + (x >> 25));
+        msg[0] = a->id;
+        memcpy(msg + 1, &seq, sizeof(seq));
+        for (uint16_t k = 5; k < len; k++)
+            msg[k] = (uint8_t)(seq + k);
+        if (!shm_mpmc_write(a->q, a->id, msg, len, pdMS_TO_TICKS(100)))
+            a->errors++;
+    }
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static void shm_mpmc_bench_rx(void *arg)
+{
+    shm_mpmc_bench_arg_t *a = (shm_mpmc_bench_arg_t *)arg;
+    uint8_t msg[136];
+    uint32_t next[SHM_MPMC_MAX_PRODUCERS] = {0}; // seq ต่อ producer ต้องเพิ่มขึ้นเสมอใน consumer เดียวกัน
+    while (1)
+    {
+        uint16_t len = sizeof(msg);
+        if (!shm_mpmc_read(a->q, msg, &len, portMAX_DELAY))
+            continue;
+        if (!len)
+            break; // frame หยุด
+        uint32_t seq;
+        memcpy(&seq, msg + 1, sizeof(seq));
+        uint8_t bad = (msg[0] >= a->producers || len < 8 || seq < next[msg[0]]);
+        for (uint16_t k = 5; k < len; k++)
+            bad |= (uint8_t)(msg[k] ^ (uint8_t)(seq + k));
+        if (bad)
+            a->errors++;
+        else
+            next[msg[0]] = seq + 1;
+        a->frames++;
+        a->bytes += len;
+    }
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static void shm_mpmc_bench(void)
+{
+    static const int np[] = {1, 2, 4, 8};
+    static const int nc[] = {1, 2, 4};
+    static shm_mpmc_bench_arg_t tx[8], rx[4];
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(12, 0);
+    if (!done)
+        return;
+    ESP_LOGI(TAG, "MPMC scaling (ring %d B, slot %d B, frames 8..135 B, %d ms per run):", SHM_MPMC_BENCH_RING,
+             SHM_MPMC_SLOT_SIZE, SHM_MPMC_BENCH_MS);
+    for (size_t c = 0; c < sizeof(nc) / sizeof(nc[0]); c++)
+    {
+        for (size_t p = 0; p < sizeof(np) / sizeof(np[0]); p++)
+        {
+            shm_mpmc_t q;
+            if (!shm_mpmc_create(&q, SHM_MPMC_BENCH_RING, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT))
+                break;
+            __atomic_store_n(&s_mpmc_bench_stop, 0, __ATOMIC_RELAXED);
+            for (int i = 0; i < nc[c]; i++)
+            {
+                rx[i] = (shm_mpmc_bench_arg_t){.q = &q, .done = done, .producers = (uint8_t)np[p]};
+                xTaskCreate(shm_mpmc_bench_rx, "MpmcRx", 3072, &rx[i], 5, NULL);
+            }
+            uint64_t t0 = esp_timer_get_time();
+            for (int i = 0; i < np[p]; i++)
+            {
+                tx[i] = (shm_mpmc_bench_arg_t){.q = &q, .done = done, .id = (uint8_t)i};
+                xTaskCreate(shm_mpmc_bench_tx, "MpmcTx", 3072, &tx[i], 5, NULL);
+            }
+            vTaskDelay(pdMS_TO_TICKS(SHM_MPMC_BENCH_MS));
+            __atomic_store_n(&s_mpmc_bench_stop, 1, __ATOMIC_RELAXED);
+            for (int i = 0; i < np[p]; i++)
+                xSemaphoreTake(done, portMAX_DELAY);
+            uint64_t us = esp_timer_get_time() - t0;
+
+            shm_mpmc_pstat_t st[SHM_MPMC_MAX_PRODUCERS];
+            shm_mpmc_get_stats(&q, st); // ก่อนส่ง frame หยุด
+            uint32_t waits = 0, max_wait = 0, errors = 0;
+            for (int i = 0; i < np[p]; i++)
+            {
+                waits += st[i].waits;
+                max_wait = st[i].max_wait_us > max_wait ? st[i].max_wait_us : max_wait;
+                errors += tx[i].errors;
+            }
+            for (int i = 0; i < nc[c]; i++)
+                shm_mpmc_write(&q, 0, NULL, 0, portMAX_DELAY);
+            uint32_t frames = 0, bytes = 0;
+            for (int i = 0; i < nc[c]; i++)
+                xSemaphoreTake(done, portMAX_DELAY);
+            for (int i = 0; i < nc[c]; i++)
+            {
+                frames += rx[i].frames;
+                bytes += rx[i].bytes;
+                errors += rx[i].errors;
+            }
+            ESP_LOGI(TAG, "  P=%d C=%d | %7lu frames/s  %6lu KB/s  fairness %.3f  waits %lu (max %lu us)  errors %lu", np[p],
+                     nc[c], (unsigned long)(us ? (uint64_t)frames * 1000000ull / us : 0),
+                     (unsigned long)(us ? (uint64_t)bytes * 1000000ull / 1024 / us : 0), _mpmc_fairness(st),
+                     (unsigned long)waits, (unsigned long)max_wait, (unsigned long)errors);
+            shm_mpmc_destroy(&q);
+        }
+    }
+    vSemaphoreDelete(done);
+}
+
+#define SHM_POOL_BENCH_MSGS 20000
+#define SHM_POOL_BENCH_BURST 8
+
+typedef struct
+{
+    shm_pool_t *pool;
+    SemaphoreHandle_t done;
+    int burst; // 1 = publish/consume ทีละก้อน
+    uint32_t wakeups;
+    uint32_t errors;
+} shm_pool_bench_arg_t;
+
+static void shm_pool_bench_tx(void *arg)
+{
+    shm_pool_bench_arg_t *a = (shm_pool_bench_arg_t *)arg;
+    void *blk[SHM_POOL_BENCH_BURST];
+    size_t lens[SHM_POOL_BENCH_BURST];
+    for (uint32_t seq = 0; seq < SHM_POOL_BENCH_MSGS;)
+    {
+        int n = 0;
+        for (; n < a->burst && seq < SHM_POOL_BENCH_MSGS; n++, seq++)
+        {
+            blk[n] = shm_pool_acquire(a->pool, portMAX_DELAY);
+            memcpy(blk[n], &seq, sizeof(seq));
+            lens[n] = sizeof(seq);
+        }
+        bool ok = a->burst == 1 ? shm_pool_publish(a->pool, blk[0], lens[0], portMAX_DELAY)
+                                : shm_pool_publish_many(a->pool, blk, lens, n, portMAX_DELAY);
+        if (!ok)
+            a->errors++;
+    }
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static void shm_pool_bench_rx(void *arg)
+{
+    shm_pool_bench_arg_t *a = (shm_pool_bench_arg_t *)arg;
+    void *blk[SHM_POOL_BENCH_BURST * 2];
+    for (uint32_t next = 0; next < SHM_POOL_BENCH_MSGS;)
+    {
+        int n = a->burst == 1 ? (shm_pool_consume(a->pool, &blk[0], NULL, portMAX_DELAY) ? 1 : 0)
+                              : shm_pool_consume_many(a->pool, blk, NULL, SHM_POOL_BENCH_BURST * 2, portMAX_DELAY);
+        a->wakeups++;
+        for (int i = 0; i < n; i++, next++)
+        {
+            uint32_t seq;
+            memcpy(&seq, blk[i], sizeof(seq));
+            if (seq != next)
+                a->errors++;
+            shm_pool_release(a->pool, blk[i]);
+        }
+    }
+    xSemaphoreGive(a->done);
+    vTaskDelete(NULL);
+}
+
+static void shm_pool_bench(void)
+{
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+    if (!done)
+        return;
+    ESP_LOGI(TAG, "Pool publish/consume (%d msgs, 32 blocks):", SHM_POOL_BENCH_MSGS);
+    for (int burst = 1; burst <= SHM_POOL_BENCH_BURST; burst *= SHM_POOL_BENCH_BURST)
+    {
+        shm_pool_t pool;
+        if (!shm_pool_create(&pool, 32, 32, SHM_QUEUE_LENGTH, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT))
+            break;
+        shm_pool_bench_arg_t tx = {.pool = &pool, .done = done, .burst = burst}, rx = tx;
+        uint64_t t0 = esp_timer_get_time();
+        xTaskCreate(shm_pool_bench_rx, "PoolBenchRx", 3072, &rx, 5, NULL);
+        xTaskCreate(shm_pool_bench_tx, "PoolBenchTx", 3072, &tx, 5, NULL);
+        xSemaphoreTake(done, portMAX_DELAY);
+        xSemaphoreTake(done, portMAX_DELAY);
+        uint64_t us = esp_timer_get_time() - t0;
+        ESP_LOGI(TAG, "  burst %d | %lu ns/msg end-to-end  consumer wakeups %lu  (errors %lu)", burst,
+                 (unsigned long)(us * 1000 / SHM_POOL_BENCH_MSGS), (unsigned long)rx.wakeups,
+                 (unsigned long)(tx.errors + rx.errors));
+        shm_pool_destroy(&pool);
+    }
+    vSemaphoreDelete(done);
+}
+
+void shm_bench(void)
+{
+    static const char *const names[] = {"LOCKED", "SPSC"};
+    static const uint16_t sizes[] = {16, 64, 256, 1024};
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+    if (!done)
+        return;
+    ESP_LOGI(TAG, "\n⏱️ ═══ SHM RING BENCH (%d B frames, ring %d B) ═══", SHM_BENCH_FRAME_LEN, SHM_RING_CAPACITY);
+    for (int mode = SHM_RING_LOCKED; mode <= SHM_RING_SPSC; mode++)
+    {
+        shm_bench_arg_t a, cfg = {.frames = SHM_BENCH_FRAMES, .len = SHM_BENCH_FRAME_LEN};
+        uint64_t us = shm_bench_run((shm_ring_mode_t)mode, SHM_RING_CAPACITY, &cfg, &a, done);
+        uint64_t bytes = (uint64_t)SHM_BENCH_FRAMES * SHM_BENCH_FRAME_LEN;
+        ESP_LOGI(TAG, "%-6s throughput: %lu frames/s  %lu KB/s  (errors %lu)", names[mode],
+                 (unsigned long)(us ? (uint64_t)SHM_BENCH_FRAMES * 1000000ull / us : 0),
+                 (unsigned long)(us ? bytes * 1000000ull / 1024 / us : 0), (unsigned long)a.errors);
+
+        cfg = (shm_bench_arg_t){.frames = SHM_BENCH_LAT_SAMPLES, .len = SHM_BENCH_FRAME_LEN, .latency = true};
+        shm_bench_run((shm_ring_mode_t)mode, SHM_RING_CAPACITY, &cfg, &a, done);
+        ESP_LOGI(TAG, "%-6s wake-to-read: avg %lu us  max %lu us  (%d samples, errors %lu)", names[mode],
+                 (unsigned long)(a.lat_sum_us / SHM_BENCH_LAT_SAMPLES), (unsigned long)a.lat_max_us,
+                 SHM_BENCH_LAT_SAMPLES, (unsigned long)a.errors);
+    }
+
+    ESP_LOGI(TAG, "SPSC copy vs zero-copy (ring %d B, %d frames):", SHM_BENCH_ZC_RING, SHM_BENCH_FRAMES);
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+    {
+        uint64_t us[2];
+        uint32_t errors = 0;
+        for (int zc = 0; zc < 2; zc++)
+        {
+            shm_bench_arg_t a, cfg = {.frames = SHM_BENCH_FRAMES, .len = sizes[k], .zero_copy = zc};
+            us[zc] = shm_bench_run(SHM_RING_SPSC, SHM_BENCH_ZC_RING, &cfg, &a, done);
+            errors += a.errors;
+        }
+        uint64_t bytes = (uint64_t)SHM_BENCH_FRAMES * sizes[k];
+        ESP_LOGI(TAG, "  %4u B | copy %6lu KB/s  %5lu ns/frame | zero-copy %6lu KB/s  %5lu ns/frame  (errors %lu)",
+                 (unsigned)sizes[k], (unsigned long)(us[0] ? bytes * 1000000ull / 1024 / us[0] : 0),
+                 (unsigned long)(us[0] * 1000 / SHM_BENCH_FRAMES),
+                 (unsigned long)(us[1] ? bytes * 1000000ull / 1024 / us[1] : 0),
+                 (unsigned long)(us[1] * 1000 / SHM_BENCH_FRAMES), (unsigned long)errors);
+    }
+    vSemaphoreDelete(done);
+    shm_mpmc_bench();
+    shm_pool_bench();
+    ESP_LOGI(TAG, "═══════════════════════════════");
+}
+#endif
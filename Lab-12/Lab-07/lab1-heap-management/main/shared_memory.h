@@ -6,6 +6,7 @@
 #include <stddef.h>
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 
@@ -24,6 +25,10 @@
 #define SHM_QUEUE_LENGTH 8 // ความยาวคิวของพูล
 #endif
 
+#ifndef SHM_DEMO_BURST
+#define SHM_DEMO_BURST 4 // ข้อความต่อชุดของ producer ใน demo (publish_many)
+#endif
+
 #ifndef SHM_RING_CAPACITY
 #define SHM_RING_CAPACITY 1024 // ขนาดบัฟเฟอร์ริง (ไบต์)
 #endif
@@ -32,18 +37,46 @@
 #define SHM_USE_SPIRAM 0 // 1 = ใช้ SPIRAM ถ้ามี
 #endif
 
+#ifndef SHM_CACHE_LINE
+#define SHM_CACHE_LINE 32 // แยก index ของ producer/consumer คนละ cache line
+#endif
+
+#ifndef SHM_MPMC_SLOT_SIZE
+#define SHM_MPMC_SLOT_SIZE 32 // ขนาด slot ของ MPMC ring (รวม header 8 ไบต์) frame ยาวใช้หลาย slot ติดกัน
+#endif
+
+#ifndef SHM_MPMC_MAX_PRODUCERS
+#define SHM_MPMC_MAX_PRODUCERS 8 // id ของ producer สำหรับสถิติ fairness
+#endif
+
+#ifndef SHM_MPMC_MAX_WAITERS
+#define SHM_MPMC_MAX_WAITERS 8 // task ที่หลับรอได้ต่อฝั่ง (เกินนี้ poll ทีละ tick)
+#endif
+
+#ifndef SHM_BENCH_ENABLE
+#define SHM_BENCH_ENABLE 0 // 1 = วัด ring (mutex/SPSC/zero-copy), MPMC scaling และ pool แบบชุดตอนบูต
+#endif
+
 /* ======================
  * Zero-copy block pool
+ * - free list เป็น stack lock-free (index + tag กัน ABA ใน word เดียว) จำนวนบล็อกว่างนับด้วย counting semaphore
+ *   acquire หลับบน semaphore จน release คืนบล็อก (ไม่ poll)
+ * - publish ส่ง "ชุด" ของบล็อกที่ร้อยกันเป็น chain ผ่าน queue ครั้งเดียว → consumer ตื่นครั้งเดียวต่อชุด
  * ====================== */
+#define SHM_POOL_MAX_BLOCKS 0xFFFE
+
 typedef struct
 {
-    void *buffer;           // memory backing ทั้งก้อน
-    size_t block_size;      // ขนาด payload ต่อบล็อก (ไม่รวม header)
-    int num_blocks;         // จำนวนบล็อก
-    void *free_list;        // LIFO free list (เก็บ pointer base ของบล็อก)
-    SemaphoreHandle_t lock; // ป้องกัน free_list
-    QueueHandle_t q;        // คิวส่ง payload ptr ที่ publish แล้ว
-    uint32_t caps;          // heap capabilities
+    void *buffer;               // memory backing ทั้งก้อน
+    size_t block_size;          // ขนาด payload ต่อบล็อก (ไม่รวม header)
+    size_t block_bytes;         // header + payload
+    int num_blocks;             // จำนวนบล็อก (<= SHM_POOL_MAX_BLOCKS)
+    uint32_t free_head;         // [tag:16][index+1:16] ของบล็อกบนสุดใน free list (0 = ว่าง)
+    SemaphoreHandle_t free_sem; // นับบล็อกว่าง
+    QueueHandle_t q;            // คิวส่ง chain ของ payload ที่ publish แล้ว
+    portMUX_TYPE spill_mux;
+    void *spill; // chain ที่ consume_many รับไม่หมดและดันกลับหน้าคิวไม่ได้ (คิวเต็ม)
+    uint32_t caps; // heap capabilities
 } shm_pool_t;
 
 bool shm_pool_create(shm_pool_t *pool, size_t block_size, int num_blocks, int queue_len, uint32_t caps);
@@ -54,30 +87,126 @@ bool shm_pool_publish(shm_pool_t *pool, void *blk_payload, size_t used_len, Tick
 bool shm_pool_consume(shm_pool_t *pool, void **out_payload, size_t *out_len, TickType_t to_ticks); // รับจากคิว
 void shm_pool_release(shm_pool_t *pool, void *blk_payload);                                        // คืนบล็อกเข้าพูล
 
+// ส่ง n บล็อกเป็นชุดเดียว (ลำดับคงเดิม) ล้ม = ยังเป็นของผู้เรียกทั้งหมด
+bool shm_pool_publish_many(shm_pool_t *pool, void *const *payloads, const size_t *used_lens, int n, TickType_t to_ticks);
+// รอ (ถ้าไม่มี) แล้วรับได้ถึง max บล็อกในการตื่นครั้งเดียว คืนจำนวนที่ได้ (0 = timeout)
+int shm_pool_consume_many(shm_pool_t *pool, void **out_payloads, size_t *out_lens, int max, TickType_t to_ticks);
+
 /* ======================
- * Simple ring buffer (SPSC)
- * frame = [uint16_t len][payload bytes]
+ * Ring buffer
+ * frame = [uint16_t len][payload bytes] ต่อเนื่องในบัฟเฟอร์เสมอ (ไม่แตกข้ามขอบ)
+ *   ท้ายบัฟเฟอร์ไม่พอ → เขียน len = SHM_RING_PAD (หรือเหลือ < 2 ไบต์ก็ข้ามเฉย ๆ) แล้วเริ่ม frame ที่ 0
+ *   payload ยาวได้ไม่เกิน shm_ring_max_frame() (~ครึ่งบัฟเฟอร์ รับประกันว่าวางได้เสมอเมื่อ ring ว่าง)
+ * - SHM_RING_LOCKED: mutex + yield แล้ววนเช็กใหม่ ไม่มีการปลุก (writer/reader กี่ตัวก็ได้)
+ * - SHM_RING_SPSC  : writer 1 ตัว reader 1 ตัวเท่านั้น ไม่มี lock
+ *                    head/tail เป็น atomic อยู่คนละ cache line ฝั่งที่รอหลับด้วย task notification
+ *                    (ใช้ notification value index 0 ของ task ที่รอ)
+ * - zero-copy: reserve → เขียน payload ในที่ → commit / peek → อ่านในที่ → consume
+ *   ระหว่าง reserve..commit (peek..consume) ห้ามเรียก write (read) ฝั่งเดียวกัน
+ *   LOCKED ถือ mutex ตั้งแต่ reserve/peek จนถึง commit/consume
  * ====================== */
+#define SHM_RING_PAD 0xFFFFu
+
+typedef enum
+{
+    SHM_RING_LOCKED = 0,
+    SHM_RING_SPSC,
+} shm_ring_mode_t;
+
 typedef struct
 {
     uint8_t *buf;
     size_t cap; // ขนาดบัฟเฟอร์ (มีเว้น 1 ไบต์ไว้กัน full=empty)
-    size_t head;
-    size_t tail;
-    SemaphoreHandle_t mtx;       // ล็อกสำหรับอ่าน/เขียน
-    SemaphoreHandle_t can_read;  // เผื่อใช้ในอนาคต
-    SemaphoreHandle_t can_write; // เผื่อใช้ในอนาคต
+    shm_ring_mode_t mode;
+    SemaphoreHandle_t mtx; // ล็อกสำหรับอ่าน/เขียน (LOCKED)
     uint32_t caps;
+
+    // ฝั่ง writer: head + tail ที่เห็นล่าสุด (ไม่ต้องอ่าน line ของ reader ทุกครั้ง)
+    size_t head __attribute__((aligned(SHM_CACHE_LINE)));
+    size_t tail_cache;
+    TaskHandle_t writer_wait; // writer ที่หลับรอที่ว่าง (SPSC)
+    size_t wr_pos;            // reserve ค้าง: ตำแหน่ง header ของ frame
+    uint16_t wr_len;          // reserve ค้าง: ความยาวที่จอง
+    bool wr_open;
+
+    // ฝั่ง reader
+    size_t tail __attribute__((aligned(SHM_CACHE_LINE)));
+    size_t head_cache;
+    TaskHandle_t reader_wait; // reader ที่หลับรอข้อมูล (SPSC)
+    size_t rd_pos;            // peek ค้าง: ตำแหน่ง header ของ frame
+    uint16_t rd_len;
+    bool rd_open;
 } shm_ring_t;
 
-bool shm_ring_create(shm_ring_t *rb, size_t capacity, uint32_t caps);
+bool shm_ring_create(shm_ring_t *rb, size_t capacity, uint32_t caps); // = SHM_RING_LOCKED
+bool shm_ring_create_mode(shm_ring_t *rb, size_t capacity, uint32_t caps, shm_ring_mode_t mode);
 void shm_ring_destroy(shm_ring_t *rb);
 bool shm_ring_write(shm_ring_t *rb, const void *data, uint16_t len, TickType_t to_ticks);
 bool shm_ring_read(shm_ring_t *rb, void *out, uint16_t *inout_len, TickType_t to_ticks);
 
+size_t shm_ring_max_frame(const shm_ring_t *rb);
+void *shm_ring_reserve(shm_ring_t *rb, uint16_t len, TickType_t to_ticks); // span ต่อเนื่อง len ไบต์ (NULL = timeout/ยาวเกิน)
+bool shm_ring_commit(shm_ring_t *rb, uint16_t used_len);                   // used_len <= len ที่ reserve
+const void *shm_ring_peek(shm_ring_t *rb, uint16_t *out_len, TickType_t to_ticks);
+void shm_ring_consume(shm_ring_t *rb);
+
+/* ======================
+ * MPMC ring (หลาย producer / หลาย consumer)
+ * - bounded sequence buffer แบบ Vyukov: slot มี seq บอกสถานะ (ว่างรอ ticket / มีข้อมูล / ว่างรอบหน้า)
+ * - frame ยาวได้หลาย slot: producer เช็ก k slot ติดกันว่าง แล้ว CAS enqueue_pos += k
+ *   consumer อ่านความยาวจาก slot แรก แล้ว CAS dequeue_pos += k
+ * - ฝั่งที่รอหลับด้วย task notification (waiter ไม่เกิน SHM_MPMC_MAX_WAITERS ต่อฝั่ง)
+ * - สถิติต่อ producer id: frame/byte ที่ส่ง, จำนวนครั้งที่ต้องรอ, เวลารอนานสุด
+ * ====================== */
+typedef struct
+{
+    uint32_t seq;
+    uint16_t len; // ความยาว payload ของ frame (slot แรกของ frame)
+    uint16_t rsv;
+    uint8_t data[SHM_MPMC_SLOT_SIZE - 8];
+} shm_mpmc_slot_t;
+
+typedef struct
+{
+    uint32_t nwait;
+    TaskHandle_t task[SHM_MPMC_MAX_WAITERS];
+} shm_waitq_t;
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t waits;    // ครั้งที่ ring เต็มต้องหลับ
+    uint32_t timeouts; // write ที่ล้มเพราะหมดเวลา
+    uint32_t max_wait_us;
+} shm_mpmc_pstat_t;
+
+typedef struct
+{
+    shm_mpmc_slot_t *slots;
+    uint32_t mask; // จำนวน slot - 1 (ยกกำลังสอง)
+    uint32_t caps;
+    uint32_t enqueue_pos __attribute__((aligned(SHM_CACHE_LINE)));
+    shm_waitq_t producers_wait;
+    uint32_t dequeue_pos __attribute__((aligned(SHM_CACHE_LINE)));
+    shm_waitq_t consumers_wait;
+    shm_mpmc_pstat_t pstat[SHM_MPMC_MAX_PRODUCERS] __attribute__((aligned(SHM_CACHE_LINE)));
+} shm_mpmc_t;
+
+bool shm_mpmc_create(shm_mpmc_t *q, size_t capacity, uint32_t caps); // capacity ปัดขึ้นเป็นจำนวน slot ยกกำลังสอง
+void shm_mpmc_destroy(shm_mpmc_t *q);
+size_t shm_mpmc_max_frame(const shm_mpmc_t *q);
+bool shm_mpmc_write(shm_mpmc_t *q, uint8_t producer, const void *data, uint16_t len, TickType_t to_ticks);
+bool shm_mpmc_read(shm_mpmc_t *q, void *out, uint16_t *inout_len, TickType_t to_ticks);
+void shm_mpmc_get_stats(const shm_mpmc_t *q, shm_mpmc_pstat_t out[SHM_MPMC_MAX_PRODUCERS]);
+void shm_mpmc_print_stats(const shm_mpmc_t *q);
+
 /* ======================
  * Demo starter
  * ====================== */
 void shm_demo_start(void);
+#if SHM_BENCH_ENABLE
+void shm_bench(void);
+#endif
 
 #endif /* SHARED_MEMORY_H */
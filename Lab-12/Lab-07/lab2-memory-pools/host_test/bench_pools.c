@@ -0,0 +1,19 @@
+// benchmark ของ lab2 บน host: latency ของ smart_pool_malloc/free ต่อขนาด
+// และ alloc+free ของ engine locked / lock-free / bitmap ที่ 1/2/4/8 task
+// ตัวเลขเป็นของเครื่อง host (pthread + futex) ใช้ดูแนวโน้ม ไม่ใช่ค่าของ ESP32: make -C host_test bench
+#include <stdio.h>
+
+#define POOL_BENCH_ENABLE 1
+#define PERSIST_BACKEND PERSIST_BACKEND_RAM
+#define app_main lab2_app_main
+#include "lab2-memory-pools.c"
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    if (!pools_boot())
+        return 1;
+    bench_smart_latency(); // บน main thread: magazine ของ task นี้ถูกคืนตอนจบ
+    bench_engines();
+    return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum
+{
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_2 = 2,
+    GPIO_NUM_4 = 4,
+    GPIO_NUM_5 = 5,
+    GPIO_NUM_18 = 18,
+    GPIO_NUM_19 = 19,
+} gpio_num_t;
+
+typedef enum
+{
+    GPIO_MODE_INPUT = 1,
+    GPIO_MODE_OUTPUT = 2,
+} gpio_mode_t;
+
+// ไม่มีขาจริงบน host: LED เป็น no-op
+static inline esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+    (void)pin;
+    (void)mode;
+    return ESP_OK;
+}
+
+static inline esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    (void)pin;
+    (void)level;
+    return ESP_OK;
+}
@@ -0,0 +1,26 @@
+#pragma once
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_TIMEOUT 0x107
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE (ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_NO_FREE_PAGES (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND (ESP_ERR_NVS_BASE + 0x10)
+
+const char *esp_err_to_name(esp_err_t err);
+void idf_host_abort(const char *expr, esp_err_t err);
+
+#define ESP_ERROR_CHECK(x)                 \
+    do                                     \
+    {                                      \
+        esp_err_t err_rc_ = (x);           \
+        if (err_rc_ != ESP_OK)             \
+            idf_host_abort(#x, err_rc_);   \
+    } while (0)
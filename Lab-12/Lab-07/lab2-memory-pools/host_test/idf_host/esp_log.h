@@ -0,0 +1,27 @@
+#pragma once
+#include <stdio.h>
+
+// log ของ host ไปที่ stdout (ไม่มีเวลา/สี) ระดับ D/V ทิ้ง
+#define ESP_LOGE(tag, fmt, ...) printf("E (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) printf("W (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) printf("I (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) \
+    do                          \
+    {                           \
+        (void)(tag);            \
+    } while (0)
+#define ESP_LOGV ESP_LOGD
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#define ESP_LOG_LEVEL(level, tag, fmt, ...)                                                             \
+    printf("%c (%s) " fmt "\n", (level) == ESP_LOG_ERROR ? 'E' : (level) == ESP_LOG_WARN ? 'W' : 'I', tag, \
+           ##__VA_ARGS__)
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// FreeRTOS บน pthread: task = thread, tick ยาวเท่าบอร์ด (CONFIG_FREERTOS_HZ)
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define portNUM_PROCESSORS 2
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS
+
+// critical section ของ host เป็น lock รวมตัวเดียว (ไม่ปิด interrupt เพราะไม่มี)
+typedef struct
+{
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void idf_host_enter_critical(portMUX_TYPE *mux);
+void idf_host_exit_critical(portMUX_TYPE *mux);
+#define portENTER_CRITICAL(mux) idf_host_enter_critical(mux)
+#define portEXIT_CRITICAL(mux) idf_host_exit_critical(mux)
+
+BaseType_t xPortGetCoreID(void);
@@ -0,0 +1,9 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct idf_host_sem *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
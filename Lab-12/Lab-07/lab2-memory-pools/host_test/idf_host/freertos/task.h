@@ -0,0 +1,26 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct idf_host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+typedef void (*TlsDeleteCallbackFunction_t)(int, void *);
+
+// stack_depth ไม่มีผลบน host (thread ใช้ stack ของ pthread)
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out);
+void vTaskDelete(TaskHandle_t task); // ลบได้เฉพาะตัวเอง (NULL)
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *prev_wake, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char *pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t prio);
+
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index);
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index, void *value);
+void vTaskSetThreadLocalStoragePointerAndDelCallback(TaskHandle_t task, BaseType_t index, void *value,
+                                                     TlsDeleteCallbackFunction_t cb);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
@@ -0,0 +1,405 @@
+// stand-in ของ ESP-IDF/FreeRTOS บน pthread สำหรับ host_test ของ lab2
+// ครอบคลุมเฉพาะ API ที่ main/ เรียก เวลา tick = 1000 / CONFIG_FREERTOS_HZ ms เหมือนบอร์ด
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+
+struct idf_host_task
+{
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    UBaseType_t prio;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    void *tls[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
+    TlsDeleteCallbackFunction_t tls_del[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
+};
+
+struct idf_host_sem
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+static pthread_mutex_t s_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread struct idf_host_task *s_self;
+
+// ===== เวลา =====
+static int64_t mono_us(void)
+{
+    static int64_t start = -1;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (start < 0)
+        start = now;
+    return now - start;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return mono_us();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(mono_us() / (1000 * portTICK_PERIOD_MS));
+}
+
+// รอ cond จนถึง deadline (ticks = portMAX_DELAY → รอไม่มีกำหนด) คืน ETIMEDOUT เมื่อหมดเวลา
+static int wait_ticks(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline)
+{
+    if (!deadline)
+        return pthread_cond_wait(cond, lock);
+    return pthread_cond_timedwait(cond, lock, deadline);
+}
+
+static struct timespec *deadline_after(struct timespec *ts, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+        return NULL;
+    uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ull;
+    clock_gettime(CLOCK_REALTIME, ts);
+    ns += (uint64_t)ts->tv_nsec;
+    ts->tv_sec += (time_t)(ns / 1000000000ull);
+    ts->tv_nsec = (long)(ns % 1000000000ull);
+    return ts;
+}
+
+// ===== critical section / core =====
+void idf_host_enter_critical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_lock(&s_critical);
+}
+
+void idf_host_exit_critical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_unlock(&s_critical);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu % portNUM_PROCESSORS;
+}
+
+// ===== task =====
+static struct idf_host_task *task_new(const char *name, UBaseType_t prio)
+{
+    struct idf_host_task *t = calloc(1, sizeof(*t));
+    if (!t)
+        return NULL;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "");
+    t->prio = prio;
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    return t;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!s_self)
+        s_self = task_new("main", 1); // thread ของ main() ได้ handle ตอนเรียกครั้งแรก
+    return s_self;
+}
+
+static struct idf_host_task *task_or_self(TaskHandle_t task)
+{
+    return task ? task : xTaskGetCurrentTaskHandle();
+}
+
+// คืน TCB ตอน thread จบ (ทั้ง vTaskDelete(NULL) และ return) เหมือน idle task ของ FreeRTOS
+static void task_free(void *arg)
+{
+    struct idf_host_task *t = (struct idf_host_task *)arg;
+    s_self = NULL;
+    pthread_cond_destroy(&t->cond);
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+}
+
+static void *task_entry(void *arg)
+{
+    s_self = (struct idf_host_task *)arg;
+    pthread_cleanup_push(task_free, arg);
+    s_self->fn(s_self->arg);
+    vTaskDelete(NULL); // task ของ FreeRTOS ห้าม return แต่กันไว้
+    pthread_cleanup_pop(0);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out)
+{
+    (void)stack_depth;
+    struct idf_host_task *t = task_new(name, prio);
+    if (!t)
+        return pdFALSE;
+    t->fn = fn;
+    t->arg = arg;
+    if (out)
+        *out = t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&t->thread, &attr, task_entry, t);
+    pthread_attr_destroy(&attr);
+    return rc == 0 ? pdPASS : pdFALSE;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    struct idf_host_task *self = xTaskGetCurrentTaskHandle();
+    if (task && task != self)
+    {
+        fprintf(stderr, "idf_host: vTaskDelete of another task is not supported\n");
+        abort();
+    }
+    // เหมือน CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS: เรียก callback ของ TLS ก่อนจบ task
+    for (int i = 0; i < configNUM_THREAD_LOCAL_STORAGE_POINTERS; i++)
+        if (self->tls_del[i])
+            self->tls_del[i](i, self->tls[i]);
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0)
+    {
+        sched_yield();
+        return;
+    }
+    usleep((useconds_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *prev_wake, TickType_t period)
+{
+    TickType_t target = *prev_wake + period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(target - now) > 0)
+        vTaskDelay(target - now);
+    *prev_wake = target;
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    return task_or_self(task)->name;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return __atomic_load_n(&task_or_self(task)->prio, __ATOMIC_RELAXED);
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t prio)
+{
+    __atomic_store_n(&task_or_self(task)->prio, prio, __ATOMIC_RELAXED); // ไม่มีผลต่อ scheduler ของ host
+}
+
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index)
+{
+    return task_or_self(task)->tls[index];
+}
+
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index, void *value)
+{
+    task_or_self(task)->tls[index] = value;
+}
+
+void vTaskSetThreadLocalStoragePointerAndDelCallback(TaskHandle_t task, BaseType_t index, void *value,
+                                                     TlsDeleteCallbackFunction_t cb)
+{
+    struct idf_host_task *t = task_or_self(task);
+    t->tls[index] = value;
+    t->tls_del[index] = cb;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct idf_host_task *t = xTaskGetCurrentTaskHandle();
+    struct timespec ts;
+    const struct timespec *deadline = deadline_after(&ts, ticks);
+    pthread_mutex_lock(&t->lock);
+    int rc = 0;
+    while (t->notify == 0 && ticks != 0 && rc != ETIMEDOUT)
+        rc = wait_ticks(&t->cond, &t->lock, deadline);
+    uint32_t v = t->notify;
+    if (v)
+        t->notify = clear_on_exit ? 0 : v - 1;
+    pthread_mutex_unlock(&t->lock);
+    return v;
+}
+
+// ===== semaphore (counting) =====
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    struct idf_host_sem *s = calloc(1, sizeof(*s));
+    if (!s)
+        return NULL;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->count = initial;
+    s->max = max;
+    return s;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    struct timespec ts;
+    const struct timespec *deadline = deadline_after(&ts, ticks);
+    pthread_mutex_lock(&sem->lock);
+    int rc = 0;
+    while (sem->count == 0 && ticks != 0 && rc != ETIMEDOUT)
+        rc = wait_ticks(&sem->cond, &sem->lock, deadline);
+    BaseType_t ok = sem->count ? pdTRUE : pdFALSE;
+    if (ok)
+        sem->count--;
+    pthread_mutex_unlock(&sem->lock);
+    return ok;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    BaseType_t ok = sem->count < sem->max ? pdTRUE : pdFALSE;
+    if (ok)
+    {
+        sem->count++;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ok;
+}
+
+// ===== heap =====
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? NULL : malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? NULL : calloc(n, size);
+}
+
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps)
+{
+    void *p = NULL;
+    if (caps & MALLOC_CAP_SPIRAM)
+        return NULL;
+    if (alignment < sizeof(void *))
+        alignment = sizeof(void *);
+    return posix_memalign(&p, alignment, size) == 0 ? p : NULL;
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+// ===== NVS (ไม่มี flash) / error =====
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    (void)ns;
+    (void)mode;
+    (void)out;
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out)
+{
+    (void)h;
+    (void)key;
+    (void)out;
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t nvs_get_u64(nvs_handle_t h, const char *key, uint64_t *out)
+{
+    (void)h;
+    (void)key;
+    (void)out;
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t val)
+{
+    (void)h;
+    (void)key;
+    (void)val;
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t nvs_set_u64(nvs_handle_t h, const char *key, uint64_t val)
+{
+    (void)h;
+    (void)key;
+    (void)val;
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    (void)h;
+    return ESP_ERR_NOT_FOUND;
+}
+
+const char *esp_err_to_name(esp_err_t err)
+{
+    static __thread char buf[16];
+    snprintf(buf, sizeof(buf), "0x%x", (unsigned)err);
+    return buf;
+}
+
+void idf_host_abort(const char *expr, esp_err_t err)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: %s = %s\n", expr, esp_err_to_name(err));
+    abort();
+}
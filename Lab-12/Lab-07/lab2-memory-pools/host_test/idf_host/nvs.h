@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+// host ไม่มี flash: ทุกตัวคืน ESP_ERR_NOT_FOUND (ใช้ backend RAM ของ persist_store แทน)
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out);
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out);
+esp_err_t nvs_get_u64(nvs_handle_t h, const char *key, uint64_t *out);
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t val);
+esp_err_t nvs_set_u64(nvs_handle_t h, const char *key, uint64_t val);
+esp_err_t nvs_commit(nvs_handle_t h);
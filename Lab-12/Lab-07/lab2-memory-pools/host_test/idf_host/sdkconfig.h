@@ -0,0 +1,5 @@
+#pragma once
+// ค่าที่โค้ด lab2 อ่านจาก sdkconfig ของบอร์ด (ให้ตรงกับ ../../sdkconfig)
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS 2
+#define CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS 1
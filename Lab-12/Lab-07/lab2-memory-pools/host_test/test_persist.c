@@ -0,0 +1,178 @@
+// ขับ persistence stage (snapshot → diff → commit) บน backend RAM ด้วยเวลาสมมุติ
+// นับ key ที่เขียนและจำนวน commit ของ: flush ที่ไม่มีอะไรเปลี่ยน, เปลี่ยนบางส่วน, คำขอถี่ ๆ ที่ถูกรวม, autosave
+#include <stdio.h>
+
+#define PERSIST_BACKEND PERSIST_BACKEND_RAM
+#define app_main lab2_app_main // ไม่สร้าง task ของแอป: test เรียก pools_boot/pool_persist_step เอง
+#include "lab2-memory-pools.c"
+
+static int s_fail = 0;
+
+#define CHECK(cond)                                                      \
+    do                                                                   \
+    {                                                                    \
+        if (!(cond))                                                     \
+        {                                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);       \
+            s_fail++;                                                    \
+        }                                                                \
+    } while (0)
+
+static uint64_t s_now_ms = 0;
+static uint64_t s_last_commit_ms = 0;
+static persist_store_stats_t s_base;
+
+// เลื่อนเวลาแล้วรัน persist หนึ่งรอบ คืนเวลารอที่ step ขอ
+static uint32_t step_at(uint64_t dt_ms)
+{
+    s_now_ms += dt_ms;
+    return pool_persist_step(s_now_ms, &s_last_commit_ms);
+}
+
+// key/commit ที่เพิ่มขึ้นตั้งแต่ mark() ครั้งก่อน
+static void mark(void)
+{
+    persist_store_get_stats(&s_base);
+}
+
+static uint32_t keys_since(void)
+{
+    persist_store_stats_t st;
+    persist_store_get_stats(&st);
+    return st.key_writes - s_base.key_writes;
+}
+
+static uint32_t commits_since(void)
+{
+    persist_store_stats_t st;
+    persist_store_get_stats(&st);
+    return st.commits - s_base.commits;
+}
+
+// จอง/คืนหนึ่งบล็อกจาก depot ตรง ๆ (ไม่ผ่าน magazine) → alloc/free +1 และ peak ≥ 1
+static void touch_pool(int pi)
+{
+    void *p = pool_malloc(&pools[pi]);
+    CHECK(p != NULL);
+    CHECK(pool_free(&pools[pi], p));
+}
+
+static uint64_t stored_u64(int pi, const char *suffix)
+{
+    char key[32];
+    uint64_t v = 0;
+    persist_key(key, sizeof(key), pi, suffix);
+    CHECK(persist_store_get_u64(key, &v) == ESP_OK);
+    return v;
+}
+
+static void test_first_flush(void)
+{
+    // store ว่าง: ค่าเดียวที่ต่างจากฐาน 0 คือ blocks (= default) ของทุกพูล
+    mark();
+    pools_persist_save_now();
+    step_at(PERSIST_FLUSH_MIN_MS);
+    CHECK(keys_since() == POOL_COUNT);
+    CHECK(commits_since() == 1);
+}
+
+static void test_unchanged(void)
+{
+    // flush ที่ไม่มีอะไรเปลี่ยน: ไม่มี set และไม่มี commit
+    mark();
+    pools_persist_save_now();
+    step_at(PERSIST_FLUSH_MIN_MS);
+    CHECK(keys_since() == 0);
+    CHECK(commits_since() == 0);
+    CHECK(!g_persist_flush_req); // คำขอถูกใช้ไปแล้ว
+
+    // autosave ที่ครบรอบแต่ไม่มีอะไรเปลี่ยน ก็ไม่แตะ store เช่นกัน
+    step_at(SAVE_INTERVAL_MS);
+    CHECK(keys_since() == 0);
+    CHECK(commits_since() == 0);
+}
+
+static void test_partial(void)
+{
+    // Medium เปลี่ยน peak/alloc/freec (blocks ยังเท่า default) → 3 key ใน commit เดียว
+    touch_pool(POOL_MEDIUM);
+    mark();
+    pools_persist_save_now();
+    step_at(PERSIST_FLUSH_MIN_MS);
+    CHECK(keys_since() == 3);
+    CHECK(commits_since() == 1);
+    CHECK(stored_u64(POOL_MEDIUM, "alloc") == 1);
+    CHECK(stored_u64(POOL_MEDIUM, "freec") == 1);
+
+    // รอบถัดไป Medium เปลี่ยนแค่ alloc/freec (peak ยัง 1) ส่วน Large เปลี่ยนครบ 3 ช่อง
+    touch_pool(POOL_MEDIUM);
+    touch_pool(POOL_LARGE);
+    mark();
+    pools_persist_save_now();
+    step_at(PERSIST_FLUSH_MIN_MS);
+    CHECK(keys_since() == 2 + 3);
+    CHECK(commits_since() == 1);
+    CHECK(stored_u64(POOL_MEDIUM, "alloc") == 2);
+}
+
+static void test_coalesced(void)
+{
+    // คำขอ 5 ครั้งภายใน PERSIST_FLUSH_MIN_MS หลัง commit ล่าสุด → ยังไม่เขียน ได้เวลารอที่เหลือ
+    // แล้วเขียนครั้งเดียวตอนครบกำหนด (ได้ค่าล่าสุดรวมทุกการเปลี่ยน)
+    uint32_t req0 = g_persist_requests;
+    mark();
+    for (int i = 0; i < 5; i++)
+    {
+        touch_pool(POOL_SMALL);
+        pools_persist_save_now();
+        CHECK(step_at(100) == PERSIST_FLUSH_MIN_MS - 100 * (uint32_t)(i + 1));
+    }
+    CHECK(keys_since() == 0);
+    CHECK(commits_since() == 0);
+    CHECK(g_persist_requests - req0 == 5);
+
+    CHECK(step_at(PERSIST_FLUSH_MIN_MS - 500) == PERSIST_POLL_MS);
+    CHECK(keys_since() == 3); // Small peak/alloc/freec
+    CHECK(commits_since() == 1);
+    CHECK(stored_u64(POOL_SMALL, "alloc") == 5);
+
+    // หลัง commit แล้วไม่มีคำขอค้าง: รอบถัดไปเงียบ
+    step_at(PERSIST_POLL_MS);
+    CHECK(commits_since() == 1);
+}
+
+static void test_autosave(void)
+{
+    // ไม่มีคำขอ flush: เขียนเมื่อห่างจาก commit ล่าสุดครบ SAVE_INTERVAL_MS เท่านั้น
+    touch_pool(POOL_HUGE);
+    mark();
+    uint64_t t0 = s_last_commit_ms;
+    while (s_now_ms + PERSIST_POLL_MS < t0 + SAVE_INTERVAL_MS)
+        step_at(PERSIST_POLL_MS);
+    CHECK(commits_since() == 0);
+    step_at(t0 + SAVE_INTERVAL_MS - s_now_ms);
+    CHECK(keys_since() == 3);
+    CHECK(commits_since() == 1);
+}
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    if (!pools_boot())
+    {
+        printf("FAIL pools_boot\n");
+        return 1;
+    }
+    test_first_flush();
+    test_unchanged();
+    test_partial();
+    test_coalesced();
+    test_autosave();
+
+    persist_store_stats_t st;
+    persist_store_get_stats(&st);
+    CHECK(st.commit_failures == 0);
+    printf("%s: %d failure(s) (%lu key write(s), %lu commit(s))\n", s_fail ? "FAIL" : "OK", s_fail,
+           (unsigned long)st.key_writes, (unsigned long)st.commits);
+    return s_fail ? 1 : 0;
+}
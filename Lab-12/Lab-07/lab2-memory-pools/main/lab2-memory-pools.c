@@ -8,8 +8,6 @@
 #include "esp_timer.h"
 #include "esp_system.h"
 #include "driver/gpio.h"
-#include "nvs_flash.h"
-#include "nvs.h"
 
 static const char *TAG = "MEM_POOLS";
 
@@ -47,6 +45,76 @@ typedef struct memory_block
 } memory_block_t;
 
 #include "pool_sync.h" // ต้องมี pool_sync_t + SYNC_TIMEOUT_MS + ฟังก์ชัน lock ต่าง ๆ
+#include "pool_activity.h"
+#include "persist_store.h"
+#include "pool_hist.h"
+#include "memory_pools.h"
+
+// กลไกจอง/คืนบล็อกของแต่ละพูล
+typedef enum
+{
+    POOL_ENGINE_LOCKED = 0, // free_list ภายใต้ pool_sync_write_lock (แบบเดิม)
+    POOL_ENGINE_LOCKFREE,   // Treiber stack บน free_list + tag (ไม่มี kernel call)
+    POOL_ENGINE_BITMAP,     // สแกน usage bitmap ทีละ word ด้วย ctz + CAS (แจกตามลำดับ address, ไม่ใช้ next)
+} pool_engine_t;
+
+// หัว free_list: LOCKED ใช้ pointer ใต้ write lock
+// LOCKFREE ใช้ top = (tag << 16) | ref ใน word เดียว → CAS 32 บิตตรง ๆ (CAS 64 บิตบน Xtensa ไปเรียก
+// libatomic ที่ล็อกรวมทั้งระบบ) tag เพิ่มทุกครั้งที่ top เปลี่ยน CAS ที่อ่าน top เก่า (ABA) จึงล้ม
+// ref = 0 คือว่าง, ไม่งั้น ((segment << POOL_LF_SEG_SHIFT) | index ในsegment) + 1
+typedef struct
+{
+    memory_block_t *head; // LOCKED
+    uint32_t top;         // LOCKFREE
+} pool_free_list_t;
+
+#define POOL_LF_SEG_SHIFT 14
+#define POOL_LF_MAX_SEG_BLOCKS ((1u << POOL_LF_SEG_SHIFT) - 1) // บล็อกต่อ segment สูงสุดของ LOCKFREE
+#define LF_REF(t) ((t) & 0xFFFFu)
+#define LF_TAG(t) ((t) >> 16)
+
+// ตำแหน่ง metadata ของบล็อก
+typedef enum
+{
+    POOL_LAYOUT_HEADER = 0, // memory_block_t นำหน้า payload ทุกบล็อก (แบบเดิม)
+    POOL_LAYOUT_COMPACT,    // ไม่มี header: state/size/เวลาอยู่ใน array แยกต่อ segment, payload ชิด cache line
+} pool_layout_t;
+
+#define POOL_COMPACT_ALIGN 32 // ขนาด cache line ของ ESP32
+#ifndef POOL_COMPACT_STAMPS
+#define POOL_COMPACT_STAMPS 1 // 0 = ไม่เก็บเวลาจองของ COMPACT (ประหยัดอีก 4 B/บล็อก)
+#endif
+
+// พูลหนึ่งประกอบด้วยหลาย segment: segs[0] = ฐานจากตอนบูต, ที่เหลือเพิ่ม/คืนตอนรันไทม์
+#define POOL_MAX_SEGMENTS 4 // ต้องไม่เกิน 4: ref ของ LOCKFREE มีที่ให้ segment 2 บิต
+
+// ตัวนับของ core หนึ่ง: allocator บวกแบบ atomic relaxed ลง shard ของ core ตัวเองเท่านั้น
+// ทุกช่องนับเพิ่มอย่างเดียว → ผู้อ่านเก็บสองรอบแล้วเทียบกันได้โดยไม่ต้องให้ writer รอ
+// 32 บิต: atomic 64 บิตบน Xtensa เป็น libatomic ที่ถือ lock รวม ยอด 64 บิตขยายใน pool_stats_snapshot()
+typedef struct
+{
+    uint32_t allocs;      // ส่งบล็อกให้ผู้ใช้ตรงจาก depot (single/bulk)
+    uint32_t frees;
+    uint32_t mag_allocs;  // เสิร์ฟจาก magazine (fold มาจาก magazine ตอนคืน slot)
+    uint32_t mag_frees;
+    uint32_t cache_fill;  // บล็อกที่ depot ส่งเข้า magazine
+    uint32_t cache_drain; // บล็อกที่ magazine คืน depot
+    uint32_t fails;
+} pool_stats_shard_t;
+
+typedef struct
+{
+    uint8_t *mem;       // NULL = slot ว่าง (slot ไม่ถูกเลื่อน เพื่อให้ผู้อ่านที่ไม่ถือ lock ปลอดภัย)
+    uint32_t *bitmap;   // 1 bit ต่อ block ของ segment นี้ (บิตท้าย word ที่เกิน block_count ตั้งเป็น 1)
+    size_t block_count;
+    size_t used;        // บล็อกที่ออกจาก depot (0 = คืนทั้ง segment ได้)
+    bool in_region;     // เป็นชิ้นของ region รวม (ห้าม free แยก, owner map ชี้ถึง)
+
+    // COMPACT เท่านั้น: metadata แบบ parallel array (index = เลขบล็อกใน segment)
+    uint8_t *state;      // POOL_STATE_*
+    uint16_t *size_used; // ขนาดที่ผู้ใช้ขอ (แทน memory_block_t.size_used)
+    uint32_t *stamp_ms;  // เวลาจอง (ms) หรือ NULL ถ้า POOL_COMPACT_STAMPS = 0
+} pool_segment_t;
 
 typedef struct
 {
@@ -55,22 +123,35 @@ typedef struct
     size_t block_count;
     size_t alignment;
     uint32_t caps;
-
-    void *pool_memory;
-    memory_block_t *free_list;
-    uint8_t *usage_bitmap; // 1 bit ต่อ block
-
-    // stats
+    pool_layout_t layout;
+    size_t hdr_size; // ไบต์ header หน้า payload (COMPACT = 0)
+
+    pool_segment_t segs[POOL_MAX_SEGMENTS];
+    size_t seg_count;           // slot สูงสุดที่เคยใช้ (+1) อ่านแบบ acquire
+    uint32_t lf_readers;        // LOCKFREE/BITMAP: ผู้อ่านที่ไม่ถือ lock ซึ่งอาจแตะหน่วยความจำ segment อยู่
+    uint8_t *retired_mem;       // segment ที่ shrink ถอดแล้วรอพ้น grace (NULL = ไม่มี) slot เดิมเก็บ metadata ไว้
+    uint8_t retired_slot;
+    pool_free_list_t free_list; // LOCKED: ใช้ .head ใต้ write lock, LOCKFREE: CAS .top
+    pool_engine_t engine;
+    uint32_t bm_hint;           // BITMAP: (segment << 24) | word ต่ำสุดที่อาจมีบล็อกว่าง
+
+    // gauge สำหรับตัดสินใจ (peak/elastic/LED) อัปเดตด้วย __atomic_* มุมมอง depot (รวมที่ค้างใน magazine)
     size_t allocated_blocks;
     size_t peak_usage;
-    uint64_t total_allocations;
-    uint64_t total_deallocations;
-    uint64_t allocation_time_total;
-    uint64_t deallocation_time_total;
-    uint32_t allocation_failures;
+    pool_stats_shard_t stats[portNUM_PROCESSORS]; // ตัวนับสะสม อ่านผ่าน pool_stats_snapshot()
+    uint32_t wide_seen[2];  // allocs/frees (32 บิต) ที่ขยายไปแล้ว ใต้ s_stats_wide_mux
+    uint64_t wide_total[2]; // ยอดสะสม 64 บิตของ allocs/frees
+    pool_hist_t alloc_hist;     // latency ต่อบล็อก (us) รวมเวลารอ lock
+    pool_hist_t free_hist;
+    pool_hist_t lock_wait_hist; // LOCKED: เวลารอ write lock (ไม่รวมงานใต้ lock)
+    uint32_t stats_seq; // seqlock ของ block_count/peak reset (grow/shrink/resize ทำใต้ write lock)
 
     pool_sync_t sync;
     uint32_t pool_id;
+    size_t mag_cap;           // ความจุ magazine ต่อ task (0 = ไม่ใช้ cache)
+    int activity_ch;          // channel ของไฟแสดงกิจกรรม (-1 = ไม่มี)
+    uint32_t grow_fail_mark;  // จำนวน failure รวม ตอนที่ elastic task ตรวจ/grow ครั้งล่าสุด
+    uint8_t low_usage_rounds; // รอบตรวจติดกันที่ใช้งานต่ำกว่าเกณฑ์ shrink
 } memory_pool_t;
 
 typedef enum
@@ -87,6 +168,42 @@ static memory_pool_t pools[POOL_COUNT];
 // Magic numbers
 #define POOL_MAGIC_FREE 0xDEADBEEF
 #define POOL_MAGIC_ALLOC 0xCAFEBABE
+#define POOL_MAGIC_CACHED 0xC0FFEE00 // อยู่ใน magazine ของ task (ออกจาก depot แล้ว แต่ยังไม่ถึงผู้ใช้)
+
+// magic ฉบับ 1 ไบต์สำหรับ state array ของ COMPACT
+enum
+{
+    POOL_STATE_NONE = 0,
+    POOL_STATE_FREE,
+    POOL_STATE_ALLOC,
+    POOL_STATE_CACHED,
+};
+
+// ============================
+//   Per-task magazine cache
+// ============================
+#define POOL_CACHE_MAG_SIZE 8   // ความจุสูงสุดต่อ magazine
+#define POOL_CACHE_MAX_TASKS 8  // จำนวน task ที่มี cache ได้พร้อมกัน
+#ifndef POOL_CACHE_TLS_INDEX
+#define POOL_CACHE_TLS_INDEX (configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1) // index 0 เป็นของ pthread
+#endif
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t allocs; // allocation/free ที่เสิร์ฟจาก magazine (เจ้าของเขียนคนเดียว fold เข้า shard ตอนคืน slot)
+    uint32_t frees;
+    void *blocks[POOL_CACHE_MAG_SIZE];
+} pool_magazine_t;
+
+typedef struct
+{
+    TaskHandle_t owner;     // NULL = slot ว่าง
+    volatile bool orphaned; // task ถูกลบแล้ว รอ monitor คืนบล็อกเข้า depot
+    pool_magazine_t mags[POOL_COUNT];
+} pool_task_cache_t;
+
+static pool_task_cache_t g_task_caches[POOL_CACHE_MAX_TASKS];
 
 typedef struct
 {
@@ -95,290 +212,1348 @@ typedef struct
     size_t block_count;
     uint32_t caps;
     gpio_num_t led_pin;
+    pool_engine_t engine;
+    pool_layout_t layout;
 } pool_config_t;
 
+// Small/Medium อยู่บนเส้นทางข้อความที่จอง/คืนถี่ → ใช้ lock-free
+// Large ใช้ bitmap: บล็อก 1 KB แจกตามลำดับ address ช่วยเรื่อง cache/prefetch เวลาวิ่งต่อเนื่อง
+// Small ใช้ COMPACT: header (memory_block_t) 32 B บนบล็อก 64 B คือ overhead ครึ่งหนึ่ง
 static const pool_config_t POOL_DEFAULTS[POOL_COUNT] = {
-    {"Small", SMALL_POOL_BLOCK_SIZE, SMALL_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, LED_SMALL_POOL},
-    {"Medium", MEDIUM_POOL_BLOCK_SIZE, MEDIUM_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, LED_MEDIUM_POOL},
-    {"Large", LARGE_POOL_BLOCK_SIZE, LARGE_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, LED_LARGE_POOL},
-    {"Huge", HUGE_POOL_BLOCK_SIZE, HUGE_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, LED_POOL_FULL},
+    {"Small", SMALL_POOL_BLOCK_SIZE, SMALL_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, LED_SMALL_POOL, POOL_ENGINE_LOCKFREE,
+     POOL_LAYOUT_COMPACT},
+    {"Medium", MEDIUM_POOL_BLOCK_SIZE, MEDIUM_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, LED_MEDIUM_POOL, POOL_ENGINE_LOCKFREE,
+     POOL_LAYOUT_HEADER},
+    {"Large", LARGE_POOL_BLOCK_SIZE, LARGE_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, LED_LARGE_POOL, POOL_ENGINE_BITMAP,
+     POOL_LAYOUT_HEADER},
+    {"Huge", HUGE_POOL_BLOCK_SIZE, HUGE_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, LED_POOL_FULL, POOL_ENGINE_LOCKED,
+     POOL_LAYOUT_HEADER},
 };
 
+// เปิด benchmark (ใช้เวลาหลายวินาที) ด้วย -DPOOL_BENCH_ENABLE=1
+#ifndef ALIGN_UP_POW2
+#define ALIGN_UP_POW2(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
+#endif
+
+#ifndef POOL_BENCH_ENABLE
+#define POOL_BENCH_ENABLE 0
+#endif
+
+// ============================
+//   Contiguous region + O(1) dispatch
+// ============================
+// ทุกพูลวางต่อกันใน region เดียว แต่ละพูลเริ่มที่ขอบ granule
+// → หา owner ของ pointer ได้ด้วย (ptr - base) >> SHIFT แทนการไล่ทุกพูล
+#define POOL_REGION_SHIFT 8 // granule 256 B
+static uint8_t *g_region_base = NULL;
+static size_t g_region_size = 0;
+static uint8_t *g_region_owner = NULL; // granule → pool index + 1 (0 = ไม่มีเจ้าของ)
+static int g_segments_outside_region = 0; // segment ที่ไม่อยู่ใน region (grow/resize) → ต้อง fallback
+
+// ============================
+//   Elastic grow/shrink
+// ============================
+#define POOL_ELASTIC_PERIOD_MS 1000 // รอบตรวจของ elastic task
+#define POOL_GROW_FAIL_DELTA 8      // failure ที่เพิ่มขึ้นตั้งแต่รอบก่อน → grow
+#define POOL_GROW_MIN_BLOCKS 4
+#define POOL_SHRINK_LOW_PCT 25      // ใช้งานต่ำกว่านี้ (% ของทั้งพูล) ...
+#define POOL_SHRINK_LOW_ROUNDS 10   // ... ติดกันกี่รอบจึงคืน segment
+static TaskHandle_t g_elastic_task = NULL;
+
+// ceil(log2(need)) → พูลแรกที่อาจรับได้ (สร้างตอน init จาก block_size จริง)
+static uint8_t g_class_by_log2[33];
+
 // ============================
-//    Persistence (NVS) config
+//    Persistence (write-behind) config
 // ============================
 #define NVS_NS "mem_pools"
-#define SAVE_INTERVAL_MS 30000ULL // อัตโนมัติทุก ~30s หากมีการเปลี่ยนแปลง
-static nvs_handle_t g_nvs = 0;
-static bool g_nvs_ready = false;
-static uint64_t g_last_saved_stamp = 0;
-static uint32_t g_dirty_epoch = 1; // เพิ่มเมื่อ stats เปลี่ยน เพื่อ trigger save
+#ifndef PERSIST_BACKEND
+#define PERSIST_BACKEND PERSIST_BACKEND_NVS // PERSIST_BACKEND_RAM = ไม่แตะ flash (วัดจำนวน write/latency)
+#endif
+#define PERSIST_POLL_MS 1000      // รอบ snapshot/diff ของ persist task
+#define SAVE_INTERVAL_MS 30000ULL // autosave ห่างกันอย่างน้อยเท่านี้ (ถ้ามี key เปลี่ยน)
+#define PERSIST_FLUSH_MIN_MS 1000 // flush ตามคำขอห่างกันอย่างน้อยเท่านี้ (คำขอถี่ ๆ ถูกรวมเป็นครั้งเดียว)
+#ifndef PERSIST_MAX_GROWTH
+#define PERSIST_MAX_GROWTH 4 // จำนวนบล็อกตอนบูตสูงสุด = default × ค่านี้ (กันค่าใน store โตขึ้นเรื่อย ๆ)
+#endif
+
+// ค่าที่ commit ลง store ล่าสุด → เขียนเฉพาะ key ที่ต่างจากนี้
+typedef struct
+{
+    uint32_t blocks[POOL_COUNT];
+    uint32_t peak[POOL_COUNT];
+    uint64_t allocs[POOL_COUNT];
+    uint64_t frees[POOL_COUNT];
+    uint32_t fails[POOL_COUNT];
+} persist_blob_t;
+
+static persist_blob_t g_persist_last;
+static TaskHandle_t g_persist_task = NULL;
+static bool g_persist_flush_req = false;  // มีคำขอ flush ค้าง (set โดย pools_persist_save_now)
+static uint32_t g_persist_requests = 0;
 
 // ============================
 //       Helpers / inline
 // ============================
-static inline memory_block_t *data_to_block(void *data)
+// COMPACT: "บล็อก" คือ payload เอง → memory_block_t* ใช้ได้แค่ฟิลด์ next (offset 0) ตอนบล็อกว่าง
+static inline memory_block_t *data_to_block(const memory_pool_t *pool, void *data)
 {
-    return (memory_block_t *)((uint8_t *)data - sizeof(memory_block_t));
+    return (memory_block_t *)((uint8_t *)data - pool->hdr_size);
 }
-static inline void *block_to_data(memory_block_t *blk)
+static inline void *block_to_data(const memory_pool_t *pool, memory_block_t *blk)
 {
-    return (void *)((uint8_t *)blk + sizeof(memory_block_t));
+    return (void *)((uint8_t *)blk + pool->hdr_size);
 }
 
-static inline bool ptr_in_pool_range(const memory_pool_t *pool, const void *data_ptr)
+static inline size_t pool_layout_stride(size_t block_size, pool_layout_t layout)
 {
-    if (!pool || !pool->pool_memory || pool->block_count == 0 || !data_ptr)
-        return false;
+    if (layout == POOL_LAYOUT_COMPACT)
+        return ALIGN_UP_POW2(block_size, (size_t)POOL_COMPACT_ALIGN);
+    return sizeof(memory_block_t) + ALIGN_UP_POW2(block_size, (size_t)4);
+}
 
-    size_t header = sizeof(memory_block_t);
+static inline size_t pool_block_stride(const memory_pool_t *pool)
+{
     size_t aligned = (pool->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-    size_t total = header + aligned;
+    return pool->hdr_size + aligned;
+}
+
+// หา segment ที่บล็อกอยู่ + index ภายใน segment (NULL = ไม่ใช่บล็อกของพูลนี้)
+// เทียบแค่ address ไม่แตะหน่วยความจำของ segment → เรียกได้ขณะ elastic task คืน segment
+static inline pool_segment_t *pool_segment_of(memory_pool_t *pool, const memory_block_t *blk, size_t *out_idx)
+{
+    size_t stride = pool_block_stride(pool);
+    size_t n = __atomic_load_n(&pool->seg_count, __ATOMIC_ACQUIRE);
+    for (size_t s = 0; s < n; s++)
+    {
+        pool_segment_t *seg = &pool->segs[s];
+        const uint8_t *base = __atomic_load_n(&seg->mem, __ATOMIC_ACQUIRE);
+        if (!base || (const uint8_t *)blk < base)
+            continue;
+        size_t off = (size_t)((const uint8_t *)blk - base);
+        if (off < stride * seg->block_count && (off % stride) == 0)
+        {
+            if (out_idx)
+                *out_idx = off / stride;
+            return seg;
+        }
+    }
+    return NULL;
+}
+
+static inline bool ptr_in_pool_range(memory_pool_t *pool, const void *data_ptr)
+{
+    if (!pool || pool->block_count == 0 || !data_ptr)
+        return false;
+    return pool_segment_of(pool, (const memory_block_t *)((const uint8_t *)data_ptr - pool->hdr_size), NULL) != NULL;
+}
+
+// ---- LOCKFREE: บล็อก ↔ ref ของ free_list.top ----
+// segment ต้องเผยแพร่แล้ว ref 0 = ไม่มีบล็อก (NULL หรือไม่ใช่บล็อกของพูล)
+static inline uint32_t lf_ref(memory_pool_t *pool, const memory_block_t *blk)
+{
+    size_t idx;
+    pool_segment_t *seg = blk ? pool_segment_of(pool, blk, &idx) : NULL;
+    return seg ? (((uint32_t)(seg - pool->segs) << POOL_LF_SEG_SHIFT) | (uint32_t)idx) + 1 : 0;
+}
+
+// NULL = segment ถูก shrink ไปแล้ว (ref มาจาก top เก่า ผู้เรียกต้องโหลด top ใหม่)
+static inline memory_block_t *lf_block(memory_pool_t *pool, uint32_t ref)
+{
+    ref--;
+    const pool_segment_t *seg = &pool->segs[ref >> POOL_LF_SEG_SHIFT];
+    uint8_t *mem = __atomic_load_n(&seg->mem, __ATOMIC_ACQUIRE);
+    return mem ? (memory_block_t *)(mem + (ref & POOL_LF_MAX_SEG_BLOCKS) * pool_block_stride(pool)) : NULL;
+}
+
+// ---- grace period ของ segment ที่ shrink (LOCKFREE/BITMAP) ----
+// ผู้อ่านที่ไม่ถือ lock (lf_pop, lf_pop_chain, bm_claim) นับตัวเองตลอดช่วงที่อาจ deref หน่วยความจำ segment
+// shrink ปลด mem (seq_cst) ก่อน แล้วค่อยคืนหน่วยความจำเมื่ออ่านตัวนับได้ 0: ผู้อ่านที่เข้ามาหลังปลดเห็น mem = NULL
+static inline void lf_reader_enter(memory_pool_t *pool)
+{
+    __atomic_fetch_add(&pool->lf_readers, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); // โหลด mem หลังจากนี้ต้องไม่ขึ้นไปก่อนการนับ
+}
+
+static inline void lf_reader_exit(memory_pool_t *pool)
+{
+    __atomic_fetch_sub(&pool->lf_readers, 1, __ATOMIC_RELEASE);
+}
+
+// ---- metadata ของบล็อก: header หรือ parallel array (COMPACT) ----
+static const uint32_t k_state_magic[4] = {0, POOL_MAGIC_FREE, POOL_MAGIC_ALLOC, POOL_MAGIC_CACHED};
+
+static inline uint8_t pool_state_of_magic(uint32_t magic)
+{
+    return magic == POOL_MAGIC_FREE ? POOL_STATE_FREE
+           : magic == POOL_MAGIC_ALLOC ? POOL_STATE_ALLOC
+           : magic == POOL_MAGIC_CACHED ? POOL_STATE_CACHED
+                                        : POOL_STATE_NONE;
+}
+
+// magic ของบล็อก (0 = ไม่ใช่บล็อกของพูลนี้/เสีย) — รวมการตรวจ pool_id ของ layout HEADER
+static inline uint32_t blk_magic(memory_pool_t *pool, memory_block_t *blk)
+{
+    if (pool->hdr_size)
+        return blk->pool_id == pool->pool_id ? __atomic_load_n(&blk->magic, __ATOMIC_ACQUIRE) : 0;
+    size_t idx;
+    pool_segment_t *seg = pool_segment_of(pool, blk, &idx);
+    return seg ? k_state_magic[__atomic_load_n(&seg->state[idx], __ATOMIC_ACQUIRE) & 3] : 0;
+}
+
+// CAS magic expect→desired; ล้มเหลว → *expect = magic ปัจจุบัน
+static inline bool blk_magic_cas(memory_pool_t *pool, memory_block_t *blk, uint32_t *expect, uint32_t desired)
+{
+    if (pool->hdr_size)
+    {
+        if (blk->pool_id != pool->pool_id)
+        {
+            *expect = 0;
+            return false;
+        }
+        return __atomic_compare_exchange_n(&blk->magic, expect, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    }
+    size_t idx;
+    pool_segment_t *seg = pool_segment_of(pool, blk, &idx);
+    if (!seg)
+    {
+        *expect = 0;
+        return false;
+    }
+    uint8_t want = pool_state_of_magic(*expect);
+    bool ok = __atomic_compare_exchange_n(&seg->state[idx], &want, pool_state_of_magic(desired), false,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    if (!ok)
+        *expect = k_state_magic[want & 3];
+    return ok;
+}
+
+// เปลี่ยน state ของบล็อกที่เราเป็นเจ้าของอยู่แล้ว + เวลาจอง + ล้าง size_used
+static inline void blk_set_state(memory_pool_t *pool, memory_block_t *blk, uint32_t magic, uint64_t now_us)
+{
+    if (pool->hdr_size)
+    {
+        blk->magic = magic;
+        blk->alloc_time = now_us;
+        blk->size_used = 0;
+        return;
+    }
+    size_t idx;
+    pool_segment_t *seg = pool_segment_of(pool, blk, &idx);
+    if (!seg)
+        return;
+    __atomic_store_n(&seg->state[idx], pool_state_of_magic(magic), __ATOMIC_RELEASE);
+    seg->size_used[idx] = 0;
+    if (seg->stamp_ms)
+        seg->stamp_ms[idx] = (uint32_t)(now_us / 1000ULL);
+}
+
+static inline size_t pool_get_size_used(memory_pool_t *pool, void *data)
+{
+    memory_block_t *blk = data_to_block(pool, data);
+    if (pool->hdr_size)
+        return blk->size_used;
+    size_t idx;
+    pool_segment_t *seg = pool_segment_of(pool, blk, &idx);
+    return seg ? seg->size_used[idx] : 0;
+}
+
+static inline void pool_set_size_used(memory_pool_t *pool, void *data, size_t size)
+{
+    memory_block_t *blk = data_to_block(pool, data);
+    if (pool->hdr_size)
+    {
+        blk->size_used = size;
+        return;
+    }
+    size_t idx;
+    pool_segment_t *seg = pool_segment_of(pool, blk, &idx);
+    if (seg)
+        seg->size_used[idx] = (uint16_t)size;
+}
+
+// ไบต์ metadata ต่อบล็อก (header + padding + parallel array) ใช้รายงานการประหยัด
+static size_t pool_overhead_per_block(size_t block_size, pool_layout_t layout)
+{
+    size_t ovh = pool_layout_stride(block_size, layout) - block_size;
+    if (layout == POOL_LAYOUT_COMPACT)
+        ovh += sizeof(uint8_t) + sizeof(uint16_t) + (POOL_COMPACT_STAMPS ? sizeof(uint32_t) : 0);
+    return ovh;
+}
+
+#define POOL_BM_WORDS(n) (((n) + 31) / 32)
+#define POOL_BM_HINT(seg, word) ((uint32_t)(((uint32_t)(seg) << 24) | (uint32_t)(word)))
 
-    const uint8_t *base = (const uint8_t *)pool->pool_memory;
-    const uint8_t *end = base + (total * pool->block_count);
-    const uint8_t *blkp = (const uint8_t *)data_ptr - header;
+// BITMAP: ขยับ hint ลงมาที่ word ที่เพิ่งมีบล็อกว่าง → การจองครั้งถัดไปได้ address ต่ำสุดเสมอ
+static inline void bm_hint_lower(memory_pool_t *pool, uint32_t hint)
+{
+    uint32_t cur = __atomic_load_n(&pool->bm_hint, __ATOMIC_RELAXED);
+    while (hint < cur &&
+           !__atomic_compare_exchange_n(&pool->bm_hint, &cur, hint, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
 
-    return (blkp >= base) && (blkp < end) && ((((size_t)(blkp - base)) % total) == 0);
+// ตั้ง/ล้างบิตใน usage bitmap ของ segment + นับ used (atomic: ใช้ได้ทุก engine)
+// BITMAP: การล้างบิตคือการคืนบล็อก จึงต้องเป็น release หลังเขียน header เสร็จ
+static inline void pool_mark_block(memory_pool_t *pool, memory_block_t *blk, bool used)
+{
+    size_t idx;
+    pool_segment_t *seg = pool_segment_of(pool, blk, &idx);
+    if (!seg)
+        return;
+    uint32_t bit = 1u << (idx & 31);
+    if (used)
+    {
+        __atomic_fetch_or(&seg->bitmap[idx >> 5], bit, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&seg->used, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_fetch_and(&seg->bitmap[idx >> 5], ~bit, __ATOMIC_RELEASE);
+        __atomic_fetch_sub(&seg->used, 1, __ATOMIC_RELAXED);
+        if (pool->engine == POOL_ENGINE_BITMAP)
+            bm_hint_lower(pool, POOL_BM_HINT(seg - pool->segs, idx >> 5));
+    }
 }
 
 // ============================
-//   NVS helpers (open/close)
+//   Stats: shard ต่อ core + seqlock ของ block_count
 // ============================
-static bool nvs_open_namespace(void)
+#define POOL_STAT_ADD(pool, field, n) \
+    __atomic_fetch_add(&(pool)->stats[xPortGetCoreID()].field, (n), __ATOMIC_RELAXED)
+
+// failure รวมทุก core (ใช้ตัดสินใจ grow ไม่ต้องตรงกับตัวนับอื่น)
+static uint32_t pool_fail_total(const memory_pool_t *pool)
 {
-    if (g_nvs_ready)
-        return true;
+    uint32_t sum = 0;
+    for (int c = 0; c < portNUM_PROCESSORS; c++)
+        sum += __atomic_load_n(&pool->stats[c].fails, __ATOMIC_RELAXED);
+    return sum;
+}
+
+// writer ถือ write lock อยู่แล้ว → ไม่มี writer ชนกัน
+static inline void pool_stats_write_begin(memory_pool_t *pool)
+{
+    __atomic_fetch_add(&pool->stats_seq, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+static inline void pool_stats_write_end(memory_pool_t *pool)
+{
+    __atomic_fetch_add(&pool->stats_seq, 1, __ATOMIC_RELEASE);
+}
+
+// write lock ของเส้นทาง alloc/free พร้อมบันทึกเวลารอ (รวมกรณี timeout)
+static bool pool_lock_timed(memory_pool_t *pool)
+{
+    uint64_t t0 = esp_timer_get_time();
+    bool ok = pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS));
+    pool_hist_record(&pool->lock_wait_hist, esp_timer_get_time() - t0);
+    return ok;
+}
 
-    esp_err_t err = nvs_flash_init();
-    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND)
+// ============================
+//   Pool core (init/malloc/free)
+// ============================
+static const char *pool_engine_name(pool_engine_t engine)
+{
+    switch (engine)
     {
-        ESP_LOGW(TAG, "NVS re-init required...");
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        err = nvs_flash_init();
+    case POOL_ENGINE_LOCKFREE:
+        return "lock-free";
+    case POOL_ENGINE_BITMAP:
+        return "bitmap";
+    default:
+        return "locked";
     }
-    if (err != ESP_OK)
+}
+
+static void pool_segment_release(pool_segment_t *seg)
+{
+    if (seg->mem && !seg->in_region)
+        heap_caps_free(seg->mem);
+    if (seg->bitmap)
+        heap_caps_free(seg->bitmap);
+    if (seg->state)
+        heap_caps_free(seg->state);
+    if (seg->size_used)
+        heap_caps_free(seg->size_used);
+    if (seg->stamp_ms)
+        heap_caps_free(seg->stamp_ms);
+    memset(seg, 0, sizeof(*seg));
+}
+
+// mem = ชิ้นใน region (NULL = จองจาก heap เอง)
+static bool pool_segment_alloc(const memory_pool_t *pool, pool_segment_t *seg, size_t count, void *mem)
+{
+    memset(seg, 0, sizeof(*seg));
+    if (pool->engine == POOL_ENGINE_LOCKFREE && count > POOL_LF_MAX_SEG_BLOCKS)
     {
-        ESP_LOGE(TAG, "NVS init failed: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "%s: %u blocks per segment exceeds lock-free limit %u", pool->name, (unsigned)count,
+                 (unsigned)POOL_LF_MAX_SEG_BLOCKS);
         return false;
     }
-    err = nvs_open(NVS_NS, NVS_READWRITE, &g_nvs);
-    if (err != ESP_OK)
+    seg->in_region = (mem != NULL);
+    seg->mem = mem ? (uint8_t *)mem
+                   : (uint8_t *)heap_caps_aligned_alloc(pool->alignment > 16 ? pool->alignment : 16,
+                                                        pool_block_stride(pool) * count,
+                                                        MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    seg->bitmap = (uint32_t *)heap_caps_calloc(POOL_BM_WORDS(count), sizeof(uint32_t), MALLOC_CAP_8BIT);
+    bool meta_ok = true;
+    if (pool->layout == POOL_LAYOUT_COMPACT)
+    {
+        seg->state = (uint8_t *)heap_caps_calloc(count, sizeof(uint8_t), MALLOC_CAP_8BIT);
+        seg->size_used = (uint16_t *)heap_caps_calloc(count, sizeof(uint16_t), MALLOC_CAP_8BIT);
+        seg->stamp_ms = POOL_COMPACT_STAMPS ? (uint32_t *)heap_caps_calloc(count, sizeof(uint32_t), MALLOC_CAP_8BIT) : NULL;
+        meta_ok = seg->state && seg->size_used && (seg->stamp_ms || !POOL_COMPACT_STAMPS);
+    }
+    if (!seg->mem || !seg->bitmap || !meta_ok)
     {
-        ESP_LOGE(TAG, "NVS open ns '%s' failed: %s", NVS_NS, esp_err_to_name(err));
+        pool_segment_release(seg);
         return false;
     }
-    g_nvs_ready = true;
+    seg->block_count = count;
+    if (count & 31) // บิตเกินท้าย = "ใช้อยู่" ตลอด → ctz ไม่มีวันเลือกบล็อกที่ไม่มีจริง
+        seg->bitmap[count >> 5] = ~((1u << (count & 31)) - 1u);
     return true;
 }
 
-static inline void nvs_mark_dirty(void) { g_dirty_epoch++; }
+// จัดบล็อกทั้ง segment เป็น chain ของบล็อก FREE → คืน head (+tail) เพื่อต่อเข้า free_list ครั้งเดียว
+static memory_block_t *pool_segment_format(const memory_pool_t *pool, pool_segment_t *seg, memory_block_t **out_tail)
+{
+    size_t stride = pool_block_stride(pool);
+    memory_block_t *head = NULL;
+    *out_tail = NULL;
+    for (size_t i = 0; i < seg->block_count; i++)
+    {
+        memory_block_t *blk = (memory_block_t *)(seg->mem + i * stride);
+        if (pool->hdr_size)
+        {
+            blk->magic = POOL_MAGIC_FREE;
+            blk->pool_id = pool->pool_id;
+            blk->alloc_time = 0;
+            blk->size_used = 0;
+        }
+        else
+        {
+            seg->state[i] = POOL_STATE_FREE; // segment ยังไม่ถูกเผยแพร่ → เขียนตรงได้
+        }
+        blk->next = head;
+        head = blk;
+        if (!*out_tail)
+            *out_tail = blk;
+    }
+    return head;
+}
 
-// ============================
-//   Pool core (init/malloc/free)
-// ============================
-static bool init_memory_pool(memory_pool_t *pool, const pool_config_t *cfg, uint32_t pool_id)
+// mem = ชิ้นที่แบ่งจาก region (NULL = จองเอง เช่นพูลชั่วคราวของ benchmark)
+static bool init_memory_pool(memory_pool_t *pool, const pool_config_t *cfg, uint32_t pool_id, void *mem)
 {
     memset(pool, 0, sizeof(*pool));
     pool->name = cfg->name;
     pool->block_size = cfg->block_size;
     pool->block_count = cfg->block_count;
-    pool->alignment = 4;
+    pool->layout = cfg->layout;
+    pool->alignment = (cfg->layout == POOL_LAYOUT_COMPACT) ? POOL_COMPACT_ALIGN : 4;
+    pool->hdr_size = (cfg->layout == POOL_LAYOUT_COMPACT) ? 0 : sizeof(memory_block_t);
     pool->caps = cfg->caps;
     pool->pool_id = pool_id;
-
-    size_t header = sizeof(memory_block_t);
-    size_t aligned = (cfg->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-    size_t total = header + aligned;
-    size_t bytes = total * cfg->block_count;
-
-    pool->pool_memory = heap_caps_aligned_alloc(16, bytes, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
-    if (!pool->pool_memory)
+    pool->engine = cfg->engine;
+    pool->activity_ch = -1;
+    // ให้ทุก task รวมกันถือบล็อกใน cache ได้ไม่เกินราว ๆ ครึ่งพูล
+    pool->mag_cap = cfg->block_count / POOL_CACHE_MAX_TASKS;
+    if (pool->mag_cap > POOL_CACHE_MAG_SIZE)
+        pool->mag_cap = POOL_CACHE_MAG_SIZE;
+    if (pool->mag_cap < 2)
+        pool->mag_cap = 0;
+
+    if (cfg->layout == POOL_LAYOUT_COMPACT && (cfg->block_size < sizeof(void *) || cfg->block_size > UINT16_MAX))
     {
-        ESP_LOGE(TAG, "Failed to alloc %s pool memory", cfg->name);
+        ESP_LOGE(TAG, "%s: block size %d not supported by compact layout", cfg->name, (int)cfg->block_size);
         return false;
     }
-
-    size_t bits = cfg->block_count;
-    size_t bbytes = (bits + 7) / 8;
-    pool->usage_bitmap = heap_caps_calloc(1, bbytes, MALLOC_CAP_8BIT);
-    if (!pool->usage_bitmap)
+    if (!pool_segment_alloc(pool, &pool->segs[0], cfg->block_count, mem))
     {
-        heap_caps_free(pool->pool_memory);
-        ESP_LOGE(TAG, "Failed to alloc %s bitmap", cfg->name);
+        ESP_LOGE(TAG, "Failed to alloc %s pool memory", cfg->name);
         return false;
     }
+    pool->seg_count = 1;
 
     // build free-list
-    uint8_t *p = (uint8_t *)pool->pool_memory;
-    for (size_t i = 0; i < cfg->block_count; i++)
-    {
-        memory_block_t *blk = (memory_block_t *)(p + i * total);
-        blk->magic = POOL_MAGIC_FREE;
-        blk->pool_id = pool->pool_id;
-        blk->alloc_time = 0;
-        blk->size_used = 0;
-        blk->next = pool->free_list;
-        pool->free_list = blk;
-    }
+    memory_block_t *tail;
+    memory_block_t *head = pool_segment_format(pool, &pool->segs[0], &tail);
+    if (pool->engine == POOL_ENGINE_LOCKED)
+        pool->free_list.head = head;
+    else if (pool->engine == POOL_ENGINE_LOCKFREE)
+        pool->free_list.top = lf_ref(pool, head); // BITMAP ไม่ใช้ free_list
 
     if (!pool_sync_init(&pool->sync))
     {
-        heap_caps_free(pool->pool_memory);
-        heap_caps_free(pool->usage_bitmap);
+        pool_segment_release(&pool->segs[0]);
         ESP_LOGE(TAG, "Failed to init sync for %s", cfg->name);
         return false;
     }
+    pool_sync_set_name(&pool->sync, pool->name);
 
-    ESP_LOGI(TAG, "✅ Initialized %s: %d blocks × %d bytes", cfg->name, (int)cfg->block_count, (int)cfg->block_size);
+    ESP_LOGI(TAG, "✅ Initialized %s: %d blocks × %d bytes (%s%s)", cfg->name, (int)cfg->block_count, (int)cfg->block_size,
+             pool_engine_name(pool->engine), pool->layout == POOL_LAYOUT_COMPACT ? ", compact" : "");
     return true;
 }
 
-static void *pool_malloc(memory_pool_t *pool)
+// ============================
+//   Lock-free engine (Treiber)
+// ============================
+// top ใหม่ที่ชี้ไป nx: nx ที่ไม่ใช่บล็อกของพูล (COMPACT: payload ถูกผู้ใช้เขียนทับแล้ว) แปลว่า
+// บล็อกที่อ่าน next มาถูกคนอื่น pop ไปแล้ว → top เปลี่ยนแน่นอน คืน false ให้ผู้เรียกโหลด top ใหม่
+static inline bool lf_next_top(memory_pool_t *pool, uint32_t cur, const memory_block_t *nx, uint32_t *out)
 {
-    uint64_t t0 = esp_timer_get_time();
-    void *result = NULL;
+    uint32_t ref = lf_ref(pool, nx);
+    if (nx && !ref)
+        return false;
+    *out = ((LF_TAG(cur) + 1) << 16) | ref;
+    return true;
+}
 
-    if (pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+static memory_block_t *lf_pop(memory_pool_t *pool)
+{
+    lf_reader_enter(pool);
+    memory_block_t *got = NULL;
+    uint32_t cur = __atomic_load_n(&pool->free_list.top, __ATOMIC_ACQUIRE), nxt;
+    while (LF_REF(cur))
     {
-        if (pool->free_list)
+        // blk->next อาจถูกเขียนทับถ้าบล็อกถูกคนอื่นจองไปแล้ว แต่ tag จะทำให้ CAS ล้ม
+        memory_block_t *blk = lf_block(pool, LF_REF(cur));
+        if (!blk || !lf_next_top(pool, cur, __atomic_load_n(&blk->next, __ATOMIC_RELAXED), &nxt))
+        {
+            cur = __atomic_load_n(&pool->free_list.top, __ATOMIC_ACQUIRE);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&pool->free_list.top, &cur, nxt, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
         {
-            memory_block_t *blk = pool->free_list;
-            pool->free_list = blk->next;
+            got = blk;
+            break;
+        }
+    }
+    lf_reader_exit(pool);
+    return got;
+}
 
-            if (blk->magic != POOL_MAGIC_FREE || blk->pool_id != pool->pool_id)
-            {
-                ESP_LOGE(TAG, "🚨 Corruption in %s block %p", pool->name, (void *)blk);
-                gpio_set_level(LED_POOL_ERROR, 1);
-                pool_sync_write_unlock(&pool->sync);
-                return NULL;
-            }
+// push chain head..tail (เชื่อมกันด้วย next แล้ว) ด้วย CAS ครั้งเดียว
+static void lf_push_chain(memory_pool_t *pool, memory_block_t *head, memory_block_t *tail)
+{
+    uint32_t ref = lf_ref(pool, head);
+    uint32_t cur = __atomic_load_n(&pool->free_list.top, __ATOMIC_RELAXED), nxt;
+    do
+    {
+        __atomic_store_n(&tail->next, LF_REF(cur) ? lf_block(pool, LF_REF(cur)) : NULL, __ATOMIC_RELAXED);
+        nxt = ((LF_TAG(cur) + 1) << 16) | ref;
+    } while (!__atomic_compare_exchange_n(&pool->free_list.top, &cur, nxt, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
 
-            blk->magic = POOL_MAGIC_ALLOC;
-            blk->next = NULL;
-            blk->alloc_time = esp_timer_get_time();
-            blk->size_used = 0;
+static inline void lf_push(memory_pool_t *pool, memory_block_t *blk)
+{
+    lf_push_chain(pool, blk, blk);
+}
 
-            pool->allocated_blocks++;
-            if (pool->allocated_blocks > pool->peak_usage)
-                pool->peak_usage = pool->allocated_blocks;
-            pool->total_allocations++;
-            nvs_mark_dirty();
+// แจ้ง elastic task ทุก ๆ POOL_GROW_FAIL_DELTA failure (ไม่รอรอบตรวจ)
+static inline void pool_note_failure(uint32_t fails)
+{
+    if ((fails % POOL_GROW_FAIL_DELTA) == 0 && g_elastic_task)
+        xTaskNotifyGive(g_elastic_task);
+}
 
-            // mark bitmap
-            size_t header = sizeof(memory_block_t);
-            size_t aligned = (pool->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-            size_t total = header + aligned;
-            size_t idx = ((size_t)((uint8_t *)blk - (uint8_t *)pool->pool_memory)) / total;
-            if (idx < pool->block_count)
-                pool->usage_bitmap[idx >> 3] |= (1 << (idx & 7));
+static inline void lf_update_peak(memory_pool_t *pool, size_t used)
+{
+    size_t peak = __atomic_load_n(&pool->peak_usage, __ATOMIC_RELAXED);
+    while (used > peak &&
+           !__atomic_compare_exchange_n(&pool->peak_usage, &peak, used, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
 
-            result = block_to_data(blk);
-        }
-        else
+// ============================
+//   Bitmap engine (ctz scan)
+// ============================
+// สแกนจาก (s0, w0) ไปท้ายพูล: ~word → ctz ได้บิตว่างต่ำสุด แล้ว CAS ตั้งบิตเพื่อจอง
+static memory_block_t *bm_scan_from(memory_pool_t *pool, size_t s0, size_t w0)
+{
+    size_t stride = pool_block_stride(pool);
+    size_t nseg = __atomic_load_n(&pool->seg_count, __ATOMIC_ACQUIRE);
+    for (size_t s = s0; s < nseg; s++, w0 = 0)
+    {
+        pool_segment_t *seg = &pool->segs[s];
+        uint8_t *mem = __atomic_load_n(&seg->mem, __ATOMIC_ACQUIRE);
+        if (!mem)
+            continue;
+        size_t words = POOL_BM_WORDS(seg->block_count);
+        for (size_t w = w0; w < words; w++)
         {
-            pool->allocation_failures++;
-            nvs_mark_dirty();
-            gpio_set_level(LED_POOL_FULL, 1);
-            if ((pool->allocation_failures % 32) == 1)
+            uint32_t cur = __atomic_load_n(&seg->bitmap[w], __ATOMIC_RELAXED);
+            while (cur != UINT32_MAX)
             {
-                ESP_LOGW(TAG, "🔴 %s exhausted! (%d/%d)", pool->name, (int)pool->allocated_blocks, (int)pool->block_count);
+                uint32_t bit = (uint32_t)__builtin_ctz(~cur);
+                if (__atomic_compare_exchange_n(&seg->bitmap[w], &cur, cur | (1u << bit), true, __ATOMIC_ACQUIRE,
+                                                __ATOMIC_RELAXED))
+                {
+                    __atomic_fetch_add(&seg->used, 1, __ATOMIC_RELAXED);
+                    __atomic_store_n(&pool->bm_hint, POOL_BM_HINT(s, w), __ATOMIC_RELAXED);
+                    return (memory_block_t *)(mem + (w * 32 + bit) * stride);
+                }
             }
         }
-        pool_sync_write_unlock(&pool->sync);
     }
-
-    pool->allocation_time_total += (esp_timer_get_time() - t0);
-    return result;
+    return NULL;
 }
 
-static bool pool_free(memory_pool_t *pool, void *ptr)
+// จองบล็อกว่าง address ต่ำสุด: เริ่มที่ hint, ถ้าไม่เจอ (hint เก่าเพราะแข่งกัน) สแกนใหม่ทั้งพูล
+static memory_block_t *bm_claim(memory_pool_t *pool)
 {
-    if (!ptr_in_pool_range(pool, ptr))
-        return false;
+    lf_reader_enter(pool); // bm_scan_from อ่าน bitmap ของ segment ที่อาจกำลังถูก shrink
+    uint32_t hint = __atomic_load_n(&pool->bm_hint, __ATOMIC_RELAXED);
+    memory_block_t *blk = bm_scan_from(pool, hint >> 24, hint & 0xFFFFFF);
+    if (!blk && hint)
+        blk = bm_scan_from(pool, 0, 0);
+    lf_reader_exit(pool);
+    return blk;
+}
 
+// engine LOCKFREE และ BITMAP ใช้เส้นทางนี้ร่วมกัน (ต่างกันแค่วิธีหยิบ/คืนบล็อก)
+static void *pool_malloc_lockfree(memory_pool_t *pool)
+{
     uint64_t t0 = esp_timer_get_time();
-    bool ok = false;
+    void *result = NULL;
 
-    if (pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+    bool bm = pool->engine == POOL_ENGINE_BITMAP;
+    memory_block_t *blk = bm ? bm_claim(pool) : lf_pop(pool);
+    if (blk)
     {
-        memory_block_t *blk = data_to_block(ptr);
-
-        if (blk->magic != POOL_MAGIC_ALLOC || blk->pool_id != pool->pool_id)
+        if (blk_magic(pool, blk) != POOL_MAGIC_FREE)
         {
-            ESP_LOGE(TAG, "🚨 Invalid block %p for %s! magic=0x%08X pid=%lu",
-                     ptr, pool->name, blk->magic, (unsigned long)blk->pool_id);
+            // ไม่คืนบล็อกเสียกลับเข้า stack (เหมือน engine LOCKED)
+            ESP_LOGE(TAG, "🚨 Corruption in %s block %p", pool->name, (void *)blk);
             gpio_set_level(LED_POOL_ERROR, 1);
-            pool_sync_write_unlock(&pool->sync);
-            return false;
+            return NULL;
         }
 
-        size_t header = sizeof(memory_block_t);
-        size_t aligned = (pool->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-        size_t total = header + aligned;
-        size_t idx = ((size_t)((uint8_t *)blk - (uint8_t *)pool->pool_memory)) / total;
-        if (idx < pool->block_count)
-            pool->usage_bitmap[idx >> 3] &= ~(1 << (idx & 7));
+        blk->next = NULL;
+        blk_set_state(pool, blk, POOL_MAGIC_ALLOC, esp_timer_get_time());
 
-        blk->magic = POOL_MAGIC_FREE;
-        blk->size_used = 0;
-        blk->next = pool->free_list;
-        pool->free_list = blk;
+        size_t used = __atomic_add_fetch(&pool->allocated_blocks, 1, __ATOMIC_RELAXED);
+        lf_update_peak(pool, used);
+        POOL_STAT_ADD(pool, allocs, 1);
 
-        if (pool->allocated_blocks)
-            pool->allocated_blocks--;
-        pool->total_deallocations++;
-        nvs_mark_dirty();
-        ok = true;
+        if (!bm) // BITMAP ตั้งบิตไปแล้วตอน claim
+            pool_mark_block(pool, blk, true);
 
-        pool_sync_write_unlock(&pool->sync);
+        result = block_to_data(pool, blk);
     }
-
-    pool->deallocation_time_total += (esp_timer_get_time() - t0);
-    return ok;
-}
-
-// ============================
-//   Smart API (malloc/free)
-// ============================
-static void *smart_pool_malloc(size_t size)
-{
-    size_t need = size + 16; // safety margin
-    for (int i = 0; i < POOL_COUNT; i++)
+    else
     {
-        if (need <= pools[i].block_size)
+        uint32_t fails = POOL_STAT_ADD(pool, fails, 1) + 1;
+        pool_note_failure(fails);
+        gpio_set_level(LED_POOL_FULL, 1);
+        if ((fails % 32) == 1)
         {
-            void *p = pool_malloc(&pools[i]);
-            if (p)
-            {
-                memory_block_t *blk = data_to_block(p);
-                size_t cap = pools[i].block_size;
-                blk->size_used = (size <= cap) ? size : cap;
-
-                // pulse LED
-                gpio_set_level(((gpio_num_t)POOL_DEFAULTS[i].led_pin), 1);
-                vTaskDelay(1);
-                gpio_set_level(((gpio_num_t)POOL_DEFAULTS[i].led_pin), 0);
-                return p;
-            }
+            ESP_LOGW(TAG, "🔴 %s exhausted! (%d/%d)", pool->name, (int)pool->allocated_blocks, (int)pool->block_count);
         }
     }
-    return heap_caps_malloc(size, MALLOC_CAP_DEFAULT); // fallback heap
+
+    pool_hist_record(&pool->alloc_hist, esp_timer_get_time() - t0);
+    return result;
 }
 
-static bool smart_pool_free(void *ptr)
+static bool pool_free_lockfree(memory_pool_t *pool, void *ptr)
 {
-    if (!ptr)
-        return false;
-    for (int i = 0; i < POOL_COUNT; i++)
+    uint64_t t0 = esp_timer_get_time();
+    memory_block_t *blk = data_to_block(pool, ptr);
+
+    // CAS magic ALLOC→FREE: double free จากสอง task พร้อมกันจะมีแค่ตัวเดียวที่ผ่าน
+    uint32_t expect = POOL_MAGIC_ALLOC;
+    if (!blk_magic_cas(pool, blk, &expect, POOL_MAGIC_FREE))
     {
-        if (ptr_in_pool_range(&pools[i], ptr))
-            return pool_free(&pools[i], ptr);
+        ESP_LOGE(TAG, "🚨 Invalid block %p for %s! magic=0x%08X", ptr, pool->name, (unsigned)expect);
+        gpio_set_level(LED_POOL_ERROR, 1);
+        return false;
+    }
+
+    pool_mark_block(pool, blk, false); // BITMAP: ล้างบิต = คืนบล็อก
+    if (pool->engine != POOL_ENGINE_BITMAP)
+        lf_push(pool, blk);
+
+    __atomic_fetch_sub(&pool->allocated_blocks, 1, __ATOMIC_RELAXED);
+    POOL_STAT_ADD(pool, frees, 1);
+
+    pool_hist_record(&pool->free_hist, esp_timer_get_time() - t0);
+    return true;
+}
+
+#if POOL_BENCH_ENABLE
+// ใช้เฉพาะ benchmark (pool ของจริงอยู่ตลอดอายุโปรแกรม ไม่มีเส้นทาง teardown)
+static void deinit_memory_pool(memory_pool_t *pool)
+{
+    pool_sync_deinit(&pool->sync);
+    if (pool->retired_mem)
+        pool->segs[pool->retired_slot].mem = pool->retired_mem; // ไม่มีผู้ใช้แล้ว คืนพร้อมกัน
+    for (size_t s = 0; s < pool->seg_count; s++)
+        pool_segment_release(&pool->segs[s]);
+    memset(pool, 0, sizeof(*pool));
+}
+#endif
+
+// จอง region เดียวสำหรับทุกพูล + สร้าง page-to-pool map
+static bool pools_region_reserve(const size_t counts[POOL_COUNT], void *mem_out[POOL_COUNT])
+{
+    const size_t granule = (size_t)1 << POOL_REGION_SHIFT;
+    size_t offs[POOL_COUNT];
+    size_t total = 0;
+    for (int i = 0; i < POOL_COUNT; i++)
+    {
+        offs[i] = total; // granule 256 B ≥ POOL_COMPACT_ALIGN → payload ของ COMPACT ชิด cache line เสมอ
+        total += ALIGN_UP_POW2(pool_layout_stride(POOL_DEFAULTS[i].block_size, POOL_DEFAULTS[i].layout) * counts[i],
+                               granule);
+    }
+
+    g_region_base = (uint8_t *)heap_caps_aligned_alloc(granule, total, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    g_region_owner = (uint8_t *)heap_caps_calloc(1, total >> POOL_REGION_SHIFT, MALLOC_CAP_8BIT);
+    if (!g_region_base || !g_region_owner)
+    {
+        if (g_region_base)
+            heap_caps_free(g_region_base);
+        if (g_region_owner)
+            heap_caps_free(g_region_owner);
+        g_region_base = NULL;
+        g_region_owner = NULL;
+        ESP_LOGE(TAG, "Failed to reserve pool region (%u bytes)", (unsigned)total);
+        return false;
+    }
+    g_region_size = total;
+
+    for (int i = 0; i < POOL_COUNT; i++)
+    {
+        size_t end = (i + 1 < POOL_COUNT) ? offs[i + 1] : total;
+        memset(g_region_owner + (offs[i] >> POOL_REGION_SHIFT), i + 1, (end - offs[i]) >> POOL_REGION_SHIFT);
+        mem_out[i] = g_region_base + offs[i];
+    }
+    ESP_LOGI(TAG, "Pool region: %u bytes @%p, %u granules", (unsigned)total, (void *)g_region_base,
+             (unsigned)(total >> POOL_REGION_SHIFT));
+    return true;
+}
+
+static void pools_build_class_table(void)
+{
+    for (int k = 0; k <= 32; k++)
+    {
+        // need ที่เล็กที่สุดใน bucket k คือ 2^(k-1)+1
+        uint64_t lo = (k == 0) ? 1 : ((1ULL << (k - 1)) + 1);
+        int c = 0;
+        while (c < POOL_COUNT - 1 && pools[c].block_size < lo)
+            c++;
+        g_class_by_log2[k] = (uint8_t)c;
+    }
+}
+
+// size (รวม margin แล้ว) → index พูลแรกที่รับได้, -1 = ใหญ่เกินทุกพูล
+static inline int pool_class_for_need(size_t need)
+{
+    if (need > pools[POOL_COUNT - 1].block_size)
+        return -1;
+    unsigned k = (need <= 1) ? 0 : 32u - (unsigned)__builtin_clz((uint32_t)(need - 1));
+    int c = g_class_by_log2[k];
+    while (need > pools[c].block_size) // ขยับได้ไม่เกินจำนวนพูลใน bucket เดียวกัน
+        c++;
+    return c;
+}
+
+// pointer → index พูลเจ้าของ, -1 = ไม่ใช่ของพูล (มาจาก heap fallback)
+static inline int pool_owner_index(const void *ptr)
+{
+    size_t off = (size_t)((const uint8_t *)ptr - g_region_base);
+    if (g_region_base && (const uint8_t *)ptr >= g_region_base && off < g_region_size)
+    {
+        int pi = (int)g_region_owner[off >> POOL_REGION_SHIFT] - 1;
+        if (pi >= 0 && ptr_in_pool_range(&pools[pi], ptr))
+            return pi;
+    }
+    if (__atomic_load_n(&g_segments_outside_region, __ATOMIC_RELAXED))
+    {
+        for (int i = 0; i < POOL_COUNT; i++)
+            if (ptr_in_pool_range(&pools[i], ptr))
+                return i;
+    }
+    return -1;
+}
+
+static void *pool_malloc(memory_pool_t *pool)
+{
+    if (pool->engine != POOL_ENGINE_LOCKED)
+        return pool_malloc_lockfree(pool);
+    uint64_t t0 = esp_timer_get_time();
+    void *result = NULL;
+
+    if (pool_lock_timed(pool))
+    {
+        if (pool->free_list.head)
+        {
+            memory_block_t *blk = pool->free_list.head;
+            pool->free_list.head = blk->next;
+
+            if (blk_magic(pool, blk) != POOL_MAGIC_FREE)
+            {
+                ESP_LOGE(TAG, "🚨 Corruption in %s block %p", pool->name, (void *)blk);
+                gpio_set_level(LED_POOL_ERROR, 1);
+                pool_sync_write_unlock(&pool->sync);
+                return NULL;
+            }
+
+            blk->next = NULL;
+            blk_set_state(pool, blk, POOL_MAGIC_ALLOC, esp_timer_get_time());
+
+            pool->allocated_blocks++;
+            if (pool->allocated_blocks > pool->peak_usage)
+                pool->peak_usage = pool->allocated_blocks;
+            POOL_STAT_ADD(pool, allocs, 1);
+
+            // mark bitmap
+            pool_mark_block(pool, blk, true);
+
+            result = block_to_data(pool, blk);
+        }
+        else
+        {
+            uint32_t fails = POOL_STAT_ADD(pool, fails, 1) + 1;
+            pool_note_failure(fails);
+            gpio_set_level(LED_POOL_FULL, 1);
+            if ((fails % 32) == 1)
+            {
+                ESP_LOGW(TAG, "🔴 %s exhausted! (%d/%d)", pool->name, (int)pool->allocated_blocks, (int)pool->block_count);
+            }
+        }
+        pool_sync_write_unlock(&pool->sync);
+    }
+
+    pool_hist_record(&pool->alloc_hist, esp_timer_get_time() - t0);
+    return result;
+}
+
+static bool pool_free(memory_pool_t *pool, void *ptr)
+{
+    if (!ptr_in_pool_range(pool, ptr))
+        return false;
+    if (pool->engine != POOL_ENGINE_LOCKED)
+        return pool_free_lockfree(pool, ptr);
+
+    uint64_t t0 = esp_timer_get_time();
+    bool ok = false;
+
+    if (pool_lock_timed(pool))
+    {
+        memory_block_t *blk = data_to_block(pool, ptr);
+
+        // CAS แม้ถือ lock: pool_cache_free เปลี่ยน ALLOC→CACHED โดยไม่ถือ lock
+        uint32_t magic = POOL_MAGIC_ALLOC;
+        if (!blk_magic_cas(pool, blk, &magic, POOL_MAGIC_FREE))
+        {
+            ESP_LOGE(TAG, "🚨 Invalid block %p for %s! magic=0x%08X", ptr, pool->name, (unsigned)magic);
+            gpio_set_level(LED_POOL_ERROR, 1);
+            pool_sync_write_unlock(&pool->sync);
+            return false;
+        }
+
+        pool_mark_block(pool, blk, false);
+
+        blk_set_state(pool, blk, POOL_MAGIC_FREE, 0);
+        blk->next = pool->free_list.head;
+        pool->free_list.head = blk;
+
+        if (pool->allocated_blocks)
+            pool->allocated_blocks--;
+        POOL_STAT_ADD(pool, frees, 1);
+        ok = true;
+
+        pool_sync_write_unlock(&pool->sync);
+    }
+
+    pool_hist_record(&pool->free_hist, esp_timer_get_time() - t0);
+    return ok;
+}
+
+// ============================
+//   Batch take/put (magazine + bulk API)
+// ============================
+// pop สูงสุด n บล็อกด้วย CAS ครั้งเดียว: เดินตาม next จาก top แล้ว CAS top → บล็อกถัดจากตัวสุดท้าย
+// tag ไม่เปลี่ยน = ไม่มี pop/push ระหว่างที่เดิน chain จึงยังต่อกันตามที่อ่านได้
+// (อ่าน next ของบล็อกที่คนอื่นจองไปแล้วได้: segment ที่ shrink คืนหน่วยความจำหลังผู้อ่านทุกคนออกแล้วเท่านั้น)
+// COMPACT: next อยู่ใน payload ซึ่งผู้ใช้อาจเขียนทับแล้ว → ตรวจก่อน deref ถ้าไม่ใช่บล็อกของพูล
+// แปลว่า chain เปลี่ยนไปแล้ว (tag เปลี่ยนแน่นอน) หยุดเดินแล้วปล่อยให้ CAS ล้ม
+static memory_block_t *lf_pop_chain(memory_pool_t *pool, size_t n)
+{
+    lf_reader_enter(pool);
+    memory_block_t *got = NULL;
+    uint32_t cur = __atomic_load_n(&pool->free_list.top, __ATOMIC_ACQUIRE), nxt;
+    while (LF_REF(cur))
+    {
+        memory_block_t *first = lf_block(pool, LF_REF(cur));
+        if (!first)
+        {
+            cur = __atomic_load_n(&pool->free_list.top, __ATOMIC_ACQUIRE);
+            continue;
+        }
+        memory_block_t *last = first;
+        for (size_t k = 1; k < n; k++)
+        {
+            memory_block_t *nx = __atomic_load_n(&last->next, __ATOMIC_RELAXED);
+            if (!nx || !pool_segment_of(pool, nx, NULL))
+                break;
+            last = nx;
+        }
+        if (!lf_next_top(pool, cur, __atomic_load_n(&last->next, __ATOMIC_RELAXED), &nxt))
+        {
+            cur = __atomic_load_n(&pool->free_list.top, __ATOMIC_ACQUIRE);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&pool->free_list.top, &cur, nxt, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            last->next = NULL;
+            got = first;
+            break;
+        }
+    }
+    lf_reader_exit(pool);
+    return got;
+}
+
+// ดึงบล็อกว่างสูงสุด n ก้อนออกจาก free_list ในครั้งเดียว → magic = as_magic (CACHED/ALLOC)
+// allocated_blocks/peak นับทันที (บล็อกออกจาก depot แล้ว) ส่วนตัวนับใน shard ให้ผู้เรียกนับเอง
+static size_t pool_depot_take(memory_pool_t *pool, void **out, size_t n, uint32_t as_magic)
+{
+    if (n == 0)
+        return 0;
+    size_t got = 0;
+    bool locked = pool->engine == POOL_ENGINE_LOCKED;
+    bool bm = pool->engine == POOL_ENGINE_BITMAP;
+    memory_block_t *chain;
+    if (bm)
+    {
+        // ต่อ chain ชั่วคราวผ่าน next ตามลำดับที่ claim (address น้อย → มาก)
+        memory_block_t **link = &chain;
+        for (size_t k = 0; k < n; k++)
+        {
+            memory_block_t *blk = bm_claim(pool);
+            if (!blk)
+                break;
+            *link = blk;
+            link = &blk->next;
+        }
+        *link = NULL;
+    }
+    else if (locked)
+    {
+        if (!pool_lock_timed(pool))
+            return 0;
+        chain = pool->free_list.head;
+        if (chain)
+        {
+            memory_block_t *last = chain;
+            for (size_t k = 1; k < n && last->next; k++)
+                last = last->next;
+            pool->free_list.head = last->next;
+            last->next = NULL;
+        }
+    }
+    else
+    {
+        chain = lf_pop_chain(pool, n);
+    }
+
+    uint64_t now = esp_timer_get_time();
+    while (chain)
+    {
+        memory_block_t *blk = chain;
+        chain = blk->next;
+        if (blk_magic(pool, blk) != POOL_MAGIC_FREE)
+        {
+            ESP_LOGE(TAG, "🚨 Corruption in %s block %p", pool->name, (void *)blk);
+            gpio_set_level(LED_POOL_ERROR, 1);
+            continue;
+        }
+        blk->next = NULL;
+        blk_set_state(pool, blk, as_magic, now);
+
+        if (!bm)
+            pool_mark_block(pool, blk, true);
+        out[got++] = block_to_data(pool, blk);
+    }
+
+    if (got)
+    {
+        size_t used = __atomic_add_fetch(&pool->allocated_blocks, got, __ATOMIC_RELAXED);
+        lf_update_peak(pool, used);
+    }
+    if (locked)
+        pool_sync_write_unlock(&pool->sync);
+    return got;
+}
+
+// คืนบล็อก n ก้อน (magic ต้องเป็น from_magic) เข้า free_list ในครั้งเดียว *put_out = จำนวนที่รับคืนจริง
+// ต่อ chain ให้เสร็จก่อนแล้วค่อย splice/CAS ครั้งเดียว
+// คืน false = lock timeout: ยังไม่แตะบล็อกใดเลย ผู้เรียกยังถือทั้งชุดและต้องคืนเองภายหลัง (ห้ามทิ้ง)
+static bool pool_depot_put(memory_pool_t *pool, void *const *in, size_t n, uint32_t from_magic, size_t *put_out)
+{
+    bool locked = pool->engine == POOL_ENGINE_LOCKED;
+    *put_out = 0;
+    if (locked && !pool_lock_timed(pool))
+    {
+        ESP_LOGW(TAG, "⚠️ %s: depot lock timeout, %d blocks kept by caller", pool->name, (int)n);
+        return false;
+    }
+
+    memory_block_t *head = NULL, *tail = NULL;
+    size_t put = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        memory_block_t *blk = data_to_block(pool, in[i]);
+        // CAS magic: double free ในชุดเดียวกันหรือจาก task อื่นจะผ่านได้แค่ครั้งเดียว
+        uint32_t expect = from_magic;
+        if (!blk_magic_cas(pool, blk, &expect, POOL_MAGIC_FREE))
+        {
+            ESP_LOGE(TAG, "🚨 Invalid block %p for %s! magic=0x%08X", in[i], pool->name, (unsigned)expect);
+            gpio_set_level(LED_POOL_ERROR, 1);
+            continue;
+        }
+        pool_mark_block(pool, blk, false);
+        put++;
+        if (pool->engine == POOL_ENGINE_BITMAP)
+            continue; // ล้างบิตแล้ว = คืนแล้ว
+        blk->next = head;
+        head = blk;
+        if (!tail)
+            tail = blk;
+    }
+
+    if (put)
+        __atomic_fetch_sub(&pool->allocated_blocks, put, __ATOMIC_RELAXED);
+    if (head)
+    {
+        if (locked)
+        {
+            tail->next = pool->free_list.head;
+            pool->free_list.head = head;
+        }
+        else
+        {
+            lf_push_chain(pool, head, tail);
+        }
+    }
+    if (locked)
+        pool_sync_write_unlock(&pool->sync);
+    *put_out = put;
+    return true;
+}
+
+// ============================
+//   Bulk API (N บล็อกต่อการเรียก)
+// ============================
+// จองสูงสุด n บล็อก: lock/timestamp/stats ครั้งเดียวต่อชุด คืนจำนวนที่ได้ (< n = พูลไม่พอ)
+static size_t pool_malloc_bulk(memory_pool_t *pool, void **out, size_t n)
+{
+    uint64_t t0 = esp_timer_get_time();
+    size_t got = pool_depot_take(pool, out, n, POOL_MAGIC_ALLOC);
+    if (got)
+        POOL_STAT_ADD(pool, allocs, (uint32_t)got);
+    if (got < n)
+    {
+        uint32_t fails = POOL_STAT_ADD(pool, fails, 1) + 1;
+        pool_note_failure(fails);
+        gpio_set_level(LED_POOL_FULL, 1);
+    }
+    // bulk: บันทึกค่าเฉลี่ยต่อบล็อก ถ่วงด้วยจำนวนบล็อก (ชุดที่ว่างเปล่านับเป็นหนึ่งครั้ง)
+    uint64_t us = esp_timer_get_time() - t0;
+    pool_hist_record_n(&pool->alloc_hist, got ? us / got : us, got ? (uint32_t)got : 1);
+    return got;
+}
+
+// คืน n บล็อกของพูลนี้ในครั้งเดียว (มี pointer ที่ไม่ใช่ของพูล → ปฏิเสธทั้งชุด) คืนจำนวนที่คืนสำเร็จ
+static size_t pool_free_bulk(memory_pool_t *pool, void *const *ptrs, size_t n)
+{
+    uint64_t t0 = esp_timer_get_time();
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!ptr_in_pool_range(pool, ptrs[i]))
+        {
+            ESP_LOGE(TAG, "🚨 %s: bulk free of foreign pointer %p", pool->name, ptrs[i]);
+            return 0;
+        }
+    }
+    size_t put;
+    pool_depot_put(pool, ptrs, n, POOL_MAGIC_ALLOC, &put); // timeout → 0 ผู้เรียกยังถือทั้งชุด
+    if (put)
+    {
+        POOL_STAT_ADD(pool, frees, (uint32_t)put);
+        pool_hist_record_n(&pool->free_hist, (esp_timer_get_time() - t0) / put, (uint32_t)put);
+    }
+    return put;
+}
+
+// ============================
+//   Per-task magazine cache
+// ============================
+// fold ตัวนับของ magazine เข้า shard ตอนคืน slot เท่านั้น (hot path ไม่แตะ atomic)
+// ลำดับ: บวกเข้า shard ก่อนแล้วค่อยล้าง ผู้อ่านที่อ่าน shard ก่อน magazine จะไม่นับซ้ำ
+// ถ้าอ่านคร่อมจังหวะนี้จะขาดไปรอบหนึ่ง แล้วค่าไม่ตรงกับรอบถัดไป → snapshot ลองใหม่เอง
+static void pool_cache_fold_stats(memory_pool_t *pool, pool_magazine_t *m)
+{
+    if (m->allocs)
+        POOL_STAT_ADD(pool, mag_allocs, m->allocs);
+    if (m->frees)
+        POOL_STAT_ADD(pool, mag_frees, m->frees);
+    __atomic_store_n(&m->allocs, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&m->frees, 0, __ATOMIC_RELEASE);
+}
+
+// คืน false = บาง pool lock timeout: บล็อกของ pool นั้นยังค้างใน magazine ให้ลองใหม่รอบหน้า
+static bool pool_cache_flush_all(pool_task_cache_t *tc)
+{
+    bool all = true;
+    for (int i = 0; i < POOL_COUNT; i++)
+    {
+        pool_magazine_t *m = &tc->mags[i];
+        size_t put;
+        if (m->count && !pool_depot_put(&pools[i], m->blocks, m->count, POOL_MAGIC_CACHED, &put))
+        {
+            all = false;
+            continue;
+        }
+        if (m->count)
+            POOL_STAT_ADD(&pools[i], cache_drain, m->count);
+        m->count = 0;
+        pool_cache_fold_stats(&pools[i], m);
+    }
+    return all;
+}
+
+#if CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS
+// เรียกตอน task ถูกลบ (อาจอยู่ใน idle task) → ห้าม block จึงแค่ทำเครื่องหมายไว้ให้ monitor เก็บ
+static void pool_cache_tls_deleted(int index, void *pv)
+{
+    (void)index;
+    ((pool_task_cache_t *)pv)->orphaned = true;
+}
+#endif
+
+static pool_task_cache_t *pool_cache_self(void)
+{
+    pool_task_cache_t *tc = (pool_task_cache_t *)pvTaskGetThreadLocalStoragePointer(NULL, POOL_CACHE_TLS_INDEX);
+    if (tc)
+        return tc;
+
+    TaskHandle_t me = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < POOL_CACHE_MAX_TASKS; i++)
+    {
+        TaskHandle_t expect = NULL;
+        if (__atomic_load_n(&g_task_caches[i].owner, __ATOMIC_RELAXED) == NULL &&
+            __atomic_compare_exchange_n(&g_task_caches[i].owner, &expect, me, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            tc = &g_task_caches[i];
+            tc->orphaned = false;
+#if CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS
+            vTaskSetThreadLocalStoragePointerAndDelCallback(NULL, POOL_CACHE_TLS_INDEX, tc, pool_cache_tls_deleted);
+#else
+            vTaskSetThreadLocalStoragePointer(NULL, POOL_CACHE_TLS_INDEX, tc);
+#endif
+            return tc;
+        }
+    }
+    return NULL; // slot เต็ม → ใช้ depot ตรง
+}
+
+// task ที่กำลังจะจบควรเรียกก่อน vTaskDelete(NULL) เพื่อคืนบล็อกทันที
+static void pool_cache_task_exit(void)
+{
+    pool_task_cache_t *tc = (pool_task_cache_t *)pvTaskGetThreadLocalStoragePointer(NULL, POOL_CACHE_TLS_INDEX);
+    if (!tc)
+        return;
+    vTaskSetThreadLocalStoragePointer(NULL, POOL_CACHE_TLS_INDEX, NULL);
+    if (!pool_cache_flush_all(tc))
+    {
+        tc->orphaned = true; // คืนไม่หมด → ยก slot ให้ monitor เก็บต่อ (owner ยังค้างไว้กันคนอื่นจอง)
+        return;
+    }
+    __atomic_store_n(&tc->owner, NULL, __ATOMIC_RELEASE);
+}
+
+// monitor: คืนบล็อกของ task ที่ตายไปโดยไม่ได้เรียก pool_cache_task_exit
+static void pool_cache_reap_orphans(void)
+{
+    for (int i = 0; i < POOL_CACHE_MAX_TASKS; i++)
+    {
+        pool_task_cache_t *tc = &g_task_caches[i];
+        if (tc->orphaned && __atomic_load_n(&tc->owner, __ATOMIC_ACQUIRE))
+        {
+            if (!pool_cache_flush_all(tc))
+                continue; // lock timeout → รอบหน้า
+            tc->orphaned = false;
+            __atomic_store_n(&tc->owner, NULL, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static void *pool_cache_alloc(pool_task_cache_t *tc, int pi)
+{
+    memory_pool_t *pool = &pools[pi];
+    if (!pool->mag_cap)
+        return NULL;
+    pool_magazine_t *m = &tc->mags[pi];
+    if (m->count == 0)
+    {
+        size_t batch = pool->mag_cap / 2;
+        m->count = (uint32_t)pool_depot_take(pool, m->blocks, batch, POOL_MAGIC_CACHED);
+        if (m->count == 0)
+            return NULL;
+        POOL_STAT_ADD(pool, cache_fill, m->count);
+    }
+
+    void *p = m->blocks[--m->count];
+    memory_block_t *blk = data_to_block(pool, p);
+    if (blk_magic(pool, blk) != POOL_MAGIC_CACHED)
+    {
+        ESP_LOGE(TAG, "🚨 Corruption in %s cached block %p", pool->name, (void *)blk);
+        gpio_set_level(LED_POOL_ERROR, 1);
+        return NULL;
+    }
+    blk_set_state(pool, blk, POOL_MAGIC_ALLOC, esp_timer_get_time());
+    __atomic_store_n(&m->allocs, m->allocs + 1, __ATOMIC_RELAXED); // เจ้าของเขียนคนเดียว: แค่ store
+    return p;
+}
+
+static bool pool_cache_free(pool_task_cache_t *tc, int pi, void *ptr)
+{
+    memory_pool_t *pool = &pools[pi];
+    if (!pool->mag_cap)
+        return false;
+
+    pool_magazine_t *m = &tc->mags[pi];
+    if (m->count >= pool->mag_cap)
+    {
+        // flush ครึ่งล่าง (บล็อกที่ค้างนานสุด) คืน depot ในครั้งเดียว
+        // depot lock timeout → magazine ยังเต็ม ส่งบล็อกนี้ให้ pool_free ตามทางปกติ (ไม่ทิ้งของใน magazine)
+        size_t batch = pool->mag_cap / 2, put;
+        if (!pool_depot_put(pool, m->blocks, batch, POOL_MAGIC_CACHED, &put))
+            return false;
+        POOL_STAT_ADD(pool, cache_drain, (uint32_t)batch);
+        memmove(m->blocks, m->blocks + batch, (m->count - batch) * sizeof(void *));
+        m->count -= (uint32_t)batch;
+    }
+
+    // CAS ALLOC→CACHED: double free จากสอง task พร้อมกัน (หรือชน pool_free) ผ่านได้แค่ครั้งเดียว
+    memory_block_t *blk = data_to_block(pool, ptr);
+    uint32_t expect = POOL_MAGIC_ALLOC;
+    if (!blk_magic_cas(pool, blk, &expect, POOL_MAGIC_CACHED))
+    {
+        ESP_LOGE(TAG, "🚨 Invalid block %p for %s! magic=0x%08X", ptr, pool->name, (unsigned)expect);
+        gpio_set_level(LED_POOL_ERROR, 1);
+        return true; // จัดการแล้ว (ปฏิเสธ) ไม่ต้องส่งต่อให้ pool_free
+    }
+    blk_set_state(pool, blk, POOL_MAGIC_CACHED, 0); // เป็นเจ้าของแล้ว: ล้างเวลาจอง/size_used
+    m->blocks[m->count++] = ptr;
+    __atomic_store_n(&m->frees, m->frees + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+// ============================
+//   Smart API (malloc/free)
+// ============================
+static void *smart_pool_malloc(size_t size)
+{
+    size_t need = size + 16; // safety margin
+    int first = pool_class_for_need(need);
+    pool_task_cache_t *tc = (first >= 0) ? pool_cache_self() : NULL;
+    for (int i = (first >= 0) ? first : POOL_COUNT; i < POOL_COUNT; i++) // พูลถัดไปใช้เมื่อพูลแรกเต็มเท่านั้น
+    {
+        void *p = tc ? pool_cache_alloc(tc, i) : NULL;
+        if (!p)
+            p = pool_malloc(&pools[i]);
+        if (p)
+        {
+            size_t cap = pools[i].block_size;
+            pool_set_size_used(&pools[i], p, (size <= cap) ? size : cap);
+
+            pool_activity_post(pools[i].activity_ch); // PoolAct task เป็นคนกระพริบ LED
+            return p;
+        }
+    }
+    return heap_caps_malloc(size, MALLOC_CAP_DEFAULT); // fallback heap
+}
+
+static bool smart_pool_free(void *ptr)
+{
+    if (!ptr)
+        return false;
+    int i = pool_owner_index(ptr);
+    if (i >= 0)
+    {
+        pool_task_cache_t *tc = pool_cache_self();
+        if (tc && pool_cache_free(tc, i, ptr))
+            return true;
+        return pool_free(&pools[i], ptr);
     }
     heap_caps_free(ptr);
     return true;
 }
 
+// จอง n บัฟเฟอร์ขนาด size เป็นชุด: พูลตาม class ก่อน ล้นไปพูลถัดไป แล้วค่อย heap
+static size_t smart_pool_malloc_bulk(size_t size, void **out, size_t n)
+{
+    size_t got = 0;
+    int first = pool_class_for_need(size + 16);
+    for (int i = (first >= 0) ? first : POOL_COUNT; i < POOL_COUNT && got < n; i++)
+    {
+        size_t k = pool_malloc_bulk(&pools[i], out + got, n - got);
+        size_t used = (size <= pools[i].block_size) ? size : pools[i].block_size;
+        for (size_t j = 0; j < k; j++)
+            pool_set_size_used(&pools[i], out[got + j], used);
+        if (k)
+            pool_activity_post(pools[i].activity_ch);
+        got += k;
+    }
+    while (got < n)
+    {
+        void *p = heap_caps_malloc(size, MALLOC_CAP_DEFAULT); // fallback heap
+        if (!p)
+            break;
+        out[got++] = p;
+    }
+    return got;
+}
+
+// คืน pointer ชุดใหญ่: แยกตามพูลเจ้าของแล้วคืนทีละก้อนย่อยผ่าน pool_free_bulk
+#define SMART_BULK_FREE_CHUNK 32
+
+static void smart_pool_free_bulk(void *const *ptrs, size_t n)
+{
+    void *group[POOL_COUNT][SMART_BULK_FREE_CHUNK];
+    size_t cnt[POOL_COUNT] = {0};
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!ptrs[i])
+            continue;
+        int pi = pool_owner_index(ptrs[i]);
+        if (pi < 0)
+        {
+            heap_caps_free(ptrs[i]);
+            continue;
+        }
+        group[pi][cnt[pi]++] = ptrs[i];
+        if (cnt[pi] == SMART_BULK_FREE_CHUNK)
+        {
+            pool_free_bulk(&pools[pi], group[pi], cnt[pi]);
+            cnt[pi] = 0;
+        }
+    }
+    for (int pi = 0; pi < POOL_COUNT; pi++)
+        if (cnt[pi])
+            pool_free_bulk(&pools[pi], group[pi], cnt[pi]);
+}
+
 // ============================
 //        (Optional) Migration
 // ============================
@@ -392,178 +1567,644 @@ static void *pool_realloc_smart(void *old_ptr, size_t new_size)
         return NULL;
     }
 
-    memory_pool_t *owner = NULL;
-    for (int i = 0; i < POOL_COUNT; i++)
+    int oi = pool_owner_index(old_ptr);
+    memory_pool_t *owner = (oi >= 0) ? &pools[oi] : NULL;
+    if (!owner)
+    {
+        void *np = smart_pool_malloc(new_size);
+        if (!np)
+            return NULL;
+        memcpy(np, old_ptr, new_size); // ผู้เรียกควรรู้ขนาดเดิม
+        heap_caps_free(old_ptr);
+        return np;
+    }
+
+    size_t need = new_size + 16;
+    if (need <= owner->block_size)
+    {
+        pool_set_size_used(owner, old_ptr, new_size);
+        return old_ptr;
+    }
+
+    void *np = smart_pool_malloc(new_size);
+    if (!np)
+        return NULL;
+    size_t old_used = pool_get_size_used(owner, old_ptr);
+    if (!old_used)
+        old_used = owner->block_size;
+    memcpy(np, old_ptr, (new_size < old_used) ? new_size : old_used);
+    smart_pool_free(old_ptr);
+    int ni = pool_owner_index(np); // np อาจมาจาก heap fallback ซึ่งไม่มี metadata
+    if (ni >= 0)
+        pool_set_size_used(&pools[ni], np, new_size);
+    return np;
+}
+
+// ============================
+//     Resize (boot-time safe)
+// ============================
+static bool resize_pool_boot(memory_pool_t *pool, size_t new_count)
+{
+    // เรียกตอนบูตเท่านั้น (ยังไม่มี allocation และยังไม่มี segment ที่ grow เพิ่ม)
+    if (!pool || new_count == 0)
+        return false;
+    if (pool->allocated_blocks != 0 || pool->seg_count != 1)
+    {
+        ESP_LOGW(TAG, "resize_pool_boot(%s): busy", pool->name);
+        return false;
+    }
+
+    pool_segment_t seg;
+    if (!pool_segment_alloc(pool, &seg, new_count, NULL))
+    {
+        ESP_LOGE(TAG, "resize_pool_boot(%s): alloc fail", pool->name);
+        return false;
+    }
+
+    // free list ใหม่
+    memory_block_t *tail;
+    memory_block_t *new_free = pool_segment_format(pool, &seg, &tail);
+
+    // ทิ้งของเก่า (ชิ้นใน region คืนแยกไม่ได้ → ปลด owner map แล้วปล่อยว่างไว้)
+    if (pool->segs[0].in_region && g_region_owner)
+    {
+        for (size_t g = 0; g < (g_region_size >> POOL_REGION_SHIFT); g++)
+            if (g_region_owner[g] == (uint8_t)(pool - pools) + 1)
+                g_region_owner[g] = 0;
+        g_segments_outside_region++;
+    }
+    pool_segment_release(&pool->segs[0]);
+
+    pool->segs[0] = seg;
+    pool->free_list.head = (pool->engine == POOL_ENGINE_LOCKED) ? new_free : NULL;
+    pool->free_list.top = (pool->engine == POOL_ENGINE_LOCKFREE)
+                              ? ((LF_TAG(pool->free_list.top) + 1) << 16) | lf_ref(pool, new_free)
+                              : 0;
+    pool->bm_hint = 0;
+    pool_stats_write_begin(pool);
+    pool->block_count = new_count;
+    pool->allocated_blocks = 0;
+    pool->peak_usage = 0;
+    pool_stats_write_end(pool);
+
+    ESP_LOGI(TAG, "Boot-resized %s → %d blocks", pool->name, (int)new_count);
+    return true;
+}
+
+// ============================
+//   Elastic grow/shrink (runtime)
+// ============================
+// เพิ่ม segment ใหม่ให้พูล: จอง+จัดบล็อกนอก lock แล้วค่อยเผยแพร่ภายใต้ write lock
+static bool pool_grow(memory_pool_t *pool, size_t nblocks)
+{
+    int slot = -1;
+    for (int s = 1; s < POOL_MAX_SEGMENTS; s++)
+    {
+        if (!pool->segs[s].mem && !pool->segs[s].bitmap) // bitmap ค้าง = slot ที่รอคืน (retired)
+        {
+            slot = s;
+            break;
+        }
+    }
+    if (slot < 0)
+        return false;
+
+    pool_segment_t seg;
+    if (!pool_segment_alloc(pool, &seg, nblocks, NULL))
+        return false;
+    memory_block_t *tail;
+    memory_block_t *head = pool_segment_format(pool, &seg, &tail);
+
+    if (!pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+    {
+        pool_segment_release(&seg);
+        return false;
+    }
+    // ต้องเห็น segment (mem) ก่อนบล็อกจะถูก pop ไปใช้ → free ของบล็อกนั้นหา segment เจอเสมอ
+    pool_segment_t *dst = &pool->segs[slot];
+    dst->bitmap = seg.bitmap;
+    dst->state = seg.state;
+    dst->size_used = seg.size_used;
+    dst->stamp_ms = seg.stamp_ms;
+    dst->block_count = seg.block_count;
+    dst->used = 0;
+    dst->in_region = false;
+    // นับก่อน publish: BITMAP จองบล็อกได้ทันทีที่เห็น mem และ pool_owner_index ต้องสแกน segment นอก region แล้ว
+    __atomic_fetch_add(&g_segments_outside_region, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&dst->mem, seg.mem, __ATOMIC_RELEASE);
+    if ((size_t)slot + 1 > pool->seg_count)
+        __atomic_store_n(&pool->seg_count, (size_t)slot + 1, __ATOMIC_RELEASE);
+    pool_stats_write_begin(pool);
+    __atomic_fetch_add(&pool->block_count, nblocks, __ATOMIC_RELAXED);
+    pool_stats_write_end(pool);
+
+    if (pool->engine == POOL_ENGINE_LOCKFREE)
+    {
+        lf_push_chain(pool, head, tail);
+    }
+    else if (pool->engine == POOL_ENGINE_LOCKED)
+    {
+        tail->next = pool->free_list.head;
+        pool->free_list.head = head;
+    }
+    // BITMAP: bitmap ของ segment ใหม่เป็นศูนย์อยู่แล้ว สแกนเจอเองหลังเห็น mem
+    pool_sync_write_unlock(&pool->sync);
+    return true;
+}
+
+// คืนหน่วยความจำของ segment ที่ shrink ถอดไว้ เมื่อไม่มีผู้อ่านที่ไม่ถือ lock ค้างอยู่ (false = ยังไม่พ้น grace)
+// ผู้เรียกมีคนเดียว (elastic task) หลังจากนี้ slot ว่างจริงจึง grow ใช้ซ้ำได้
+static bool pool_reclaim_retired(memory_pool_t *pool)
+{
+    if (!pool->retired_mem)
+        return true;
+    if (__atomic_load_n(&pool->lf_readers, __ATOMIC_SEQ_CST) != 0)
+        return false;
+    pool_segment_t *slot = &pool->segs[pool->retired_slot];
+    pool_segment_t old = *slot;
+    old.mem = pool->retired_mem;
+    slot->block_count = 0;
+    slot->bitmap = NULL;
+    slot->state = NULL;
+    slot->size_used = NULL;
+    slot->stamp_ms = NULL;
+    pool->retired_mem = NULL;
+    pool_segment_release(&old);
+    return true;
+}
+
+// LOCKFREE: ถอดทั้ง stack มาแยกบล็อกของ victim ออก (ระหว่างนี้ผู้จองเห็นพูลว่างชั่วครู่ → ไปพูลถัดไป/heap)
+// บล็อกของ victim ต้องอยู่ครบ ถ้าขาดแปลว่ามีคน pop ไปแล้วแต่ยังไม่ได้ตั้ง used → คืนทุกบล็อกแล้วเลิก
+static bool lf_detach_segment(memory_pool_t *pool, const pool_segment_t *victim)
+{
+    uint32_t cur = __atomic_load_n(&pool->free_list.top, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&pool->free_list.top, &cur, (LF_TAG(cur) + 1) << 16, true, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED))
+    {
+    }
+
+    // chain ที่ถอดมาเป็นของเราคนเดียว (pop/push ใหม่ทำกับ top ที่ว่างแล้ว)
+    const uint8_t *lo = victim->mem;
+    const uint8_t *hi = lo + pool_block_stride(pool) * victim->block_count;
+    memory_block_t *chain = LF_REF(cur) ? lf_block(pool, LF_REF(cur)) : NULL;
+    memory_block_t *keep = NULL, *keep_tail = NULL, *gone = NULL, *gone_tail = NULL;
+    size_t ngone = 0;
+    while (chain)
+    {
+        memory_block_t *blk = chain;
+        chain = blk->next;
+        bool in_victim = (const uint8_t *)blk >= lo && (const uint8_t *)blk < hi;
+        memory_block_t **head = in_victim ? &gone : &keep;
+        memory_block_t **tail = in_victim ? &gone_tail : &keep_tail;
+        blk->next = *head;
+        *head = blk;
+        if (!*tail)
+            *tail = blk;
+        ngone += in_victim;
+    }
+
+    bool ok = ngone == victim->block_count;
+    if (!ok && gone)
+    {
+        gone_tail->next = keep;
+        keep = gone;
+        if (!keep_tail)
+            keep_tail = gone_tail;
+    }
+    if (keep)
+        lf_push_chain(pool, keep, keep_tail);
+    return ok;
+}
+
+// BITMAP: CAS ทุก word ของ victim จาก "ว่างทั้ง word" → เต็ม หลังจากนี้ bm_scan_from จองอะไรใน victim ไม่ได้อีก
+// word ไหน CAS ล้ม = มีคนเพิ่ง claim → คืน word ที่ตั้งไปแล้ว (ยังไม่มีใครแตะได้เพราะบิตเต็ม) แล้วเลิก
+static bool bm_detach_segment(memory_pool_t *pool, pool_segment_t *victim)
+{
+    size_t words = POOL_BM_WORDS(victim->block_count);
+    uint32_t pad = (victim->block_count & 31) ? ~((1u << (victim->block_count & 31)) - 1u) : 0;
+    for (size_t w = 0; w < words; w++)
+    {
+        uint32_t expect = (w == words - 1) ? pad : 0;
+        if (!__atomic_compare_exchange_n(&victim->bitmap[w], &expect, UINT32_MAX, false, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_RELAXED))
+        {
+            while (w--)
+                __atomic_store_n(&victim->bitmap[w], 0, __ATOMIC_RELEASE); // word ก่อนหน้าไม่ใช่ word สุดท้าย
+            bm_hint_lower(pool, POOL_BM_HINT(victim - pool->segs, 0));
+            return false;
+        }
+    }
+    return true;
+}
+
+// คืน segment ที่เพิ่มตอนรันไทม์ซึ่งว่างทั้งก้อน (segs[0] ไม่คืน) ทีละก้อน
+// LOCKED: ถอดบล็อกออกจาก free_list ใต้ lock แล้ว free ทันที
+// LOCKFREE/BITMAP: ถอดบล็อกทั้งหมดของ victim จากผู้จองที่ไม่ถือ lock ก่อน (lf_/bm_detach_segment) แล้วปลด mem
+// หน่วยความจำคืนเมื่อพ้น grace ของ lf_readers (ทันที หรือรอบ elastic ถัดไปถ้ายังมีผู้อ่านค้าง)
+static bool pool_shrink_one(memory_pool_t *pool)
+{
+    if (!pool_reclaim_retired(pool))
+        return false; // ก้อนก่อนยังรอคืนอยู่
+    if (!pool_sync_write_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+        return false;
+
+    pool_segment_t *victim = NULL;
+    for (size_t s = pool->seg_count; s-- > 1;)
     {
-        if (ptr_in_pool_range(&pools[i], old_ptr))
+        if (pool->segs[s].mem && __atomic_load_n(&pool->segs[s].used, __ATOMIC_ACQUIRE) == 0)
         {
-            owner = &pools[i];
+            victim = &pool->segs[s];
             break;
         }
     }
-    if (!owner)
+    bool ok = victim != NULL;
+    if (ok && pool->engine == POOL_ENGINE_LOCKFREE)
     {
-        void *np = smart_pool_malloc(new_size);
-        if (!np)
-            return NULL;
-        memcpy(np, old_ptr, new_size); // ผู้เรียกควรรู้ขนาดเดิม
-        heap_caps_free(old_ptr);
-        return np;
+        ok = lf_detach_segment(pool, victim);
+    }
+    else if (ok && pool->engine == POOL_ENGINE_BITMAP)
+    {
+        ok = bm_detach_segment(pool, victim);
+    }
+    else if (ok)
+    {
+        // ถอดบล็อกของ victim ออกจาก free_list (ทุกบล็อกต้องอยู่ในนั้นเพราะ used == 0)
+        const uint8_t *lo = victim->mem;
+        const uint8_t *hi = lo + pool_block_stride(pool) * victim->block_count;
+        memory_block_t **pp = &pool->free_list.head;
+        while (*pp)
+        {
+            const uint8_t *b = (const uint8_t *)*pp;
+            if (b >= lo && b < hi)
+                *pp = (*pp)->next;
+            else
+                pp = &(*pp)->next;
+        }
+    }
+    if (!ok)
+    {
+        pool_sync_write_unlock(&pool->sync);
+        return false;
     }
 
-    size_t need = new_size + 16;
-    if (need <= owner->block_size)
+    pool_segment_t old = *victim;
+    __atomic_store_n(&victim->mem, NULL, __ATOMIC_SEQ_CST); // คู่กับ lf_reader_enter
+    if (pool->engine == POOL_ENGINE_LOCKED)
     {
-        data_to_block(old_ptr)->size_used = new_size;
-        return old_ptr;
+        victim->block_count = 0;
+        victim->bitmap = NULL;
+        victim->state = NULL;
+        victim->size_used = NULL;
+        victim->stamp_ms = NULL;
+    }
+    else
+    {
+        // ผู้อ่านที่เห็น mem ก่อนปลดอาจยังอ่าน block_count/bitmap ของ slot อยู่ → เก็บไว้จนพ้น grace
+        pool->retired_mem = old.mem;
+        pool->retired_slot = (uint8_t)(victim - pool->segs);
     }
+    pool_stats_write_begin(pool);
+    pool->block_count -= old.block_count;
+    pool_stats_write_end(pool);
+    __atomic_fetch_sub(&g_segments_outside_region, 1, __ATOMIC_RELAXED);
+    pool_sync_write_unlock(&pool->sync);
+
+    if (pool->engine == POOL_ENGINE_LOCKED)
+        pool_segment_release(&old);
+    else
+        pool_reclaim_retired(pool); // ส่วนใหญ่ไม่มีผู้อ่านค้าง คืนได้ทันที
+    return true;
+}
 
-    void *np = smart_pool_malloc(new_size);
-    if (!np)
-        return NULL;
-    size_t old_used = data_to_block(old_ptr)->size_used ? data_to_block(old_ptr)->size_used : owner->block_size;
-    memcpy(np, old_ptr, (new_size < old_used) ? new_size : old_used);
-    smart_pool_free(old_ptr);
-    data_to_block(np)->size_used = new_size;
-    return np;
+static size_t pool_active_segments(const memory_pool_t *pool)
+{
+    size_t n = 0;
+    for (size_t s = 0; s < pool->seg_count; s++)
+        if (pool->segs[s].mem)
+            n++;
+    return n;
+}
+
+// grow เมื่อ failure เพิ่มขึ้นเร็ว, shrink เมื่อใช้งานต่ำต่อเนื่อง
+// ตื่นทุก POOL_ELASTIC_PERIOD_MS หรือทันทีเมื่อ allocator แจ้งผ่าน task notification
+static void pool_elastic_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(POOL_ELASTIC_PERIOD_MS));
+
+        for (int i = 0; i < POOL_COUNT; i++)
+        {
+            memory_pool_t *pool = &pools[i];
+            pool_reclaim_retired(pool);
+            uint32_t fails = pool_fail_total(pool);
+            if (fails - pool->grow_fail_mark >= POOL_GROW_FAIL_DELTA)
+            {
+                // เลื่อน mark แม้ grow ไม่สำเร็จ (slot เต็ม/heap ไม่พอ) กันการลองซ้ำรัว ๆ
+                pool->grow_fail_mark = fails;
+                pool->low_usage_rounds = 0;
+                size_t step = pool->segs[0].block_count / 2;
+                if (step < POOL_GROW_MIN_BLOCKS)
+                    step = POOL_GROW_MIN_BLOCKS;
+                if (pool_grow(pool, step))
+                    ESP_LOGI(TAG, "ELASTIC | %s grew +%d blocks → %d (segs=%d)", pool->name, (int)step,
+                             (int)pool->block_count, (int)pool_active_segments(pool));
+                continue;
+            }
+
+            size_t in_use = __atomic_load_n(&pool->allocated_blocks, __ATOMIC_RELAXED);
+            if (pool_active_segments(pool) > 1 && in_use * 100 < pool->block_count * POOL_SHRINK_LOW_PCT)
+            {
+                if (++pool->low_usage_rounds >= POOL_SHRINK_LOW_ROUNDS)
+                {
+                    pool->low_usage_rounds = 0;
+                    if (pool_shrink_one(pool))
+                        ESP_LOGI(TAG, "ELASTIC | %s shrank → %d blocks (segs=%d)", pool->name,
+                                 (int)pool->block_count, (int)pool_active_segments(pool));
+                }
+            }
+            else
+            {
+                pool->low_usage_rounds = 0;
+            }
+        }
+    }
 }
 
 // ============================
-//     Resize (boot-time safe)
+//   Stats snapshot (ไม่ถือ lock, ไม่ block)
 // ============================
-static bool resize_pool_boot(memory_pool_t *pool, size_t new_count)
+#ifndef POOL_STATS_SNAPSHOT_TRIES
+#define POOL_STATS_SNAPSHOT_TRIES 8 // รอบเก็บสูงสุดก่อนยอมคืนค่าที่อาจคลาดเล็กน้อย
+#endif
+
+// ค่าดิบหนึ่งรอบ (ทุกช่องนับเพิ่มอย่างเดียว ยกเว้น block_count ที่มี stats_seq คุม)
+// ผลรวมเป็น mod 2^32: ผลต่าง (in_use, cached) ยังถูกแม้ตัวนับวนรอบ
+typedef struct
 {
-    // เรียกตอนบูตเท่านั้น (ยังไม่มี allocation)
-    if (!pool || new_count == 0)
-        return false;
-    if (pool->allocated_blocks != 0)
+    pool_stats_shard_t sum; // รวมทุก core
+    uint32_t live_allocs;   // magazine ที่ยังไม่ fold
+    uint32_t live_frees;
+    size_t peak_usage;
+    size_t block_count;
+    uint32_t seq;
+} pool_stats_raw_t;
+
+static void pool_stats_collect(const memory_pool_t *pool, int pi, pool_stats_raw_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->seq = __atomic_load_n(&pool->stats_seq, __ATOMIC_ACQUIRE);
+    r->block_count = __atomic_load_n(&pool->block_count, __ATOMIC_RELAXED);
+    r->peak_usage = __atomic_load_n(&pool->peak_usage, __ATOMIC_RELAXED);
+    for (int c = 0; c < portNUM_PROCESSORS; c++)
     {
-        ESP_LOGW(TAG, "resize_pool_boot(%s): busy", pool->name);
-        return false;
+        const pool_stats_shard_t *sh = &pool->stats[c];
+        r->sum.allocs += __atomic_load_n(&sh->allocs, __ATOMIC_RELAXED);
+        r->sum.frees += __atomic_load_n(&sh->frees, __ATOMIC_RELAXED);
+        r->sum.mag_allocs += __atomic_load_n(&sh->mag_allocs, __ATOMIC_RELAXED);
+        r->sum.mag_frees += __atomic_load_n(&sh->mag_frees, __ATOMIC_RELAXED);
+        r->sum.cache_fill += __atomic_load_n(&sh->cache_fill, __ATOMIC_RELAXED);
+        r->sum.cache_drain += __atomic_load_n(&sh->cache_drain, __ATOMIC_RELAXED);
+        r->sum.fails += __atomic_load_n(&sh->fails, __ATOMIC_RELAXED);
     }
-
-    size_t header = sizeof(memory_block_t);
-    size_t aligned = (pool->block_size + pool->alignment - 1) & ~(pool->alignment - 1);
-    size_t total = header + aligned;
-    size_t bytes = total * new_count;
-
-    void *new_mem = heap_caps_aligned_alloc(16, bytes, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
-    size_t bits = new_count;
-    size_t bbytes = (bits + 7) / 8;
-    uint8_t *bitmap = (uint8_t *)heap_caps_calloc(1, bbytes, MALLOC_CAP_8BIT);
-    if (!new_mem || !bitmap)
-    {
-        if (new_mem)
-            heap_caps_free(new_mem);
-        if (bitmap)
-            heap_caps_free(bitmap);
-        ESP_LOGE(TAG, "resize_pool_boot(%s): alloc fail", pool->name);
-        return false;
+    // shard ก่อน magazine (คู่กับลำดับใน pool_cache_fold_stats)
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    for (int i = 0; i < POOL_CACHE_MAX_TASKS; i++)
+    {
+        const pool_magazine_t *m = &g_task_caches[i].mags[pi];
+        r->live_allocs += __atomic_load_n(&m->allocs, __ATOMIC_ACQUIRE);
+        r->live_frees += __atomic_load_n(&m->frees, __ATOMIC_ACQUIRE);
     }
+}
 
-    // free list ใหม่
-    memory_block_t *new_free = NULL;
-    uint8_t *p = (uint8_t *)new_mem;
-    for (size_t i = 0; i < new_count; i++)
-    {
-        memory_block_t *blk = (memory_block_t *)(p + i * total);
-        blk->magic = POOL_MAGIC_FREE;
-        blk->pool_id = pool->pool_id;
-        blk->alloc_time = 0;
-        blk->size_used = 0;
-        blk->next = new_free;
-        new_free = blk;
+static portMUX_TYPE s_stats_wide_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ขยายตัวนับ 32 บิตเป็นยอด 64 บิต: บวกเฉพาะส่วนที่เพิ่มจากครั้งก่อน (mod 2^32)
+// ค่าที่ถอยหลัง (อ่านคร่อม fold ของ magazine) ไม่นับ รอบหน้าค่อยตามทัน
+// ต้องมี snapshot อย่างน้อยหนึ่งครั้งต่อ 2^31 event (monitor เรียกทุกไม่กี่วินาที)
+static uint64_t pool_stats_widen(memory_pool_t *pool, int which, uint32_t now)
+{
+    portENTER_CRITICAL(&s_stats_wide_mux);
+    int32_t delta = (int32_t)(now - pool->wide_seen[which]);
+    if (delta > 0)
+    {
+        pool->wide_total[which] += (uint32_t)delta;
+        pool->wide_seen[which] = now;
     }
+    uint64_t total = pool->wide_total[which];
+    portEXIT_CRITICAL(&s_stats_wide_mux);
+    return total;
+}
 
-    // ทิ้งของเก่า
-    if (pool->pool_memory)
-        heap_caps_free(pool->pool_memory);
-    if (pool->usage_bitmap)
-        heap_caps_free(pool->usage_bitmap);
+// อ่านสถิติของ pool โดยไม่ให้ allocator รอ: เก็บสองรอบติดกัน ถ้าเท่ากันทุกช่อง (และ seq คู่)
+// แปลว่าไม่มีการเปลี่ยนคร่อม → เป็นภาพ ณ ขณะหนึ่งจริง (สองรอบห่างกันไม่กี่ us ตัวนับวนครบ 2^32 ไม่ทัน)
+// ไม่ block/ไม่ delay เรียกจาก task ใดก็ได้ (ไม่ใช่ ISR: widen ใช้ critical section ของ task)
+// คืน false = writer แทรกทุกรอบ ค่าใน out ยังใช้ได้แต่อาจคลาดกันเล็กน้อย
+bool pool_stats_snapshot(int pool_index, pool_stats_t *out)
+{
+    if (pool_index < 0 || pool_index >= POOL_COUNT || !out)
+        return false;
+    memory_pool_t *pool = &pools[pool_index];
 
-    pool->pool_memory = new_mem;
-    pool->usage_bitmap = bitmap;
-    pool->free_list = new_free;
-    pool->block_count = new_count;
-    pool->allocated_blocks = 0;
-    pool->peak_usage = 0;
+    pool_stats_raw_t a, b;
+    bool stable = false;
+    pool_stats_collect(pool, pool_index, &a);
+    for (int tries = 0; tries < POOL_STATS_SNAPSHOT_TRIES && !stable; tries++)
+    {
+        pool_stats_collect(pool, pool_index, &b);
+        stable = !(b.seq & 1) && memcmp(&a, &b, sizeof(a)) == 0;
+        a = b;
+    }
 
-    ESP_LOGI(TAG, "Boot-resized %s → %d blocks", pool->name, (int)new_count);
-    return true;
+    uint32_t allocs = a.sum.allocs + a.sum.mag_allocs + a.live_allocs;
+    uint32_t frees = a.sum.frees + a.sum.mag_frees + a.live_frees;
+    uint32_t cached = (a.sum.cache_fill - a.sum.cache_drain) - (a.sum.mag_allocs + a.live_allocs) +
+                      (a.sum.mag_frees + a.live_frees);
+    out->block_count = a.block_count;
+    out->in_use = (size_t)(allocs - frees);
+    out->cached = (size_t)cached;
+    out->peak_usage = a.peak_usage;
+    out->allocations = pool_stats_widen(pool, 0, allocs);
+    out->deallocations = pool_stats_widen(pool, 1, frees);
+    out->failures = a.sum.fails;
+    return stable;
 }
 
 // ============================
-//   Persistence: SAVE / LOAD
+//   Persistence: snapshot → diff → write-behind
 // ============================
-static esp_err_t pools_persist_load_counts_from_nvs(size_t out_counts[POOL_COUNT])
+// จำนวนบล็อกตอนบูตจาก peak: ไม่ต่ำกว่า default ไม่เกิน default × PERSIST_MAX_GROWTH
+// (และไม่เกินที่ segment เดียวของ LOCKFREE รับได้)
+static uint32_t persist_boot_blocks(int pi, uint32_t want)
 {
-    if (!nvs_open_namespace())
-        return ESP_FAIL;
+    uint32_t lo = (uint32_t)POOL_DEFAULTS[pi].block_count;
+    uint32_t hi = lo * PERSIST_MAX_GROWTH;
+    if (POOL_DEFAULTS[pi].engine == POOL_ENGINE_LOCKFREE && hi > POOL_LF_MAX_SEG_BLOCKS)
+        hi = POOL_LF_MAX_SEG_BLOCKS;
+    return want < lo ? lo : want > hi ? hi : want;
+}
 
+static void persist_snapshot(persist_blob_t *b)
+{
     for (int i = 0; i < POOL_COUNT; i++)
     {
-        char key[32];
-        snprintf(key, sizeof(key), "%s_blocks", POOL_DEFAULTS[i].name); // "Small_blocks" ...
-        uint32_t val = 0;
-        esp_err_t err = nvs_get_u32(g_nvs, key, &val);
-        if (err == ESP_OK && val > 0)
+        pool_stats_t v;
+        pool_stats_snapshot(i, &v);
+        // ใช้ peak ไม่ใช่ block_count: block_count รวม segment ที่ grow แล้วไม่เคย shrink
+        // ถ้าเก็บค่านั้น segment ฐานรอบหน้าจะเท่าขนาดสูงสุดที่เคยโตถึงและโตต่อได้ทุกบูต
+        b->blocks[i] = persist_boot_blocks(i, (uint32_t)v.peak_usage);
+        b->peak[i] = (uint32_t)v.peak_usage;
+        b->allocs[i] = v.allocations;
+        b->frees[i] = v.deallocations;
+        b->fails[i] = v.failures;
+    }
+}
+
+static void persist_key(char *key, size_t len, int pi, const char *suffix)
+{
+    snprintf(key, len, "%s_%s", POOL_DEFAULTS[pi].name, suffix); // "Small_blocks" ...
+}
+
+// เขียนเฉพาะ key ที่ต่างจาก last แล้ว commit ครั้งเดียว คืนจำนวน key ที่เขียน (-1 = ล้มเหลว)
+static int persist_write_diff(const persist_blob_t *cur, const persist_blob_t *last)
+{
+    int n = 0;
+    esp_err_t err = ESP_OK;
+    char key[32];
+    for (int i = 0; i < POOL_COUNT; i++)
+    {
+        if (cur->blocks[i] != last->blocks[i] && err == ESP_OK)
         {
-            out_counts[i] = val;
+            persist_key(key, sizeof(key), i, "blocks");
+            err = persist_store_set_u32(key, cur->blocks[i]);
+            n++;
         }
-        else
+        if (cur->peak[i] != last->peak[i] && err == ESP_OK)
+        {
+            persist_key(key, sizeof(key), i, "peak");
+            err = persist_store_set_u32(key, cur->peak[i]);
+            n++;
+        }
+        if (cur->allocs[i] != last->allocs[i] && err == ESP_OK)
+        {
+            persist_key(key, sizeof(key), i, "alloc");
+            err = persist_store_set_u64(key, cur->allocs[i]);
+            n++;
+        }
+        if (cur->frees[i] != last->frees[i] && err == ESP_OK)
+        {
+            persist_key(key, sizeof(key), i, "freec");
+            err = persist_store_set_u64(key, cur->frees[i]);
+            n++;
+        }
+        if (cur->fails[i] != last->fails[i] && err == ESP_OK)
         {
-            out_counts[i] = POOL_DEFAULTS[i].block_count; // default
+            persist_key(key, sizeof(key), i, "fail");
+            err = persist_store_set_u32(key, cur->fails[i]);
+            n++;
         }
     }
-    return ESP_OK;
+    if (n == 0)
+        return 0;
+    if (err == ESP_OK)
+        err = persist_store_commit();
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "PERSIST | commit failed: %s (retry next round)", esp_err_to_name(err));
+        return -1;
+    }
+    return n;
 }
 
-static esp_err_t pools_persist_save_counts_to_nvs(void)
+// โหลด block_count สำหรับบูต + ค่าที่เคย commit ไว้ (ใช้เป็นฐานของ diff)
+static esp_err_t pools_persist_load_counts(size_t out_counts[POOL_COUNT])
 {
-    if (!nvs_open_namespace())
-        return ESP_FAIL;
-
+    bool ok = persist_store_open(PERSIST_BACKEND, NVS_NS);
     for (int i = 0; i < POOL_COUNT; i++)
     {
         char key[32];
-        snprintf(key, sizeof(key), "%s_blocks", pools[i].name);
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(g_nvs, key, (uint32_t)pools[i].block_count));
+        uint32_t v32 = 0;
+        uint64_t v64 = 0;
+        out_counts[i] = POOL_DEFAULTS[i].block_count; // default
+        if (!ok)
+            continue;
+
+        persist_key(key, sizeof(key), i, "blocks");
+        if (persist_store_get_u32(key, &v32) == ESP_OK && v32 > 0)
+        {
+            out_counts[i] = persist_boot_blocks(i, v32); // ค่าเก่าก่อนมี clamp อาจใหญ่เกิน
+            g_persist_last.blocks[i] = v32;
+        }
+        persist_key(key, sizeof(key), i, "peak");
+        if (persist_store_get_u32(key, &v32) == ESP_OK)
+            g_persist_last.peak[i] = v32;
+        persist_key(key, sizeof(key), i, "alloc");
+        if (persist_store_get_u64(key, &v64) == ESP_OK)
+            g_persist_last.allocs[i] = v64;
+        persist_key(key, sizeof(key), i, "freec");
+        if (persist_store_get_u64(key, &v64) == ESP_OK)
+            g_persist_last.frees[i] = v64;
+        persist_key(key, sizeof(key), i, "fail");
+        if (persist_store_get_u32(key, &v32) == ESP_OK)
+            g_persist_last.fails[i] = v32;
     }
-    return nvs_commit(g_nvs);
+    return ok ? ESP_OK : ESP_FAIL;
 }
 
-static esp_err_t pools_persist_save_stats_to_nvs(void)
+// หนึ่งรอบของ persist task ที่เวลา now_ms (แยกจากลูปเพื่อให้ host test ขับเวลาเองได้)
+// - ถ้าต่างและห่างจาก commit ล่าสุด >= SAVE_INTERVAL_MS → เขียน
+// - คำขอ flush: เขียนทันทีถ้าห่างจากครั้งก่อน >= PERSIST_FLUSH_MIN_MS ไม่งั้นรอจนครบ (คำขอที่มาระหว่างนั้นรวมเป็นครั้งเดียว)
+// คืนเวลา (ms) ที่ควรรอก่อนรอบถัดไป
+static uint32_t pool_persist_step(uint64_t now_ms, uint64_t *last_commit_ms)
 {
-    if (!nvs_open_namespace())
-        return ESP_FAIL;
-
-    for (int i = 0; i < POOL_COUNT; i++)
+    uint64_t since = now_ms - *last_commit_ms;
+    bool flush = __atomic_load_n(&g_persist_flush_req, __ATOMIC_ACQUIRE);
+    if (flush && since < PERSIST_FLUSH_MIN_MS)
+        return (uint32_t)(PERSIST_FLUSH_MIN_MS - since); // ยังเร็วไป → ตื่นอีกทีตอนครบกำหนด
+    if (!flush && since < SAVE_INTERVAL_MS)
+        return PERSIST_POLL_MS;
+
+    __atomic_store_n(&g_persist_flush_req, false, __ATOMIC_RELAXED);
+    persist_blob_t cur;
+    persist_snapshot(&cur);
+    int n = persist_write_diff(&cur, &g_persist_last);
+    if (n < 0)
+    {
+        if (flush)
+            __atomic_store_n(&g_persist_flush_req, true, __ATOMIC_RELAXED);
+        *last_commit_ms = now_ms; // ถอยไปหนึ่งช่วงก่อนลองใหม่ ไม่กระหน่ำ flash ที่มีปัญหา
+        return PERSIST_POLL_MS;
+    }
+    if (n > 0)
     {
-        char k1[32], k2[32], k3[32], k4[32];
-        snprintf(k1, sizeof(k1), "%s_peak", pools[i].name);
-        snprintf(k2, sizeof(k2), "%s_alloc", pools[i].name);
-        snprintf(k3, sizeof(k3), "%s_freec", pools[i].name);
-        snprintf(k4, sizeof(k4), "%s_fail", pools[i].name);
+        g_persist_last = cur;
+        *last_commit_ms = now_ms;
+        ESP_LOGI(TAG, "PERSIST | committed %d key(s)%s", n, flush ? " (flush)" : "");
+    }
+    return PERSIST_POLL_MS;
+}
+
+// Persist task: งานเขียน flash ทั้งหมดอยู่ที่นี่ hot path ไม่ต้องรู้เรื่อง persistence เลย
+// ตื่นทุก PERSIST_POLL_MS หรือเมื่อมีคำขอ flush แล้วให้ pool_persist_step ตัดสิน
+static void pool_persist_task(void *arg)
+{
+    uint64_t last_commit_ms = esp_timer_get_time() / 1000ULL;
+    uint32_t wait_ms = PERSIST_POLL_MS;
 
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(g_nvs, k1, (uint32_t)pools[i].peak_usage));
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u64(g_nvs, k2, pools[i].total_allocations));
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u64(g_nvs, k3, pools[i].total_deallocations));
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(g_nvs, k4, pools[i].allocation_failures));
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+        wait_ms = pool_persist_step(esp_timer_get_time() / 1000ULL, &last_commit_ms);
     }
-    return nvs_commit(g_nvs);
 }
 
-// Public: on-demand save (เรียกจากที่ไหนก็ได้)
+// Public: ขอ flush (ไม่บล็อก เรียกจากที่ไหนก็ได้) — persist task เป็นคนเขียนจริง
 void pools_persist_save_now(void)
 {
-    if (!g_nvs_ready && !nvs_open_namespace())
-        return;
-
-    ESP_LOGI(TAG, "MON | Persist: saving counts+stats to NVS...");
-    ESP_ERROR_CHECK_WITHOUT_ABORT(pools_persist_save_counts_to_nvs());
-    ESP_ERROR_CHECK_WITHOUT_ABORT(pools_persist_save_stats_to_nvs());
-    g_last_saved_stamp = esp_timer_get_time() / 1000ULL;
-    ESP_LOGI(TAG, "MON | Persist: done");
+    __atomic_store_n(&g_persist_flush_req, true, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&g_persist_requests, 1, __ATOMIC_RELAXED);
+    if (g_persist_task)
+        xTaskNotifyGive(g_persist_task);
 }
 
 // ============================
@@ -575,31 +2216,58 @@ static void print_pool_statistics(void)
     for (int i = 0; i < POOL_COUNT; i++)
     {
         memory_pool_t *pool = &pools[i];
-        if (pool_sync_stats_lock(&pool->sync, pdMS_TO_TICKS(SYNC_TIMEOUT_MS)))
+        // peak เป็นมุมมองของ depot (รวมบล็อกที่ค้างใน magazine)
+        pool_stats_t st;
+        bool stable = pool_stats_snapshot(i, &st);
+        ESP_LOGI(TAG, "%-6s | used %2d/%-2d  segs=%d  cached=%-2d  peak=%-2d  alloc=%llu  free=%llu  fail=%lu%s",
+                 pool->name, (int)st.in_use, (int)st.block_count, (int)pool_active_segments(pool), (int)st.cached,
+                 (int)st.peak_usage, (unsigned long long)st.allocations, (unsigned long long)st.deallocations,
+                 (unsigned long)st.failures, stable ? "" : "  ~");
+    }
+
+    // overhead ต่อบล็อกเทียบกับ layout HEADER (header + padding ของ alignment 4)
+    for (int i = 0; i < POOL_COUNT; i++)
+    {
+        const memory_pool_t *pool = &pools[i];
+        size_t ovh = pool_overhead_per_block(pool->block_size, pool->layout);
+        size_t ovh_hdr = pool_overhead_per_block(pool->block_size, POOL_LAYOUT_HEADER);
+        long saved = ((long)ovh_hdr - (long)ovh) * (long)pool->block_count;
+        ESP_LOGI(TAG, "%-6s | layout=%-7s overhead %2d B/blk (%2d%%)  saved %ld B vs header",
+                 pool->name, pool->layout == POOL_LAYOUT_COMPACT ? "compact" : "header", (int)ovh,
+                 (int)(ovh * 100 / (pool->block_size + ovh)), saved);
+    }
+
+    // latency (us) จาก histogram: snapshot ได้โดยไม่หยุด allocator
+    static pool_hist_snap_t snap; // ใหญ่เกินจะวางบน stack ของ monitor (ผู้เรียกมีทีละตัว)
+    static const char *const kinds[] = {"alloc", "free", "lockwait"};
+    for (int i = 0; i < POOL_COUNT; i++)
+    {
+        const pool_hist_t *h[] = {&pools[i].alloc_hist, &pools[i].free_hist, &pools[i].lock_wait_hist};
+        for (int k = 0; k < 3; k++)
         {
-            int used = (int)pool->allocated_blocks;
-            int tot = (int)pool->block_count;
-            ESP_LOGI(TAG, "%-6s | used %2d/%-2d  peak=%-2d  alloc=%llu  free=%llu  fail=%lu",
-                     pool->name, used, tot, (int)pool->peak_usage,
-                     (unsigned long long)pool->total_allocations,
-                     (unsigned long long)pool->total_deallocations,
-                     (unsigned long)pool->allocation_failures);
-            pool_sync_stats_unlock(&pool->sync);
+            pool_hist_snapshot(h[k], &snap);
+            if (snap.count == 0)
+                continue;
+            char line[96];
+            pool_hist_format(&snap, line, sizeof(line));
+            ESP_LOGI(TAG, "%-6s | %-8s us %s  avg=%llu n=%lu", pools[i].name, kinds[k], line,
+                     (unsigned long long)(snap.sum / snap.count), (unsigned long)snap.count);
         }
     }
 }
 
-// Monitor task: แสดงผล + autosave NVS เป็นระยะเมื่อมี “dirty”
+// Monitor task: แสดงผล (การบันทึกย้ายไป pool_persist_task แล้ว)
 static void pool_monitor_task(void *arg)
 {
     ESP_LOGI(TAG, "MON | started");
-    uint32_t last_seen_epoch = g_dirty_epoch;
 
     while (1)
     {
         vTaskDelay(pdMS_TO_TICKS(5000));
 
+        pool_cache_reap_orphans();
         print_pool_statistics();
+        pool_sync_dump();
 
         // LED เตือน
         bool any_full = false;
@@ -613,15 +2281,13 @@ static void pool_monitor_task(void *arg)
         }
         gpio_set_level(LED_POOL_FULL, any_full ? 1 : 0);
 
-        // Autosave ถ้ามีสถิติเปลี่ยน หรือผ่านไปนานกว่า SAVE_INTERVAL_MS
-        uint64_t now_ms = esp_timer_get_time() / 1000ULL;
-        bool epoch_changed = (g_dirty_epoch != last_seen_epoch);
-        bool timed = (now_ms - g_last_saved_stamp) > SAVE_INTERVAL_MS;
-        if (epoch_changed || timed)
-        {
-            pools_persist_save_now();
-            last_seen_epoch = g_dirty_epoch;
-        }
+        persist_store_stats_t ps;
+        persist_store_get_stats(&ps);
+        ESP_LOGI(TAG, "PERSIST | req=%lu commits=%lu keys=%lu fail=%lu txn avg=%lluus max=%luus (%s)",
+                 (unsigned long)g_persist_requests, (unsigned long)ps.commits, (unsigned long)ps.key_writes,
+                 (unsigned long)ps.commit_failures,
+                 (unsigned long long)(ps.commits ? ps.txn_us_total / ps.commits : 0),
+                 (unsigned long)ps.txn_us_max, persist_store_backend_name());
     }
 }
 
@@ -630,20 +2296,383 @@ static void pool_monitor_task(void *arg)
 // ============================
 static void persistence_demo_task(void *arg)
 {
-    // ตัวอย่างการใช้งาน: จอง/คืน/ปรับขนาด แล้วปล่อยให้ monitor บันทึกลง NVS ให้อัตโนมัติ
+    // ตัวอย่างการใช้งาน: จอง/คืน/ปรับขนาด แล้วปล่อยให้ persist task บันทึกลง NVS ให้อัตโนมัติ
     void *p = smart_pool_malloc(120); // น่าจะได้ Medium
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
-    p = pool_realloc_smart(p, 1800); // ย้ายไป Large
+    p = pool_realloc_smart(p, 1800); // 1800 B เกิน Large (1 KB) → ย้ายไป Huge
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     smart_pool_free(p);
 
+    // จอง/คืนเป็นชุด (เช่น เตรียมบัฟเฟอร์ให้ทั้ง burst): ถือ lock/CAS ต่อชุดแทนต่อก้อน
+    void *burst[16];
+    size_t got = smart_pool_malloc_bulk(48, burst, 16);
+    ESP_LOGI(TAG, "Demo bulk: got %u/16 buffers of 48 B", (unsigned)got);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    smart_pool_free_bulk(burst, got);
+
     // บันทึก on-demand (สมมุติว่าเป็นการกดปุ่ม)
     pools_persist_save_now();
 
+    pool_cache_task_exit();
+    vTaskDelete(NULL);
+}
+
+// ============================
+//   Benchmark: locked vs lock-free
+// ============================
+#if POOL_BENCH_ENABLE
+#define BENCH_ITERS_PER_TASK 20000
+#define BENCH_MAX_TASKS 8
+
+typedef struct
+{
+    memory_pool_t *pool;
+    SemaphoreHandle_t start; // ประตูเริ่มพร้อมกัน
+    SemaphoreHandle_t done;
+} bench_ctx_t;
+
+static void bench_alloc_free_worker(void *arg)
+{
+    bench_ctx_t *ctx = (bench_ctx_t *)arg;
+    xSemaphoreTake(ctx->start, portMAX_DELAY);
+    for (int i = 0; i < BENCH_ITERS_PER_TASK; i++)
+    {
+        void *p = pool_malloc(ctx->pool);
+        if (p)
+            pool_free(ctx->pool, p);
+    }
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+// คืนค่า alloc+free ต่อวินาที (รวมทุก task)
+static uint32_t bench_alloc_free(pool_engine_t engine, int ntasks)
+{
+    pool_config_t cfg = {"Bench", SMALL_POOL_BLOCK_SIZE, SMALL_POOL_BLOCK_COUNT, MALLOC_CAP_DEFAULT, GPIO_NUM_NC, engine,
+                         POOL_LAYOUT_HEADER};
+    static memory_pool_t pool; // hist ใหญ่เกิน stack ของ bench task (init_memory_pool ล้างให้ทุกครั้ง)
+    if (!init_memory_pool(&pool, &cfg, 100 + (uint32_t)engine, NULL))
+        return 0;
+
+    bench_ctx_t ctx = {
+        .pool = &pool,
+        .start = xSemaphoreCreateCounting(BENCH_MAX_TASKS, 0),
+        .done = xSemaphoreCreateCounting(BENCH_MAX_TASKS, 0),
+    };
+    for (int i = 0; i < ntasks; i++)
+        xTaskCreate(bench_alloc_free_worker, "BenchW", 3072, &ctx, 5, NULL);
+
+    uint64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < ntasks; i++)
+        xSemaphoreGive(ctx.start);
+    for (int i = 0; i < ntasks; i++)
+        xSemaphoreTake(ctx.done, portMAX_DELAY);
+    uint64_t us = esp_timer_get_time() - t0;
+
+    vSemaphoreDelete(ctx.start);
+    vSemaphoreDelete(ctx.done);
+    deinit_memory_pool(&pool);
+
+    uint64_t ops = (uint64_t)ntasks * BENCH_ITERS_PER_TASK;
+    return us ? (uint32_t)(ops * 1000000ULL / us) : 0;
+}
+
+// ---- dispatch: ไล่ทุกพูล (แบบเดิม) vs region map / clz ----
+#define BENCH_DISPATCH_PTRS 32
+#define BENCH_DISPATCH_ROUNDS 2000
+
+static int bench_owner_linear(const void *ptr)
+{
+    for (int i = 0; i < POOL_COUNT; i++)
+        if (ptr_in_pool_range(&pools[i], ptr))
+            return i;
+    return -1;
+}
+
+static int bench_class_linear(size_t need)
+{
+    for (int i = 0; i < POOL_COUNT; i++)
+        if (need <= pools[i].block_size)
+            return i;
+    return -1;
+}
+
+static void bench_dispatch(void)
+{
+    // ชุด pointer ผสมทุกพูล + heap fallback (กรณีแย่สุดของการไล่แบบเดิม)
+    void *ptrs[BENCH_DISPATCH_PTRS] = {0};
+    size_t needs[BENCH_DISPATCH_PTRS];
+    for (int j = 0; j < BENCH_DISPATCH_PTRS; j++)
+    {
+        int pi = j % (POOL_COUNT + 1);
+        if (pi < POOL_COUNT)
+        {
+            ptrs[j] = pool_malloc(&pools[pi]);
+            needs[j] = pools[pi].block_size - 8;
+        }
+        else
+        {
+            ptrs[j] = heap_caps_malloc(32, MALLOC_CAP_DEFAULT);
+            needs[j] = 8000;
+        }
+    }
+
+    volatile int sink = 0;
+    uint64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_DISPATCH_ROUNDS; r++)
+        for (int j = 0; j < BENCH_DISPATCH_PTRS; j++)
+            sink += bench_owner_linear(ptrs[j]);
+    uint64_t own_lin = esp_timer_get_time() - t0;
+
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_DISPATCH_ROUNDS; r++)
+        for (int j = 0; j < BENCH_DISPATCH_PTRS; j++)
+            sink += pool_owner_index(ptrs[j]);
+    uint64_t own_map = esp_timer_get_time() - t0;
+
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_DISPATCH_ROUNDS; r++)
+        for (int j = 0; j < BENCH_DISPATCH_PTRS; j++)
+            sink += bench_class_linear(needs[j]);
+    uint64_t cls_lin = esp_timer_get_time() - t0;
+
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_DISPATCH_ROUNDS; r++)
+        for (int j = 0; j < BENCH_DISPATCH_PTRS; j++)
+            sink += pool_class_for_need(needs[j]);
+    uint64_t cls_clz = esp_timer_get_time() - t0;
+    (void)sink;
+
+    const uint64_t calls = (uint64_t)BENCH_DISPATCH_ROUNDS * BENCH_DISPATCH_PTRS;
+    ESP_LOGI(TAG, "BENCH | free owner lookup: linear %llu ns/call, region map %llu ns/call",
+             (unsigned long long)(own_lin * 1000ULL / calls), (unsigned long long)(own_map * 1000ULL / calls));
+    ESP_LOGI(TAG, "BENCH | size class lookup: linear %llu ns/call, clz table %llu ns/call",
+             (unsigned long long)(cls_lin * 1000ULL / calls), (unsigned long long)(cls_clz * 1000ULL / calls));
+
+    for (int j = 0; j < BENCH_DISPATCH_PTRS; j++)
+    {
+        int pi = pool_owner_index(ptrs[j]);
+        if (pi >= 0)
+            pool_free(&pools[pi], ptrs[j]);
+        else if (ptrs[j])
+            heap_caps_free(ptrs[j]);
+    }
+}
+
+// ---- latency ของ smart_pool_malloc/free (รวม magazine + activity post) ----
+#define BENCH_SMART_ROUNDS 20000
+
+static void bench_smart_latency(void)
+{
+    static const size_t sizes[] = {24, 120, 600};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        uint64_t t_alloc = 0, t_free = 0;
+        for (int r = 0; r < BENCH_SMART_ROUNDS; r++)
+        {
+            uint64_t t0 = esp_timer_get_time();
+            void *p = smart_pool_malloc(sizes[s]);
+            uint64_t t1 = esp_timer_get_time();
+            smart_pool_free(p);
+            t_free += esp_timer_get_time() - t1;
+            t_alloc += t1 - t0;
+        }
+        ESP_LOGI(TAG, "BENCH | smart %4u B: malloc %llu ns, free %llu ns (avg, incl. timer read)", (unsigned)sizes[s],
+                 (unsigned long long)(t_alloc * 1000ULL / BENCH_SMART_ROUNDS),
+                 (unsigned long long)(t_free * 1000ULL / BENCH_SMART_ROUNDS));
+    }
+    pool_cache_task_exit();
+}
+
+// ---- bulk: ต้นทุนต่อบล็อกเมื่อจอง/คืนเป็นชุด ----
+#define BENCH_BULK_POOL_BLOCKS 256
+#define BENCH_BULK_BLOCKS_TOTAL 32768
+
+static void bench_bulk(pool_engine_t engine)
+{
+    static const size_t batches[] = {1, 8, 32, 128};
+    static void *buf[128];
+    pool_config_t cfg = {"BulkB", SMALL_POOL_BLOCK_SIZE, BENCH_BULK_POOL_BLOCKS, MALLOC_CAP_DEFAULT, GPIO_NUM_NC, engine,
+                         POOL_LAYOUT_HEADER};
+    static memory_pool_t pool; // เหตุผลเดียวกับ bench_alloc_free
+    if (!init_memory_pool(&pool, &cfg, 110 + (uint32_t)engine, NULL))
+        return;
+
+    // อ้างอิง: pool_malloc/pool_free ทีละบล็อก
+    uint64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_BULK_BLOCKS_TOTAL / 128; r++)
+    {
+        for (int j = 0; j < 128; j++)
+            buf[j] = pool_malloc(&pool);
+        for (int j = 0; j < 128; j++)
+            pool_free(&pool, buf[j]);
+    }
+    uint64_t single = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "BENCH | %s single: %llu ns/block (alloc+free)", pool_engine_name(engine),
+             (unsigned long long)(single * 1000ULL / BENCH_BULK_BLOCKS_TOTAL));
+
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+    {
+        size_t n = batches[b];
+        t0 = esp_timer_get_time();
+        for (size_t r = 0; r < BENCH_BULK_BLOCKS_TOTAL / n; r++)
+        {
+            size_t got = pool_malloc_bulk(&pool, buf, n);
+            pool_free_bulk(&pool, buf, got);
+        }
+        uint64_t us = esp_timer_get_time() - t0;
+        ESP_LOGI(TAG, "BENCH | %s bulk x%-3u: %llu ns/block (alloc+free)", pool_engine_name(engine), (unsigned)n,
+                 (unsigned long long)(us * 1000ULL / BENCH_BULK_BLOCKS_TOTAL));
+    }
+    deinit_memory_pool(&pool);
+}
+
+// ---- pool_sync: reader/writer ผสมตามสัดส่วน ----
+#define BENCH_RW_TASKS 4
+#define BENCH_RW_ITERS 20000
+
+typedef struct
+{
+    pool_sync_t sync;
+    uint32_t pair[2]; // writer แก้คู่กันใต้ write lock → reader ต้องเห็นเท่ากันเสมอ
+    uint32_t torn;
+    int write_pct;
+    pool_hist_t wait_hist; // เวลารอ lock ต่อครั้ง (us)
+    SemaphoreHandle_t start;
+    SemaphoreHandle_t done;
+} bench_rw_ctx_t;
+
+static void bench_rw_worker(void *arg)
+{
+    bench_rw_ctx_t *ctx = (bench_rw_ctx_t *)arg;
+    uint32_t rng = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle() | 1u;
+    xSemaphoreTake(ctx->start, portMAX_DELAY);
+    for (int i = 0; i < BENCH_RW_ITERS; i++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        bool write = (int)(rng % 100) < ctx->write_pct;
+        uint64_t t0 = esp_timer_get_time();
+        if (write)
+        {
+            if (!pool_sync_write_lock(&ctx->sync, portMAX_DELAY))
+                continue;
+            pool_hist_record(&ctx->wait_hist, esp_timer_get_time() - t0);
+            ctx->pair[0]++;
+            ctx->pair[1]++;
+            pool_sync_write_unlock(&ctx->sync);
+        }
+        else
+        {
+            if (!pool_sync_stats_lock(&ctx->sync, portMAX_DELAY))
+                continue;
+            pool_hist_record(&ctx->wait_hist, esp_timer_get_time() - t0);
+            if (__atomic_load_n(&ctx->pair[0], __ATOMIC_RELAXED) != __atomic_load_n(&ctx->pair[1], __ATOMIC_RELAXED))
+                __atomic_fetch_add(&ctx->torn, 1, __ATOMIC_RELAXED);
+            pool_sync_stats_unlock(&ctx->sync);
+        }
+    }
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+static void bench_rwlock(void)
+{
+    static const int write_pcts[] = {0, 5, 20, 50, 100};
+    static bench_rw_ctx_t ctx; // hist ใหญ่เกิน stack ของ bench task
+    static pool_hist_snap_t snap;
+    ESP_LOGI(TAG, "BENCH | pool_sync %d tasks x %d ops", BENCH_RW_TASKS, BENCH_RW_ITERS);
+    ESP_LOGI(TAG, "BENCH | read:write |     ops/s | wait p50/p99/max us | torn");
+    for (size_t r = 0; r < sizeof(write_pcts) / sizeof(write_pcts[0]); r++)
+    {
+        memset(&ctx, 0, sizeof(ctx));
+        pool_sync_init(&ctx.sync);
+        ctx.write_pct = write_pcts[r];
+        ctx.start = xSemaphoreCreateCounting(BENCH_RW_TASKS, 0);
+        ctx.done = xSemaphoreCreateCounting(BENCH_RW_TASKS, 0);
+        for (int i = 0; i < BENCH_RW_TASKS; i++)
+            xTaskCreate(bench_rw_worker, "BenchRW", 3072, &ctx, 5, NULL);
+
+        uint64_t t0 = esp_timer_get_time();
+        for (int i = 0; i < BENCH_RW_TASKS; i++)
+            xSemaphoreGive(ctx.start);
+        for (int i = 0; i < BENCH_RW_TASKS; i++)
+            xSemaphoreTake(ctx.done, portMAX_DELAY);
+        uint64_t us = esp_timer_get_time() - t0;
+
+        vSemaphoreDelete(ctx.start);
+        vSemaphoreDelete(ctx.done);
+        pool_sync_deinit(&ctx.sync);
+
+        pool_hist_snapshot(&ctx.wait_hist, &snap);
+        uint64_t ops = (uint64_t)BENCH_RW_TASKS * BENCH_RW_ITERS;
+        ESP_LOGI(TAG, "BENCH | %4d:%-5d | %9lu | %5lu / %5lu / %6lu | %lu", 100 - write_pcts[r], write_pcts[r],
+                 (unsigned long)(us ? ops * 1000000ULL / us : 0), (unsigned long)pool_hist_percentile(&snap, 0.50),
+                 (unsigned long)pool_hist_percentile(&snap, 0.99), (unsigned long)snap.max, (unsigned long)ctx.torn);
+    }
+}
+
+// ตาราง alloc+free ของทั้งสาม engine ที่ 1/2/4/8 task (host_test/bench_pools เรียกตรงได้)
+static void bench_engines(void)
+{
+    static const int task_counts[] = {1, 2, 4, 8};
+    ESP_LOGI(TAG, "BENCH | alloc+free, %d iters/task", BENCH_ITERS_PER_TASK);
+    ESP_LOGI(TAG, "BENCH | tasks |   locked ops/s | lock-free ops/s |  bitmap ops/s | lock-free speedup");
+    for (size_t i = 0; i < sizeof(task_counts) / sizeof(task_counts[0]); i++)
+    {
+        uint32_t locked = bench_alloc_free(POOL_ENGINE_LOCKED, task_counts[i]);
+        uint32_t lockfree = bench_alloc_free(POOL_ENGINE_LOCKFREE, task_counts[i]);
+        uint32_t bitmap = bench_alloc_free(POOL_ENGINE_BITMAP, task_counts[i]);
+        ESP_LOGI(TAG, "BENCH | %5d | %14lu | %15lu | %13lu | %6.2fx", task_counts[i], (unsigned long)locked,
+                 (unsigned long)lockfree, (unsigned long)bitmap, locked ? (double)lockfree / (double)locked : 0.0);
+    }
+}
+
+static void pool_bench_task(void *arg)
+{
+    bench_dispatch();
+    bench_smart_latency();
+    bench_bulk(POOL_ENGINE_LOCKED);
+    bench_bulk(POOL_ENGINE_LOCKFREE);
+    bench_bulk(POOL_ENGINE_BITMAP);
+    bench_rwlock();
+    bench_engines();
     vTaskDelete(NULL);
 }
+#endif
+
+// ============================
+//           Boot
+// ============================
+// โหลดจำนวนบล็อกจาก store แล้วสร้างทุกพูลใน region เดียว (ยังไม่สร้าง task ใด ๆ)
+static bool pools_boot(void)
+{
+    // ----- Load desired block counts from store (ถ้ามี) -----
+    size_t boot_counts[POOL_COUNT];
+    pools_persist_load_counts(boot_counts);
+
+    // ----- Init pools (ใช้จำนวนที่โหลดมา) ใน region เดียว -----
+    void *region_mem[POOL_COUNT];
+    if (!pools_region_reserve(boot_counts, region_mem))
+        return false;
+    for (int i = 0; i < POOL_COUNT; i++)
+    {
+        pool_config_t cfg = POOL_DEFAULTS[i]; // copy
+        cfg.block_count = boot_counts[i];     // override from store
+        if (!init_memory_pool(&pools[i], &cfg, (uint32_t)(i + 1), region_mem[i]))
+        {
+            ESP_LOGE(TAG, "Init %s failed", cfg.name);
+            return false;
+        }
+    }
+    pools_build_class_table();
+    for (int i = 0; i < POOL_COUNT; i++)
+        pools[i].activity_ch = pool_activity_register(POOL_DEFAULTS[i].name, POOL_DEFAULTS[i].led_pin);
+    return true;
+}
 
 // ============================
 //            app_main
@@ -664,26 +2693,19 @@ void app_main(void)
     gpio_set_level(LED_POOL_FULL, 0);
     gpio_set_level(LED_POOL_ERROR, 0);
 
-    // ----- Load desired block counts from NVS (ถ้ามี) -----
-    size_t boot_counts[POOL_COUNT];
-    pools_persist_load_counts_from_nvs(boot_counts);
-
-    // ----- Init pools (ใช้จำนวนที่โหลดมา) -----
-    for (int i = 0; i < POOL_COUNT; i++)
-    {
-        pool_config_t cfg = POOL_DEFAULTS[i]; // copy
-        cfg.block_count = boot_counts[i];     // override from NVS
-        if (!init_memory_pool(&pools[i], &cfg, (uint32_t)(i + 1)))
-        {
-            ESP_LOGE(TAG, "Init %s failed", cfg.name);
-            return;
-        }
-    }
+    if (!pools_boot())
+        return;
     print_pool_statistics();
 
     // ----- Tasks -----
     xTaskCreate(pool_monitor_task, "PoolMon", 4096, NULL, 5, NULL);
+    xTaskCreate(pool_elastic_task, "PoolElastic", 3072, NULL, 3, &g_elastic_task);
+    xTaskCreate(pool_persist_task, "PoolPersist", 4096, NULL, 2, &g_persist_task);
+    pool_activity_start(1);
     xTaskCreate(persistence_demo_task, "PersistD", 4096, NULL, 6, NULL);
+#if POOL_BENCH_ENABLE
+    xTaskCreate(pool_bench_task, "PoolBench", 4096, NULL, 4, NULL);
+#endif
 
     ESP_LOGI(TAG, "System up.");
 }
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ภาพสถิติของ pool หนึ่ง ณ ขณะหนึ่ง (ได้จาก pool_stats_snapshot)
+typedef struct
+{
+    size_t block_count;
+    size_t in_use;      // บล็อกที่ผู้ใช้ถืออยู่
+    size_t cached;      // บล็อกที่ค้างใน magazine
+    size_t peak_usage;  // มุมมอง depot (in_use + cached)
+    uint64_t allocations;
+    uint64_t deallocations;
+    uint32_t failures;
+} pool_stats_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // อ่านสถิติของ pool index 0..3 (Small, Medium, Large, Huge) โดยไม่ถือ lock/ไม่ block (ไม่ใช่ ISR)
+    // คืน false = index ผิด หรือ writer แทรกทุกรอบ (ค่าใน out ยังใช้ได้แต่อาจคลาดกันเล็กน้อย)
+    bool pool_stats_snapshot(int pool_index, pool_stats_t *out);
+
+    // ขอ flush สถิติลง NVS (ไม่บล็อก เรียกจากที่ไหนก็ได้) — persist task เป็นคนเขียนจริง
+    void pools_persist_save_now(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,170 @@
+#include "persist_store.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+
+static const char *STORE_TAG = "PERSIST";
+
+static persist_backend_t s_backend = PERSIST_BACKEND_NVS;
+static bool s_ready = false;
+static nvs_handle_t s_nvs = 0;
+static persist_store_stats_t s_stats;
+static uint64_t s_txn_us = 0;   // เวลาที่ใช้ใน transaction ปัจจุบัน (สะสมจาก set)
+
+// ===== RAM backend =====
+typedef struct
+{
+    char key[16]; // NVS จำกัด key ไม่เกิน 15 ตัวอักษร
+    uint64_t val;
+    bool used;
+} ram_entry_t;
+
+static ram_entry_t s_ram[PERSIST_RAM_MAX_KEYS];
+
+static ram_entry_t *ram_find(const char *key, bool create)
+{
+    ram_entry_t *free_slot = NULL;
+    for (int i = 0; i < PERSIST_RAM_MAX_KEYS; i++)
+    {
+        if (s_ram[i].used && strncmp(s_ram[i].key, key, sizeof(s_ram[i].key)) == 0)
+            return &s_ram[i];
+        if (!s_ram[i].used && !free_slot)
+            free_slot = &s_ram[i];
+    }
+    if (!create || !free_slot)
+        return NULL;
+    strncpy(free_slot->key, key, sizeof(free_slot->key) - 1);
+    free_slot->key[sizeof(free_slot->key) - 1] = '\0';
+    free_slot->used = true;
+    return free_slot;
+}
+
+// ===== NVS backend =====
+static bool nvs_open_namespace(const char *ns)
+{
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_LOGW(STORE_TAG, "NVS re-init required...");
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(STORE_TAG, "NVS init failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    err = nvs_open(ns, NVS_READWRITE, &s_nvs);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(STORE_TAG, "NVS open ns '%s' failed: %s", ns, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+bool persist_store_open(persist_backend_t backend, const char *ns)
+{
+    if (s_ready)
+        return true;
+    s_backend = backend;
+    if (backend == PERSIST_BACKEND_RAM)
+        memset(s_ram, 0, sizeof(s_ram));
+    else if (!nvs_open_namespace(ns))
+        return false;
+    s_ready = true;
+    ESP_LOGI(STORE_TAG, "store ready (%s, ns=%s)", persist_store_backend_name(), ns);
+    return true;
+}
+
+esp_err_t persist_store_get_u32(const char *key, uint32_t *out)
+{
+    if (!s_ready)
+        return ESP_ERR_INVALID_STATE;
+    if (s_backend == PERSIST_BACKEND_NVS)
+        return nvs_get_u32(s_nvs, key, out);
+    ram_entry_t *e = ram_find(key, false);
+    if (!e)
+        return ESP_ERR_NVS_NOT_FOUND;
+    *out = (uint32_t)e->val;
+    return ESP_OK;
+}
+
+esp_err_t persist_store_get_u64(const char *key, uint64_t *out)
+{
+    if (!s_ready)
+        return ESP_ERR_INVALID_STATE;
+    if (s_backend == PERSIST_BACKEND_NVS)
+        return nvs_get_u64(s_nvs, key, out);
+    ram_entry_t *e = ram_find(key, false);
+    if (!e)
+        return ESP_ERR_NVS_NOT_FOUND;
+    *out = e->val;
+    return ESP_OK;
+}
+
+static esp_err_t store_set(const char *key, uint64_t val, bool wide)
+{
+    if (!s_ready)
+        return ESP_ERR_INVALID_STATE;
+    uint64_t t0 = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+    if (s_backend == PERSIST_BACKEND_NVS)
+    {
+        err = wide ? nvs_set_u64(s_nvs, key, val) : nvs_set_u32(s_nvs, key, (uint32_t)val);
+    }
+    else
+    {
+        ram_entry_t *e = ram_find(key, true);
+        if (e)
+            e->val = val;
+        else
+            err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    s_txn_us += esp_timer_get_time() - t0;
+    if (err == ESP_OK)
+        s_stats.key_writes++;
+    return err;
+}
+
+esp_err_t persist_store_set_u32(const char *key, uint32_t val) { return store_set(key, val, false); }
+esp_err_t persist_store_set_u64(const char *key, uint64_t val) { return store_set(key, val, true); }
+
+esp_err_t persist_store_commit(void)
+{
+    if (!s_ready)
+        return ESP_ERR_INVALID_STATE;
+    uint64_t t0 = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+    if (s_backend == PERSIST_BACKEND_NVS)
+        err = nvs_commit(s_nvs);
+    else if (PERSIST_RAM_COMMIT_DELAY_MS > 0)
+        vTaskDelay(pdMS_TO_TICKS(PERSIST_RAM_COMMIT_DELAY_MS));
+
+    uint64_t us = s_txn_us + (esp_timer_get_time() - t0);
+    s_txn_us = 0;
+    if (err != ESP_OK)
+    {
+        s_stats.commit_failures++;
+        return err;
+    }
+    s_stats.commits++;
+    s_stats.txn_us_total += us;
+    if (us > s_stats.txn_us_max)
+        s_stats.txn_us_max = (uint32_t)us;
+    return ESP_OK;
+}
+
+void persist_store_get_stats(persist_store_stats_t *out)
+{
+    *out = s_stats;
+}
+
+const char *persist_store_backend_name(void)
+{
+    return s_backend == PERSIST_BACKEND_RAM ? "ram" : "nvs";
+}
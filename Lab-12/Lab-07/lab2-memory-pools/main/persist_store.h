@@ -0,0 +1,53 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// ===== Config =====
+#ifndef PERSIST_RAM_MAX_KEYS
+#define PERSIST_RAM_MAX_KEYS 32
+#endif
+#ifndef PERSIST_RAM_COMMIT_DELAY_MS
+#define PERSIST_RAM_COMMIT_DELAY_MS 0 // จำลองเวลาเขียน flash ของ backend RAM (0 = ไม่หน่วง)
+#endif
+
+// ที่เก็บ key/value สำหรับ persistence stage
+// - NVS: ของจริงบน flash
+// - RAM: stand-in ไม่แตะ flash ใช้วัดจำนวนครั้งที่เขียน/commit และ latency ตอนทดสอบ
+typedef enum
+{
+    PERSIST_BACKEND_NVS = 0,
+    PERSIST_BACKEND_RAM,
+} persist_backend_t;
+
+typedef struct
+{
+    uint32_t key_writes;      // set ที่ส่งถึง backend
+    uint32_t commits;
+    uint32_t commit_failures;
+    uint64_t txn_us_total;    // เวลา set+commit รวมทุก transaction
+    uint32_t txn_us_max;
+} persist_store_stats_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // เปิด namespace (NVS) หรือเคลียร์ตาราง (RAM) เรียกซ้ำได้
+    bool persist_store_open(persist_backend_t backend, const char *ns);
+
+    esp_err_t persist_store_get_u32(const char *key, uint32_t *out);
+    esp_err_t persist_store_get_u64(const char *key, uint64_t *out);
+
+    // set ค้างไว้ใน transaction จนกว่าจะ persist_store_commit
+    esp_err_t persist_store_set_u32(const char *key, uint32_t val);
+    esp_err_t persist_store_set_u64(const char *key, uint64_t val);
+    esp_err_t persist_store_commit(void);
+
+    void persist_store_get_stats(persist_store_stats_t *out);
+    const char *persist_store_backend_name(void);
+
+#ifdef __cplusplus
+}
+#endif
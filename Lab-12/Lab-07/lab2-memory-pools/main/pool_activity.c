@@ -0,0 +1,85 @@
+#include "pool_activity.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *ACT_TAG = "POOL_ACT";
+
+uint32_t pool_activity_counts[POOL_ACTIVITY_MAX_CHANNELS];
+
+typedef struct
+{
+    const char *name;
+    gpio_num_t led_pin;
+    uint32_t seen;     // ค่าตัวนับที่ task อ่านไปล่าสุด (ต่อรอบ LED)
+    uint32_t reported; // ค่าตัวนับตอน report ล่าสุด
+    bool led_on;
+} activity_channel_t;
+
+static activity_channel_t s_channels[POOL_ACTIVITY_MAX_CHANNELS];
+static int s_channel_count = 0;
+static TaskHandle_t s_task = NULL;
+
+int pool_activity_register(const char *name, gpio_num_t led_pin)
+{
+    if (s_channel_count >= POOL_ACTIVITY_MAX_CHANNELS)
+        return -1;
+    int ch = s_channel_count++;
+    s_channels[ch].name = name;
+    s_channels[ch].led_pin = led_pin;
+    s_channels[ch].seen = 0;
+    s_channels[ch].reported = 0;
+    s_channels[ch].led_on = false;
+    pool_activity_counts[ch] = 0;
+    return ch;
+}
+
+static void pool_activity_task(void *arg)
+{
+    (void)arg;
+    TickType_t last_wake = xTaskGetTickCount();
+    uint64_t last_report_us = esp_timer_get_time();
+    TickType_t period = pdMS_TO_TICKS(POOL_ACTIVITY_PERIOD_MS);
+    if (period == 0)
+        period = 1;
+
+    while (1)
+    {
+        vTaskDelayUntil(&last_wake, period);
+
+        // LED: มีกิจกรรมในรอบนี้ → ติด, รอบถัดไปดับ (กิจกรรมต่อเนื่องจะเห็นเป็นกระพริบ)
+        for (int ch = 0; ch < s_channel_count; ch++)
+        {
+            activity_channel_t *c = &s_channels[ch];
+            uint32_t now = __atomic_load_n(&pool_activity_counts[ch], __ATOMIC_RELAXED);
+            bool on = (now != c->seen) && !c->led_on;
+            c->seen = now;
+            if (on != c->led_on)
+            {
+                gpio_set_level(c->led_pin, on ? 1 : 0);
+                c->led_on = on;
+            }
+        }
+
+        uint64_t now_us = esp_timer_get_time();
+        if (now_us - last_report_us >= (uint64_t)POOL_ACTIVITY_REPORT_MS * 1000ULL)
+        {
+            float secs = (float)(now_us - last_report_us) / 1e6f;
+            for (int ch = 0; ch < s_channel_count; ch++)
+            {
+                activity_channel_t *c = &s_channels[ch];
+                uint32_t delta = c->seen - c->reported; // wrap-safe
+                c->reported = c->seen;
+                if (delta)
+                    ESP_LOGI(ACT_TAG, "ACT | %-6s %8.1f alloc/s", c->name, (double)((float)delta / secs));
+            }
+            last_report_us = now_us;
+        }
+    }
+}
+
+bool pool_activity_start(UBaseType_t priority)
+{
+    if (s_task)
+        return true;
+    return xTaskCreate(pool_activity_task, "PoolAct", 2560, NULL, priority, &s_task) == pdPASS;
+}
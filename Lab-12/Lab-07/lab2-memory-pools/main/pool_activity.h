@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+
+// ===== Config =====
+#ifndef POOL_ACTIVITY_MAX_CHANNELS
+#define POOL_ACTIVITY_MAX_CHANNELS 8
+#endif
+#ifndef POOL_ACTIVITY_PERIOD_MS
+#define POOL_ACTIVITY_PERIOD_MS 50 // รอบอ่านตัวนับ + กระพริบ LED
+#endif
+#ifndef POOL_ACTIVITY_REPORT_MS
+#define POOL_ACTIVITY_REPORT_MS 5000 // รอบ log อัตรา (ครั้ง/วินาที)
+#endif
+
+// ไฟแสดงกิจกรรมแบบ asynchronous:
+// - ฝั่ง allocator แค่ atomic increment ตัวนับของ channel (ไม่แตะ GPIO ไม่ delay)
+// - task ลำดับความสำคัญต่ำอ่าน delta ทุก POOL_ACTIVITY_PERIOD_MS แล้วแปลงเป็นพัลส์ LED + อัตรา
+extern uint32_t pool_activity_counts[POOL_ACTIVITY_MAX_CHANNELS];
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // ลงทะเบียน channel (เรียกก่อน pool_activity_start) คืน index หรือ -1 ถ้าเต็ม
+    int pool_activity_register(const char *name, gpio_num_t led_pin);
+
+    // สร้าง indicator task
+    bool pool_activity_start(UBaseType_t priority);
+
+    // Hot path: เรียกได้จากทุก task (และ ISR) ราคาเท่า atomic add หนึ่งครั้ง
+    static inline void pool_activity_post(int ch)
+    {
+        if (ch >= 0 && ch < POOL_ACTIVITY_MAX_CHANNELS)
+            __atomic_fetch_add(&pool_activity_counts[ch], 1, __ATOMIC_RELAXED);
+    }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,61 @@
+#include "pool_hist.h"
+#include <stdio.h>
+#include <string.h>
+
+// ขอบบนของช่อง idx (ค่าสูงสุดที่ตกช่องนี้)
+static uint32_t bucket_upper(uint32_t idx)
+{
+    if (idx < 2 * POOL_HIST_SUB)
+        return idx;
+    uint32_t shift = idx / POOL_HIST_SUB - 1;
+    uint32_t lower = (POOL_HIST_SUB + idx % POOL_HIST_SUB) << shift;
+    return lower + (1u << shift) - 1;
+}
+
+// ไม่หยุดผู้บันทึก: แต่ละช่องอ่านแบบ atomic ทีละช่อง ค่าที่เข้ามาระหว่างคัดลอกอาจติดหรือไม่ติดก็ได้
+// sum: อ่าน sum_hi คร่อม sum จนค่าตรงกัน ถ้าผู้บันทึกยังไม่ได้ทดคำบน sum อาจต่ำไปหนึ่งรอบชั่วคราว
+void pool_hist_snapshot(const pool_hist_t *h, pool_hist_snap_t *out)
+{
+    out->count = 0;
+    for (uint32_t i = 0; i < POOL_HIST_BUCKETS; i++)
+    {
+        out->buckets[i] = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        out->count += out->buckets[i];
+    }
+    out->max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    uint32_t hi, lo;
+    do
+    {
+        hi = __atomic_load_n(&h->sum_hi, __ATOMIC_ACQUIRE);
+        lo = __atomic_load_n(&h->sum, __ATOMIC_ACQUIRE);
+    } while (hi != __atomic_load_n(&h->sum_hi, __ATOMIC_RELAXED));
+    out->sum = ((uint64_t)hi << 32) | lo;
+}
+
+uint32_t pool_hist_percentile(const pool_hist_snap_t *s, double q)
+{
+    if (s->count == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(q * (double)s->count + 0.999999);
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < POOL_HIST_BUCKETS; i++)
+    {
+        seen += s->buckets[i];
+        if (seen >= rank)
+        {
+            uint32_t up = bucket_upper(i);
+            return up < s->max ? up : s->max;
+        }
+    }
+    return s->max;
+}
+
+void pool_hist_format(const pool_hist_snap_t *s, char *buf, size_t len)
+{
+    snprintf(buf, len, "p50=%lu p90=%lu p99=%lu p99.9=%lu max=%lu",
+             (unsigned long)pool_hist_percentile(s, 0.50), (unsigned long)pool_hist_percentile(s, 0.90),
+             (unsigned long)pool_hist_percentile(s, 0.99), (unsigned long)pool_hist_percentile(s, 0.999),
+             (unsigned long)s->max);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// ===== Config =====
+#ifndef POOL_HIST_SUB_BITS
+#define POOL_HIST_SUB_BITS 3 // 8 ช่องย่อยต่อช่วงกำลังสอง → error สัมพัทธ์ <= 12.5%
+#endif
+#ifndef POOL_HIST_MAX_LOG2
+#define POOL_HIST_MAX_LOG2 20 // แยกช่องได้ถึง ~2^21 us (~2 s) เกินนี้ตกช่องสุดท้าย (max ยังเก็บค่าจริง)
+#endif
+
+#define POOL_HIST_SUB (1u << POOL_HIST_SUB_BITS)
+#define POOL_HIST_BUCKETS (POOL_HIST_SUB * (POOL_HIST_MAX_LOG2 - POOL_HIST_SUB_BITS + 2))
+
+// Histogram แบบ log-linear (HDR-style) ของ latency หน่วย us
+// - ค่า < 2*SUB ได้ช่องละค่า (ตรงเป๊ะ) ถัดไปแต่ละช่วง [2^k, 2^(k+1)) แบ่งเป็น SUB ช่องเท่ากัน
+// - ฝั่งบันทึกเป็น atomic add แบบ relaxed ล้วน ไม่มี lock → ผู้อ่าน snapshot ได้ขณะ allocator ทำงาน
+// - ทุกช่อง 32 บิต (atomic 64 บิตบน Xtensa เป็น libatomic ที่ถือ lock รวม) sum แยกเป็นคำล่าง + ตัวนับการวนรอบ
+typedef struct
+{
+    uint32_t buckets[POOL_HIST_BUCKETS];
+    uint32_t max;
+    uint32_t sum;    // ผลรวม us (32 บิตล่าง)
+    uint32_t sum_hi; // จำนวนครั้งที่ sum วนรอบ
+} pool_hist_t;
+
+// ผลอ่านแบบ snapshot (count คำนวณจาก buckets ที่คัดลอกมา จึงสอดคล้องกับ percentile เสมอ)
+typedef struct
+{
+    uint32_t buckets[POOL_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+} pool_hist_snap_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    static inline uint32_t pool_hist_bucket(uint32_t v)
+    {
+        if (v < 2 * POOL_HIST_SUB)
+            return v;
+        uint32_t msb = 31u - (uint32_t)__builtin_clz(v);
+        if (msb > POOL_HIST_MAX_LOG2)
+            return POOL_HIST_BUCKETS - 1;
+        uint32_t shift = msb - POOL_HIST_SUB_BITS;
+        return (shift + 1) * POOL_HIST_SUB + ((v >> shift) - POOL_HIST_SUB);
+    }
+
+    // Hot path: บันทึก n ครั้งของค่า v (n > 1 = ค่าเฉลี่ยต่อบล็อกของ bulk call)
+    static inline void pool_hist_record_n(pool_hist_t *h, uint64_t v, uint32_t n)
+    {
+        uint32_t v32 = v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+        uint64_t add64 = v * n;
+        uint32_t add = add64 > UINT32_MAX ? UINT32_MAX : (uint32_t)add64;
+        __atomic_fetch_add(&h->buckets[pool_hist_bucket(v32)], n, __ATOMIC_RELAXED);
+        uint32_t old = __atomic_fetch_add(&h->sum, add, __ATOMIC_RELAXED);
+        if ((uint32_t)(old + add) < old)
+            __atomic_fetch_add(&h->sum_hi, 1, __ATOMIC_RELAXED); // ทดไปคำบน (นานๆ ครั้ง)
+        uint32_t m = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+        while (v32 > m &&
+               !__atomic_compare_exchange_n(&h->max, &m, v32, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+        }
+    }
+
+    static inline void pool_hist_record(pool_hist_t *h, uint64_t v) { pool_hist_record_n(h, v, 1); }
+
+    void pool_hist_snapshot(const pool_hist_t *h, pool_hist_snap_t *out);
+
+    // q ในช่วง 0..1 คืนขอบบนของช่องที่มี rank นั้น (ไม่เกิน max จริง)
+    uint32_t pool_hist_percentile(const pool_hist_snap_t *s, double q);
+
+    // "p50=.. p90=.. p99=.. p99.9=.. max=.." ลง buf
+    void pool_hist_format(const pool_hist_snap_t *s, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,25 +1,185 @@
 #include "pool_sync.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
 
-#define MAX_READERS 16
 static const char *SYNC_TAG = "POOL_SYNC";
 
+// node ของ task ที่รอ lock อยู่บน stack ของ task นั้นเอง (อยู่จนกว่าจะได้ notification ของตัวเอง)
+typedef struct pool_sync_waiter
+{
+    struct pool_sync_waiter *next;
+    TaskHandle_t task;
+    UBaseType_t prio;
+    bool writer;
+    volatile bool woken; // ตั้งใต้ spin โดยผู้ปลุกก่อนส่ง notification
+} pool_sync_waiter_t;
+
+// ===== Instrumentation: hold/wait ต่อ lock + wait-for graph =====
+// fast path แตะแค่ esp_timer ตอนได้/ปล่อย write lock; ที่เหลือเกิดใน slow path เท่านั้น
+#if POOL_SYNC_DEBUG
+typedef struct
+{
+    TaskHandle_t task; // NULL = slot ว่าง
+    pool_sync_t *lock; // lock ที่ task นี้รออยู่ (ขอบ task → lock → owner)
+} sync_wait_edge_t;
+
+static pool_sync_t *s_locks[POOL_SYNC_MAX_TRACKED]; // lock ที่ตั้งชื่อแล้ว (แสดงใน dump)
+static sync_wait_edge_t s_edges[POOL_SYNC_MAX_WAITERS];
+static portMUX_TYPE s_graph_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void dbg_register(pool_sync_t *s, bool add)
+{
+    portENTER_CRITICAL(&s_graph_mux);
+    int slot = -1;
+    for (int i = 0; i < POOL_SYNC_MAX_TRACKED; i++)
+    {
+        if (s_locks[i] == s)
+        {
+            slot = i; // ลงทะเบียนไว้แล้ว
+            break;
+        }
+        if (!s_locks[i] && slot < 0)
+            slot = i;
+    }
+    if (slot >= 0 && (add || s_locks[slot] == s))
+        s_locks[slot] = add ? s : NULL;
+    portEXIT_CRITICAL(&s_graph_mux);
+}
+
+// เรียกก่อนเก็บ owner: ผู้อ่านที่เห็น owner แล้วจะเห็นเวลาเริ่มถือที่ถูกต้อง
+static inline void dbg_acquired(pool_sync_t *s)
+{
+    __atomic_store_n(&s->acq_us, (uint32_t)esp_timer_get_time(), __ATOMIC_RELAXED);
+}
+
+// esp_timer เป็นนาฬิกาเดียวทั้งระบบ (CCOUNT แยกต่อ core ใช้ไม่ได้เมื่อผู้อ่านหรือ owner อยู่คนละ core)
+// ผลต่าง 32 บิตถูกต้องถึง ~71 นาที ค่าติดลบ (อ่าน acq_us ใหม่กว่าเวลาที่อ่าน) ถือเป็น 0
+static inline uint32_t dbg_held_us(const pool_sync_t *s)
+{
+    uint32_t acq = __atomic_load_n(&s->acq_us, __ATOMIC_RELAXED);
+    int32_t d = (int32_t)((uint32_t)esp_timer_get_time() - acq);
+    return d > 0 ? (uint32_t)d : 0;
+}
+
+// writer ถือ lock อยู่คนเดียว → อัปเดต max ได้โดยไม่ต้อง CAS
+static inline void dbg_released(pool_sync_t *s)
+{
+    uint32_t us = dbg_held_us(s);
+    if (us > s->hold_max_us)
+        __atomic_store_n(&s->hold_max_us, us, __ATOMIC_RELAXED);
+    if (us > POOL_SYNC_HOLD_WARN_US)
+        __atomic_fetch_add(&s->long_holds, 1, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t dbg_contended(pool_sync_t *s)
+{
+    __atomic_fetch_add(&s->contended, 1, __ATOMIC_RELAXED);
+    return esp_timer_get_time();
+}
+
+static void dbg_wait_done(pool_sync_t *s, uint64_t t0)
+{
+    uint64_t w = esp_timer_get_time() - t0;
+    uint32_t us = w > UINT32_MAX ? UINT32_MAX : (uint32_t)w;
+    uint32_t m = __atomic_load_n(&s->wait_max_us, __ATOMIC_RELAXED);
+    while (us > m &&
+           !__atomic_compare_exchange_n(&s->wait_max_us, &m, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+// เรียกใต้ s_graph_mux: เดินจาก owner ของ lock ไปตาม "owner รอ lock ไหนอยู่" ถ้าถึง target = วงจร
+// lock ที่ไม่มี writer (ว่างหรือ reader ถือ) ตัดเส้นทาง
+static bool graph_reaches_locked(pool_sync_t *lock, TaskHandle_t target)
+{
+    for (int hop = 0; lock && hop <= POOL_SYNC_MAX_WAITERS; hop++)
+    {
+        TaskHandle_t owner = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+        if (!owner)
+            return false;
+        if (owner == target)
+            return true;
+        lock = NULL;
+        for (int i = 0; i < POOL_SYNC_MAX_WAITERS; i++)
+        {
+            if (s_edges[i].task == owner)
+            {
+                lock = s_edges[i].lock;
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+// ต่อขอบ self → s ก่อนเข้าคิว แล้วตรวจวงจรทันที (วงจรที่เกิดขึ้นต้องมี task ตัวสุดท้ายที่ต่อขอบปิดวง)
+static int graph_wait_begin(pool_sync_t *s)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int slot = -1;
+    portENTER_CRITICAL(&s_graph_mux);
+    for (int i = 0; i < POOL_SYNC_MAX_WAITERS; i++)
+    {
+        if (!s_edges[i].task)
+        {
+            s_edges[i].task = self;
+            s_edges[i].lock = s;
+            slot = i;
+            break;
+        }
+    }
+    bool cycle = graph_reaches_locked(s, self);
+    portEXIT_CRITICAL(&s_graph_mux);
+
+    if (cycle)
+    {
+        __atomic_fetch_add(&s->deadlocks, 1, __ATOMIC_RELAXED);
+        TaskHandle_t owner = __atomic_load_n(&s->owner, __ATOMIC_RELAXED);
+        ESP_LOGE(SYNC_TAG, "🚨 deadlock: %s waits on %s held by %s (wait-for cycle)", pcTaskGetName(self),
+                 s->name ? s->name : "?", owner ? pcTaskGetName(owner) : "-");
+    }
+    return slot;
+}
+
+static void graph_wait_end(int slot)
+{
+    if (slot < 0)
+        return;
+    portENTER_CRITICAL(&s_graph_mux);
+    s_edges[slot].task = NULL;
+    s_edges[slot].lock = NULL;
+    portEXIT_CRITICAL(&s_graph_mux);
+}
+#else
+static inline void dbg_register(pool_sync_t *s, bool add) { (void)s; (void)add; }
+static inline void dbg_acquired(pool_sync_t *s) { (void)s; }
+static inline void dbg_released(pool_sync_t *s) { (void)s; }
+static inline uint64_t dbg_contended(pool_sync_t *s) { (void)s; return 0; }
+static inline void dbg_wait_done(pool_sync_t *s, uint64_t t0) { (void)s; (void)t0; }
+static inline int graph_wait_begin(pool_sync_t *s) { (void)s; return -1; }
+static inline void graph_wait_end(int slot) { (void)slot; }
+#endif
+
 bool pool_sync_init(pool_sync_t *s)
 {
     if (!s)
         return false;
-    s->rw_mutex = xSemaphoreCreateMutex(); // priority inheritance
-    s->readers_sem = xSemaphoreCreateCounting(MAX_READERS, MAX_READERS);
-    s->readers = 0;
+    s->state = 0;
+    s->owner = NULL;
+    s->head = NULL;
+    s->tail = NULL;
+    s->woken = 0;
     s->spin = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
-
-    if (!s->rw_mutex || !s->readers_sem)
-    {
-        if (s->rw_mutex)
-            vSemaphoreDelete(s->rw_mutex);
-        if (s->readers_sem)
-            vSemaphoreDelete(s->readers_sem);
-        return false;
-    }
+#if POOL_SYNC_DEBUG
+    s->name = NULL;
+    s->acq_us = 0;
+    s->hold_max_us = 0;
+    s->wait_max_us = 0;
+    s->contended = 0;
+    s->long_holds = 0;
+    s->deadlocks = 0;
+#endif
     return true;
 }
 
@@ -27,82 +187,565 @@ void pool_sync_deinit(pool_sync_t *s)
 {
     if (!s)
         return;
-    if (s->rw_mutex)
-        vSemaphoreDelete(s->rw_mutex);
-    if (s->readers_sem)
-        vSemaphoreDelete(s->readers_sem);
-    s->rw_mutex = NULL;
-    s->readers_sem = NULL;
-    s->readers = 0;
+    uint32_t st = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+    if (st != 0)
+        ESP_LOGW(SYNC_TAG, "deinit while held/contended (state=0x%08lx)", (unsigned long)st);
+    dbg_register(s, false);
+    s->state = 0;
+    s->owner = NULL;
+    s->head = NULL;
+    s->tail = NULL;
 }
 
-bool pool_sync_write_lock(pool_sync_t *s, TickType_t to_ticks)
+// ===== คิว waiter (เรียกใต้ spin ทั้งหมด) =====
+// WAITERS ต้องค้างไว้ตราบที่ยังมีคนในคิวหรือมีคนที่ถูกปลุกแล้วยังไม่ได้แย่ง
+static void waiters_update_locked(pool_sync_t *s)
 {
-    if (!s || !s->rw_mutex)
-        return false;
+    if (!s->head && s->woken == 0)
+        __atomic_fetch_and(&s->state, ~POOL_SYNC_WAITERS, __ATOMIC_RELEASE);
+}
 
-    // block writers until all readers are out: เราใช้ readers_sem drain + mutex
-    if (xSemaphoreTake(s->rw_mutex, to_ticks) != pdTRUE)
-        return false;
+// ปลุกจากหัวคิว (ไม่ส่งต่อ lock ให้ task ที่ยังหลับ ให้ตื่นมาแย่งเอง):
+// writer ตัวเดียวเมื่อว่างสนิท, reader ต่อกันได้หลายตัวจนเจอ writer เมื่อไม่มี writer ถือ
+// คืน chain ของ node ที่ต้องส่ง notification หลังออกจาก spin
+static pool_sync_waiter_t *wake_locked(pool_sync_t *s)
+{
+    pool_sync_waiter_t *woken = NULL, **link = &woken;
+    while (s->head)
+    {
+        pool_sync_waiter_t *w = s->head;
+        uint32_t st = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+        if (st & POOL_SYNC_WRITER)
+            break;
+        if (w->writer && (st & POOL_SYNC_READERS_MASK))
+            break;
+        s->woken++;
+        s->head = w->next;
+        if (!s->head)
+            s->tail = NULL;
+        w->next = NULL;
+        w->woken = true;
+        *link = w;
+        link = &w->next;
+        if (w->writer)
+            break;
+    }
+    waiters_update_locked(s);
+    return woken;
+}
+
+static void enqueue_locked(pool_sync_t *s, pool_sync_waiter_t *node, bool front)
+{
+    node->next = NULL;
+    if (!s->head)
+    {
+        s->head = s->tail = node;
+    }
+    else if (front)
+    {
+        node->next = s->head;
+        s->head = node;
+    }
+    else
+    {
+        s->tail->next = node;
+        s->tail = node;
+    }
+}
+
+static void unlink_locked(pool_sync_t *s, pool_sync_waiter_t *node)
+{
+    pool_sync_waiter_t *prev = NULL;
+    for (pool_sync_waiter_t *w = s->head; w; prev = w, w = w->next)
+    {
+        if (w != node)
+            continue;
+        if (prev)
+            prev->next = w->next;
+        else
+            s->head = w->next;
+        if (s->tail == w)
+            s->tail = prev;
+        return;
+    }
+}
+
+static void notify_chain(pool_sync_waiter_t *w)
+{
+    while (w)
+    {
+        // อ่านให้ครบก่อน give: หลังจากนั้น waiter คืนได้ทันทีและ node (บน stack) หายไป
+        pool_sync_waiter_t *next = w->next;
+        TaskHandle_t task = w->task;
+        xTaskNotifyGive(task);
+        w = next;
+    }
+}
+
+// ===== Priority inheritance =====
+// ทะเบียนกลางต่อ owner: priority ฐาน (ก่อนถูกยกครั้งแรก) + การยกของแต่ละ lock ที่ owner ถืออยู่
+// priority ที่ควรเป็น = max(ฐาน, การยกทุกตัว) → ปล่อย lock หนึ่งถอดแค่การยกของ lock นั้น
+// ถือหลาย lock ซ้อนแล้วปล่อยสลับลำดับก็ไม่คืนค่าที่ lock อื่นยกไว้ให้เป็นฐาน
+// vTaskPrioritySet ทำนอก spin โดยผู้ apply ทีละคนต่อ owner คนที่มาระหว่างนั้นตั้ง dirty ให้วนอีกรอบ
+typedef struct
+{
+    const pool_sync_t *lock;
+    UBaseType_t prio;
+} pi_boost_t;
+
+typedef struct
+{
+    TaskHandle_t task; // NULL = slot ว่าง
+    UBaseType_t base;
+    uint8_t n;         // จำนวน lock ที่ยกอยู่ (0 = รอ apply ฐานแล้วคืน slot)
+    bool applying;
+    bool dirty;
+    pi_boost_t boost[POOL_SYNC_PI_HELD];
+} pi_owner_t;
+
+static pi_owner_t s_pi[POOL_SYNC_PI_OWNERS];
+static portMUX_TYPE s_pi_mux = portMUX_INITIALIZER_UNLOCKED;
 
-    // ปิดทาง readers ใหม่: ดึง permits ออกให้หมด
-    for (int i = 0; i < MAX_READERS; ++i)
+static pi_owner_t *pi_find_locked(TaskHandle_t task)
+{
+    for (int i = 0; i < POOL_SYNC_PI_OWNERS; i++)
+        if (s_pi[i].task == task)
+            return &s_pi[i];
+    return NULL;
+}
+
+static UBaseType_t pi_target_locked(const pi_owner_t *o)
+{
+    UBaseType_t t = o->base;
+    for (int i = 0; i < o->n; i++)
+        if (o->boost[i].prio > t)
+            t = o->boost[i].prio;
+    return t;
+}
+
+// เรียกใต้ spin: ถ้า writer ถือ lock อยู่และ prio สูงกว่าที่ lock นี้ยกไว้ → บันทึก คืน owner ที่ต้อง apply
+// ทะเบียนเต็ม = ไม่ยก (ทำงานถูกต้องแค่ไม่มี inheritance)
+static TaskHandle_t pi_plan_locked(pool_sync_t *s, UBaseType_t prio)
+{
+    TaskHandle_t owner = __atomic_load_n(&s->owner, __ATOMIC_RELAXED);
+    if (!owner || !(__atomic_load_n(&s->state, __ATOMIC_RELAXED) & POOL_SYNC_WRITER))
+        return NULL;
+    TaskHandle_t apply = NULL;
+    portENTER_CRITICAL(&s_pi_mux);
+    pi_owner_t *o = pi_find_locked(owner);
+    if (!o && prio > uxTaskPriorityGet(owner) && (o = pi_find_locked(NULL)) != NULL)
+        *o = (pi_owner_t){.task = owner, .base = uxTaskPriorityGet(owner)};
+    if (o)
     {
-        if (xSemaphoreTake(s->readers_sem, 0) != pdTRUE)
+        int i = 0;
+        while (i < o->n && o->boost[i].lock != s)
+            i++;
+        if (i == o->n && o->n < POOL_SYNC_PI_HELD)
+            o->boost[o->n++] = (pi_boost_t){.lock = s, .prio = 0};
+        if (i < o->n && prio > o->boost[i].prio)
         {
-            // หมายความว่า permits หมดแล้ว (ดี) หรือมีคนยืมอยู่
-            // ถ้ามี readers ค้าง: spin รอแบบสุภาพ
-            // เราไม่ใช้ vTaskDelay(1) ตรงนี้ เพราะมีโอกาสเกิด priority inversion
-            // ใช้ polling สั้น ๆ + yield
-            while (s->readers > 0)
-            {
-                taskYIELD();
-            }
+            o->boost[i].prio = prio; // เพิ่มได้อย่างเดียวระหว่างถือ
+            apply = owner;
+        }
+    }
+    portEXIT_CRITICAL(&s_pi_mux);
+    return apply;
+}
+
+// เรียกใต้ spin ตอน owner ปล่อย lock: ถอดการยกของ lock นี้ คืน true = ต้อง apply ใหม่
+static bool pi_drop_locked(const pool_sync_t *s, TaskHandle_t owner)
+{
+    bool apply = false;
+    portENTER_CRITICAL(&s_pi_mux);
+    pi_owner_t *o = pi_find_locked(owner);
+    for (int i = 0; o && i < o->n; i++)
+    {
+        if (o->boost[i].lock == s)
+        {
+            o->boost[i] = o->boost[--o->n];
+            apply = true;
             break;
         }
     }
-    // ถึงตรงนี้ readers ใหม่จะเข้าไม่ได้, readers เดิมออกหมด (readers==0)
-    return true;
+    portEXIT_CRITICAL(&s_pi_mux);
+    return apply;
 }
 
-void pool_sync_write_unlock(pool_sync_t *s)
+// ตั้ง priority ของ task ให้ตรงทะเบียน (นอก spin) slot ที่ไม่มีการยกเหลือคืนหลัง apply ฐานแล้วเท่านั้น
+// → การยกใหม่ที่แทรกระหว่างนั้นใช้ฐานเดิม ไม่จำค่าที่ถูกยกค้างเป็นฐาน
+static void pi_apply(TaskHandle_t task)
 {
-    if (!s || !s->rw_mutex)
+    portENTER_CRITICAL(&s_pi_mux);
+    pi_owner_t *o = pi_find_locked(task);
+    if (!o || o->applying)
+    {
+        if (o)
+            o->dirty = true;
+        portEXIT_CRITICAL(&s_pi_mux);
         return;
+    }
+    o->applying = true;
+    do
+    {
+        o->dirty = false;
+        UBaseType_t target = pi_target_locked(o);
+        portEXIT_CRITICAL(&s_pi_mux);
+        vTaskPrioritySet(task, target);
+        portENTER_CRITICAL(&s_pi_mux);
+    } while (o->dirty);
+    o->applying = false;
+    if (o->n == 0)
+        o->task = NULL;
+    portEXIT_CRITICAL(&s_pi_mux);
+}
+
+// notification ของคนอื่นที่กินไประหว่างรอ → คืนให้ task ตัวเอง (task เดียวกันอาจใช้ notification กับงานอื่น)
+static void give_back(uint32_t n)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    while (n--)
+        xTaskNotifyGive(self);
+}
+
+// ===== Fast path =====
+// writer แย่งได้เมื่อไม่มีใครถือ แม้มีคนรอ (WAITERS ค้างไว้ตามเดิม); reader ต้องไม่มีคนรอ (writer preference)
+static inline bool try_write(pool_sync_t *s)
+{
+    uint32_t st = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+    return !(st & ~POOL_SYNC_WAITERS) &&
+           __atomic_compare_exchange_n(&s->state, &st, st | POOL_SYNC_WRITER, false, __ATOMIC_ACQUIRE,
+                                       __ATOMIC_RELAXED);
+}
 
-    // เปิดทาง readers: เติม permits กลับ
-    UBaseType_t avail = uxSemaphoreGetCount(s->readers_sem);
-    for (UBaseType_t i = avail; i < MAX_READERS; ++i)
+static inline bool try_read(pool_sync_t *s)
+{
+    uint32_t st = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+    while (!(st & (POOL_SYNC_WRITER | POOL_SYNC_WAITERS)))
     {
-        xSemaphoreGive(s->readers_sem);
+        if (__atomic_compare_exchange_n(&s->state, &st, st + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
     }
-    xSemaphoreGive(s->rw_mutex);
+    return false;
 }
 
-bool pool_sync_stats_lock(pool_sync_t *s, TickType_t to_ticks)
+// ===== Slow path: วนลอง → ต่อคิว → หลับบน task notification =====
+// ผู้ถือส่วนใหญ่อยู่บนอีก core และปล่อยในไม่กี่ us → วนลองก่อนหลับ
+static bool lock_spin(pool_sync_t *s, bool writer)
 {
-    if (!s || !s->readers_sem)
-        return false;
-    if (xSemaphoreTake(s->readers_sem, to_ticks) != pdTRUE)
+    for (int i = 0; i < POOL_SYNC_SPIN_TRIES; i++)
+    {
+        if (writer ? try_write(s) : try_read(s))
+        {
+            if (writer)
+            {
+                dbg_acquired(s);
+                __atomic_store_n(&s->owner, xTaskGetCurrentTaskHandle(), __ATOMIC_RELAXED);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool lock_queued(pool_sync_t *s, bool writer, TickType_t to_ticks)
+{
+    pool_sync_waiter_t node = {
+        .next = NULL,
+        .task = xTaskGetCurrentTaskHandle(),
+        .prio = uxTaskPriorityGet(NULL),
+        .writer = writer,
+        .woken = false,
+    };
+    TickType_t start = xTaskGetTickCount();
+    uint32_t notes = 0; // notification ที่กินไปทั้งหมด (ของเรา + ของงานอื่นใน task นี้)
+    bool requeue = false;
+
+    for (;;)
+    {
+        TickType_t waited = xTaskGetTickCount() - start;
+        bool expired = to_ticks != portMAX_DELAY && waited >= to_ticks;
+
+        portENTER_CRITICAL(&s->spin);
+        if (requeue)
+            s->woken--; // คนที่ถูกปลุกกลับมาแย่งแล้ว
+        uint32_t st = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+        bool acquired = false;
+        for (;;)
+        {
+            // ใต้ spin: writer เข้าได้ถ้าว่างสนิท, reader ต้องไม่มีคนรอด้วย ยกเว้น reader ที่เพิ่งถูกปลุก
+            bool free_now = writer ? !(st & (POOL_SYNC_WRITER | POOL_SYNC_READERS_MASK))
+                                   : !(st & POOL_SYNC_WRITER) && (requeue || !(st & POOL_SYNC_WAITERS));
+            if (free_now)
+            {
+                if (__atomic_compare_exchange_n(&s->state, &st, writer ? (st | POOL_SYNC_WRITER) : (st + 1), true,
+                                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                {
+                    acquired = true;
+                    break;
+                }
+                continue;
+            }
+            if (expired)
+                break;
+            // ตั้ง WAITERS โดยเทียบกับ state ที่เห็น: ถ้า lock ถูกปล่อยระหว่างนี้ CAS พลาดแล้วลองใหม่ (ไม่ตกหล่น wakeup)
+            if (__atomic_compare_exchange_n(&s->state, &st, st | POOL_SYNC_WAITERS, true, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_RELAXED))
+                break;
+        }
+
+        if (acquired || expired)
+        {
+            pool_sync_waiter_t *w = NULL;
+            TaskHandle_t boost = NULL;
+            if (acquired && writer)
+            {
+                dbg_acquired(s);
+                __atomic_store_n(&s->owner, node.task, __ATOMIC_RELAXED);
+                // ได้ lock ขณะยังมีคนรอ → ยกตัวเองขึ้นเท่า waiter ที่สูงสุด
+                UBaseType_t top = 0;
+                for (pool_sync_waiter_t *q = s->head; q; q = q->next)
+                    if (q->prio > top)
+                        top = q->prio;
+                boost = top ? pi_plan_locked(s, top) : NULL;
+            }
+            waiters_update_locked(s);
+            if (!acquired)
+                w = wake_locked(s); // เราอาจเป็น writer ตัวที่กั้น reader ไว้
+            portEXIT_CRITICAL(&s->spin);
+            notify_chain(w);
+            if (boost)
+                pi_apply(boost);
+            give_back(notes);
+            return acquired;
+        }
+
+        // ต่อคิว: คนที่แพ้หลังถูกปลุกกลับหัวคิว (ไม่เสียลำดับ)
+        node.woken = false;
+        enqueue_locked(s, &node, requeue);
+        TaskHandle_t boost = pi_plan_locked(s, node.prio);
+        portEXIT_CRITICAL(&s->spin);
+        if (boost)
+            pi_apply(boost);
+
+        while (!node.woken)
+        {
+            waited = xTaskGetTickCount() - start;
+            if (to_ticks != portMAX_DELAY && waited >= to_ticks)
+            {
+                // หมดเวลา: ถอนตัวจากคิว (ถ้าหัวคิวเป็นเรา คนข้างหลังอาจได้สิทธิ์ต่อทันที)
+                portENTER_CRITICAL(&s->spin);
+                bool woken = node.woken;
+                pool_sync_waiter_t *w = NULL;
+                if (!woken)
+                {
+                    unlink_locked(s, &node);
+                    w = wake_locked(s);
+                }
+                portEXIT_CRITICAL(&s->spin);
+                notify_chain(w);
+                if (!woken)
+                {
+                    give_back(notes);
+                    return false;
+                }
+                break;
+            }
+            notes += ulTaskNotifyTake(pdTRUE, to_ticks == portMAX_DELAY ? portMAX_DELAY : to_ticks - waited);
+        }
+
+        // ถูกปลุกแล้ว: กิน notification ของผู้ปลุกก่อน (มันอาจยังไม่ได้ส่ง)
+        while (notes == 0)
+            notes += ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        notes--;
+        requeue = true; // กลับไปแย่งใหม่
+    }
+}
+
+static bool lock_slow(pool_sync_t *s, bool writer, TickType_t to_ticks)
+{
+    uint64_t t0 = dbg_contended(s);
+    bool ok = lock_spin(s, writer);
+    if (!ok && to_ticks != 0)
+    {
+        int edge = graph_wait_begin(s);
+        ok = lock_queued(s, writer, to_ticks);
+        graph_wait_end(edge);
+    }
+    dbg_wait_done(s, t0);
+    return ok;
+}
+
+// ===== Write lock (exclusive) =====
+bool pool_sync_write_lock(pool_sync_t *s, TickType_t to_ticks)
+{
+    if (!s)
         return false;
+    uint32_t expect = 0;
+    if (__atomic_compare_exchange_n(&s->state, &expect, POOL_SYNC_WRITER, false, __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED))
+    {
+        dbg_acquired(s);
+        __atomic_store_n(&s->owner, xTaskGetCurrentTaskHandle(), __ATOMIC_RELAXED);
+        return true;
+    }
+    return lock_slow(s, true, to_ticks);
+}
+
+void pool_sync_write_unlock(pool_sync_t *s)
+{
+    if (!s)
+        return;
+    dbg_released(s);
+    __atomic_store_n(&s->owner, NULL, __ATOMIC_RELAXED);
+    uint32_t expect = POOL_SYNC_WRITER;
+    if (__atomic_compare_exchange_n(&s->state, &expect, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return;
 
-    // นับ readers
-    taskENTER_CRITICAL(&s->spin);
-    s->readers++;
-    taskEXIT_CRITICAL(&s->spin);
+    // มีคนรอ: ถอดการยกของ lock นี้ใต้ spin เดียวกับที่ waiter บันทึกการยก (ไม่มีการยกค้างหลังปล่อย)
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&s->spin);
+    bool restore = pi_drop_locked(s, self);
+    __atomic_fetch_and(&s->state, ~POOL_SYNC_WRITER, __ATOMIC_RELEASE);
+    pool_sync_waiter_t *w = wake_locked(s);
+    portEXIT_CRITICAL(&s->spin);
 
-    return true;
+    notify_chain(w); // ปลุกก่อนลด priority ตัวเอง: waiter ที่สูงกว่าจะ preempt เราทันที
+    if (restore)
+        pi_apply(self);
+}
+
+// ===== Read (stats) lock (shared) =====
+bool pool_sync_stats_lock(pool_sync_t *s, TickType_t to_ticks)
+{
+    if (!s)
+        return false;
+    if (try_read(s))
+        return true;
+    return lock_slow(s, false, to_ticks);
 }
 
 void pool_sync_stats_unlock(pool_sync_t *s)
 {
-    if (!s || !s->readers_sem)
+    if (!s)
+        return;
+    uint32_t st = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+    while (!(st & POOL_SYNC_WAITERS))
+    {
+        if (__atomic_compare_exchange_n(&s->state, &st, st - 1, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return;
+    }
+
+    portENTER_CRITICAL(&s->spin);
+    __atomic_fetch_sub(&s->state, 1, __ATOMIC_RELEASE);
+    pool_sync_waiter_t *w = wake_locked(s);
+    portEXIT_CRITICAL(&s->spin);
+    notify_chain(w);
+}
+
+// ===== Instrumentation API =====
+void pool_sync_set_name(pool_sync_t *s, const char *name)
+{
+#if POOL_SYNC_DEBUG
+    if (!s)
         return;
+    s->name = name;
+    dbg_register(s, true);
+#else
+    (void)s;
+    (void)name;
+#endif
+}
+
+void pool_sync_get_info(pool_sync_t *s, pool_sync_info_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s)
+        return;
+    portENTER_CRITICAL(&s->spin);
+    uint32_t st = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+    out->owner = (st & POOL_SYNC_WRITER) ? __atomic_load_n(&s->owner, __ATOMIC_RELAXED) : NULL;
+    out->readers = st & POOL_SYNC_READERS_MASK;
+    for (pool_sync_waiter_t *w = s->head; w; w = w->next)
+        out->waiting++;
+    portEXIT_CRITICAL(&s->spin);
+#if POOL_SYNC_DEBUG
+    if (out->owner)
+        out->held_us = dbg_held_us(s);
+    out->hold_max_us = __atomic_load_n(&s->hold_max_us, __ATOMIC_RELAXED);
+    out->wait_max_us = __atomic_load_n(&s->wait_max_us, __ATOMIC_RELAXED);
+    out->contended = __atomic_load_n(&s->contended, __ATOMIC_RELAXED);
+    out->long_holds = __atomic_load_n(&s->long_holds, __ATOMIC_RELAXED);
+    out->deadlocks = __atomic_load_n(&s->deadlocks, __ATOMIC_RELAXED);
+#endif
+}
+
+bool pool_sync_check_deadlock(pool_sync_t *s)
+{
+#if POOL_SYNC_DEBUG
+    if (!s)
+        return false;
+    if ((__atomic_load_n(&s->state, __ATOMIC_RELAXED) & POOL_SYNC_WRITER) &&
+        __atomic_load_n(&s->owner, __ATOMIC_RELAXED) && dbg_held_us(s) > POOL_SYNC_HOLD_WARN_US)
+        return true;
 
-    taskENTER_CRITICAL(&s->spin);
-    if (s->readers > 0)
-        s->readers--;
-    taskEXIT_CRITICAL(&s->spin);
+    bool cycle = false;
+    portENTER_CRITICAL(&s_graph_mux);
+    for (int i = 0; i < POOL_SYNC_MAX_WAITERS && !cycle; i++)
+        if (s_edges[i].task && s_edges[i].lock == s)
+            cycle = graph_reaches_locked(s, s_edges[i].task);
+    portEXIT_CRITICAL(&s_graph_mux);
+    return cycle;
+#else
+    (void)s;
+    return false;
+#endif
+}
 
-    xSemaphoreGive(s->readers_sem);
+void pool_sync_dump(void)
+{
+#if POOL_SYNC_DEBUG
+    // คัดลอกใต้ mux: lock ที่ไม่ได้ตั้งชื่อ (เช่นของ benchmark บน stack) อาจหายไปหลังขอบถูกลบ
+    pool_sync_t *locks[POOL_SYNC_MAX_TRACKED];
+    struct
+    {
+        TaskHandle_t task, owner;
+        const char *lock;
+    } edges[POOL_SYNC_MAX_WAITERS];
+    portENTER_CRITICAL(&s_graph_mux);
+    memcpy(locks, s_locks, sizeof(locks));
+    for (int i = 0; i < POOL_SYNC_MAX_WAITERS; i++)
+    {
+        edges[i].task = s_edges[i].task;
+        edges[i].owner = edges[i].task ? __atomic_load_n(&s_edges[i].lock->owner, __ATOMIC_RELAXED) : NULL;
+        edges[i].lock = edges[i].task && s_edges[i].lock->name ? s_edges[i].lock->name : "?";
+    }
+    portEXIT_CRITICAL(&s_graph_mux);
+
+    for (int i = 0; i < POOL_SYNC_MAX_TRACKED; i++)
+    {
+        pool_sync_t *s = locks[i];
+        if (!s)
+            continue;
+        pool_sync_info_t in;
+        pool_sync_get_info(s, &in);
+        bool bad = pool_sync_check_deadlock(s);
+        char held[40] = "free";
+        if (in.owner)
+            snprintf(held, sizeof(held), "W:%s %luus", pcTaskGetName(in.owner), (unsigned long)in.held_us);
+        else if (in.readers)
+            snprintf(held, sizeof(held), "R:%lu", (unsigned long)in.readers);
+        ESP_LOG_LEVEL(bad ? ESP_LOG_WARN : ESP_LOG_INFO, SYNC_TAG,
+                      "%-6s | %-18s q=%lu  hold max=%luus  wait max=%luus  contended=%lu  long=%lu  deadlock=%lu%s",
+                      s->name, held, (unsigned long)in.waiting, (unsigned long)in.hold_max_us,
+                      (unsigned long)in.wait_max_us, (unsigned long)in.contended, (unsigned long)in.long_holds,
+                      (unsigned long)in.deadlocks, bad ? "  ⚠️" : "");
+    }
+    for (int i = 0; i < POOL_SYNC_MAX_WAITERS; i++)
+    {
+        if (!edges[i].task)
+            continue;
+        ESP_LOGI(SYNC_TAG, "WAIT   | %s → %s (writer %s)", pcTaskGetName(edges[i].task), edges[i].lock,
+                 edges[i].owner ? pcTaskGetName(edges[i].owner) : "-");
+    }
+#endif
 }
@@ -6,24 +6,81 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_attr.h"
+#include "sdkconfig.h"
 
 // ===== Config =====
 #ifndef SYNC_TIMEOUT_MS
 #define SYNC_TIMEOUT_MS 200 // ค่า default ถ้า caller ไม่กำหนด
 #endif
+#ifndef POOL_SYNC_SPIN_TRIES
+#define POOL_SYNC_SPIN_TRIES 64 // ลอง fast path ซ้ำก่อนต่อคิว (critical section ของพูลสั้นกว่าการหลับ/ปลุก)
+#endif
+#ifndef POOL_SYNC_DEBUG
+#define POOL_SYNC_DEBUG 1 // เก็บ hold/wait ต่อ lock + wait-for graph (0 = ตัดออกทั้งหมด)
+#endif
+#ifndef POOL_SYNC_HOLD_WARN_US
+#define POOL_SYNC_HOLD_WARN_US 2000 // writer ถือนานเกินนี้นับเป็น long hold
+#endif
+#ifndef POOL_SYNC_MAX_TRACKED
+#define POOL_SYNC_MAX_TRACKED 16 // lock ที่ลงทะเบียนได้ (เกินนี้ยังใช้ได้ แค่ไม่อยู่ใน dump/graph)
+#endif
+#ifndef POOL_SYNC_MAX_WAITERS
+#define POOL_SYNC_MAX_WAITERS 16 // task ที่รอพร้อมกันได้ใน wait-for graph
+#endif
+#ifndef POOL_SYNC_PI_OWNERS
+#define POOL_SYNC_PI_OWNERS 8 // owner ที่ถูกยก priority พร้อมกันได้ (เกินนี้ไม่ยก)
+#endif
+#ifndef POOL_SYNC_PI_HELD
+#define POOL_SYNC_PI_HELD 4 // lock ที่ยก owner คนเดียวกันพร้อมกันได้ (ถือซ้อนกัน)
+#endif
+
+// กลยุทธ์ซิงก์: reader/writer lock บน state word เดียว
+// - ไม่มีคู่แข่ง: CAS ครั้งเดียว ไม่เรียก kernel เลย
+// - มีคู่แข่ง: วนลองสั้น ๆ แล้วต่อคิว FIFO (ใต้ spin) หลับบน task notification
+// - waiter ถูกปลุกให้ตื่นมาแย่งใหม่ (แพ้ → กลับหัวคิว) ไม่ส่งต่อ lock ให้ task ที่ยังหลับอยู่
+//   → ไม่เกิด convoy ตอนแย่งหนัก
+// - writer preference: เมื่อมีคนรอในคิว reader ใหม่ต้องต่อคิว (ไม่แซง writer ที่รออยู่)
+// - priority inheritance: waiter ที่ priority สูงกว่ายก priority ของ writer ที่ถือ lock จนกว่าจะปล่อย
+//   (reader ที่ถืออยู่ไม่ถูกยก: ไม่ได้เก็บรายชื่อ reader) ทะเบียนต่อ owner อยู่ใน pool_sync.c
+//   ห้ามถือคร่อม FreeRTOS mutex ที่อาจกำลังสืบทอด priority (ฐานที่จำไว้จะเป็นค่าที่ถูกยกแล้ว)
+// - ใช้ spinlock แบบ portMUX_TYPE ป้องกันคิว + race สั้น ๆ ใน ISR/critical
+#define POOL_SYNC_READERS_MASK 0xFFFFu
+#define POOL_SYNC_WRITER (1u << 16)
+#define POOL_SYNC_WAITERS (1u << 17) // คิวไม่ว่างหรือมี writer ถูกปลุกค้าง → reader fast path และ unlock fast path ปิด
+
+struct pool_sync_waiter;
 
-// กลยุทธ์ซิงก์:
-// - ใช้ mutex (priority-inheritance) สำหรับ write (ปรับโครงสร้าง/แก้ freelist)
-// - ใช้ counting semaphore สำหรับ read (อ่านสถิติได้พร้อมกันหลาย task)
-// - ใช้ spinlock แบบ portMUX_TYPE ป้องกัน race สั้น ๆ ที่ต้อง atomic ใน ISR/critical
 typedef struct
 {
-    SemaphoreHandle_t rw_mutex;    // exclusive writers
-    SemaphoreHandle_t readers_sem; // permits for readers (MAX_READERS)
-    volatile int readers;          // readers in critical
-    portMUX_TYPE spin;             // short critical sections / ISR
+    uint32_t state;                      // [15:0] readers ที่ถืออยู่ | WRITER | WAITERS
+    TaskHandle_t owner;                  // writer ปัจจุบัน (NULL = ไม่รู้/ไม่มี) ใช้กับ priority inheritance
+    struct pool_sync_waiter *head, *tail; // คิว waiter (node อยู่บน stack ของ waiter)
+    uint8_t woken;                       // waiter ที่ถูกปลุกแล้วแต่ยังไม่ได้แย่งใหม่ (กัน reader ใหม่แซงระหว่างตื่น)
+    portMUX_TYPE spin;                   // คิว + short critical sections / ISR
+#if POOL_SYNC_DEBUG
+    const char *name;
+    uint32_t acq_us;      // esp_timer (us, 32 บิตล่าง) ตอน writer ได้ lock (fast path แตะแค่ช่องนี้)
+    uint32_t hold_max_us; // writer เท่านั้น: reader ไม่มีรายชื่อจึงวัด hold ไม่ได้
+    uint32_t wait_max_us; // เวลาใน slow path (วน + ต่อคิว) รวม timeout
+    uint32_t contended;   // ครั้งที่เข้า slow path
+    uint32_t long_holds;  // hold เกิน POOL_SYNC_HOLD_WARN_US
+    uint32_t deadlocks;   // วงจรใน wait-for graph ที่พบตอนต่อคิวบน lock นี้
+#endif
 } pool_sync_t;
 
+typedef struct
+{
+    TaskHandle_t owner;   // writer ที่ถืออยู่ (NULL = ว่าง/reader)
+    uint32_t readers;
+    uint32_t waiting;     // task ในคิว
+    uint32_t held_us;     // writer ถือมาแล้วนานเท่าไร (0 = ไม่มี writer)
+    uint32_t hold_max_us;
+    uint32_t wait_max_us;
+    uint32_t contended;
+    uint32_t long_holds;
+    uint32_t deadlocks;
+} pool_sync_info_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -41,13 +98,18 @@ extern "C"
     bool pool_sync_stats_lock(pool_sync_t *s, TickType_t to_ticks);
     void pool_sync_stats_unlock(pool_sync_t *s);
 
-    // Deadlock symptom checker (best-effort)
-    static inline bool pool_sync_check_deadlock(pool_sync_t *s)
-    {
-        (void)s;
-        // สามารถใส่เงื่อนไขเฉพาะงานได้ภายหลัง ตอนนี้คืน false ไป
-        return false;
-    }
+    // ===== Instrumentation (POOL_SYNC_DEBUG) =====
+    // ชื่อที่ใช้ใน dump (เก็บ pointer ไว้ ต้องอยู่ตลอดอายุ lock)
+    void pool_sync_set_name(pool_sync_t *s, const char *name);
+
+    // true = มีวงจรใน wait-for graph ที่ผ่าน lock นี้ หรือ writer ถือนานเกิน POOL_SYNC_HOLD_WARN_US
+    // เดินตาม owner ของ writer เท่านั้น: lock ที่ reader ถืออยู่ตัดเส้นทาง (best-effort)
+    bool pool_sync_check_deadlock(pool_sync_t *s);
+
+    void pool_sync_get_info(pool_sync_t *s, pool_sync_info_t *out);
+
+    // พิมพ์ทุก lock ที่ลงทะเบียน + ขอบของ wait-for graph (เรียกจาก monitor task)
+    void pool_sync_dump(void);
 
     // ===== ISR-safe criticals =====
     // หมายเหตุ: หลีกเลี่ยงการเรียก API FreeRTOS ที่ block/alloc ใน ISR